@@ -208,7 +208,32 @@ SOURCES += src/JuceLibraryCode/modules/juce_audio_basics/juce_audio_basics.cpp \
     src/nsmlistenerthread.cpp \
     src/jackoutputsdialog.cpp \
     src/sampleutils.cpp \
-    src/calcbpmdialog.cpp
+    src/calcbpmdialog.cpp \
+    src/batchprocessor.cpp \
+    src/projectsaver.cpp \
+    src/editjournal.cpp \
+    src/projectloader.cpp \
+    src/targzwriter.cpp \
+    src/h2drumkitarchiver.cpp \
+    src/exporter.cpp \
+    src/audiorecorder.cpp \
+    src/recorddialog.cpp \
+    src/streaminganalyser.cpp \
+    src/spectrogramrenderer.cpp \
+    src/sliceclassifier.cpp \
+    src/sequenceclock.cpp \
+    src/jobscheduler.cpp \
+    src/stretchergovernor.cpp \
+    src/memorylocker.cpp \
+    src/memoryaccountant.cpp \
+    src/scrubvoice.cpp \
+    src/waveformlayout.cpp \
+    src/audiofilereader.cpp \
+    src/previewplayer.cpp \
+    src/thumbnailer.cpp \
+    src/importbrowser.cpp \
+    src/libraryindex.cpp \
+    src/librarydialog.cpp
 HEADERS += src/JuceLibraryCode/JuceHeader.h \
     src/JuceLibraryCode/AppConfig.h \
     src/JuceLibraryCode/modules/juce_audio_basics/juce_audio_basics.h \
@@ -448,7 +473,33 @@ HEADERS += src/JuceLibraryCode/JuceHeader.h \
     src/nsmlistenerthread.h \
     src/jackoutputsdialog.h \
     src/sampleutils.h \
-    src/calcbpmdialog.h
+    src/calcbpmdialog.h \
+    src/batchprocessor.h \
+    src/projectsaver.h \
+    src/editjournal.h \
+    src/projectloader.h \
+    src/targzwriter.h \
+    src/h2drumkitarchiver.h \
+    src/exporter.h \
+    src/audiorecorder.h \
+    src/recorddialog.h \
+    src/streaminganalyser.h \
+    src/spectrogramrenderer.h \
+    src/sliceclassifier.h \
+    src/sequenceclock.h \
+    src/jobscheduler.h \
+    src/stretchergovernor.h \
+    src/memorylocker.h \
+    src/memoryaccountant.h \
+    src/scrubvoice.h \
+    src/waveformlayout.h \
+    src/audiofilereader.h \
+    src/previewplayer.h \
+    src/thumbnailer.h \
+    src/importbrowser.h \
+    src/libraryindex.h \
+    src/librarydialog.h \
+    src/realtimechecker.h
 FORMS += src/mainwindow.ui \
     src/optionsdialog.ui \
     src/helpform.ui \
@@ -458,7 +509,10 @@ FORMS += src/mainwindow.ui \
     src/exportdialog.ui \
     src/confirmbpmdialog.ui \
     src/jackoutputsdialog.ui \
-    src/calcbpmdialog.ui
+    src/calcbpmdialog.ui \
+    src/recorddialog.ui \
+    src/importbrowser.ui \
+    src/librarydialog.ui
 INCLUDEPATH += src \
     src/SndLibShuriken \
     src/JuceLibraryCode
@@ -485,6 +539,17 @@ else {
     DESTDIR = $$OUT_PWD/release
     DEFINES += "NDEBUG=1"
 }
+
+# Real-time safety checker: "qmake CONFIG+=rtcheck" reports heap allocation, locking and blocking
+# calls made from the audio callbacks. See src/realtimechecker.h. The same flag adds the offline
+# audio graph tests to tests/tests.pro
+rtcheck {
+    CONFIG += debug
+    DEFINES += "SHURIKEN_RTCHECK=1"
+    SOURCES += src/realtimechecker.cpp
+    QMAKE_LFLAGS += -rdynamic
+}
+
 OBJECTS_DIR = $${DESTDIR}/.obj
 MOC_DIR = $${DESTDIR}/.moc
 RCC_DIR = $${DESTDIR}/.rcc
@@ -23,10 +23,15 @@
 #include "audioanalyser.h"
 
 
+QMutex AudioAnalyser::s_aubioMutex;
+
+
 //==================================================================================================
 // Public Static:
 
-QList<int> AudioAnalyser::findOnsetFrameNums( const SharedSampleBuffer sampleBuffer, const DetectionSettings settings )
+QList<FrameNum> AudioAnalyser::findOnsetFrameNums( const SharedSampleBuffer sampleBuffer,
+                                                   const DetectionSettings settings,
+                                                   JobScheduler::Job* const job )
 {
     char_t* detectionMethod = (char_t*) settings.detectionMethod.data();
     smpl_t threshold = settings.threshold;
@@ -36,16 +41,18 @@ QList<int> AudioAnalyser::findOnsetFrameNums( const SharedSampleBuffer sampleBuf
     fvec_t* detectionResultVector;
     fvec_t* inputBuffer;
 
-    QList<int> slicePointFrameNumList;
+    QList<FrameNum> slicePointFrameNumList;
 
     const int numFrames = sampleBuffer->getNumFrames();
 
     const int vectorSize = 1;
     const int onsetData = 0;
-    int slicePointFrameNum = 0;
+    FrameNum slicePointFrameNum = 0;
 
     // Create onset detector and detection result vector
+    s_aubioMutex.lock();
     aubio_onset_t* onsetDetector = new_aubio_onset( detectionMethod, windowSize, hopSize, sampleRate );
+    s_aubioMutex.unlock();
     aubio_onset_set_threshold( onsetDetector, threshold );
     aubio_onset_set_minioi_s( onsetDetector, MIN_INTER_ONSET_SECS );
     detectionResultVector = new_fvec( vectorSize );
@@ -55,6 +62,11 @@ QList<int> AudioAnalyser::findOnsetFrameNums( const SharedSampleBuffer sampleBuf
     // Do onset detection
     for ( int frameNum = 0; frameNum < numFrames; frameNum += hopSize )
     {
+        if ( ! updateJobProgress( job, frameNum, numFrames ) )
+        {
+            break;
+        }
+
         fillAubioInputBuffer( inputBuffer, sampleBuffer, frameNum );
 
         aubio_onset_do( onsetDetector, inputBuffer, detectionResultVector );
@@ -68,19 +80,22 @@ QList<int> AudioAnalyser::findOnsetFrameNums( const SharedSampleBuffer sampleBuf
     }
 
     // Delete onset detector
+    s_aubioMutex.lock();
     del_aubio_onset( onsetDetector );
+    s_aubioMutex.unlock();
 
     // Clean up memory
     del_fvec( detectionResultVector );
     del_fvec( inputBuffer );
-    aubio_cleanup();
 
     return slicePointFrameNumList;
 }
 
 
 
-QList<int> AudioAnalyser::findBeatFrameNums( const SharedSampleBuffer sampleBuffer, const DetectionSettings settings )
+QList<FrameNum> AudioAnalyser::findBeatFrameNums( const SharedSampleBuffer sampleBuffer,
+                                                  const DetectionSettings settings,
+                                                  JobScheduler::Job* const job )
 {
     char_t* detectionMethod = (char_t*) settings.detectionMethod.data();
     smpl_t threshold = settings.threshold;
@@ -90,17 +105,19 @@ QList<int> AudioAnalyser::findBeatFrameNums( const SharedSampleBuffer sampleBuff
     fvec_t* detectionResultVector;
     fvec_t* inputBuffer;
 
-    QList<int> slicePointFrameNumList;
+    QList<FrameNum> slicePointFrameNumList;
 
     const int numFrames = sampleBuffer->getNumFrames();
 
     const int vectorSize = 2;
     const int beatData = 0;
 //    const int onsetData = 1;
-    int slicePointFrameNum = 0;
+    FrameNum slicePointFrameNum = 0;
 
     // Create beat detector and detection result vector
+    s_aubioMutex.lock();
     aubio_tempo_t* beatDetector = new_aubio_tempo( detectionMethod, windowSize, hopSize, sampleRate );
+    s_aubioMutex.unlock();
     aubio_tempo_set_threshold( beatDetector, threshold );
     detectionResultVector = new_fvec( vectorSize );
 
@@ -109,6 +126,11 @@ QList<int> AudioAnalyser::findBeatFrameNums( const SharedSampleBuffer sampleBuff
     // Do beat detection
     for ( int frameNum = 0; frameNum < numFrames; frameNum += hopSize )
     {
+        if ( ! updateJobProgress( job, frameNum, numFrames ) )
+        {
+            break;
+        }
+
         fillAubioInputBuffer( inputBuffer, sampleBuffer, frameNum );
 
         aubio_tempo_do( beatDetector, inputBuffer, detectionResultVector );
@@ -122,19 +144,22 @@ QList<int> AudioAnalyser::findBeatFrameNums( const SharedSampleBuffer sampleBuff
     }
 
     // Delete beat detector
+    s_aubioMutex.lock();
     del_aubio_tempo( beatDetector );
+    s_aubioMutex.unlock();
 
     // Clean up memory
     del_fvec( detectionResultVector );
     del_fvec( inputBuffer );
-    aubio_cleanup();
 
     return slicePointFrameNumList;
 }
 
 
 
-qreal AudioAnalyser::calcBPM( const SharedSampleBuffer sampleBuffer, const DetectionSettings settings )
+qreal AudioAnalyser::calcBPM( const SharedSampleBuffer sampleBuffer,
+                              const DetectionSettings settings,
+                              JobScheduler::Job* const job )
 {
     char_t* detectionMethod = (char_t*) settings.detectionMethod.data();
     smpl_t threshold = settings.threshold;
@@ -160,7 +185,9 @@ qreal AudioAnalyser::calcBPM( const SharedSampleBuffer sampleBuffer, const Detec
     qreal confidence = 0.0;
 
     // Create beat detector and detection result vector
+    s_aubioMutex.lock();
     aubio_tempo_t* beatDetector = new_aubio_tempo( detectionMethod, windowSize, hopSize, sampleRate );
+    s_aubioMutex.unlock();
     aubio_tempo_set_threshold( beatDetector, threshold );
     detectionResultVector = new_fvec( vectorSize );
 
@@ -169,6 +196,11 @@ qreal AudioAnalyser::calcBPM( const SharedSampleBuffer sampleBuffer, const Detec
     // Do bpm detection
     for ( int frameNum = 0; frameNum < numFrames; frameNum += hopSize )
     {
+        if ( ! updateJobProgress( job, frameNum, numFrames ) )
+        {
+            break;
+        }
+
         fillAubioInputBuffer( inputBuffer, sampleBuffer, frameNum );
 
         aubio_tempo_do( beatDetector, inputBuffer, detectionResultVector );
@@ -188,12 +220,13 @@ qreal AudioAnalyser::calcBPM( const SharedSampleBuffer sampleBuffer, const Detec
     }
 
     // Delete beat detector
+    s_aubioMutex.lock();
     del_aubio_tempo( beatDetector );
+    s_aubioMutex.unlock();
 
     // Clean up memory
     del_fvec( detectionResultVector );
     del_fvec( inputBuffer );
-    aubio_cleanup();
 
     if ( numDetections > 0 )
     {
@@ -205,6 +238,29 @@ qreal AudioAnalyser::calcBPM( const SharedSampleBuffer sampleBuffer, const Detec
 
 
 
+//==================================================================================================
+// Public:
+
+void AudioAnalyser::DetectionJob::run()
+{
+    switch ( m_type )
+    {
+    case FIND_ONSETS:
+        m_frameNums = findOnsetFrameNums( m_sampleBuffer, m_settings, this );
+        break;
+    case FIND_BEATS:
+        m_frameNums = findBeatFrameNums( m_sampleBuffer, m_settings, this );
+        break;
+    case CALC_BPM:
+        m_bpm = calcBPM( m_sampleBuffer, m_settings, this );
+        break;
+    default:
+        break;
+    }
+}
+
+
+
 //==================================================================================================
 // Private Static:
 
@@ -227,3 +283,17 @@ void AudioAnalyser::fillAubioInputBuffer( fvec_t* inputBuffer, const SharedSampl
         FloatVectorOperations::addWithMultiply( inputBuffer->data, sampleData, multiplier, numFramesToAdd );
     }
 }
+
+
+
+bool AudioAnalyser::updateJobProgress( JobScheduler::Job* const job, const int frameNum, const int numFrames )
+{
+    if ( job == NULL )
+    {
+        return true;
+    }
+
+    job->setProgress( static_cast<int>( frameNum * 100LL / numFrames ) );
+
+    return ! job->isCancelled();
+}
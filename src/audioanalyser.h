@@ -25,7 +25,9 @@
 
 #include <aubio/aubio.h>
 #include <QList>
+#include <QMutex>
 #include "samplebuffer.h"
+#include "jobscheduler.h"
 
 class AudioAnalyser
 {
@@ -41,18 +43,63 @@ public:
         uint_t sampleRate;
     };
 
-    static QList<int> findOnsetFrameNums( SharedSampleBuffer sampleBuffer,
-                                          DetectionSettings settings );
+    // If "job" is given, detection reports progress to it and stops early if it's cancelled
+    static QList<FrameNum> findOnsetFrameNums( SharedSampleBuffer sampleBuffer,
+                                               DetectionSettings settings,
+                                               JobScheduler::Job* job = NULL );
 
-    static QList<int> findBeatFrameNums( SharedSampleBuffer sampleBuffer,
-                                         DetectionSettings settings );
+    static QList<FrameNum> findBeatFrameNums( SharedSampleBuffer sampleBuffer,
+                                              DetectionSettings settings,
+                                              JobScheduler::Job* job = NULL );
 
-    static qreal calcBPM( SharedSampleBuffer sampleBuffer, DetectionSettings settings );
+    static qreal calcBPM( SharedSampleBuffer sampleBuffer,
+                          DetectionSettings settings,
+                          JobScheduler::Job* job = NULL );
+
+    // aubio's FFT setup is not thread-safe, so hold this while creating or deleting aubio detectors.
+    // aubio_cleanup() is never called as it would free FFT state that running detectors still use
+    static QMutex& getAubioMutex()                  { return s_aubioMutex; }
+
+    // Runs one of the above on a JobScheduler worker thread
+    class DetectionJob : public JobScheduler::Job
+    {
+    public:
+        enum Type { FIND_ONSETS, FIND_BEATS, CALC_BPM };
+
+        DetectionJob( SharedSampleBuffer sampleBuffer, DetectionSettings settings, Type type ) :
+            JobScheduler::Job(),
+            m_sampleBuffer( sampleBuffer ),
+            m_settings( settings ),
+            m_type( type ),
+            m_bpm( 0.0 )
+        {
+        }
+
+        void run();
+
+        Type getType() const                            { return m_type; }
+        SharedSampleBuffer getSampleBuffer() const      { return m_sampleBuffer; }
+        QList<FrameNum> getFrameNums() const            { return m_frameNums; }
+        qreal getBPM() const                            { return m_bpm; }
+
+    private:
+        const SharedSampleBuffer m_sampleBuffer;
+        const DetectionSettings m_settings;
+        const Type m_type;
+
+        QList<FrameNum> m_frameNums;
+        qreal m_bpm;
+    };
 
 private:
     static void fillAubioInputBuffer( fvec_t* inputBuffer,
                                       SharedSampleBuffer sampleBuffer,
                                       int sampleOffset );
+
+    // Returns false if the job has been cancelled
+    static bool updateJobProgress( JobScheduler::Job* job, int frameNum, int numFrames );
+
+    static QMutex s_aubioMutex;
 };
 
 #endif // AUDIOANALYSER_H
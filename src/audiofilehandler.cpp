@@ -148,9 +148,6 @@ QString AudioFileHandler::saveAudioFile( const QString dirPath,
 {
     Q_ASSERT( currentSampleRate != 0 );
 
-    const int hopSize = 8192;
-    const int numChans = sampleBuffer->getNumChannels();
-
     bool isSuccessful = false;
 
     QDir saveDir( dirPath );
@@ -158,37 +155,15 @@ QString AudioFileHandler::saveAudioFile( const QString dirPath,
 
     if ( saveDir.exists() )
     {
-        filePath = saveDir.absoluteFilePath( fileBaseName );
+        filePath = saveDir.absoluteFilePath( fileBaseName ) + getFileExtension( sndFileFormat );
 
         SF_INFO sfInfo;
         memset( &sfInfo, 0, sizeof( SF_INFO ) );
 
         sfInfo.samplerate = outputSampleRate;
-        sfInfo.channels   = numChans;
+        sfInfo.channels   = sampleBuffer->getNumChannels();
         sfInfo.format     = sndFileFormat;
 
-        switch ( sndFileFormat & SF_FORMAT_TYPEMASK )
-        {
-        case SF_FORMAT_WAV:
-            filePath.append( ".wav" );
-            break;
-        case SF_FORMAT_AIFF:
-            filePath.append( ".aiff" );
-            break;
-        case SF_FORMAT_AU:
-            filePath.append( ".au" );
-            break;
-        case SF_FORMAT_FLAC:
-            filePath.append( ".flac" );
-            break;
-        case SF_FORMAT_OGG:
-            filePath.append( ".ogg" );
-            break;
-        default:
-            qDebug() << "Unknown format: " << sndFileFormat;
-            break;
-        }
-
         Q_ASSERT( sf_format_check( &sfInfo ) );
 
         if ( isOverwriteEnabled || ! QFileInfo( filePath ).exists() )
@@ -197,23 +172,8 @@ QString AudioFileHandler::saveAudioFile( const QString dirPath,
 
             if ( fileID != NULL )
             {
-                if ( outputSampleRate == currentSampleRate )
-                {
-                    isSuccessful = sndfileSaveAudioFile( fileID, sampleBuffer, hopSize );
-                }
-                else
-                {
-                    const qreal sampleRateRatio = (qreal) outputSampleRate / (qreal) currentSampleRate;
+                isSuccessful = sndfileWriteSampleBuffer( fileID, sampleBuffer, currentSampleRate, outputSampleRate );
 
-                    Array<float> interleavedBuffer;
-
-                    isSuccessful = convertSampleRate( sampleBuffer, sampleRateRatio, interleavedBuffer );
-
-                    if ( isSuccessful )
-                    {
-                        isSuccessful = sndfileSaveAudioFile( fileID, interleavedBuffer, hopSize * numChans );
-                    }
-                }
                 sf_write_sync( fileID );
                 sf_close( fileID );
             }
@@ -242,11 +202,114 @@ QString AudioFileHandler::saveAudioFile( const QString dirPath,
 
 
 
+bool AudioFileHandler::encodeAudioFile( const SharedSampleBuffer sampleBuffer,
+                                        const int currentSampleRate,
+                                        const int outputSampleRate,
+                                        const int sndFileFormat,
+                                        MemoryBlock& encodedData )
+{
+    Q_ASSERT( currentSampleRate != 0 );
+
+    SF_INFO sfInfo;
+    memset( &sfInfo, 0, sizeof( SF_INFO ) );
+
+    sfInfo.samplerate = outputSampleRate;
+    sfInfo.channels   = sampleBuffer->getNumChannels();
+    sfInfo.format     = sndFileFormat;
+
+    Q_ASSERT( sf_format_check( &sfInfo ) );
+
+    SF_VIRTUAL_IO virtualIO;
+    virtualIO.get_filelen = &MemoryFile::getLength;
+    virtualIO.seek        = &MemoryFile::seek;
+    virtualIO.read        = &MemoryFile::read;
+    virtualIO.write       = &MemoryFile::write;
+    virtualIO.tell        = &MemoryFile::tell;
+
+    MemoryFile memoryFile( encodedData );
+
+    bool isSuccessful = false;
+
+    SNDFILE* fileID = sf_open_virtual( &virtualIO, SFM_WRITE, &sfInfo, &memoryFile );
+
+    if ( fileID != NULL )
+    {
+        isSuccessful = sndfileWriteSampleBuffer( fileID, sampleBuffer, currentSampleRate, outputSampleRate );
+
+        sf_close( fileID );
+    }
+    else
+    {
+        s_errorTitle = "Couldn't encode audio data";
+        s_errorInfo = sf_strerror( NULL );
+    }
+
+    // The memory block grows in large steps, so trim it to the number of bytes actually written
+    encodedData.setSize( memoryFile.length );
+
+    return isSuccessful;
+}
+
+
+
+AudioFileHandler::ReadJob::ReadJob( const QString filePath ) :
+    JobScheduler::Job(),
+    m_filePath( filePath )
+{
+}
+
+
+
+void AudioFileHandler::ReadJob::run()
+{
+    const SharedSampleBuffer sampleBuffer = m_fileHandler.getSampleData( m_filePath );
+    const SharedSampleHeader sampleHeader = m_fileHandler.getSampleHeader( m_filePath );
+
+    if ( sampleBuffer.isNull() || sampleHeader.isNull() )
+    {
+        // Errors are per-thread so they have to be collected here
+        m_errorTitle = m_fileHandler.getLastErrorTitle();
+        m_errorInfo = m_fileHandler.getLastErrorInfo();
+    }
+    else
+    {
+        m_sampleBuffer = sampleBuffer;
+        m_sampleHeader = sampleHeader;
+    }
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+QString AudioFileHandler::getFileExtension( const int sndFileFormat )
+{
+    switch ( sndFileFormat & SF_FORMAT_TYPEMASK )
+    {
+    case SF_FORMAT_WAV:
+        return ".wav";
+    case SF_FORMAT_AIFF:
+        return ".aiff";
+    case SF_FORMAT_AU:
+        return ".au";
+    case SF_FORMAT_FLAC:
+        return ".flac";
+    case SF_FORMAT_OGG:
+        return ".ogg";
+    default:
+        qDebug() << "Unknown format: " << sndFileFormat;
+        return QString();
+    }
+}
+
+
+
 //==================================================================================================
 // Private Static:
 
-QString AudioFileHandler::s_errorTitle;
-QString AudioFileHandler::s_errorInfo;
+thread_local QString AudioFileHandler::s_errorTitle;
+thread_local QString AudioFileHandler::s_errorInfo;
 
 
 void AudioFileHandler::interleaveSamples( const SharedSampleBuffer inputBuffer,
@@ -424,6 +487,39 @@ void AudioFileHandler::sndfileRecordWriteError( const int numSamplesToWrite, con
 
 
 
+bool AudioFileHandler::sndfileWriteSampleBuffer( SNDFILE* fileID,
+                                                 const SharedSampleBuffer sampleBuffer,
+                                                 const int currentSampleRate,
+                                                 const int outputSampleRate )
+{
+    const int hopSize = 8192;
+    const int numChans = sampleBuffer->getNumChannels();
+
+    bool isSuccessful = false;
+
+    if ( outputSampleRate == currentSampleRate )
+    {
+        isSuccessful = sndfileSaveAudioFile( fileID, sampleBuffer, hopSize );
+    }
+    else
+    {
+        const qreal sampleRateRatio = (qreal) outputSampleRate / (qreal) currentSampleRate;
+
+        Array<float> interleavedBuffer;
+
+        isSuccessful = convertSampleRate( sampleBuffer, sampleRateRatio, interleavedBuffer );
+
+        if ( isSuccessful )
+        {
+            isSuccessful = sndfileSaveAudioFile( fileID, interleavedBuffer, hopSize * numChans );
+        }
+    }
+
+    return isSuccessful;
+}
+
+
+
 SharedSampleBuffer AudioFileHandler::sndfileLoadFile( const char* filePath, sf_count_t startFrame, sf_count_t numFramesToRead )
 {
     const sf_count_t hopSize = 4096;
@@ -717,3 +813,88 @@ SharedSampleBuffer AudioFileHandler::aubioLoadFile( const char* filePath, uint_t
 
     return sampleBuffer;
 }
+
+
+sf_count_t AudioFileHandler::MemoryFile::getLength( void* userData )
+{
+    return static_cast<MemoryFile*>( userData )->length;
+}
+
+
+
+sf_count_t AudioFileHandler::MemoryFile::seek( const sf_count_t offset, const int whence, void* userData )
+{
+    MemoryFile* file = static_cast<MemoryFile*>( userData );
+
+    sf_count_t newPosition = offset;
+
+    switch ( whence )
+    {
+    case SEEK_CUR:
+        newPosition += file->position;
+        break;
+    case SEEK_END:
+        newPosition += file->length;
+        break;
+    default:
+        break;
+    }
+
+    if ( newPosition < 0 )
+    {
+        return -1;
+    }
+
+    file->position = newPosition;
+
+    return file->position;
+}
+
+
+
+sf_count_t AudioFileHandler::MemoryFile::read( void* ptr, sf_count_t count, void* userData )
+{
+    MemoryFile* file = static_cast<MemoryFile*>( userData );
+
+    if ( file->position + count > file->length )
+    {
+        count = jmax( (sf_count_t) 0, file->length - file->position );
+    }
+
+    if ( count > 0 )
+    {
+        file->data.copyTo( ptr, (int) file->position, (size_t) count );
+        file->position += count;
+    }
+
+    return count;
+}
+
+
+
+sf_count_t AudioFileHandler::MemoryFile::write( const void* ptr, const sf_count_t count, void* userData )
+{
+    MemoryFile* file = static_cast<MemoryFile*>( userData );
+
+    const sf_count_t endPosition = file->position + count;
+
+    if ( endPosition > (sf_count_t) file->data.getSize() )
+    {
+        // Grow geometrically so that encoding long samples doesn't reallocate on every write
+        file->data.ensureSize( (size_t) jmax( endPosition, (sf_count_t) file->data.getSize() * 2 ), true );
+    }
+
+    file->data.copyFrom( ptr, (int) file->position, (size_t) count );
+
+    file->position = endPosition;
+    file->length = jmax( file->length, endPosition );
+
+    return count;
+}
+
+
+
+sf_count_t AudioFileHandler::MemoryFile::tell( void* userData )
+{
+    return static_cast<MemoryFile*>( userData )->position;
+}
@@ -25,6 +25,7 @@
 
 #include "JuceHeader.h"
 #include "samplebuffer.h"
+#include "jobscheduler.h"
 #include "SndLibShuriken/_sndlib.h"
 #include <aubio/aubio.h>
 #include <sndfile.h>
@@ -33,6 +34,8 @@
 class AudioFileHandler
 {
 public:
+    class ReadJob;
+
     AudioFileHandler();
 
     SharedSampleBuffer getSampleData( QString filePath );
@@ -48,14 +51,41 @@ public:
                            int sndFileFormat,
                            bool isOverwriteEnabled = true );
 
+    // Encodes the sample buffer into "encodedData" exactly as saveAudioFile() would write it to disk;
+    // safe to call from worker threads, in which case errors are only visible to the calling thread
+    bool encodeAudioFile( SharedSampleBuffer sampleBuffer,
+                          int currentSampleRate,
+                          int outputSampleRate,
+                          int sndFileFormat,
+                          MemoryBlock& encodedData );
+
     QString getLastErrorTitle() const   { return s_errorTitle; }
     QString getLastErrorInfo() const    { return s_errorInfo; }
 
 public:
+    // Returns the file extension, including the dot, for the given libsndfile format
+    static QString getFileExtension( int sndFileFormat );
+
     static const int SAVE_FORMAT = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
     static const int TEMP_FORMAT = SF_ENDIAN_CPU | SF_FORMAT_AU | SF_FORMAT_FLOAT;
 
 private:
+    // libsndfile virtual I/O on top of a growable memory block
+    struct MemoryFile
+    {
+        MemoryFile( MemoryBlock& block ) : data( block ), position( 0 ), length( 0 ) {}
+
+        static sf_count_t getLength( void* userData );
+        static sf_count_t seek( sf_count_t offset, int whence, void* userData );
+        static sf_count_t read( void* ptr, sf_count_t count, void* userData );
+        static sf_count_t write( const void* ptr, sf_count_t count, void* userData );
+        static sf_count_t tell( void* userData );
+
+        MemoryBlock& data;
+        sf_count_t position;
+        sf_count_t length;
+    };
+
     static void interleaveSamples( SharedSampleBuffer inputBuffer,
                                    int numChans,
                                    int inputStartFrame,
@@ -74,6 +104,11 @@ private:
                                    qreal sampleRateRatio,
                                    Array<float>& outputBuffer );
 
+    static bool sndfileWriteSampleBuffer( SNDFILE* fileID,
+                                          SharedSampleBuffer sampleBuffer,
+                                          int currentSampleRate,
+                                          int outputSampleRate );
+
     static bool sndfileSaveAudioFile( SNDFILE* fileID, SharedSampleBuffer sampleBuffer, int hopSize );
     static bool sndfileSaveAudioFile( SNDFILE* fileID, Array<float> interleavedBuffer, int hopSize );
     static void sndfileRecordWriteError( int numSamplesToWrite, int numSamplesWritten );
@@ -85,11 +120,44 @@ private:
 
     static SharedSampleBuffer aubioLoadFile( const char* filePath, uint_t startFrame, uint_t numFramesToRead );
 
-    static QString s_errorTitle;
-    static QString s_errorInfo;
+    // Per-thread so that projects can be saved in the background without clobbering GUI thread errors
+    static thread_local QString s_errorTitle;
+    static thread_local QString s_errorInfo;
 
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( AudioFileHandler );
 };
 
+
+
+// Reads an audio file and its header on a JobScheduler worker thread
+class AudioFileHandler::ReadJob : public JobScheduler::Job
+{
+public:
+    ReadJob( QString filePath );
+
+    void run();
+
+    QString getFilePath() const                     { return m_filePath; }
+
+    // Both are null if the file couldn't be read
+    SharedSampleBuffer getSampleBuffer() const      { return m_sampleBuffer; }
+    SharedSampleHeader getSampleHeader() const      { return m_sampleHeader; }
+
+    QString getErrorTitle() const                   { return m_errorTitle; }
+    QString getErrorInfo() const                    { return m_errorInfo; }
+
+private:
+    const QString m_filePath;
+
+    AudioFileHandler m_fileHandler;
+
+    SharedSampleBuffer m_sampleBuffer;
+    SharedSampleHeader m_sampleHeader;
+    QString m_errorTitle;
+    QString m_errorInfo;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( ReadJob );
+};
+
 #endif // AUDIOFILEHANDLER_H
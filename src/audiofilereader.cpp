@@ -0,0 +1,150 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "audiofilereader.h"
+
+
+//==================================================================================================
+// Public:
+
+AudioFileReader::AudioFileReader() :
+    m_fileID( NULL )
+{
+    memset( &m_info, 0, sizeof( SF_INFO ) );
+}
+
+
+
+AudioFileReader::~AudioFileReader()
+{
+    close();
+}
+
+
+
+QStringList AudioFileReader::getFileNameFilters()
+{
+    QStringList nameFilters;
+
+    nameFilters << "*.wav" << "*.wave" << "*.aif" << "*.aiff" << "*.aifc" << "*.flac" << "*.ogg" << "*.oga"
+                << "*.au" << "*.snd" << "*.w64" << "*.caf" << "*.mp3";
+
+    return nameFilters;
+}
+
+
+
+bool AudioFileReader::open( const QString filePath )
+{
+    close();
+
+    m_fileID = sf_open( filePath.toLocal8Bit().data(), SFM_READ, &m_info );
+
+    if ( m_fileID == NULL )
+    {
+        return false;
+    }
+
+    if ( m_info.channels < 1 || m_info.channels > 2 || m_info.samplerate < 1 || m_info.frames < 1 )
+    {
+        close();
+        return false;
+    }
+
+    m_interleavedBuffer.resize( MAX_BLOCK_SIZE * m_info.channels );
+
+    return true;
+}
+
+
+
+void AudioFileReader::close()
+{
+    if ( m_fileID != NULL )
+    {
+        sf_close( m_fileID );
+        m_fileID = NULL;
+    }
+
+    memset( &m_info, 0, sizeof( SF_INFO ) );
+}
+
+
+
+bool AudioFileReader::seek( const FrameNum frameNum )
+{
+    if ( m_fileID == NULL )
+    {
+        return false;
+    }
+
+    return sf_seek( m_fileID, frameNum, SEEK_SET ) == frameNum;
+}
+
+
+
+int AudioFileReader::read( AudioSampleBuffer& buffer, const int startFrame, const int numFrames )
+{
+    if ( m_fileID == NULL )
+    {
+        return 0;
+    }
+
+    const int numChans = m_info.channels;
+    int totalNumFramesRead = 0;
+
+    jassert( buffer.getNumChannels() >= numChans );
+    jassert( startFrame + numFrames <= buffer.getNumSamples() );
+
+    while ( totalNumFramesRead < numFrames )
+    {
+        const int numFramesToRead = jmin( numFrames - totalNumFramesRead, (int) MAX_BLOCK_SIZE );
+        const int numFramesRead = (int) sf_readf_float( m_fileID, m_interleavedBuffer.getRawDataPointer(), numFramesToRead );
+
+        if ( numFramesRead <= 0 )
+        {
+            break;
+        }
+
+        const float* interleavedSamples = m_interleavedBuffer.getRawDataPointer();
+
+        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+        {
+            float* destSamples = buffer.getWritePointer( chanNum, startFrame + totalNumFramesRead );
+
+            for ( int frameNum = 0; frameNum < numFramesRead; frameNum++ )
+            {
+                destSamples[ frameNum ] = interleavedSamples[ frameNum * numChans + chanNum ];
+            }
+        }
+
+        totalNumFramesRead += numFramesRead;
+
+        if ( numFramesRead < numFramesToRead )
+        {
+            break;
+        }
+    }
+
+    return totalNumFramesRead;
+}
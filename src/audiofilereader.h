@@ -0,0 +1,74 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef AUDIOFILEREADER_H
+#define AUDIOFILEREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <sndfile.h>
+#include "JuceHeader.h"
+#include "samplebuffer.h"
+
+
+// Reads an audio file a block at a time using libsndfile, for previews and background analysis that
+// don't need the whole file in memory. Each thread should use its own reader
+class AudioFileReader
+{
+public:
+    AudioFileReader();
+    ~AudioFileReader();
+
+    // Wildcards for the file extensions that are worth trying to open, e.g. "*.wav"
+    static QStringList getFileNameFilters();
+
+    // Returns false if libsndfile can't read the file, or if it isn't mono or stereo
+    bool open( QString filePath );
+    void close();
+
+    bool isOpen() const                     { return m_fileID != NULL; }
+
+    int getNumChannels() const              { return m_info.channels; }
+    int getSampleRate() const               { return m_info.samplerate; }
+    FrameNum getNumFrames() const           { return m_info.frames; }
+
+    bool seek( FrameNum frameNum );
+
+    // Reads up to "numFrames" frames into "buffer" from "startFrame" onwards. "buffer" must have at least
+    // as many channels as the file. Returns the no. of frames read, which is only less than "numFrames"
+    // at the end of the file or if there's a read error
+    int read( AudioSampleBuffer& buffer, int startFrame, int numFrames );
+
+private:
+    static const int MAX_BLOCK_SIZE = 4096;
+
+    SNDFILE* m_fileID;
+    SF_INFO m_info;
+
+    Array<float> m_interleavedBuffer;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( AudioFileReader );
+};
+
+#endif // AUDIOFILEREADER_H
@@ -0,0 +1,399 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "audiorecorder.h"
+#include "audiofilehandler.h"
+#include "realtimechecker.h"
+#include <QMutexLocker>
+
+
+//==================================================================================================
+// Public:
+
+AudioRecorder::AudioRecorder( QObject* parent ) :
+    QThread( parent ),
+    m_numChans( 0 ),
+    m_sampleRate( 0 ),
+    m_tempFile( NULL ),
+    m_hasWriteFailed( false ),
+    m_currentPeak( 0.0f ),
+    m_numFramesInPeak( 0 ),
+    m_isAnalysisEnabled( false )
+{
+}
+
+
+
+AudioRecorder::~AudioRecorder()
+{
+    if ( isRunning() )
+    {
+        stopRecording();
+        wait();
+    }
+}
+
+
+
+void AudioRecorder::setAnalysisEnabled( const bool isEnabled, const AudioAnalyser::DetectionSettings settings )
+{
+    m_isAnalysisEnabled = isEnabled;
+    m_detectionSettings = settings;
+}
+
+
+
+bool AudioRecorder::startRecording( const QString tempFilePath )
+{
+    // Pick up a format change that ended the last take
+    if ( m_deviceNumChans.get() != m_numChans || m_deviceSampleRate.get() != m_sampleRate )
+    {
+        setFormat( m_deviceNumChans.get(), m_deviceSampleRate.get() );
+    }
+
+    if ( m_numChans == 0 || m_sampleRate == 0 || m_fifo == NULL )
+    {
+        m_errorInfo = tr( "The current audio device has no active input channels" );
+        return false;
+    }
+
+    SF_INFO sfInfo;
+    memset( &sfInfo, 0, sizeof( SF_INFO ) );
+
+    sfInfo.samplerate = m_sampleRate;
+    sfInfo.channels   = m_numChans;
+    sfInfo.format     = AudioFileHandler::TEMP_FORMAT;
+
+    m_tempFile = sf_open( tempFilePath.toLocal8Bit().data(), SFM_WRITE, &sfInfo );
+
+    if ( m_tempFile == NULL )
+    {
+        m_errorInfo = sf_strerror( NULL );
+        return false;
+    }
+
+    m_tempFilePath = tempFilePath;
+    m_hasWriteFailed = false;
+    m_take.clear();
+
+    if ( m_isAnalysisEnabled )
+    {
+        AudioAnalyser::DetectionSettings settings = m_detectionSettings;
+        settings.sampleRate = m_sampleRate;
+
+        m_analyser = new StreamingAnalyser( settings );
+    }
+    else
+    {
+        m_analyser = NULL;
+    }
+
+    m_currentPeak = 0.0f;
+    m_numFramesInPeak = 0;
+
+    {
+        QMutexLocker locker( &m_peaksMutex );
+        m_peaks.clearQuick();
+    }
+
+    m_numFramesDropped.set( 0 );
+    m_numFramesRecorded.set( 0 );
+    m_isStopRequested.set( 0 );
+    m_isTakeInterrupted.set( 0 );
+
+    // Safe while not recording as the audio callback doesn't touch the FIFO
+    m_fifo->reset();
+
+    start();
+
+    m_isRecording.set( 1 );
+
+    return true;
+}
+
+
+
+void AudioRecorder::stopRecording()
+{
+    m_isRecording.set( 0 );
+    m_isStopRequested.set( 1 );
+}
+
+
+
+int AudioRecorder::getPeaks( const int startIndex, Array<float>& peaks )
+{
+    QMutexLocker locker( &m_peaksMutex );
+
+    for ( int i = startIndex; i < m_peaks.size(); i++ )
+    {
+        peaks.add( m_peaks.getUnchecked( i ) );
+    }
+
+    return m_peaks.size();
+}
+
+
+
+void AudioRecorder::audioDeviceIOCallback( const float** inputChannelData, const int numInputChannels,
+                                           float** outputChannelData, const int numOutputChannels,
+                                           const int numSamples )
+{
+    const RealtimeChecker::ScopedRealtimeContext realtimeContext;
+
+    for ( int chanNum = 0; chanNum < numOutputChannels; chanNum++ )
+    {
+        if ( outputChannelData[ chanNum ] != NULL )
+        {
+            zeromem( outputChannelData[ chanNum ], sizeof( float ) * numSamples );
+        }
+    }
+
+    if ( m_isRecording.get() == 0 )
+    {
+        return;
+    }
+
+    int start1, size1, start2, size2;
+
+    m_fifo->prepareToWrite( numSamples, start1, size1, start2, size2 );
+
+    const int numFramesToWrite = size1 + size2;
+
+    if ( numFramesToWrite < numSamples )
+    {
+        m_numFramesDropped += numSamples - numFramesToWrite;
+    }
+
+    for ( int chanNum = 0; chanNum < m_numChans; chanNum++ )
+    {
+        if ( chanNum < numInputChannels && inputChannelData[ chanNum ] != NULL )
+        {
+            if ( size1 > 0 )
+                m_fifoBuffer.copyFrom( chanNum, start1, inputChannelData[ chanNum ], size1 );
+            if ( size2 > 0 )
+                m_fifoBuffer.copyFrom( chanNum, start2, inputChannelData[ chanNum ] + size1, size2 );
+        }
+        else
+        {
+            if ( size1 > 0 )
+                m_fifoBuffer.clear( chanNum, start1, size1 );
+            if ( size2 > 0 )
+                m_fifoBuffer.clear( chanNum, start2, size2 );
+        }
+    }
+
+    m_fifo->finishedWrite( numFramesToWrite );
+}
+
+
+
+void AudioRecorder::audioDeviceAboutToStart( AudioIODevice* device )
+{
+    const int numChans = jmin( (int) MAX_NUM_CHANS, device->getActiveInputChannels().countNumberOfSetBits() );
+    const int sampleRate = roundToInt( device->getCurrentSampleRate() );
+
+    m_deviceNumChans.set( numChans );
+    m_deviceSampleRate.set( sampleRate );
+
+    // The disk writer is still using the FIFO, so leave it alone. A take can't change format part way
+    // through, so if the device has come back with a different one, end the take here
+    if ( isRunning() )
+    {
+        if ( numChans != m_numChans || sampleRate != m_sampleRate )
+        {
+            m_isRecording.set( 0 );
+            m_isTakeInterrupted.set( 1 );
+        }
+
+        return;
+    }
+
+    setFormat( numChans, sampleRate );
+}
+
+
+
+void AudioRecorder::audioDeviceStopped()
+{
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+void AudioRecorder::run()
+{
+    while ( m_isStopRequested.get() == 0 )
+    {
+        drainFifo();
+        msleep( DISK_WRITER_INTERVAL_MS );
+    }
+
+    drainFifo();
+
+    if ( m_analyser != NULL )
+    {
+        m_analyser->finish();
+    }
+
+    if ( m_tempFile != NULL )
+    {
+        sf_write_sync( m_tempFile );
+        sf_close( m_tempFile );
+        m_tempFile = NULL;
+    }
+
+    readTake();
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void AudioRecorder::setFormat( const int numChans, const int sampleRate )
+{
+    m_numChans = numChans;
+    m_sampleRate = sampleRate;
+
+    if ( m_numChans > 0 )
+    {
+        const int fifoSize = m_sampleRate * FIFO_SIZE_SECS;
+
+        m_fifoBuffer.setSize( m_numChans, fifoSize );
+        m_fifo = new AbstractFifo( fifoSize );
+    }
+    else
+    {
+        m_fifo = NULL;
+    }
+}
+
+
+
+void AudioRecorder::drainFifo()
+{
+    int start1, size1, start2, size2;
+
+    m_fifo->prepareToRead( m_fifo->getNumReady(), start1, size1, start2, size2 );
+
+    if ( size1 > 0 )
+        appendToTake( m_fifoBuffer, start1, size1 );
+    if ( size2 > 0 )
+        appendToTake( m_fifoBuffer, start2, size2 );
+
+    m_fifo->finishedRead( size1 + size2 );
+}
+
+
+
+void AudioRecorder::readTake()
+{
+    if ( m_hasWriteFailed )
+    {
+        m_take.clear();
+        return;
+    }
+
+    if ( m_numFramesRecorded.get() == 0 )
+    {
+        m_take = SharedSampleBuffer( new SampleBuffer( m_numChans, 0 ) );
+        return;
+    }
+
+    AudioFileHandler fileHandler;
+
+    m_take = fileHandler.getSampleData( m_tempFilePath );
+
+    if ( m_take.isNull() )
+    {
+        m_errorInfo = fileHandler.getLastErrorInfo();
+    }
+}
+
+
+
+void AudioRecorder::appendToTake( const AudioSampleBuffer& source, const int startFrame, const int numFrames )
+{
+    // Once the temp file has failed the take is lost, so just keep the FIFO from filling up
+    if ( m_hasWriteFailed )
+    {
+        return;
+    }
+
+    m_interleavedBuffer.resize( numFrames * m_numChans );
+    float* interleaved = m_interleavedBuffer.getRawDataPointer();
+
+    for ( int chanNum = 0; chanNum < m_numChans; chanNum++ )
+    {
+        const float* samples = source.getReadPointer( chanNum, startFrame );
+
+        for ( int i = 0; i < numFrames; i++ )
+        {
+            interleaved[ i * m_numChans + chanNum ] = samples[ i ];
+        }
+    }
+
+    if ( sf_writef_float( m_tempFile, interleaved, numFrames ) != numFrames )
+    {
+        m_errorInfo = tr( "The recording could not be written to the temp file: " ) + sf_strerror( m_tempFile );
+        m_hasWriteFailed = true;
+
+        sf_close( m_tempFile );
+        m_tempFile = NULL;
+
+        m_isRecording.set( 0 );
+        return;
+    }
+
+    if ( m_analyser != NULL )
+    {
+        m_analyser->process( source, startFrame, numFrames );
+    }
+
+    Array<float> newPeaks;
+
+    for ( int i = 0; i < numFrames; i++ )
+    {
+        for ( int chanNum = 0; chanNum < m_numChans; chanNum++ )
+        {
+            m_currentPeak = jmax( m_currentPeak, std::abs( source.getSample( chanNum, startFrame + i ) ) );
+        }
+
+        if ( ++m_numFramesInPeak == PEAK_BLOCK_SIZE )
+        {
+            newPeaks.add( m_currentPeak );
+            m_currentPeak = 0.0f;
+            m_numFramesInPeak = 0;
+        }
+    }
+
+    if ( newPeaks.size() > 0 )
+    {
+        QMutexLocker locker( &m_peaksMutex );
+        m_peaks.addArray( newPeaks );
+    }
+
+    m_numFramesRecorded += numFrames;
+}
@@ -0,0 +1,148 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef AUDIORECORDER_H
+#define AUDIORECORDER_H
+
+#include <QThread>
+#include <QMutex>
+#include "JuceHeader.h"
+#include "samplebuffer.h"
+#include "streaminganalyser.h"
+#include <sndfile.h>
+
+
+// Captures audio from the current input device. The audio callback only copies incoming frames into
+// a preallocated lock-free FIFO; a disk writer thread drains the FIFO into a temp file and builds peak
+// data for drawing a live waveform. Once recording has stopped the disk writer thread reads the take
+// back into memory and then finishes, so the GUI thread never waits on the temp file
+class AudioRecorder : public QThread, public AudioIODeviceCallback
+{
+    Q_OBJECT
+
+public:
+    AudioRecorder( QObject* parent = NULL );
+    ~AudioRecorder();
+
+    // Detect onsets and tempo on the disk writer thread while recording; takes effect from the next take
+    void setAnalysisEnabled( bool isEnabled, AudioAnalyser::DetectionSettings settings );
+
+    // Called on the GUI thread; returns false and sets the error info if the temp file can't be opened
+    bool startRecording( QString tempFilePath );
+
+    // Asks the disk writer to finish the take and read it back from the temp file; returns straight
+    // away. The take is ready once the thread has emitted finished()
+    void stopRecording();
+
+    // Only valid once the disk writer has finished. Returns a null pointer and sets the error info if
+    // the take couldn't be written or read back
+    SharedSampleBuffer getTake() const      { return m_take; }
+
+    // Recording stops by itself if the temp file can't be written or the input device changes
+    // format part way through a take; stopRecording() must still be called to get the take
+    bool isRecording() const                { return m_isRecording.get() != 0; }
+
+    // True if the take was ended early because the input device's sample rate or channel count changed
+    bool wasInterrupted() const             { return m_isTakeInterrupted.get() != 0; }
+
+    // True if the disk writer fell behind and frames were dropped
+    bool hasOverflowed() const              { return m_numFramesDropped.get() > 0; }
+    FrameNum getNumFramesDropped() const    { return m_numFramesDropped.get(); }
+
+    FrameNum getNumFramesRecorded() const   { return m_numFramesRecorded.get(); }
+    int getNumChannels() const              { return m_numChans; }
+    int getSampleRate() const               { return m_sampleRate; }
+
+    // Appends peaks calculated since peak number "startIndex" to "peaks". Each peak is the absolute
+    // maximum across all channels of PEAK_BLOCK_SIZE frames. Returns the total number of peaks so far
+    int getPeaks( int startIndex, Array<float>& peaks );
+
+    // Results of analysing the current or last take, or NULL if analysis was disabled
+    StreamingAnalyser* getAnalyser() const  { return m_analyser; }
+
+    QString getErrorInfo() const            { return m_errorInfo; }
+
+    void audioDeviceIOCallback( const float** inputChannelData, int numInputChannels,
+                                float** outputChannelData, int numOutputChannels,
+                                int numSamples );
+
+    void audioDeviceAboutToStart( AudioIODevice* device );
+    void audioDeviceStopped();
+
+public:
+    static const int MAX_NUM_CHANS = 2;
+    static const int PEAK_BLOCK_SIZE = 256;
+
+protected:
+    void run();
+
+private:
+    void setFormat( int numChans, int sampleRate );
+    void drainFifo();
+    void readTake();
+    void appendToTake( const AudioSampleBuffer& source, int startFrame, int numFrames );
+
+    static const int FIFO_SIZE_SECS = 4;
+    static const int DISK_WRITER_INTERVAL_MS = 10;
+
+    // Format of the FIFO and of the current or last take
+    int m_numChans;
+    int m_sampleRate;
+
+    // Format of the input device, applied at the start of the next take if it changed during this one
+    Atomic<int> m_deviceNumChans;
+    Atomic<int> m_deviceSampleRate;
+
+    ScopedPointer<AbstractFifo> m_fifo;
+    AudioSampleBuffer m_fifoBuffer;
+
+    Atomic<int> m_isRecording;
+    Atomic<int> m_isStopRequested;
+    Atomic<int> m_isTakeInterrupted;
+    Atomic<FrameNum> m_numFramesDropped;
+    Atomic<FrameNum> m_numFramesRecorded;
+
+    QString m_tempFilePath;
+
+    // Only touched by the disk writer thread while recording
+    SNDFILE* m_tempFile;
+    bool m_hasWriteFailed;
+    Array<float> m_interleavedBuffer;
+    float m_currentPeak;
+    int m_numFramesInPeak;
+
+    bool m_isAnalysisEnabled;
+    AudioAnalyser::DetectionSettings m_detectionSettings;
+    ScopedPointer<StreamingAnalyser> m_analyser;
+
+    QMutex m_peaksMutex;
+    Array<float> m_peaks;
+
+    // Set by the disk writer thread just before it finishes
+    SharedSampleBuffer m_take;
+    QString m_errorInfo;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( AudioRecorder );
+};
+
+#endif // AUDIORECORDER_H
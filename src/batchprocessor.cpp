@@ -0,0 +1,193 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "batchprocessor.h"
+#include <emmintrin.h>
+#include <cmath>
+
+
+//==================================================================================================
+// Public Static:
+
+void BatchProcessor::process( const QList<SharedSampleBuffer> sampleBufferList,
+                              const Settings settings,
+                              JobScheduler::Job* const job )
+{
+    if ( job == NULL || sampleBufferList.size() < 2 )
+    {
+        foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
+        {
+            processSampleBuffer( sampleBuffer, settings );
+        }
+    }
+    else
+    {
+        QList<JobScheduler::SharedTask> tasks;
+
+        foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
+        {
+            const JobScheduler::SharedTask task( new ProcessTask( sampleBuffer, settings ) );
+            job->startTask( task );
+            tasks << task;
+        }
+
+        foreach ( JobScheduler::SharedTask task, tasks )
+        {
+            task->wait();
+        }
+    }
+}
+
+
+
+void BatchProcessor::processSampleBuffer( const SharedSampleBuffer sampleBuffer, const Settings settings )
+{
+    const int numFrames = sampleBuffer->getNumFrames();
+
+    switch ( settings.operation )
+    {
+    case APPLY_GAIN:
+        sampleBuffer->applyGain( 0, numFrames, settings.startGain );
+        break;
+    case APPLY_GAIN_RAMP:
+        sampleBuffer->applyGainRamp( 0, numFrames, settings.startGain, settings.endGain );
+        break;
+    case NORMALISE:
+    {
+        const float magnitude = sampleBuffer->getMagnitude( 0, numFrames );
+
+        if ( magnitude > 0.0f )
+        {
+            sampleBuffer->applyGain( 0, numFrames, 1.0f / magnitude );
+        }
+        break;
+    }
+    case REVERSE:
+        sampleBuffer->reverse( 0, numFrames );
+        break;
+    case REMOVE_DC_OFFSET:
+        removeDCOffset( sampleBuffer, settings.sampleRate );
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+void BatchProcessor::removeDCOffset( const SharedSampleBuffer sampleBuffer, const int sampleRate )
+{
+    const int numChans = sampleBuffer->getNumChannels();
+    const int numFrames = sampleBuffer->getNumFrames();
+
+    if ( numFrames == 0 || sampleRate <= 0 )
+    {
+        return;
+    }
+
+    // One-pole DC blocker: y[n] = x[n] - x[n-1] + r * y[n-1]
+    const float r = 1.0f - ( float_Pi * 2.0f * DC_FILTER_CUTOFF_HZ / sampleRate );
+
+    for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+    {
+        float* samples = sampleBuffer->getWritePointer( chanNum );
+
+        // Removing the mean first means the filter starts close to its steady state,
+        // which avoids a click at the start of the slice
+        const float mean = calcMean( samples, numFrames );
+
+        FloatVectorOperations::add( samples, -mean, numFrames );
+
+        // The filter recursion can't be vectorised, but it is cheap compared to the above
+        float prevInput = samples[ 0 ];
+        float prevOutput = samples[ 0 ];
+
+        for ( int frameNum = 1; frameNum < numFrames; frameNum++ )
+        {
+            const float input = samples[ frameNum ];
+            const float output = input - prevInput + r * prevOutput;
+
+            prevInput = input;
+            prevOutput = output;
+
+            samples[ frameNum ] = output;
+        }
+    }
+}
+
+
+
+//==================================================================================================
+// Public:
+
+BatchProcessor::ProcessJob::ProcessJob( const QList<SharedSampleBuffer> sampleBufferList, const Settings settings ) :
+    JobScheduler::Job(),
+    m_settings( settings )
+{
+    // Work on copies so that the originals can still be played and edited meanwhile
+    foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
+    {
+        m_sampleBufferList << SharedSampleBuffer( new SampleBuffer( *sampleBuffer.data() ) );
+    }
+}
+
+
+
+void BatchProcessor::ProcessJob::run()
+{
+    process( m_sampleBufferList, m_settings, this );
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+float BatchProcessor::calcMean( const float* const samples, const int numSamples )
+{
+    // Sum four lanes at a time, accumulating in double precision so that long slices
+    // don't lose accuracy
+    __m128d sumLow = _mm_setzero_pd();
+    __m128d sumHigh = _mm_setzero_pd();
+
+    const int numQuads = numSamples / 4;
+
+    for ( int i = 0; i < numQuads; i++ )
+    {
+        const __m128 quad = _mm_loadu_ps( samples + i * 4 );
+
+        sumLow = _mm_add_pd( sumLow, _mm_cvtps_pd( quad ) );
+        sumHigh = _mm_add_pd( sumHigh, _mm_cvtps_pd( _mm_movehl_ps( quad, quad ) ) );
+    }
+
+    double partialSums[ 2 ];
+    _mm_storeu_pd( partialSums, _mm_add_pd( sumLow, sumHigh ) );
+
+    double sum = partialSums[ 0 ] + partialSums[ 1 ];
+
+    for ( int i = numQuads * 4; i < numSamples; i++ )
+    {
+        sum += samples[ i ];
+    }
+
+    return static_cast<float>( sum / numSamples );
+}
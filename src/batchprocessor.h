@@ -0,0 +1,96 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QList>
+#include "samplebuffer.h"
+#include "jobscheduler.h"
+
+
+class BatchProcessor
+{
+public:
+    enum Operation { APPLY_GAIN, APPLY_GAIN_RAMP, NORMALISE, REVERSE, REMOVE_DC_OFFSET };
+
+    struct Settings
+    {
+        Operation operation;
+        float startGain;    // Also used as the gain value for APPLY_GAIN
+        float endGain;
+        int sampleRate;
+    };
+
+    // Apply an operation in place to each sample buffer in the list. If called from a job the buffers
+    // are processed concurrently as tasks of that job; either way this returns once all are done
+    static void process( QList<SharedSampleBuffer> sampleBufferList, Settings settings, JobScheduler::Job* job = NULL );
+
+    static void processSampleBuffer( SharedSampleBuffer sampleBuffer, Settings settings );
+
+    // Subtract the mean of each channel and then remove any remaining low frequency drift
+    static void removeDCOffset( SharedSampleBuffer sampleBuffer, int sampleRate );
+
+    // Processes copies of a list of sample buffers on a JobScheduler worker thread; the originals are
+    // left untouched so that the GUI thread can apply the results once the job has finished
+    class ProcessJob : public JobScheduler::Job
+    {
+    public:
+        ProcessJob( QList<SharedSampleBuffer> sampleBufferList, Settings settings );
+
+        void run();
+
+        QList<SharedSampleBuffer> getSampleBufferList() const     { return m_sampleBufferList; }
+
+    private:
+        QList<SharedSampleBuffer> m_sampleBufferList;
+        const Settings m_settings;
+    };
+
+private:
+    static constexpr float DC_FILTER_CUTOFF_HZ = 10.0f;
+
+    static float calcMean( const float* samples, int numSamples );
+
+    class ProcessTask : public JobScheduler::Task
+    {
+    public:
+        ProcessTask( SharedSampleBuffer sampleBuffer, Settings settings ) :
+            JobScheduler::Task(),
+            m_sampleBuffer( sampleBuffer ),
+            m_settings( settings )
+        {
+        }
+
+        void run()
+        {
+            processSampleBuffer( m_sampleBuffer, m_settings );
+        }
+
+    private:
+        const SharedSampleBuffer m_sampleBuffer;
+        const Settings m_settings;
+    };
+};
+
+
+#endif // BATCHPROCESSOR_H
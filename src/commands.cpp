@@ -24,12 +24,11 @@
 #include <QApplication>
 #include <QDir>
 #include <QtDebug>
-#include "messageboxes.h"
 #include "offlinetimestretcher.h"
 #include "sampleutils.h"
 
 
-AddSlicePointItemCommand::AddSlicePointItemCommand( const int frameNum,
+AddSlicePointItemCommand::AddSlicePointItemCommand( const FrameNum frameNum,
                                                     const bool canBeMovedPastOtherSlicePoints,
                                                     WaveGraphicsScene* const graphicsScene,
                                                     QPushButton* const sliceButton,
@@ -47,7 +46,7 @@ AddSlicePointItemCommand::AddSlicePointItemCommand( const int frameNum,
 
 
 
-AddSlicePointItemCommand::AddSlicePointItemCommand( const int frameNum,
+AddSlicePointItemCommand::AddSlicePointItemCommand( const FrameNum frameNum,
                                                     const bool canBeMovedPastOtherSlicePoints,
                                                     WaveGraphicsScene* const graphicsScene,
                                                     QComboBox* const snapComboBox,
@@ -109,7 +108,7 @@ void AddSlicePointItemCommand::redo()
 //==================================================================================================
 
 MoveSlicePointItemCommand::MoveSlicePointItemCommand( const SharedSlicePointItem slicePoint,
-                                                      const int oldFrameNum,
+                                                      const FrameNum oldFrameNum,
                                                       WaveGraphicsScene* const graphicsScene,
                                                       QUndoCommand* parent ) :
     QUndoCommand( parent ),
@@ -850,6 +849,28 @@ void DeleteWaveformItemCommand::redo()
 
 
 
+void DeleteWaveformItemCommand::replaceHeldSampleBuffer( const SharedSampleBuffer oldSampleBuffer,
+                                                         const SharedSampleBuffer newSampleBuffer )
+{
+    const int i = m_removedSampleBuffers.indexOf( oldSampleBuffer );
+
+    if ( i >= 0 )
+    {
+        m_removedSampleBuffers.replace( i, newSampleBuffer );
+    }
+
+    // The removed waveforms would otherwise keep spilled audio in memory
+    foreach ( SharedWaveformItem item, m_removedWaveforms )
+    {
+        if ( item->getSampleBuffer() == oldSampleBuffer )
+        {
+            item->setSampleBuffer( newSampleBuffer );
+        }
+    }
+}
+
+
+
 //==================================================================================================
 
 PasteWaveformItemCommand::PasteWaveformItemCommand( const QList<SharedSampleBuffer> copiedSampleBuffers,
@@ -1022,74 +1043,14 @@ void PasteWaveformItemCommand::redo()
 
 
 
-//==================================================================================================
-
-ApplyGainCommand::ApplyGainCommand( const float gain,
-                                    const int waveformItemOrderPos,
-                                    WaveGraphicsScene* const graphicsScene,
-                                    const int sampleRate,
-                                    AudioFileHandler& fileHandler,
-                                    const QString tempDirPath,
-                                    const QString fileBaseName,
-                                    QUndoCommand* parent ) :
-    QUndoCommand( parent ),
-    m_gain( gain ),
-    m_orderPos( waveformItemOrderPos ),
-    m_graphicsScene( graphicsScene ),
-    m_sampleRate( sampleRate ),
-    m_fileHandler( fileHandler ),
-    m_tempDirPath( tempDirPath ),
-    m_fileBaseName( fileBaseName )
+void PasteWaveformItemCommand::replaceHeldSampleBuffer( const SharedSampleBuffer oldSampleBuffer,
+                                                        const SharedSampleBuffer newSampleBuffer )
 {
-    setText( "Apply Gain" );
-}
+    const int i = m_copiedSampleBuffers.indexOf( oldSampleBuffer );
 
-
-
-void ApplyGainCommand::undo()
-{
-    if ( ! m_filePath.isEmpty() )
+    if ( i >= 0 )
     {
-        const SharedWaveformItem waveformItem = m_graphicsScene->getWaveformAt( m_orderPos );
-
-        const SharedSampleBuffer origSampleBuffer = m_fileHandler.getSampleData( m_filePath );
-
-        const int numChans = origSampleBuffer->getNumChannels();
-        const int numFrames = origSampleBuffer->getNumFrames();
-
-        const SharedSampleBuffer sampleBuffer = waveformItem->getSampleBuffer();
-
-        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
-        {
-            sampleBuffer->copyFrom( chanNum, 0, *origSampleBuffer.data(), chanNum, 0, numFrames );
-        }
-
-        m_graphicsScene->redrawWaveforms();
-    }
-}
-
-
-
-void ApplyGainCommand::redo()
-{
-    const SharedWaveformItem item = m_graphicsScene->getWaveformAt( m_orderPos );
-    const SharedSampleBuffer sampleBuffer = item->getSampleBuffer();
-
-    m_filePath = m_fileHandler.saveAudioFile( m_tempDirPath,
-                                            m_fileBaseName,
-                                            sampleBuffer,
-                                            m_sampleRate,
-                                            m_sampleRate,
-                                            AudioFileHandler::TEMP_FORMAT );
-
-    if ( ! m_filePath.isEmpty() )
-    {
-        sampleBuffer->applyGain( 0, sampleBuffer->getNumFrames(), m_gain );
-        m_graphicsScene->redrawWaveforms();
-    }
-    else
-    {
-        MessageBoxes::showWarningDialog( m_fileHandler.getLastErrorTitle(), m_fileHandler.getLastErrorInfo() );
+        m_copiedSampleBuffers.replace( i, newSampleBuffer );
     }
 }
 
@@ -1097,185 +1058,81 @@ void ApplyGainCommand::redo()
 
 //==================================================================================================
 
-ApplyGainRampCommand::ApplyGainRampCommand( const float startGain,
-                                            const float endGain,
-                                            const int waveformItemOrderPos,
-                                            WaveGraphicsScene* const graphicsScene,
-                                            const int sampleRate,
-                                            AudioFileHandler& fileHandler,
-                                            const QString tempDirPath,
-                                            const QString fileBaseName,
-                                            QUndoCommand* parent ) :
+BatchProcessCommand::BatchProcessCommand( MainWindow* const mainWindow,
+                                          const BatchProcessor::Settings settings,
+                                          const QList<int> waveformItemOrderPositions,
+                                          WaveGraphicsScene* const graphicsScene,
+                                          QUndoCommand* parent ) :
     QUndoCommand( parent ),
-    m_startGain( startGain ),
-    m_endGain( endGain ),
-    m_orderPos( waveformItemOrderPos ),
-    m_graphicsScene( graphicsScene ),
-    m_sampleRate( sampleRate ),
-    m_fileHandler( fileHandler ),
-    m_tempDirPath( tempDirPath ),
-    m_fileBaseName( fileBaseName )
-{
-    setText( "Apply Gain Ramp" );
-}
-
-
-
-void ApplyGainRampCommand::undo()
+    m_mainWindow( mainWindow ),
+    m_orderPositions( waveformItemOrderPositions ),
+    m_graphicsScene( graphicsScene )
 {
-    if ( ! m_filePath.isEmpty() )
+    switch ( settings.operation )
     {
-        const SharedWaveformItem waveformItem = m_graphicsScene->getWaveformAt( m_orderPos );
-
-        const SharedSampleBuffer origSampleBuffer = m_fileHandler.getSampleData( m_filePath );
-
-        const int numChans = origSampleBuffer->getNumChannels();
-        const int numFrames = origSampleBuffer->getNumFrames();
-
-        const SharedSampleBuffer sampleBuffer = waveformItem->getSampleBuffer();
-
-        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
-        {
-            sampleBuffer->copyFrom( chanNum, 0, *origSampleBuffer.data(), chanNum, 0, numFrames );
-        }
-
-        m_graphicsScene->redrawWaveforms();
+    case BatchProcessor::APPLY_GAIN:
+        setText( "Apply Gain" );
+        break;
+    case BatchProcessor::APPLY_GAIN_RAMP:
+        setText( "Apply Gain Ramp" );
+        break;
+    case BatchProcessor::NORMALISE:
+        setText( "Normalise" );
+        break;
+    case BatchProcessor::REVERSE:
+        setText( "Reverse" );
+        break;
+    case BatchProcessor::REMOVE_DC_OFFSET:
+        setText( "Remove DC Offset" );
+        break;
+    default:
+        break;
     }
 }
 
 
 
-void ApplyGainRampCommand::redo()
+void BatchProcessCommand::undo()
 {
-    const SharedWaveformItem item = m_graphicsScene->getWaveformAt( m_orderPos );
-    const SharedSampleBuffer sampleBuffer = item->getSampleBuffer();
-
-    m_filePath = m_fileHandler.saveAudioFile( m_tempDirPath,
-                                            m_fileBaseName,
-                                            sampleBuffer,
-                                            m_sampleRate,
-                                            m_sampleRate,
-                                            AudioFileHandler::TEMP_FORMAT );
+    m_mainWindow->swapSampleData( getSampleBuffers(), m_heldSampleBuffers );
 
-    if ( ! m_filePath.isEmpty() )
-    {
-        sampleBuffer->applyGainRamp( 0, sampleBuffer->getNumFrames(), m_startGain, m_endGain );
-        m_graphicsScene->redrawWaveforms();
-    }
-    else
-    {
-        MessageBoxes::showWarningDialog( m_fileHandler.getLastErrorTitle(), m_fileHandler.getLastErrorInfo() );
-    }
+    m_graphicsScene->redrawWaveforms( m_orderPositions );
 }
 
 
 
-//==================================================================================================
-
-NormaliseCommand::NormaliseCommand( const int waveformItemOrderPos,
-                                    WaveGraphicsScene* const graphicsScene,
-                                    const int sampleRate,
-                                    AudioFileHandler& fileHandler,
-                                    const QString tempDirPath,
-                                    const QString fileBaseName,
-                                    QUndoCommand* parent ) :
-    QUndoCommand( parent ),
-    m_orderPos( waveformItemOrderPos ),
-    m_graphicsScene( graphicsScene ),
-    m_sampleRate( sampleRate ),
-    m_fileHandler( fileHandler ),
-    m_tempDirPath( tempDirPath ),
-    m_fileBaseName( fileBaseName )
+void BatchProcessCommand::redo()
 {
-    setText( "Normalise" );
-}
-
-
+    m_mainWindow->swapSampleData( getSampleBuffers(), m_heldSampleBuffers );
 
-void NormaliseCommand::undo()
-{
-    if ( ! m_filePath.isEmpty() )
-    {
-        const SharedWaveformItem waveformItem = m_graphicsScene->getWaveformAt( m_orderPos );
-
-        const SharedSampleBuffer origSampleBuffer = m_fileHandler.getSampleData( m_filePath );
-
-        const int numChans = origSampleBuffer->getNumChannels();
-        const int numFrames = origSampleBuffer->getNumFrames();
-
-        const SharedSampleBuffer sampleBuffer = waveformItem->getSampleBuffer();
-
-        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
-        {
-            sampleBuffer->copyFrom( chanNum, 0, *origSampleBuffer.data(), chanNum, 0, numFrames );
-        }
-
-        m_graphicsScene->redrawWaveforms();
-    }
+    m_graphicsScene->redrawWaveforms( m_orderPositions );
 }
 
 
 
-void NormaliseCommand::redo()
+QList<SharedSampleBuffer> BatchProcessCommand::getSampleBuffers() const
 {
-    const SharedWaveformItem item = m_graphicsScene->getWaveformAt( m_orderPos );
-    const SharedSampleBuffer sampleBuffer = item->getSampleBuffer();
-
-    m_filePath = m_fileHandler.saveAudioFile( m_tempDirPath,
-                                            m_fileBaseName,
-                                            sampleBuffer,
-                                            m_sampleRate,
-                                            m_sampleRate,
-                                            AudioFileHandler::TEMP_FORMAT );
+    QList<SharedSampleBuffer> sampleBufferList;
 
-    if ( ! m_filePath.isEmpty() )
+    foreach ( int orderPos, m_orderPositions )
     {
-        const int numFrames = sampleBuffer->getNumFrames();
-        const float magnitude = sampleBuffer->getMagnitude( 0, numFrames );
-
-        if ( magnitude > 0.0 )
-        {
-            sampleBuffer->applyGain( 0, numFrames, 1.0 / magnitude );
-            m_graphicsScene->redrawWaveforms();
-        }
-    }
-    else
-    {
-        MessageBoxes::showWarningDialog( m_fileHandler.getLastErrorTitle(), m_fileHandler.getLastErrorInfo() );
+        sampleBufferList << m_graphicsScene->getWaveformAt( orderPos )->getSampleBuffer();
     }
-}
-
-
-
-//==================================================================================================
 
-ReverseCommand::ReverseCommand( const int waveformItemOrderPos,
-                                WaveGraphicsScene* const graphicsScene,
-                                QUndoCommand* parent ) :
-    QUndoCommand( parent ),
-    mOrderPos( waveformItemOrderPos ),
-    m_graphicsScene( graphicsScene )
-{
-    setText( "Reverse" );
-}
-
-
-
-void ReverseCommand::undo()
-{
-    redo();
+    return sampleBufferList;
 }
 
 
 
-void ReverseCommand::redo()
+void BatchProcessCommand::replaceHeldSampleBuffer( const SharedSampleBuffer oldSampleBuffer,
+                                                   const SharedSampleBuffer newSampleBuffer )
 {
-    const SharedWaveformItem item = m_graphicsScene->getWaveformAt( mOrderPos );
-    const SharedSampleBuffer sampleBuffer = item->getSampleBuffer();
-
-    sampleBuffer->reverse( 0, sampleBuffer->getNumFrames() );
+    const int i = m_heldSampleBuffers.indexOf( oldSampleBuffer );
 
-    m_graphicsScene->redrawWaveforms();
+    if ( i >= 0 )
+    {
+        m_heldSampleBuffers.replace( i, newSampleBuffer );
+    }
 }
 
 
@@ -1287,8 +1144,6 @@ GlobalTimeStretchCommand::GlobalTimeStretchCommand( MainWindow* const mainWindow
                                                   QDoubleSpinBox* const spinBoxOriginalBPM,
                                                   QDoubleSpinBox* const spinBoxNewBPM,
                                                   QCheckBox* const checkBoxPitchCorrection,
-                                                  const QString tempDirPath,
-                                                  const QString fileBaseName,
                                                   QUndoCommand* parent ) :
     QUndoCommand( parent ),
     m_mainWindow( mainWindow ),
@@ -1300,9 +1155,7 @@ GlobalTimeStretchCommand::GlobalTimeStretchCommand( MainWindow* const mainWindow
     m_newBPM( m_spinBoxNewBPM->value() ),
     m_prevAppliedBPM( m_mainWindow->m_appliedBPM ),
     m_isPitchCorrectionEnabled( m_checkBoxPitchCorrection->isChecked() ),
-    m_options( m_mainWindow->m_optionsDialog->getStretcherOptions() ),
-    m_tempDirPath( tempDirPath ),
-    m_fileBaseName( fileBaseName )
+    m_options( m_mainWindow->m_optionsDialog->getStretcherOptions() )
 {
     setText( "Global Time Stretch" );
 }
@@ -1311,27 +1164,10 @@ GlobalTimeStretchCommand::GlobalTimeStretchCommand( MainWindow* const mainWindow
 
 void GlobalTimeStretchCommand::undo()
 {
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
     m_mainWindow->stopPlayback();
+    m_mainWindow->cancelStretchRender();
 
-    const int numChans = m_mainWindow->m_sampleHeader->numChans;
-
-    for ( int i = 0; i < m_tempFilePaths.size(); i++ )
-    {
-        const QString filePath = m_tempFilePaths.at( i );
-        const SharedSampleBuffer origSampleBuffer = m_mainWindow->m_fileHandler.getSampleData( filePath );
-
-        const int origBufferSize = origSampleBuffer->getNumFrames();
-
-        const SharedSampleBuffer sampleBuffer = m_mainWindow->m_sampleBufferList.at( i );
-        sampleBuffer->setSize( numChans, origBufferSize );
-
-        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
-        {
-            sampleBuffer->copyFrom( chanNum, 0, *origSampleBuffer.data(), chanNum, 0, origBufferSize );
-        }
-    }
+    m_mainWindow->swapSampleData( m_mainWindow->m_sampleBufferList, m_heldSampleBuffers );
 
     m_mainWindow->resetSamples();
 
@@ -1345,84 +1181,65 @@ void GlobalTimeStretchCommand::undo()
     m_checkBoxPitchCorrection->setChecked( m_isPitchCorrectionEnabled );
 
     m_mainWindow->m_appliedBPM = m_prevAppliedBPM;
-
-    QApplication::restoreOverrideCursor();
 }
 
 
 
 void GlobalTimeStretchCommand::redo()
 {
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
     m_mainWindow->stopPlayback();
 
-    m_tempFilePaths.clear();
+    // Put the preview in place; the original audio is held by this command from now on
+    m_mainWindow->swapSampleData( m_mainWindow->m_sampleBufferList, m_heldSampleBuffers );
+
+    const qreal timeRatio = m_originalBPM / m_newBPM;
+    const qreal pitchScale = m_isPitchCorrectionEnabled ? 1.0 : m_newBPM / m_originalBPM;
 
-    for ( int i = 0; i < m_mainWindow->m_sampleBufferList.size(); i++ )
+    QList<qreal> timeRatioList;
+
+    for ( int i = 0; i < m_heldSampleBuffers.size(); i++ )
     {
-        const QString path = m_mainWindow->m_fileHandler.saveAudioFile( m_tempDirPath,
-                                                                        m_fileBaseName + "_" + QString::number( i ),
-                                                                        m_mainWindow->m_sampleBufferList.at( i ),
-                                                                        m_mainWindow->m_sampleHeader->sampleRate,
-                                                                        m_mainWindow->m_sampleHeader->sampleRate,
-                                                                        AudioFileHandler::TEMP_FORMAT );
-        if ( ! path.isEmpty() )
-        {
-            m_tempFilePaths << path;
-        }
-        else
-        {
-            m_tempFilePaths.clear();
-            break;
-        }
+        timeRatioList << timeRatio;
     }
 
-    if ( ! m_tempFilePaths.isEmpty() )
-    {
-        const qreal timeRatio = m_originalBPM / m_newBPM;
-        const qreal pitchScale = m_isPitchCorrectionEnabled ? 1.0 : m_newBPM / m_originalBPM;
+    // Render the original audio at full quality in the background to replace the preview
+    m_mainWindow->startStretchRender( this, m_heldSampleBuffers, timeRatioList, pitchScale, m_options );
 
-        const int sampleRate = m_mainWindow->m_sampleHeader->sampleRate;
-        const int numChans = m_mainWindow->m_sampleHeader->numChans;
+    m_mainWindow->resetSamples();
 
-        foreach ( SharedSampleBuffer sampleBuffer, m_mainWindow->m_sampleBufferList )
-        {
-            OfflineTimeStretcher::stretch( sampleBuffer, sampleRate, numChans, m_options, timeRatio, pitchScale );
-        }
+    updateSlicePoints( timeRatio );
+    m_graphicsScene->redrawWaveforms();
 
-        m_mainWindow->resetSamples();
+    m_spinBoxOriginalBPM->setValue( m_newBPM );
+    m_spinBoxNewBPM->setValue( m_newBPM );
+    m_checkBoxPitchCorrection->setChecked( m_isPitchCorrectionEnabled );
 
-        updateSlicePoints( timeRatio );
-        m_graphicsScene->redrawWaveforms();
+    m_mainWindow->m_appliedBPM = m_newBPM;
+}
 
-        m_spinBoxOriginalBPM->setValue( m_newBPM );
-        m_spinBoxNewBPM->setValue( m_newBPM );
-        m_checkBoxPitchCorrection->setChecked( m_isPitchCorrectionEnabled );
 
-        m_mainWindow->m_appliedBPM = m_newBPM;
 
-        QApplication::restoreOverrideCursor();
-    }
-    else
-    {
-        QApplication::restoreOverrideCursor();
+void GlobalTimeStretchCommand::updateSlicePoints( const qreal timeRatio )
+{
+    QList<SharedSlicePointItem> slicePointList = m_graphicsScene->getSlicePointList();
 
-        MessageBoxes::showWarningDialog( m_mainWindow->m_fileHandler.getLastErrorTitle(),
-                                         m_mainWindow->m_fileHandler.getLastErrorInfo() );
+    foreach ( SharedSlicePointItem slicePoint, slicePointList )
+    {
+        const FrameNum newFrameNum = roundToFrameNum( slicePoint->getFrameNum() * timeRatio );
+        slicePoint->setFrameNum( newFrameNum );
     }
 }
 
 
 
-void GlobalTimeStretchCommand::updateSlicePoints( const qreal timeRatio )
+void GlobalTimeStretchCommand::replaceHeldSampleBuffer( const SharedSampleBuffer oldSampleBuffer,
+                                                        const SharedSampleBuffer newSampleBuffer )
 {
-    QList<SharedSlicePointItem> slicePointList = m_graphicsScene->getSlicePointList();
+    const int i = m_heldSampleBuffers.indexOf( oldSampleBuffer );
 
-    foreach ( SharedSlicePointItem slicePoint, slicePointList )
+    if ( i >= 0 )
     {
-        const int newFrameNum = roundToIntAccurate( slicePoint->getFrameNum() * timeRatio );
-        slicePoint->setFrameNum( newFrameNum );
+        m_heldSampleBuffers.replace( i, newSampleBuffer );
     }
 }
 
@@ -1432,15 +1249,15 @@ void GlobalTimeStretchCommand::updateSlicePoints( const qreal timeRatio )
 
 RenderTimeStretchCommand::RenderTimeStretchCommand( MainWindow* const mainWindow,
                                                     WaveGraphicsScene* const graphicsScene,
-                                                    const QString tempDirPath,
-                                                    const QString fileBaseName,
+                                                    const QList<qreal> timeRatioList,
+                                                    const RubberBandStretcher::Options options,
                                                     QUndoCommand* parent ) :
     QUndoCommand( parent ),
     m_mainWindow( mainWindow ),
     m_graphicsScene( graphicsScene ),
-    m_options( m_mainWindow->m_optionsDialog->getStretcherOptions() & ~RubberBandStretcher::OptionProcessRealTime ),
-    m_tempDirPath( tempDirPath ),
-    m_fileBaseName( fileBaseName )
+    m_timeRatioList( timeRatioList ),
+    m_options( options ),
+    m_isRenderedInBackground( parent == NULL )
 {
     setText( "Render Time Stretch" );
 }
@@ -1449,35 +1266,22 @@ RenderTimeStretchCommand::RenderTimeStretchCommand( MainWindow* const mainWindow
 
 void RenderTimeStretchCommand::undo()
 {
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
     m_mainWindow->stopPlayback();
+    m_mainWindow->cancelStretchRender();
 
     if ( m_mainWindow->m_rubberbandAudioSource == NULL )
     {
         m_mainWindow->m_optionsDialog->enableRealtimeMode();
     }
 
+    m_mainWindow->swapSampleData( m_mainWindow->m_sampleBufferList, m_heldSampleBuffers );
+
     const int lowestAssignedMidiNote = m_mainWindow->m_samplerAudioSource->getLowestAssignedMidiNote();
-    const int numChans = m_mainWindow->m_sampleHeader->numChans;
 
     QList<int> orderPosList;
 
-    for ( int i = 0; i < m_tempFilePaths.size(); i++ )
+    for ( int i = 0; i < m_timeRatioList.size(); i++ )
     {
-        const QString filePath = m_tempFilePaths.at( i );
-        const SharedSampleBuffer origSampleBuffer = m_mainWindow->m_fileHandler.getSampleData( filePath );
-
-        const int origBufferSize = origSampleBuffer->getNumFrames();
-
-        const SharedSampleBuffer sampleBuffer = m_mainWindow->m_sampleBufferList.at( i );
-        sampleBuffer->setSize( numChans, origBufferSize );
-
-        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
-        {
-            sampleBuffer->copyFrom( chanNum, 0, *origSampleBuffer.data(), chanNum, 0, origBufferSize );
-        }
-
         m_mainWindow->m_rubberbandAudioSource->setNoteTimeRatio( lowestAssignedMidiNote + i, m_timeRatioList.at( i ) );
 
         orderPosList << i;
@@ -1486,77 +1290,53 @@ void RenderTimeStretchCommand::undo()
     m_mainWindow->resetSamples();
 
     m_graphicsScene->stretchWaveforms( orderPosList, m_timeRatioList );
-
-    QApplication::restoreOverrideCursor();
 }
 
 
 
 void RenderTimeStretchCommand::redo()
 {
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
     m_mainWindow->stopPlayback();
 
-    m_tempFilePaths.clear();
+    // Put the stretched audio in place; the original audio is held by this command from now on
+    m_mainWindow->swapSampleData( m_mainWindow->m_sampleBufferList, m_heldSampleBuffers );
 
-    for ( int i = 0; i < m_mainWindow->m_sampleBufferList.size(); i++ )
+    if ( m_isRenderedInBackground )
     {
-        const QString path = m_mainWindow->m_fileHandler.saveAudioFile( m_tempDirPath,
-                                                                        m_fileBaseName + "_" + QString::number( i ),
-                                                                        m_mainWindow->m_sampleBufferList.at( i ),
-                                                                        m_mainWindow->m_sampleHeader->sampleRate,
-                                                                        m_mainWindow->m_sampleHeader->sampleRate,
-                                                                        AudioFileHandler::TEMP_FORMAT );
-        if ( ! path.isEmpty() )
-        {
-            m_tempFilePaths << path;
-        }
-        else
-        {
-            m_tempFilePaths.clear();
-            break;
-        }
+        m_mainWindow->startStretchRender( this, m_heldSampleBuffers, m_timeRatioList, 1.0, m_options );
     }
 
-    if ( ! m_tempFilePaths.isEmpty() )
+    // The time stretcher has usually been removed already by switching to offline mode
+    if ( m_mainWindow->m_rubberbandAudioSource != NULL )
     {
-        m_timeRatioList.clear();
-
         const int lowestAssignedMidiNote = m_mainWindow->m_samplerAudioSource->getLowestAssignedMidiNote();
 
-        const int sampleRate = m_mainWindow->m_sampleHeader->sampleRate;
-        const int numChans = m_mainWindow->m_sampleHeader->numChans;
-
-        const qreal pitchScale = 1.0;
-
-        for ( int i = 0; i < m_mainWindow->m_sampleBufferList.size(); i++ )
+        for ( int i = 0; i < m_timeRatioList.size(); i++ )
         {
-            const int midiNote = lowestAssignedMidiNote + i;
-            const qreal timeRatio = m_mainWindow->m_rubberbandAudioSource->getNoteTimeRatio( midiNote );
+            m_mainWindow->m_rubberbandAudioSource->setNoteTimeRatio( lowestAssignedMidiNote + i, 1.0 );
+        }
+    }
 
-            SharedSampleBuffer sampleBuffer = m_mainWindow->m_sampleBufferList.at( i );
+    for ( int i = 0; i < m_timeRatioList.size(); i++ )
+    {
+        m_graphicsScene->getWaveformAt( i )->setStretchRatio( 1.0 );
+    }
 
-            OfflineTimeStretcher::stretch( sampleBuffer, sampleRate, numChans, m_options, timeRatio, pitchScale );
+    m_mainWindow->resetSamples();
 
-            m_timeRatioList << timeRatio;
-            m_mainWindow->m_rubberbandAudioSource->setNoteTimeRatio( midiNote, 1.0 );
+    m_graphicsScene->redrawWaveforms();
+}
 
-            m_graphicsScene->getWaveformAt( i )->setStretchRatio( 1.0 );
-        }
 
-        m_mainWindow->resetSamples();
 
-        m_graphicsScene->redrawWaveforms();
+void RenderTimeStretchCommand::replaceHeldSampleBuffer( const SharedSampleBuffer oldSampleBuffer,
+                                                        const SharedSampleBuffer newSampleBuffer )
+{
+    const int i = m_heldSampleBuffers.indexOf( oldSampleBuffer );
 
-        QApplication::restoreOverrideCursor();
-    }
-    else
+    if ( i >= 0 )
     {
-        QApplication::restoreOverrideCursor();
-
-        MessageBoxes::showWarningDialog( m_mainWindow->m_fileHandler.getLastErrorTitle(),
-                                         m_mainWindow->m_fileHandler.getLastErrorInfo() );
+        m_heldSampleBuffers.replace( i, newSampleBuffer );
     }
 }
 
@@ -34,19 +34,41 @@
 #include "slicepointitem.h"
 #include "mainwindow.h"
 #include "optionsdialog.h"
+#include "batchprocessor.h"
+
+
+// Implemented by undo commands that keep sample data in memory which nothing but the undo history
+// may need, so that MainWindow can account for it and spill it to disk when memory is short.
+// Spilled buffers are swapped for empty placeholders, and MainWindow swaps the sample data back in
+// before the command is undone or redone
+class SampleDataHolder
+{
+public:
+    virtual ~SampleDataHolder() {}
+
+    virtual QList<SharedSampleBuffer> getHeldSampleBuffers() const = 0;
+
+    // Hold "newSampleBuffer" in place of "oldSampleBuffer"; both hold the same audio, or will do once restored
+    virtual void replaceHeldSampleBuffer( SharedSampleBuffer oldSampleBuffer, SharedSampleBuffer newSampleBuffer ) = 0;
+
+    // True if the held buffers should go to the temp dir as soon as possible, whatever the memory ceiling.
+    // Commands that edit all of the audio at once would otherwise hold as much audio again as the project
+    virtual bool isSpilledEagerly() const   { return false; }
+};
+
 
 
 class AddSlicePointItemCommand : public QUndoCommand
 {
 public:
-    AddSlicePointItemCommand( int frameNum,
+    AddSlicePointItemCommand( FrameNum frameNum,
                               bool canBeMovedPastOtherSlicePoints,
                               WaveGraphicsScene* graphicsScene,
                               QPushButton* sliceButton,
                               QComboBox* snapComboBox,
                               QUndoCommand* parent = NULL );
 
-    AddSlicePointItemCommand( int frameNum,
+    AddSlicePointItemCommand( FrameNum frameNum,
                               bool canBeMovedPastOtherSlicePoints,
                               WaveGraphicsScene* graphicsScene,
                               QComboBox* snapComboBox,
@@ -69,7 +91,7 @@ class MoveSlicePointItemCommand : public QUndoCommand
 {
 public:
     MoveSlicePointItemCommand( SharedSlicePointItem slicePoint,
-                               int oldFrameNum,
+                               FrameNum oldFrameNum,
                                WaveGraphicsScene* graphicsScene,
                                QUndoCommand* parent = NULL );
 
@@ -78,8 +100,8 @@ public:
 
 private:
     const SharedSlicePointItem m_slicePointItem;
-    const int m_oldFrameNum;
-    const int m_newFrameNum;
+    const FrameNum m_oldFrameNum;
+    const FrameNum m_newFrameNum;
     WaveGraphicsScene* const m_graphicsScene;
     bool m_isFirstRedoCall;
 };
@@ -276,7 +298,7 @@ private:
 
 
 
-class DeleteWaveformItemCommand : public QUndoCommand
+class DeleteWaveformItemCommand : public QUndoCommand, public SampleDataHolder
 {
 public:
     DeleteWaveformItemCommand( QList<int> orderPositions,
@@ -290,6 +312,9 @@ public:
     void undo();
     void redo();
 
+    QList<SharedSampleBuffer> getHeldSampleBuffers() const  { return m_removedSampleBuffers; }
+    void replaceHeldSampleBuffer( SharedSampleBuffer oldSampleBuffer, SharedSampleBuffer newSampleBuffer );
+
 private:
     const QList<int> m_orderPositions;
     WaveGraphicsScene* const m_graphicsScene;
@@ -306,7 +331,7 @@ private:
 
 
 
-class PasteWaveformItemCommand : public QUndoCommand
+class PasteWaveformItemCommand : public QUndoCommand, public SampleDataHolder
 {
 public:
     PasteWaveformItemCommand( QList<SharedSampleBuffer> copiedSampleBuffers,
@@ -320,8 +345,11 @@ public:
     void undo();
     void redo();
 
+    QList<SharedSampleBuffer> getHeldSampleBuffers() const  { return m_copiedSampleBuffers; }
+    void replaceHeldSampleBuffer( SharedSampleBuffer oldSampleBuffer, SharedSampleBuffer newSampleBuffer );
+
 private:
-    const QList<SharedSampleBuffer> m_copiedSampleBuffers;
+    QList<SharedSampleBuffer> m_copiedSampleBuffers;
     const SamplerAudioSource::EnvelopeSettings m_copiedEnvelopes;
     const QList<qreal> m_copiedNoteTimeRatios;
     const int m_orderPosToInsertAt;
@@ -331,108 +359,39 @@ private:
 
 
 
-class ApplyGainCommand : public QUndoCommand
+class BatchProcessCommand : public QUndoCommand, public SampleDataHolder
 {
 public:
-    ApplyGainCommand( float gain,
-                      int waveformItemOrderPos,
-                      WaveGraphicsScene* graphicsScene,
-                      int sampleRate,
-                      AudioFileHandler& fileHandler,
-                      QString tempDirPath,
-                      QString fileBaseName,
-                      QUndoCommand* parent = NULL );
-
-    void undo();
-    void redo();
+    BatchProcessCommand( MainWindow* mainWindow,
+                         BatchProcessor::Settings settings,
+                         QList<int> waveformItemOrderPositions,
+                         WaveGraphicsScene* graphicsScene,
+                         QUndoCommand* parent = NULL );
 
-private:
-    const float m_gain;
-    const int m_orderPos;
-    WaveGraphicsScene* const m_graphicsScene;
-    const int m_sampleRate;
-    AudioFileHandler& m_fileHandler;
-    const QString m_tempDirPath;
-    const QString m_fileBaseName;
-    QString m_filePath;
-};
-
-
-
-class ApplyGainRampCommand : public QUndoCommand
-{
-public:
-    ApplyGainRampCommand( float startGain,
-                          float endGain,
-                          int waveformItemOrderPos,
-                          WaveGraphicsScene* graphicsScene,
-                          int sampleRate,
-                          AudioFileHandler& fileHandler,
-                          QString tempDirPath,
-                          QString fileBaseName,
-                          QUndoCommand* parent = NULL );
+    // Must be called with the results of a BatchProcessor::ProcessJob before the command is pushed
+    void setProcessedSampleBuffers( QList<SharedSampleBuffer> sampleBufferList ) { m_heldSampleBuffers = sampleBufferList; }
 
     void undo();
     void redo();
 
-private:
-    const float m_startGain;
-    const float m_endGain;
-    const int m_orderPos;
-    WaveGraphicsScene* const m_graphicsScene;
-    const int m_sampleRate;
-    AudioFileHandler& m_fileHandler;
-    const QString m_tempDirPath;
-    const QString m_fileBaseName;
-    QString m_filePath;
-};
-
-
-
-class NormaliseCommand : public QUndoCommand
-{
-public:
-    NormaliseCommand( int waveformItemOrderPos,
-                      WaveGraphicsScene* graphicsScene,
-                      int sampleRate,
-                      AudioFileHandler& fileHandler,
-                      QString tempDirPath,
-                      QString fileBaseName,
-                      QUndoCommand* parent = NULL );
-
-    void undo();
-    void redo();
+    QList<SharedSampleBuffer> getHeldSampleBuffers() const      { return m_heldSampleBuffers; }
+    void replaceHeldSampleBuffer( SharedSampleBuffer oldSampleBuffer, SharedSampleBuffer newSampleBuffer );
+    bool isSpilledEagerly() const                               { return true; }
 
 private:
-    const int m_orderPos;
-    WaveGraphicsScene* const m_graphicsScene;
-    const int m_sampleRate;
-    AudioFileHandler& m_fileHandler;
-    const QString m_tempDirPath;
-    const QString m_fileBaseName;
-    QString m_filePath;
-};
-
-
-
-class ReverseCommand : public QUndoCommand
-{
-public:
-    ReverseCommand( int waveformItemOrderPos,
-                    WaveGraphicsScene* graphicsScene,
-                    QUndoCommand* parent = NULL );
+    QList<SharedSampleBuffer> getSampleBuffers() const;
 
-    void undo();
-    void redo();
-
-private:
-    const int mOrderPos;
+    MainWindow* const m_mainWindow;
+    const QList<int> m_orderPositions;
     WaveGraphicsScene* const m_graphicsScene;
+
+    // The processed audio until the command is done, then the original audio until it's undone
+    QList<SharedSampleBuffer> m_heldSampleBuffers;
 };
 
 
 
-class GlobalTimeStretchCommand : public QUndoCommand
+class GlobalTimeStretchCommand : public QUndoCommand, public SampleDataHolder
 {
 public:
     GlobalTimeStretchCommand( MainWindow* mainWindow,
@@ -440,13 +399,18 @@ public:
                               QDoubleSpinBox* spinBoxOriginalBPM,
                               QDoubleSpinBox* spinBoxNewBPM,
                               QCheckBox* checkBoxPitchCorrection,
-                              QString tempDirPath,
-                              QString fileBaseName,
                               QUndoCommand* parent = NULL );
 
+    // Must be called with the results of a preview OfflineTimeStretcher::RenderJob before the command is pushed
+    void setStretchedSampleBuffers( QList<SharedSampleBuffer> sampleBufferList ) { m_heldSampleBuffers = sampleBufferList; }
+
     void undo();
     void redo();
 
+    QList<SharedSampleBuffer> getHeldSampleBuffers() const      { return m_heldSampleBuffers; }
+    void replaceHeldSampleBuffer( SharedSampleBuffer oldSampleBuffer, SharedSampleBuffer newSampleBuffer );
+    bool isSpilledEagerly() const                               { return true; }
+
 private:
     void updateSlicePoints( qreal timeRatio );
 
@@ -460,33 +424,44 @@ private:
     const qreal m_prevAppliedBPM;
     const bool m_isPitchCorrectionEnabled;
     const RubberBandStretcher::Options m_options;
-    const QString m_tempDirPath;
-    const QString m_fileBaseName;
-    QStringList m_tempFilePaths;
+
+    // The stretched audio until the command is done, then the original audio until it's undone
+    QList<SharedSampleBuffer> m_heldSampleBuffers;
 };
 
 
 
-class RenderTimeStretchCommand : public QUndoCommand
+class RenderTimeStretchCommand : public QUndoCommand, public SampleDataHolder
 {
 public:
     RenderTimeStretchCommand( MainWindow* mainWindow,
                               WaveGraphicsScene* graphicsScene,
-                              QString tempDirPath,
-                              QString fileBaseName,
+                              QList<qreal> timeRatioList,
+                              RubberBandStretcher::Options options,
                               QUndoCommand* parent = NULL );
 
+    // Must be called with the results of an OfflineTimeStretcher::RenderJob before the command is pushed;
+    // a preview if the command is rendered in the background, otherwise full quality
+    void setStretchedSampleBuffers( QList<SharedSampleBuffer> sampleBufferList ) { m_heldSampleBuffers = sampleBufferList; }
+
     void undo();
     void redo();
 
+    QList<SharedSampleBuffer> getHeldSampleBuffers() const      { return m_heldSampleBuffers; }
+    void replaceHeldSampleBuffer( SharedSampleBuffer oldSampleBuffer, SharedSampleBuffer newSampleBuffer );
+    bool isSpilledEagerly() const                               { return true; }
+
 private:
     MainWindow* const m_mainWindow;
     WaveGraphicsScene* const m_graphicsScene;
+    const QList<qreal> m_timeRatioList;
     const RubberBandStretcher::Options m_options;
-    const QString m_tempDirPath;
-    const QString m_fileBaseName;
-    QStringList m_tempFilePaths;
-    QList<qreal> m_timeRatioList;
+
+    // The stretched audio until the command is done, then the original audio until it's undone
+    QList<SharedSampleBuffer> m_heldSampleBuffers;
+
+    // When this is part of a larger command the next child needs the final audio straight away
+    const bool m_isRenderedInBackground;
 };
 
 
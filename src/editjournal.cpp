@@ -0,0 +1,561 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "editjournal.h"
+#include "projectsaver.h"
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+
+static const char* const LOG_FILE_NAME = "journal.log";
+static const char* const JOURNAL_DIR_NAME = "journal";
+static const char* const BLOB_DIR_NAME = "blobs";
+
+
+//==================================================================================================
+// Public:
+
+EditJournal::EditJournal( const QString tempDirPath ) :
+    QThread(),
+    m_nextBlobId( 0 ),
+    m_nextSequenceNum( 0 ),
+    m_isOpen( false ),
+    m_isRetrackNeeded( false ),
+    m_isStopping( false ),
+    m_hasUnsyncedData( false )
+{
+    QDir tempDir( tempDirPath );
+    tempDir.mkpath( QString( JOURNAL_DIR_NAME ) + "/" + BLOB_DIR_NAME );
+
+    m_journalDir.setPath( tempDir.absoluteFilePath( JOURNAL_DIR_NAME ) );
+    m_blobDir.setPath( m_journalDir.absoluteFilePath( BLOB_DIR_NAME ) );
+
+    m_logFile.setFileName( m_journalDir.absoluteFilePath( LOG_FILE_NAME ) );
+    m_isOpen = m_logFile.open( QIODevice::WriteOnly | QIODevice::Append );
+
+    if ( m_isOpen )
+    {
+        start( QThread::LowPriority );
+    }
+}
+
+
+
+EditJournal::~EditJournal()
+{
+    // Write and sync anything still in the queue before stopping
+    m_mutex.lock();
+    m_isStopping = true;
+    m_entryQueued.wakeAll();
+    m_mutex.unlock();
+
+    wait();
+
+    m_logFile.close();
+}
+
+
+
+bool EditJournal::addEntry( const QString description,
+                            const int undoIndex,
+                            const QList<SharedSampleBuffer> sampleBufferList,
+                            const int sampleRate,
+                            const TextFileHandler::ProjectSettings settings )
+{
+    if ( ! m_isOpen )
+    {
+        return false;
+    }
+
+    m_mutex.lock();
+
+    if ( m_isRetrackNeeded )
+    {
+        m_trackedBuffers.clear();
+        m_isRetrackNeeded = false;
+    }
+
+    m_mutex.unlock();
+
+    QueuedEntry entry;
+    entry.isClear = false;
+    entry.sequenceNum = m_nextSequenceNum++;
+    entry.undoIndex = undoIndex;
+    entry.description = description;
+    entry.sampleRate = sampleRate;
+    entry.settings = settings;
+
+    QHash<SampleBuffer*, TrackedBuffer> trackedBuffers;
+
+    foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
+    {
+        QueuedSample sample;
+
+        if ( m_trackedBuffers.contains( sampleBuffer.data() ) )
+        {
+            sample.blobId = m_trackedBuffers[ sampleBuffer.data() ].blobId;
+        }
+        else
+        {
+            // Edits replace sample buffers rather than changing them, so the writer thread can share this one
+            sample.blobId = m_nextBlobId++;
+            sample.sampleBuffer = sampleBuffer;
+        }
+
+        TrackedBuffer trackedBuffer;
+        trackedBuffer.sampleBuffer = sampleBuffer;
+        trackedBuffer.blobId = sample.blobId;
+
+        trackedBuffers.insert( sampleBuffer.data(), trackedBuffer );
+        entry.samples << sample;
+    }
+
+    // Forget about buffers that are no longer part of the project
+    m_trackedBuffers = trackedBuffers;
+
+    QMutexLocker locker( &m_mutex );
+
+    m_queue.enqueue( entry );
+    m_entryQueued.wakeOne();
+
+    return true;
+}
+
+
+
+void EditJournal::clear()
+{
+    m_trackedBuffers.clear();
+    m_nextSequenceNum = 0;
+
+    QueuedEntry entry;
+    entry.isClear = true;
+
+    QMutexLocker locker( &m_mutex );
+
+    // Entries that haven't been written yet would only be deleted again
+    m_queue.clear();
+    m_queue.enqueue( entry );
+    m_entryQueued.wakeOne();
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+void EditJournal::run()
+{
+    forever
+    {
+        m_mutex.lock();
+
+        while ( m_queue.isEmpty() && ! m_isStopping )
+        {
+            if ( ! m_hasUnsyncedData )
+            {
+                m_entryQueued.wait( &m_mutex );
+            }
+            else if ( m_syncTimer.elapsed() < SYNC_INTERVAL_MS )
+            {
+                m_entryQueued.wait( &m_mutex, SYNC_INTERVAL_MS - m_syncTimer.elapsed() );
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        const bool isStopping = m_isStopping;
+        const bool hasEntry = ! m_queue.isEmpty();
+
+        QueuedEntry entry;
+
+        if ( hasEntry )
+        {
+            entry = m_queue.dequeue();
+        }
+
+        m_mutex.unlock();
+
+        if ( hasEntry )
+        {
+            if ( entry.isClear )
+            {
+                removeFiles();
+            }
+            else if ( ! writeEntry( entry ) )
+            {
+                QMutexLocker locker( &m_mutex );
+                m_isRetrackNeeded = true;
+            }
+        }
+
+        // Entries are written straight away but only synced to disk at intervals, and on stopping
+        if ( m_hasUnsyncedData && ( m_syncTimer.elapsed() >= SYNC_INTERVAL_MS || ( isStopping && ! hasEntry ) ) )
+        {
+            sync();
+        }
+
+        if ( isStopping && ! hasEntry )
+        {
+            break;
+        }
+    }
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+QString EditJournal::findOrphanedJournal( const QString tempDirPath )
+{
+    QString journalDirPath;
+    QDateTime lastModified;
+
+    foreach ( QString dirPath, getOrphanedTempDirPaths( tempDirPath ) )
+    {
+        const QDir journalDir( QDir( dirPath ).absoluteFilePath( JOURNAL_DIR_NAME ) );
+        const QFileInfo logFileInfo( journalDir.absoluteFilePath( LOG_FILE_NAME ) );
+
+        if ( logFileInfo.exists() && logFileInfo.size() > 0 )
+        {
+            if ( journalDirPath.isEmpty() || logFileInfo.lastModified() > lastModified )
+            {
+                journalDirPath = journalDir.absolutePath();
+                lastModified = logFileInfo.lastModified();
+            }
+        }
+    }
+
+    return journalDirPath;
+}
+
+
+
+bool EditJournal::readLastEntry( const QString journalDirPath, QString& xmlFilePath, QString& description )
+{
+    const QDir journalDir( journalDirPath );
+    const QDir blobDir( journalDir.absoluteFilePath( BLOB_DIR_NAME ) );
+
+    QFile logFile( journalDir.absoluteFilePath( LOG_FILE_NAME ) );
+
+    if ( ! logFile.open( QIODevice::ReadOnly ) )
+    {
+        return false;
+    }
+
+    const QList<QByteArray> lines = logFile.readAll().split( '\n' );
+
+    // Work backwards; the last line may have been torn by the crash, and files that hadn't
+    // been synced when it happened may be missing, in which case fall back to an earlier entry
+    for ( int i = lines.size() - 1; i >= 0; i-- )
+    {
+        const var entry = JSON::parse( String::fromUTF8( lines.at( i ).constData() ) );
+
+        if ( ! entry.isObject() )
+        {
+            continue;
+        }
+
+        const QString settingsFilePath = blobDir.absoluteFilePath( entry[ "settings" ].toString().toRawUTF8() );
+
+        TextFileHandler::ProjectSettings settings;
+        QString errorInfo;
+
+        if ( ! TextFileHandler::readProjectXmlFile( settingsFilePath, settings, errorInfo ) )
+        {
+            continue;
+        }
+
+        bool isComplete = ! settings.audioFileNames.isEmpty();
+
+        foreach ( QString fileName, settings.audioFileNames )
+        {
+            if ( ! blobDir.exists( fileName ) )
+            {
+                isComplete = false;
+                break;
+            }
+        }
+
+        if ( isComplete )
+        {
+            xmlFilePath = settingsFilePath;
+            description = QString::fromUtf8( entry[ "description" ].toString().toRawUTF8() );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+void EditJournal::removeOrphanedTempDirs( const QString tempDirPath )
+{
+    foreach ( QString dirPath, getOrphanedTempDirPaths( tempDirPath ) )
+    {
+        File( dirPath.toLocal8Bit().data() ).deleteRecursively();
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+bool EditJournal::writeEntry( const QueuedEntry& entry )
+{
+    TextFileHandler::ProjectSettings settings = entry.settings;
+    settings.audioFileNames.clear();
+
+    QHash<int, QString> blobFileNamesById;
+
+    foreach ( QueuedSample sample, entry.samples )
+    {
+        QString fileName;
+
+        if ( sample.sampleBuffer.isNull() )
+        {
+            // This blob failed to be written for an earlier entry if there's no file name
+            fileName = m_blobFileNamesById.value( sample.blobId );
+        }
+        else
+        {
+            fileName = writeSampleBlob( sample.sampleBuffer, entry.sampleRate );
+        }
+
+        if ( fileName.isEmpty() )
+        {
+            return false;
+        }
+
+        settings.audioFileNames << fileName;
+        blobFileNamesById.insert( sample.blobId, fileName );
+    }
+
+    // Later entries only refer to buffers that are part of this one
+    m_blobFileNamesById = blobFileNamesById;
+
+    const QString settingsFileName = writeSettingsBlob( settings );
+
+    if ( settingsFileName.isEmpty() )
+    {
+        return false;
+    }
+
+    DynamicObject* const entryObject = new DynamicObject();
+    const var entryVar( entryObject );
+
+    entryObject->setProperty( "seq", entry.sequenceNum );
+    entryObject->setProperty( "undoIndex", entry.undoIndex );
+    entryObject->setProperty( "description", String::fromUTF8( entry.description.toUtf8().constData() ) );
+    entryObject->setProperty( "settings", String( settingsFileName.toLocal8Bit().data() ) );
+
+    const String line = JSON::toString( entryVar, true ) + "\n";
+
+    m_logFile.write( line.toRawUTF8() );
+    m_logFile.flush();
+
+    if ( ! m_hasUnsyncedData )
+    {
+        m_hasUnsyncedData = true;
+        m_syncTimer.start();
+    }
+
+    return true;
+}
+
+
+
+QString EditJournal::writeSampleBlob( const SharedSampleBuffer sampleBuffer, const int sampleRate )
+{
+    const QByteArray hash = hashSampleBuffer( sampleBuffer );
+
+    if ( m_blobFileNames.contains( hash ) )
+    {
+        return m_blobFileNames.value( hash );
+    }
+
+    const QString filePath = m_fileHandler.saveAudioFile( m_blobDir.absolutePath(),
+                                                          QString( hash ),
+                                                          sampleBuffer,
+                                                          sampleRate,
+                                                          sampleRate,
+                                                          AudioFileHandler::TEMP_FORMAT );
+    if ( filePath.isEmpty() )
+    {
+        return QString();
+    }
+
+    const QString fileName = QFileInfo( filePath ).fileName();
+
+    m_blobFileNames.insert( hash, fileName );
+    m_unsyncedFilePaths << filePath;
+
+    return fileName;
+}
+
+
+
+QString EditJournal::writeSettingsBlob( const TextFileHandler::ProjectSettings& settings )
+{
+    const QString pendingFilePath = m_blobDir.absoluteFilePath( "pending.xml" );
+
+    if ( ! TextFileHandler::createProjectXmlFile( pendingFilePath, settings ) )
+    {
+        return QString();
+    }
+
+    QFile pendingFile( pendingFilePath );
+
+    if ( ! pendingFile.open( QIODevice::ReadOnly ) )
+    {
+        return QString();
+    }
+
+    const QByteArray hash = QCryptographicHash::hash( pendingFile.readAll(), QCryptographicHash::Sha1 ).toHex();
+    pendingFile.close();
+
+    const QString fileName = QString( hash ) + ".xml";
+
+    if ( m_blobDir.exists( fileName ) )
+    {
+        m_blobDir.remove( "pending.xml" );
+    }
+    else
+    {
+        m_blobDir.rename( "pending.xml", fileName );
+        m_unsyncedFilePaths << m_blobDir.absoluteFilePath( fileName );
+    }
+
+    return fileName;
+}
+
+
+
+void EditJournal::removeFiles()
+{
+    m_logFile.resize( 0 );
+
+    foreach ( QString fileName, m_blobDir.entryList( QDir::Files ) )
+    {
+        m_blobDir.remove( fileName );
+    }
+
+    m_blobFileNames.clear();
+    m_blobFileNamesById.clear();
+    m_unsyncedFilePaths.clear();
+    m_hasUnsyncedData = false;
+}
+
+
+
+void EditJournal::sync()
+{
+    // Sync the audio and settings files before the log so that entries never refer to missing files
+    foreach ( QString filePath, m_unsyncedFilePaths )
+    {
+        ProjectSaver::syncPath( filePath );
+    }
+
+    if ( ! m_unsyncedFilePaths.isEmpty() )
+    {
+        ProjectSaver::syncPath( m_blobDir.absolutePath() );
+        m_unsyncedFilePaths.clear();
+    }
+
+    m_logFile.flush();
+    fsync( m_logFile.handle() );
+
+    m_hasUnsyncedData = false;
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+QByteArray EditJournal::hashSampleBuffer( const SharedSampleBuffer sampleBuffer )
+{
+    const int numChans = sampleBuffer->getNumChannels();
+    const int numFrames = sampleBuffer->getNumFrames();
+
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+
+    hash.addData( reinterpret_cast<const char*>( &numChans ), sizeof( numChans ) );
+    hash.addData( reinterpret_cast<const char*>( &numFrames ), sizeof( numFrames ) );
+
+    for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+    {
+        hash.addData( reinterpret_cast<const char*>( sampleBuffer->getReadPointer( chanNum ) ),
+                      numFrames * sizeof( float ) );
+    }
+
+    return hash.result().toHex();
+}
+
+
+
+QStringList EditJournal::getOrphanedTempDirPaths( const QString tempDirPath )
+{
+    // Temp dirs are named "shuriken-<user>-<pid>", see OptionsDialog::setTempDirPath()
+    const QFileInfo tempDirInfo( tempDirPath );
+    const QString tempDirName = tempDirInfo.fileName();
+    const QString prefix = tempDirName.left( tempDirName.lastIndexOf( '-' ) + 1 );
+    const QDir parentDir = tempDirInfo.absoluteDir();
+
+    QStringList dirPaths;
+
+    if ( prefix.isEmpty() )
+    {
+        return dirPaths;
+    }
+
+    foreach ( QString dirName, parentDir.entryList( QStringList( prefix + "*" ), QDir::Dirs | QDir::NoDotAndDotDot ) )
+    {
+        bool isValidPid = false;
+        const pid_t pid = dirName.mid( prefix.length() ).toInt( &isValidPid );
+
+        if ( ! isValidPid || dirName == tempDirName )
+        {
+            continue;
+        }
+
+        // Skip dirs belonging to instances that are still running
+        if ( kill( pid, 0 ) == 0 || errno == EPERM )
+        {
+            continue;
+        }
+
+        dirPaths << parentDir.absoluteFilePath( dirName );
+    }
+
+    return dirPaths;
+}
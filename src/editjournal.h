@@ -0,0 +1,146 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include "samplebuffer.h"
+#include "audiofilehandler.h"
+#include "textfilehandler.h"
+#include "JuceHeader.h"
+
+
+// Append-only journal of edits kept in the temp dir so that a session can be recovered after
+// a crash. Each entry refers to a project XML file and to audio files named after the hash of
+// their contents, so unchanged slices are never written twice. Hashing and writing happen on a
+// background thread so that editing never waits for the disk
+class EditJournal : public QThread
+{
+    Q_OBJECT
+
+public:
+    EditJournal( QString tempDirPath );
+    ~EditJournal();
+
+    // Queue an entry recording the current state of the project after an undo stack change. Only
+    // sample buffers that are new since the last entry are hashed and written; the rest are
+    // referred to as before. Returns false if the journal couldn't be opened
+    bool addEntry( QString description,
+                   int undoIndex,
+                   QList<SharedSampleBuffer> sampleBufferList,
+                   int sampleRate,
+                   TextFileHandler::ProjectSettings settings );
+
+    // Discard all entries, e.g. when the project is closed
+    void clear();
+
+    // Returns the journal dir of the most recent session that didn't exit cleanly, or an empty
+    // string if there is none. Only sessions belonging to processes that no longer exist are considered
+    static QString findOrphanedJournal( QString tempDirPath );
+
+    // Find the last complete entry in a journal; returns false if there isn't one
+    static bool readLastEntry( QString journalDirPath, QString& xmlFilePath, QString& description );
+
+    // Remove the temp dirs of all sessions that didn't exit cleanly
+    static void removeOrphanedTempDirs( QString tempDirPath );
+
+    static const int SYNC_INTERVAL_MS = 2000;
+
+protected:
+    void run();
+
+private:
+    struct QueuedSample
+    {
+        int blobId;
+        SharedSampleBuffer sampleBuffer;        // Null if the blob was written for an earlier entry
+    };
+
+    struct QueuedEntry
+    {
+        bool isClear;
+        int sequenceNum;
+        int undoIndex;
+        QString description;
+        QList<QueuedSample> samples;
+        int sampleRate;
+        TextFileHandler::ProjectSettings settings;
+    };
+
+    struct TrackedBuffer
+    {
+        SharedSampleBuffer sampleBuffer;        // Keeps the buffer alive so its address can't be reused
+        int blobId;
+    };
+
+    // Called on the writer thread only
+    bool writeEntry( const QueuedEntry& entry );
+    QString writeSampleBlob( SharedSampleBuffer sampleBuffer, int sampleRate );
+    QString writeSettingsBlob( const TextFileHandler::ProjectSettings& settings );
+    void removeFiles();
+    void sync();
+
+    static QByteArray hashSampleBuffer( SharedSampleBuffer sampleBuffer );
+    static QStringList getOrphanedTempDirPaths( QString tempDirPath );
+
+    // Used by the GUI thread only
+    QHash<SampleBuffer*, TrackedBuffer> m_trackedBuffers;
+    int m_nextBlobId;
+    int m_nextSequenceNum;
+    bool m_isOpen;
+
+    // Shared between threads and guarded by the mutex
+    QMutex m_mutex;
+    QWaitCondition m_entryQueued;
+    QQueue<QueuedEntry> m_queue;
+    bool m_isRetrackNeeded;     // Set when a write fails so that every buffer gets written again
+    bool m_isStopping;
+
+    // Used by the writer thread only
+    AudioFileHandler m_fileHandler;
+
+    QDir m_journalDir;
+    QDir m_blobDir;
+    QFile m_logFile;
+
+    QHash<QByteArray, QString> m_blobFileNames;
+    QHash<int, QString> m_blobFileNamesById;
+    QStringList m_unsyncedFilePaths;
+
+    QElapsedTimer m_syncTimer;
+    bool m_hasUnsyncedData;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( EditJournal );
+};
+
+
+#endif // EDITJOURNAL_H
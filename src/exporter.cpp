@@ -0,0 +1,214 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "exporter.h"
+#include "exportdialog.h"
+#include "h2drumkitarchiver.h"
+#include "textfilehandler.h"
+#include "akaifilehandler.h"
+#include "globals.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+
+
+//==================================================================================================
+// Public Static:
+
+bool Exporter::exportProject( const Settings& settings,
+                              AudioFileHandler& fileHandler,
+                              QString& errorTitle,
+                              QString& errorInfo,
+                              JobScheduler::Job* const job )
+{
+    const QDir outputDir( settings.outputDirPath );
+    const QString fileName = settings.fileName;
+    const QString samplesDirPath = settings.samplesDirPath;
+
+    const bool isExportTypeAudioFiles = settings.exportType & ExportDialog::EXPORT_AUDIO_FILES;
+    const bool isExportTypeH2Drumkit  = settings.exportType & ExportDialog::EXPORT_H2DRUMKIT;
+    const bool isExportTypeSFZ        = settings.exportType & ExportDialog::EXPORT_SFZ;
+    const bool isExportTypeAkaiPgm    = settings.exportType & ExportDialog::EXPORT_AKAI_PGM;
+    const bool isExportTypeMidiFile   = settings.exportType & ExportDialog::EXPORT_MIDI_FILE;
+
+    // SFZ and MIDI files put each slice on a key of its own, as the sampler does
+    if ( ( isExportTypeSFZ || isExportTypeMidiFile ) && settings.numSamplesToExport > Midi::NUM_KEYS )
+    {
+        errorTitle = QObject::tr("Too many slices!");
+        errorInfo = QObject::tr("SFZ and MIDI files can't hold more than %1 slices").arg( Midi::NUM_KEYS );
+        return false;
+    }
+
+    // Hydrogen drumkit samples are streamed straight into the archive rather than written to a directory
+    if ( isExportTypeAudioFiles && ! isExportTypeH2Drumkit )
+    {
+        outputDir.mkdir( fileName );
+    }
+
+    QStringList audioFileNames;
+
+    // Export audio files
+    if ( isExportTypeAudioFiles )
+    {
+        for ( int i = 0; i < settings.numSamplesToExport; i++ )
+        {
+            QString audioFileName = fileName;
+
+            if ( isExportTypeAkaiPgm && audioFileName.size() > 14 )
+            {
+                audioFileName.resize( 14 );
+            }
+
+            if ( settings.numberingStyle == ExportDialog::NUMBERING_PREFIX )
+            {
+                audioFileName.prepend( QString::number( i + 1 ).rightJustified( 2, '0' ) );
+            }
+            else // SUFFIX
+            {
+                audioFileName.append( QString::number( i + 1 ).rightJustified( 2, '0' ) );
+            }
+
+            if ( isExportTypeH2Drumkit )
+            {
+                audioFileNames << audioFileName + AudioFileHandler::getFileExtension( settings.sndFileFormat );
+                continue;
+            }
+
+            if ( job != NULL )
+            {
+                if ( job->isCancelled() )
+                {
+                    return false;
+                }
+
+                job->setProgress( i * 100 / settings.numSamplesToExport );
+            }
+
+            const QString path = fileHandler.saveAudioFile( samplesDirPath,
+                                                            audioFileName,
+                                                            settings.sampleBufferList.at( i ),
+                                                            settings.sampleRate,
+                                                            settings.outputSampleRate,
+                                                            settings.sndFileFormat );
+
+            if ( ! path.isEmpty() )
+            {
+                if ( isExportTypeAkaiPgm )
+                {
+                    audioFileNames << audioFileName;    // File base name, no extension
+                }
+                else
+                {
+                    audioFileNames << QFileInfo( path ).fileName(); // File name including extension
+                }
+            }
+            else
+            {
+                errorTitle = fileHandler.getLastErrorTitle();
+                errorInfo = fileHandler.getLastErrorInfo();
+                return false;
+            }
+        }
+    }
+
+    // Export Hydrogen drumkit
+    if ( isExportTypeH2Drumkit )
+    {
+        H2DrumkitArchiver::Settings archiverSettings;
+
+        archiverSettings.archiveFilePath = outputDir.absoluteFilePath( fileName + ".h2drumkit" );
+        archiverSettings.kitName = fileName;
+        archiverSettings.audioFileNames = audioFileNames;
+        archiverSettings.sampleBufferList = settings.sampleBufferList.mid( 0, settings.numSamplesToExport );
+        archiverSettings.currentSampleRate = settings.sampleRate;
+        archiverSettings.outputSampleRate = settings.outputSampleRate;
+        archiverSettings.sndFileFormat = settings.sndFileFormat;
+        archiverSettings.envelopes = settings.envelopes;
+
+        if ( ! H2DrumkitArchiver::writeArchive( archiverSettings, fileHandler, errorTitle, errorInfo, job ) )
+        {
+            return false;
+        }
+    }
+    // Export SFZ
+    else if ( isExportTypeSFZ )
+    {
+        const QString sfzFilePath = outputDir.absoluteFilePath( fileName + ".sfz" );
+        const QString samplesDirName = QFileInfo( samplesDirPath ).fileName();
+
+        TextFileHandler::createSFZFile( sfzFilePath, samplesDirName, audioFileNames,
+                                        settings.sampleBufferList, settings.sampleRate, settings.envelopes );
+    }
+    // Export Akai PGM
+    else if ( isExportTypeAkaiPgm )
+    {
+        switch ( settings.akaiModelID )
+        {
+        case AkaiModelID::MPC1000_ID:
+            AkaiFileHandler::writePgmFileMPC1000( audioFileNames, fileName, samplesDirPath, settings.tempDirPath,
+                                                  settings.isVoiceOverlapMono, settings.muteGroup, settings.envelopes );
+            break;
+        case AkaiModelID::MPC500_ID:
+            AkaiFileHandler::writePgmFileMPC500( audioFileNames, fileName, samplesDirPath, settings.tempDirPath,
+                                                 settings.isVoiceOverlapMono, settings.muteGroup, settings.envelopes );
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Export MIDI file
+    if ( isExportTypeMidiFile && settings.isMidiFileConfirmed )
+    {
+        const QString midiDirPath = isExportTypeAkaiPgm ? samplesDirPath : settings.outputDirPath;
+
+        MidiFileHandler::SaveMidiFile( fileName,
+                                       midiDirPath,
+                                       settings.sampleBufferList,
+                                       settings.numSamplesToExport,
+                                       settings.sampleRate,
+                                       settings.bpm,
+                                       settings.timeSigNumerator,
+                                       settings.timeSigDenominator,
+                                       settings.midiFileType );
+    }
+
+    return true;
+}
+
+
+
+//==================================================================================================
+
+Exporter::ExportJob::ExportJob( const Settings& settings ) :
+    JobScheduler::Job(),
+    m_settings( settings ),
+    m_isSuccessful( false )
+{
+}
+
+
+
+void Exporter::ExportJob::run()
+{
+    m_isSuccessful = exportProject( m_settings, m_fileHandler, m_errorTitle, m_errorInfo, this );
+}
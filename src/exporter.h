@@ -0,0 +1,107 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QString>
+#include <QList>
+#include "samplebuffer.h"
+#include "sampleraudiosource.h"
+#include "audiofilehandler.h"
+#include "midifilehandler.h"
+#include "jobscheduler.h"
+
+
+class Exporter
+{
+public:
+    class ExportJob;
+
+    // Everything needed to export a project, gathered on the GUI thread beforehand
+    struct Settings
+    {
+        QString tempDirPath;
+        QString outputDirPath;
+        QString samplesDirPath;
+        QString fileName;
+        int exportType;                 // ExportDialog::ExportType flags
+        int numberingStyle;             // ExportDialog::NumberingStyle
+        int sndFileFormat;
+        int outputSampleRate;
+        int numSamplesToExport;
+
+        int akaiModelID;
+        bool isVoiceOverlapMono;
+        int muteGroup;
+
+        // Set if the user has confirmed the BPM and time signature for a MIDI file
+        bool isMidiFileConfirmed;
+        qreal bpm;
+        int timeSigNumerator;
+        int timeSigDenominator;
+        MidiFileHandler::MidiFileType midiFileType;
+
+        QList<SharedSampleBuffer> sampleBufferList;
+        int sampleRate;
+        SamplerAudioSource::EnvelopeSettings envelopes;
+    };
+
+    // Writes audio files, a Hydrogen drumkit, an SFZ or Akai program and a MIDI file as chosen in
+    // the export dialog. Returns false and sets "errorTitle" and "errorInfo" if the audio couldn't
+    // be written. If "job" is given its progress is set, it can be cancelled between audio files,
+    // and a drumkit's samples are encoded as tasks of it
+    static bool exportProject( const Settings& settings,
+                               AudioFileHandler& fileHandler,
+                               QString& errorTitle,
+                               QString& errorInfo,
+                               JobScheduler::Job* job = NULL );
+};
+
+
+
+// Exports a project on a JobScheduler worker thread. The sample buffers in the settings should
+// be copies, as they are read while the GUI thread goes on editing the project
+class Exporter::ExportJob : public JobScheduler::Job
+{
+public:
+    ExportJob( const Settings& settings );
+
+    void run();
+
+    bool isSuccessful() const                   { return m_isSuccessful; }
+    QString getErrorTitle() const               { return m_errorTitle; }
+    QString getErrorInfo() const                { return m_errorInfo; }
+
+private:
+    const Settings m_settings;
+
+    AudioFileHandler m_fileHandler;
+
+    bool m_isSuccessful;
+    QString m_errorTitle;
+    QString m_errorInfo;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( ExportJob );
+};
+
+#endif // EXPORTER_H
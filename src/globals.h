@@ -32,6 +32,8 @@
 
 #define AUDIO_CONFIG_FILE_PATH      "~/.shuriken/audioconfig.xml"
 #define PATHS_CONFIG_FILE_PATH      "~/.shuriken/pathsconfig.xml"
+#define THUMBNAIL_CACHE_DIR_PATH    "~/.shuriken/thumbnails"
+#define LIBRARY_INDEX_FILE_PATH     "~/.shuriken/library.index"
 
 #define FILE_EXTENSION              ".shuriken"
 
@@ -45,7 +47,7 @@ namespace RecentProjects
 namespace InputChannels
 {
     const int MIN = 0;
-    const int MAX = 0;
+    const int MAX = 2;
 }
 
 
@@ -86,6 +88,29 @@ namespace Midi
 {
     const int MIDDLE_C       = 60;
     const int MAX_POLYPHONY  = 128;
+    const int NUM_NOTES      = 128;
+    const int NUM_CHANNELS   = 16;
+
+    // Slices are assigned to "keys", which number every note on every MIDI channel, so that more than
+    // 128 slices can be played: once the notes of channel 1 run out, slices carry on from note 0 of
+    // channel 2, and so on
+    const int NUM_KEYS       = NUM_NOTES * NUM_CHANNELS;
+
+    inline int getKeyNum( const int channel, const int noteNum )    { return ( channel - 1 ) * NUM_NOTES + noteNum; }
+    inline int getChannel( const int keyNum )                       { return keyNum / NUM_NOTES + 1; }
+    inline int getNoteNum( const int keyNum )                       { return keyNum % NUM_NOTES; }
+
+    // The key of the first of 'numSlices' consecutive slices. Slices start at middle C if they all fit on
+    // channel 1 from there, otherwise they start as low as needed, from note 0 if they need more than one channel
+    inline int getStartKeyNum( const int numSlices )
+    {
+        if ( numSlices <= NUM_NOTES - MIDDLE_C )
+        {
+            return MIDDLE_C;
+        }
+
+        return numSlices < NUM_NOTES ? NUM_NOTES - numSlices : 0;
+    }
 }
 
 
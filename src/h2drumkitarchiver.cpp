@@ -0,0 +1,129 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "h2drumkitarchiver.h"
+#include "targzwriter.h"
+#include "textfilehandler.h"
+#include <QSharedPointer>
+
+
+//==================================================================================================
+// Public Static:
+
+bool H2DrumkitArchiver::writeArchive( const Settings& settings,
+                                      AudioFileHandler& fileHandler,
+                                      QString& errorTitle,
+                                      QString& errorInfo,
+                                      JobScheduler::Job* const job )
+{
+    Q_ASSERT( settings.audioFileNames.size() == settings.sampleBufferList.size() );
+
+    const int numSamples = settings.sampleBufferList.size();
+
+    QList< QSharedPointer<EncodeTask> > tasks;
+
+    for ( int i = 0; i < numSamples; i++ )
+    {
+        QSharedPointer<EncodeTask> task( new EncodeTask( fileHandler, settings.sampleBufferList.at( i ), settings ) );
+        tasks << task;
+
+        if ( job != NULL )
+        {
+            job->startTask( task );
+        }
+    }
+
+    TarGzWriter writer( settings.archiveFilePath, job );
+
+    const QString kitDirName = settings.kitName + "/";
+
+    writer.addDirectory( kitDirName );
+
+    const String xml = TextFileHandler::createH2DrumkitXml( settings.kitName, settings.audioFileNames, settings.envelopes );
+    const MemoryBlock xmlData( xml.toRawUTF8(), xml.getNumBytesAsUTF8() );
+
+    writer.addFile( kitDirName + "drumkit.xml", xmlData );
+
+    bool isSuccessful = writer.isOpen();
+
+    // Archive the samples in order as each finishes encoding, freeing the encoded data as we go
+    for ( int i = 0; i < numSamples && isSuccessful; i++ )
+    {
+        tasks.at( i )->wait();
+
+        if ( tasks.at( i )->isSuccessful )
+        {
+            isSuccessful = writer.addFile( kitDirName + settings.audioFileNames.at( i ), tasks.at( i )->encodedData );
+            tasks.at( i )->encodedData.reset();
+        }
+        else
+        {
+            errorTitle = tasks.at( i )->errorTitle;
+            errorInfo = tasks.at( i )->errorInfo;
+            isSuccessful = false;
+        }
+    }
+
+    foreach ( QSharedPointer<EncodeTask> task, tasks )
+    {
+        task->wait();
+    }
+
+    if ( isSuccessful )
+    {
+        isSuccessful = writer.finish();
+    }
+
+    if ( ! isSuccessful )
+    {
+        if ( errorTitle.isEmpty() )
+        {
+            errorTitle = "Couldn't write Hydrogen drumkit";
+            errorInfo = writer.getErrorInfo();
+        }
+
+        writer.finish();
+        File( settings.archiveFilePath.toLocal8Bit().data() ).deleteFile();
+    }
+
+    return isSuccessful;
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void H2DrumkitArchiver::EncodeTask::run()
+{
+    isSuccessful = m_fileHandler.encodeAudioFile( m_sampleBuffer,
+                                                  m_settings.currentSampleRate,
+                                                  m_settings.outputSampleRate,
+                                                  m_settings.sndFileFormat,
+                                                  encodedData );
+    if ( ! isSuccessful )
+    {
+        // Errors are recorded per thread so fetch them before leaving the worker
+        errorTitle = m_fileHandler.getLastErrorTitle();
+        errorInfo = m_fileHandler.getLastErrorInfo();
+    }
+}
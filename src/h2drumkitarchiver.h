@@ -0,0 +1,87 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef H2DRUMKITARCHIVER_H
+#define H2DRUMKITARCHIVER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include "samplebuffer.h"
+#include "sampleraudiosource.h"
+#include "audiofilehandler.h"
+#include "jobscheduler.h"
+
+
+class H2DrumkitArchiver
+{
+public:
+    struct Settings
+    {
+        QString archiveFilePath;
+        QString kitName;
+        QStringList audioFileNames;     // File names including extension
+        QList<SharedSampleBuffer> sampleBufferList;
+        int currentSampleRate;
+        int outputSampleRate;
+        int sndFileFormat;
+        SamplerAudioSource::EnvelopeSettings envelopes;
+    };
+
+    // Encodes the samples and streams them, together with the drumkit XML, into a gzipped tar archive
+    // without writing anything else to disk. Encoding and compression run concurrently as tasks of "job".
+    // On failure the partially written archive is removed and "errorTitle" and "errorInfo" are set
+    static bool writeArchive( const Settings& settings,
+                              AudioFileHandler& fileHandler,
+                              QString& errorTitle,
+                              QString& errorInfo,
+                              JobScheduler::Job* job = NULL );
+
+private:
+    class EncodeTask : public JobScheduler::Task
+    {
+    public:
+        EncodeTask( AudioFileHandler& fileHandler, SharedSampleBuffer sampleBuffer, const Settings& settings ) :
+            JobScheduler::Task(),
+            m_fileHandler( fileHandler ),
+            m_sampleBuffer( sampleBuffer ),
+            m_settings( settings ),
+            isSuccessful( false )
+        {
+        }
+
+        void run();
+
+    private:
+        AudioFileHandler& m_fileHandler;
+        const SharedSampleBuffer m_sampleBuffer;
+        const Settings& m_settings;
+
+    public:
+        MemoryBlock encodedData;
+        bool isSuccessful;
+        QString errorTitle;
+        QString errorInfo;
+    };
+};
+
+#endif // H2DRUMKITARCHIVER_H
@@ -0,0 +1,341 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "importbrowser.h"
+#include "ui_importbrowser.h"
+#include "globals.h"
+#include "audiofilereader.h"
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QListWidgetItem>
+#include <QPainter>
+#include <QStyle>
+
+
+//==================================================================================================
+// Public:
+
+ImportBrowser::ImportBrowser( AudioDeviceManager& deviceManager, JobScheduler& jobScheduler, QWidget* parent ) :
+    QWidget( parent ),
+    m_UI( new Ui::ImportBrowser ),
+    m_cacheDirPath( QString::fromUtf8( File( THUMBNAIL_CACHE_DIR_PATH ).getFullPathName().toRawUTF8() ) ),
+    m_jobScheduler( jobScheduler ),
+    m_previewPlayer( deviceManager )
+{
+    m_UI->setupUi( this );
+
+    connect( &m_jobScheduler, SIGNAL( jobFinished(int,bool) ),
+             this, SLOT( thumbnailJobFinished(int,bool) ) );
+}
+
+
+
+ImportBrowser::~ImportBrowser()
+{
+    delete m_UI;
+}
+
+
+
+void ImportBrowser::setDirectory( const QString dirPath )
+{
+    QDir dir( dirPath );
+
+    if ( dirPath.isEmpty() || ! dir.exists() )
+    {
+        m_UI->lineEdit_Dir->setText( QDir::toNativeSeparators( m_dirPath ) );
+        return;
+    }
+
+    stopAudition();
+
+    // Thumbnails still being made for the old directory are no longer needed
+    foreach ( int jobId, m_thumbnailJobs.keys() )
+    {
+        m_jobScheduler.cancel( jobId );
+    }
+    m_thumbnailJobs.clear();
+    m_fileItems.clear();
+    m_UI->listWidget_Files->clear();
+
+    m_dirPath = dir.absolutePath();
+    m_UI->lineEdit_Dir->setText( QDir::toNativeSeparators( m_dirPath ) );
+    m_UI->pushButton_Up->setEnabled( ! dir.isRoot() );
+
+    const QDir::SortFlags sortFlags = QDir::Name | QDir::IgnoreCase;
+
+    foreach ( QFileInfo fileInfo, dir.entryInfoList( QDir::Dirs | QDir::NoDotAndDotDot, sortFlags ) )
+    {
+        QListWidgetItem* item = new QListWidgetItem( style()->standardIcon( QStyle::SP_DirIcon ),
+                                                     fileInfo.fileName(),
+                                                     m_UI->listWidget_Files );
+        item->setData( FILE_PATH_ROLE, fileInfo.absoluteFilePath() );
+        item->setData( IS_DIR_ROLE, true );
+    }
+
+    // A blank icon keeps the file names lined up until the thumbnails arrive
+    QPixmap blankPixmap( m_UI->listWidget_Files->iconSize() );
+    blankPixmap.fill( Qt::transparent );
+
+    foreach ( QFileInfo fileInfo, dir.entryInfoList( AudioFileReader::getFileNameFilters(), QDir::Files, sortFlags ) )
+    {
+        const QString filePath = fileInfo.absoluteFilePath();
+
+        QListWidgetItem* item = new QListWidgetItem( QIcon( blankPixmap ),
+                                                     fileInfo.fileName(),
+                                                     m_UI->listWidget_Files );
+        item->setData( FILE_PATH_ROLE, filePath );
+        item->setData( IS_DIR_ROLE, false );
+
+        m_fileItems.insert( filePath, item );
+
+        const QSharedPointer<Thumbnailer::ThumbnailJob> job( new Thumbnailer::ThumbnailJob( filePath, m_cacheDirPath ) );
+        // One job per file is too many to report in the status bar, so no description is given
+        const int jobId = m_jobScheduler.start( job, JobScheduler::PRIORITY_BACKGROUND, QString() );
+
+        m_thumbnailJobs.insert( jobId, job );
+    }
+}
+
+
+
+void ImportBrowser::stopAudition()
+{
+    m_previewPlayer.stop();
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+void ImportBrowser::changeEvent( QEvent* event )
+{
+    QWidget::changeEvent( event );
+
+    switch ( event->type() )
+    {
+    case QEvent::LanguageChange:
+        m_UI->retranslateUi( this );
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+void ImportBrowser::hideEvent( QHideEvent* event )
+{
+    stopAudition();
+
+    QWidget::hideEvent( event );
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+QPixmap ImportBrowser::renderThumbnail( const Thumbnailer::Thumbnail& thumbnail, const QColor colour )
+{
+    const int numColumns = thumbnail.minValues.size();
+
+    QPixmap pixmap( numColumns, THUMBNAIL_HEIGHT );
+    pixmap.fill( Qt::transparent );
+
+    QPainter painter( &pixmap );
+    painter.setPen( colour );
+
+    const qreal halfHeight = THUMBNAIL_HEIGHT / 2.0;
+
+    for ( int columnNum = 0; columnNum < numColumns; columnNum++ )
+    {
+        const int top = roundToInt( halfHeight - thumbnail.maxValues.at( columnNum ) * halfHeight );
+        const int bottom = roundToInt( halfHeight - thumbnail.minValues.at( columnNum ) * halfHeight );
+
+        painter.drawLine( columnNum, top, columnNum, bottom );
+    }
+
+    return pixmap;
+}
+
+
+
+//==================================================================================================
+// Private:
+
+QString ImportBrowser::getSelectedFilePath() const
+{
+    const QListWidgetItem* item = m_UI->listWidget_Files->currentItem();
+
+    if ( item == NULL || item->data( IS_DIR_ROLE ).toBool() )
+    {
+        return QString();
+    }
+
+    return item->data( FILE_PATH_ROLE ).toString();
+}
+
+
+
+//==================================================================================================
+// Private Slots:
+
+void ImportBrowser::thumbnailJobFinished( const int jobId, const bool isCancelled )
+{
+    const QSharedPointer<Thumbnailer::ThumbnailJob> job = m_thumbnailJobs.take( jobId );
+
+    if ( job.isNull() || isCancelled )
+    {
+        return;
+    }
+
+    QListWidgetItem* item = m_fileItems.value( job->getFilePath() );
+
+    if ( item == NULL )
+    {
+        return;
+    }
+
+    const Thumbnailer::Thumbnail thumbnail = job->getThumbnail();
+
+    if ( thumbnail.isValid() )
+    {
+        QString info = QString::number( thumbnail.numFrames / (qreal) thumbnail.sampleRate, 'f', 2 ) + " s";
+
+        if ( thumbnail.bpm > 0.0 )
+        {
+            info += ", " + QString::number( thumbnail.bpm, 'f', 1 ) + " BPM";
+        }
+
+        item->setIcon( QIcon( renderThumbnail( thumbnail, palette().color( QPalette::Text ) ) ) );
+        item->setText( QFileInfo( job->getFilePath() ).fileName() + "\n" + info );
+        item->setToolTip( tr("%1 Hz, %2 channel(s)").arg( thumbnail.sampleRate ).arg( thumbnail.numChans ) );
+    }
+    else
+    {
+        item->setToolTip( tr("No preview available") );
+    }
+}
+
+
+
+void ImportBrowser::on_lineEdit_Dir_returnPressed()
+{
+    setDirectory( QDir::fromNativeSeparators( m_UI->lineEdit_Dir->text() ) );
+}
+
+
+
+void ImportBrowser::on_pushButton_Up_clicked()
+{
+    QDir dir( m_dirPath );
+
+    if ( dir.cdUp() )
+    {
+        setDirectory( dir.absolutePath() );
+    }
+}
+
+
+
+void ImportBrowser::on_pushButton_ChooseDir_clicked()
+{
+    const QString dirPath = QFileDialog::getExistingDirectory( this, tr("Choose Directory"), m_dirPath );
+
+    // If user didn't click "Cancel"
+    if ( ! dirPath.isEmpty() )
+    {
+        setDirectory( dirPath );
+    }
+}
+
+
+
+void ImportBrowser::on_listWidget_Files_currentItemChanged( QListWidgetItem* current, QListWidgetItem* /*previous*/ )
+{
+    const bool isFileSelected = current != NULL && ! current->data( IS_DIR_ROLE ).toBool();
+
+    m_UI->pushButton_Play->setEnabled( isFileSelected );
+    m_UI->pushButton_Import->setEnabled( isFileSelected );
+
+    if ( m_UI->checkBox_AutoPlay->isChecked() )
+    {
+        if ( isFileSelected )
+        {
+            on_pushButton_Play_clicked();
+        }
+        else
+        {
+            stopAudition();
+        }
+    }
+}
+
+
+
+void ImportBrowser::on_listWidget_Files_itemActivated( QListWidgetItem* item )
+{
+    if ( item->data( IS_DIR_ROLE ).toBool() )
+    {
+        setDirectory( item->data( FILE_PATH_ROLE ).toString() );
+    }
+    else
+    {
+        on_pushButton_Import_clicked();
+    }
+}
+
+
+
+void ImportBrowser::on_pushButton_Play_clicked()
+{
+    const QString filePath = getSelectedFilePath();
+
+    if ( ! filePath.isEmpty() )
+    {
+        m_previewPlayer.play( filePath );
+    }
+}
+
+
+
+void ImportBrowser::on_pushButton_Stop_clicked()
+{
+    stopAudition();
+}
+
+
+
+void ImportBrowser::on_pushButton_Import_clicked()
+{
+    const QString filePath = getSelectedFilePath();
+
+    if ( ! filePath.isEmpty() )
+    {
+        stopAudition();
+        emit importRequested( filePath );
+    }
+}
@@ -0,0 +1,101 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef IMPORTBROWSER_H
+#define IMPORTBROWSER_H
+
+#include <QWidget>
+#include <QHash>
+#include <QPixmap>
+#include "JuceHeader.h"
+#include "jobscheduler.h"
+#include "thumbnailer.h"
+#include "previewplayer.h"
+
+class QListWidgetItem;
+
+namespace Ui
+{
+    class ImportBrowser;
+}
+
+
+// Lists the audio files in a directory with a waveform thumbnail and tempo guess for each, and plays them
+// from disk so that they can be auditioned before one is imported
+class ImportBrowser : public QWidget
+{
+    Q_OBJECT
+
+public:
+    ImportBrowser( AudioDeviceManager& deviceManager, JobScheduler& jobScheduler, QWidget* parent = NULL );
+    ~ImportBrowser();
+
+    void setDirectory( QString dirPath );
+    QString getDirectory() const            { return m_dirPath; }
+
+    void stopAudition();
+
+signals:
+    void importRequested( QString filePath );
+
+protected:
+    void changeEvent( QEvent* event );
+    void hideEvent( QHideEvent* event );
+
+private:
+    static const int THUMBNAIL_HEIGHT = 32;
+
+    enum ItemDataRole { FILE_PATH_ROLE = Qt::UserRole, IS_DIR_ROLE };
+
+    static QPixmap renderThumbnail( const Thumbnailer::Thumbnail& thumbnail, QColor colour );
+
+    QString getSelectedFilePath() const;
+
+    Ui::ImportBrowser* m_UI;
+
+    QString m_dirPath;
+    QString m_cacheDirPath;
+
+    JobScheduler& m_jobScheduler;
+    QHash<int, QSharedPointer<Thumbnailer::ThumbnailJob> > m_thumbnailJobs;
+    QHash<QString, QListWidgetItem*> m_fileItems;
+
+    PreviewPlayer m_previewPlayer;
+
+private slots:
+    void thumbnailJobFinished( int jobId, bool isCancelled );
+
+    void on_lineEdit_Dir_returnPressed();
+    void on_pushButton_Up_clicked();
+    void on_pushButton_ChooseDir_clicked();
+    void on_listWidget_Files_currentItemChanged( QListWidgetItem* current, QListWidgetItem* previous );
+    void on_listWidget_Files_itemActivated( QListWidgetItem* item );
+    void on_pushButton_Play_clicked();
+    void on_pushButton_Stop_clicked();
+    void on_pushButton_Import_clicked();
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( ImportBrowser );
+};
+
+#endif // IMPORTBROWSER_H
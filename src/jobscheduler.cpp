@@ -0,0 +1,223 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "jobscheduler.h"
+#include <QThread>
+
+
+//==================================================================================================
+// Public:
+
+JobScheduler::Task::Task() :
+    m_isClaimed( 0 )
+{
+}
+
+
+
+void JobScheduler::Task::wait()
+{
+    if ( claim() )
+    {
+        run();
+        m_isDone.release();
+    }
+    else
+    {
+        // Put the permit back so that the task can be waited for again
+        m_isDone.acquire();
+        m_isDone.release();
+    }
+}
+
+
+
+JobScheduler::Job::Job() :
+    m_scheduler( NULL ),
+    m_jobId( 0 ),
+    m_isCancelled( 0 ),
+    m_progress( 0 )
+{
+}
+
+
+
+void JobScheduler::Job::setProgress( int percent )
+{
+    percent = jlimit( 0, 100, percent );
+
+    if ( m_progress.exchange( percent ) != percent && m_scheduler != NULL )
+    {
+        QMetaObject::invokeMethod( m_scheduler, "updateProgress", Qt::QueuedConnection,
+                                   Q_ARG( int, m_jobId ), Q_ARG( int, percent ) );
+    }
+}
+
+
+
+void JobScheduler::Job::startTask( const SharedTask task )
+{
+    if ( m_scheduler != NULL )
+    {
+        m_scheduler->m_threadPool.start( new TaskRunner( task ), TASK_PRIORITY );
+    }
+}
+
+
+
+void JobScheduler::Job::waitUntilFinished()
+{
+    m_isFinished.acquire();
+    m_isFinished.release();
+}
+
+
+
+JobScheduler::JobScheduler( QObject* parent ) :
+    QObject( parent ),
+    m_nextJobId( 1 )
+{
+    m_threadPool.setMaxThreadCount( qMax( QThread::idealThreadCount(), 1 ) );
+}
+
+
+
+JobScheduler::~JobScheduler()
+{
+    cancelAll();
+    m_threadPool.waitForDone();
+}
+
+
+
+int JobScheduler::start( const SharedJob job, const Priority priority, const QString description )
+{
+    const int jobId = m_nextJobId++;
+
+    job->m_scheduler = this;
+    job->m_jobId = jobId;
+
+    ScheduledJob scheduledJob;
+    scheduledJob.job = job;
+    scheduledJob.description = description;
+
+    m_jobs.insert( jobId, scheduledJob );
+
+    m_threadPool.start( new Runner( job ), priority );
+
+    emit progressChanged( jobId, description, 0 );
+
+    return jobId;
+}
+
+
+
+void JobScheduler::cancel( const int jobId )
+{
+    if ( m_jobs.contains( jobId ) )
+    {
+        m_jobs.value( jobId ).job->m_isCancelled = 1;
+    }
+}
+
+
+
+void JobScheduler::cancelAll()
+{
+    foreach ( ScheduledJob scheduledJob, m_jobs )
+    {
+        scheduledJob.job->m_isCancelled = 1;
+    }
+}
+
+
+
+void JobScheduler::whenFinished( const int jobId, const Callback callback )
+{
+    if ( m_jobs.contains( jobId ) )
+    {
+        m_jobs[ jobId ].callbacks << callback;
+    }
+    else
+    {
+        callback();
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void JobScheduler::Runner::run()
+{
+    if ( ! m_job->isCancelled() )
+    {
+        m_job->run();
+    }
+
+    m_job->m_isFinished.release();
+
+    QMetaObject::invokeMethod( m_job->m_scheduler, "finishJob", Qt::QueuedConnection,
+                               Q_ARG( int, m_job->m_jobId ) );
+}
+
+
+
+void JobScheduler::TaskRunner::run()
+{
+    if ( m_task->claim() )
+    {
+        m_task->run();
+        m_task->m_isDone.release();
+    }
+}
+
+
+
+//==================================================================================================
+// Private Slots:
+
+void JobScheduler::updateProgress( const int jobId, const int percent )
+{
+    if ( m_jobs.contains( jobId ) )
+    {
+        emit progressChanged( jobId, m_jobs.value( jobId ).description, percent );
+    }
+}
+
+
+
+void JobScheduler::finishJob( const int jobId )
+{
+    const ScheduledJob scheduledJob = m_jobs.take( jobId );
+
+    if ( ! scheduledJob.job.isNull() )
+    {
+        emit jobFinished( jobId, scheduledJob.job->isCancelled() );
+
+        foreach ( Callback callback, scheduledJob.callbacks )
+        {
+            callback();
+        }
+    }
+}
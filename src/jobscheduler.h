@@ -0,0 +1,202 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QHash>
+#include <QList>
+#include <functional>
+#include "JuceHeader.h"
+
+
+// Runs long operations on a fixed pool of worker threads so that the GUI stays responsive. There is
+// one scheduler for the whole application, owned by MainWindow; nothing else should start threads of
+// its own for short-lived work. A job's run() is called on a worker thread; jobFinished() and any
+// callbacks given to whenFinished() are always called on the thread that owns the scheduler (the GUI
+// thread), which is where results should be applied
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Queued jobs with a higher priority are started first
+    enum Priority
+    {
+        PRIORITY_BACKGROUND = 0,
+        PRIORITY_NORMAL = 1,
+        PRIORITY_INTERACTIVE = 2
+    };
+
+    typedef std::function<void ()> Callback;
+
+    // Part of a job that can run alongside the rest of it on another worker, e.g. one file of many
+    class Task
+    {
+    public:
+        Task();
+        virtual ~Task() {}
+
+        virtual void run() = 0;
+
+        // Returns once run() has returned. If no worker has picked the task up yet it's run on the
+        // calling thread instead, so a job waiting for its tasks can never hold up the pool
+        void wait();
+
+    private:
+        friend class JobScheduler;
+
+        // Returns true for the one caller that should run the task
+        bool claim()                            { return m_isClaimed.compareAndSetBool( 1, 0 ); }
+
+        Atomic<int> m_isClaimed;
+        QSemaphore m_isDone;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( Task );
+    };
+
+    typedef QSharedPointer<Task> SharedTask;
+
+    class Job
+    {
+    public:
+        Job();
+        virtual ~Job() {}
+
+        // Called on a worker thread. Long loops should check isCancelled() and call setProgress()
+        virtual void run() = 0;
+
+        bool isCancelled() const                { return m_isCancelled.get() != 0; }
+
+        // "percent" should be 0 - 100. Only changes in value are passed on to the GUI thread
+        void setProgress( int percent );
+
+        // Queue a task on the scheduler's workers ahead of any waiting jobs. Should only be called
+        // from run(); the task must then be waited for before run() returns. If the job isn't being
+        // run by a scheduler the task is simply run when it's waited for
+        void startTask( SharedTask task );
+
+        // Blocks until run() has returned, or until the job has been dropped without being run.
+        // This is for threads outside the scheduler, e.g. ProjectSaver's; the GUI thread must not block
+        // and should use JobScheduler::whenFinished() instead
+        void waitUntilFinished();
+
+    private:
+        friend class JobScheduler;
+
+        JobScheduler* m_scheduler;
+        int m_jobId;
+        Atomic<int> m_isCancelled;
+        Atomic<int> m_progress;
+        QSemaphore m_isFinished;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( Job );
+    };
+
+    typedef QSharedPointer<Job> SharedJob;
+
+    JobScheduler( QObject* parent = NULL );
+
+    // Cancels all jobs and waits for any that are running to return
+    ~JobScheduler();
+
+    // Queue a job and return an ID that identifies it in progressChanged() and jobFinished().
+    // "description" is a short user-visible summary, e.g. "Finding onsets"
+    int start( SharedJob job, Priority priority, QString description );
+
+    // Jobs that have already started are asked to stop; jobFinished() is still emitted for them
+    void cancel( int jobId );
+    void cancelAll();
+
+    // Call "callback" once the job has finished, straight after jobFinished() has been emitted for it.
+    // Callbacks for the same job are called in the order they were added. If the job has already
+    // finished, or "jobId" is 0, the callback is called straight away
+    void whenFinished( int jobId, Callback callback );
+
+    bool isBusy() const                         { return ! m_jobs.isEmpty(); }
+
+signals:
+    void progressChanged( int jobId, QString description, int percent );
+    void jobFinished( int jobId, bool isCancelled );
+
+private:
+    class Runner : public QRunnable
+    {
+    public:
+        Runner( SharedJob job ) :
+            QRunnable(),
+            m_job( job )
+        {
+            setAutoDelete( true );
+        }
+
+        void run();
+
+    private:
+        const SharedJob m_job;
+    };
+
+    class TaskRunner : public QRunnable
+    {
+    public:
+        TaskRunner( SharedTask task ) :
+            QRunnable(),
+            m_task( task )
+        {
+            setAutoDelete( true );
+        }
+
+        void run();
+
+    private:
+        const SharedTask m_task;
+    };
+
+    struct ScheduledJob
+    {
+        SharedJob job;
+        QString description;
+        QList<Callback> callbacks;
+    };
+
+    // Tasks belong to jobs that have already started, so they go before any queued jobs
+    static const int TASK_PRIORITY = PRIORITY_INTERACTIVE + 1;
+
+    QThreadPool m_threadPool;
+    QHash<int, ScheduledJob> m_jobs;
+    int m_nextJobId;
+
+private slots:
+    void updateProgress( int jobId, int percent );
+    void finishJob( int jobId );
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( JobScheduler );
+};
+
+
+#endif // JOBSCHEDULER_H
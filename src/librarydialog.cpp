@@ -0,0 +1,313 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "librarydialog.h"
+#include "ui_librarydialog.h"
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QTableWidgetItem>
+
+
+//==================================================================================================
+// Public:
+
+LibraryDialog::LibraryDialog( JobScheduler& jobScheduler, QWidget* parent ) :
+    QDialog( parent ),
+    m_ui( new Ui::LibraryDialog ),
+    m_jobScheduler( jobScheduler ),
+    m_updateJobId( 0 )
+{
+    m_ui->setupUi( this );
+
+    m_index.load( LibraryIndex::getDefaultFilePath() );
+    m_ui->listWidget_Dirs->addItems( m_index.getDirPaths() );
+    m_ui->label_Status->setText( tr("%1 files indexed").arg( m_index.getNumEntries() ) );
+
+    // Queries are quick enough to rerun whenever a search field is changed
+    connect( m_ui->doubleSpinBox_MinBPM, SIGNAL( valueChanged(double) ),
+             this, SLOT( runQuery() ) );
+
+    connect( m_ui->doubleSpinBox_MaxBPM, SIGNAL( valueChanged(double) ),
+             this, SLOT( runQuery() ) );
+
+    connect( m_ui->doubleSpinBox_MinDuration, SIGNAL( valueChanged(double) ),
+             this, SLOT( runQuery() ) );
+
+    connect( m_ui->doubleSpinBox_MaxDuration, SIGNAL( valueChanged(double) ),
+             this, SLOT( runQuery() ) );
+
+    connect( m_ui->lineEdit_Name, SIGNAL( textChanged(QString) ),
+             this, SLOT( runQuery() ) );
+
+    // The scheduler is shared with the main window, so only the update job's signals are acted on
+    connect( &m_jobScheduler, SIGNAL( progressChanged(int,QString,int) ),
+             this, SLOT( updateProgress(int,QString,int) ) );
+
+    connect( &m_jobScheduler, SIGNAL( jobFinished(int,bool) ),
+             this, SLOT( updateFinished(int,bool) ) );
+
+    runQuery();
+}
+
+
+
+LibraryDialog::~LibraryDialog()
+{
+    // The scheduler is owned by the main window and is destroyed first, taking any update job with it
+    delete m_ui;
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+void LibraryDialog::changeEvent( QEvent* event )
+{
+    QDialog::changeEvent( event );
+
+    switch ( event->type() )
+    {
+    case QEvent::LanguageChange:
+        m_ui->retranslateUi( this );
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void LibraryDialog::setDirPaths( const QStringList dirPaths )
+{
+    m_index.setDirPaths( dirPaths );
+
+    m_ui->listWidget_Dirs->clear();
+    m_ui->listWidget_Dirs->addItems( m_index.getDirPaths() );
+
+    startUpdate();
+}
+
+
+
+void LibraryDialog::startUpdate()
+{
+    m_updateJob = QSharedPointer<LibraryIndex::UpdateJob>( new LibraryIndex::UpdateJob( m_index ) );
+    m_updateJobId = m_jobScheduler.start( m_updateJob, JobScheduler::PRIORITY_BACKGROUND, tr("Indexing library") );
+
+    enableDirControls( false );
+}
+
+
+
+void LibraryDialog::enableDirControls( const bool isEnabled )
+{
+    m_ui->pushButton_AddDir->setEnabled( isEnabled );
+    m_ui->pushButton_RemoveDir->setEnabled( isEnabled );
+    m_ui->pushButton_Update->setEnabled( isEnabled );
+    m_ui->pushButton_Cancel->setEnabled( ! isEnabled );
+}
+
+
+
+QString LibraryDialog::getSelectedFilePath() const
+{
+    const QTableWidgetItem* item = m_ui->tableWidget_Results->item( m_ui->tableWidget_Results->currentRow(), NAME_COLUMN );
+
+    if ( item == NULL )
+    {
+        return QString();
+    }
+
+    return item->data( Qt::UserRole ).toString();
+}
+
+
+
+//==================================================================================================
+// Private Slots:
+
+void LibraryDialog::runQuery()
+{
+    // A value of zero means "any"
+    LibraryIndex::Query query;
+
+    if ( m_ui->doubleSpinBox_MinBPM->value() > 0.0 )
+    {
+        query.minBPM = m_ui->doubleSpinBox_MinBPM->value();
+    }
+    if ( m_ui->doubleSpinBox_MaxBPM->value() > 0.0 )
+    {
+        query.maxBPM = m_ui->doubleSpinBox_MaxBPM->value();
+    }
+    if ( m_ui->doubleSpinBox_MinDuration->value() > 0.0 )
+    {
+        query.minDurationSecs = m_ui->doubleSpinBox_MinDuration->value();
+    }
+    if ( m_ui->doubleSpinBox_MaxDuration->value() > 0.0 )
+    {
+        query.maxDurationSecs = m_ui->doubleSpinBox_MaxDuration->value();
+    }
+
+    query.nameContains = m_ui->lineEdit_Name->text().trimmed();
+
+    const QList<LibraryIndex::Entry> results = m_index.find( query );
+    const int numRows = qMin( results.size(), (int) MAX_NUM_RESULTS_SHOWN );
+
+    m_ui->tableWidget_Results->clearContents();
+    m_ui->tableWidget_Results->setRowCount( numRows );
+
+    for ( int row = 0; row < numRows; row++ )
+    {
+        const LibraryIndex::Entry& entry = results.at( row );
+
+        QTableWidgetItem* nameItem = new QTableWidgetItem( QFileInfo( entry.filePath ).fileName() );
+        nameItem->setData( Qt::UserRole, entry.filePath );
+        nameItem->setToolTip( entry.filePath );
+
+        const QString bpmText = entry.bpm > 0.0f ? QString::number( entry.bpm, 'f', 1 ) : "-";
+
+        m_ui->tableWidget_Results->setItem( row, NAME_COLUMN, nameItem );
+        m_ui->tableWidget_Results->setItem( row, DURATION_COLUMN, new QTableWidgetItem( QString::number( entry.durationSecs, 'f', 2 ) ) );
+        m_ui->tableWidget_Results->setItem( row, BPM_COLUMN, new QTableWidgetItem( bpmText ) );
+        m_ui->tableWidget_Results->setItem( row, ONSETS_COLUMN, new QTableWidgetItem( QString::number( entry.numOnsets ) ) );
+        m_ui->tableWidget_Results->setItem( row, LOUDNESS_COLUMN, new QTableWidgetItem( QString::number( entry.loudness, 'f', 1 ) ) );
+    }
+
+    if ( results.size() > numRows )
+    {
+        m_ui->label_NumResults->setText( tr("Showing %1 of %2 matches").arg( numRows ).arg( results.size() ) );
+    }
+    else
+    {
+        m_ui->label_NumResults->setText( tr("%1 matches").arg( results.size() ) );
+    }
+
+    m_ui->pushButton_Import->setEnabled( false );
+}
+
+
+
+void LibraryDialog::updateProgress( const int jobId, const QString /*description*/, const int percent )
+{
+    if ( jobId == m_updateJobId )
+    {
+        m_ui->label_Status->setText( tr("Indexing library: %1%").arg( percent ) );
+    }
+}
+
+
+
+void LibraryDialog::updateFinished( const int jobId, const bool /*isCancelled*/ )
+{
+    if ( jobId != m_updateJobId || m_updateJob.isNull() )
+    {
+        return;
+    }
+
+    // Files analysed before a cancel are kept so that the next update can carry on from there
+    m_index = m_updateJob->getIndex();
+    m_index.save( LibraryIndex::getDefaultFilePath() );
+
+    m_ui->label_Status->setText( tr("%1 files indexed, %2 analysed").arg( m_index.getNumEntries() )
+                                                                     .arg( m_updateJob->getNumFilesAnalysed() ) );
+    m_updateJob.clear();
+
+    enableDirControls( true );
+    runQuery();
+}
+
+
+
+void LibraryDialog::on_pushButton_AddDir_clicked()
+{
+    const QString dirPath = QFileDialog::getExistingDirectory( this, tr("Add Library Directory"), QDir::homePath() );
+
+    // If user didn't click "Cancel"
+    if ( ! dirPath.isEmpty() )
+    {
+        QStringList dirPaths = m_index.getDirPaths();
+        dirPaths << dirPath;
+
+        setDirPaths( dirPaths );
+    }
+}
+
+
+
+void LibraryDialog::on_pushButton_RemoveDir_clicked()
+{
+    const int row = m_ui->listWidget_Dirs->currentRow();
+
+    if ( row >= 0 )
+    {
+        QStringList dirPaths = m_index.getDirPaths();
+        dirPaths.removeAt( row );
+
+        setDirPaths( dirPaths );
+    }
+}
+
+
+
+void LibraryDialog::on_pushButton_Update_clicked()
+{
+    startUpdate();
+}
+
+
+
+void LibraryDialog::on_pushButton_Cancel_clicked()
+{
+    m_jobScheduler.cancel( m_updateJobId );
+}
+
+
+
+void LibraryDialog::on_tableWidget_Results_cellDoubleClicked( const int /*row*/, const int /*column*/ )
+{
+    on_pushButton_Import_clicked();
+}
+
+
+
+void LibraryDialog::on_tableWidget_Results_itemSelectionChanged()
+{
+    m_ui->pushButton_Import->setEnabled( ! getSelectedFilePath().isEmpty() );
+}
+
+
+
+void LibraryDialog::on_pushButton_Import_clicked()
+{
+    const QString filePath = getSelectedFilePath();
+
+    if ( ! filePath.isEmpty() )
+    {
+        emit importRequested( filePath );
+    }
+}
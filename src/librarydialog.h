@@ -0,0 +1,92 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef LIBRARYDIALOG_H
+#define LIBRARYDIALOG_H
+
+#include <QDialog>
+#include <QSharedPointer>
+#include "JuceHeader.h"
+#include "libraryindex.h"
+#include "jobscheduler.h"
+
+
+namespace Ui
+{
+    class LibraryDialog;
+}
+
+
+// Finds loops in the library index by tempo, length and name. The index is updated in the background
+class LibraryDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    LibraryDialog( JobScheduler& jobScheduler, QWidget* parent = NULL );
+    ~LibraryDialog();
+
+signals:
+    void importRequested( QString filePath );
+
+protected:
+    void changeEvent( QEvent* event );
+
+private:
+    enum Column { NAME_COLUMN, DURATION_COLUMN, BPM_COLUMN, ONSETS_COLUMN, LOUDNESS_COLUMN };
+
+    static const int MAX_NUM_RESULTS_SHOWN = 1000;
+
+    void setDirPaths( QStringList dirPaths );
+    void startUpdate();
+    void enableDirControls( bool isEnabled );
+
+    QString getSelectedFilePath() const;
+
+    Ui::LibraryDialog* m_ui;
+
+    LibraryIndex m_index;
+
+    JobScheduler& m_jobScheduler;
+    QSharedPointer<LibraryIndex::UpdateJob> m_updateJob;
+    int m_updateJobId;
+
+private slots:
+    void runQuery();
+
+    void updateProgress( int jobId, QString description, int percent );
+    void updateFinished( int jobId, bool isCancelled );
+
+    void on_pushButton_AddDir_clicked();
+    void on_pushButton_RemoveDir_clicked();
+    void on_pushButton_Update_clicked();
+    void on_pushButton_Cancel_clicked();
+    void on_tableWidget_Results_cellDoubleClicked( int row, int column );
+    void on_tableWidget_Results_itemSelectionChanged();
+    void on_pushButton_Import_clicked();
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( LibraryDialog );
+};
+
+#endif // LIBRARYDIALOG_H
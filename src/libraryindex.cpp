@@ -0,0 +1,445 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "libraryindex.h"
+#include "audiofilereader.h"
+#include "audioanalyser.h"
+#include "thumbnailer.h"
+#include "globals.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+//==================================================================================================
+// Public:
+
+LibraryIndex::Query::Query() :
+    minBPM( std::numeric_limits<float>::quiet_NaN() ),
+    maxBPM( std::numeric_limits<float>::quiet_NaN() ),
+    minDurationSecs( std::numeric_limits<float>::quiet_NaN() ),
+    maxDurationSecs( std::numeric_limits<float>::quiet_NaN() ),
+    minNumOnsets( std::numeric_limits<float>::quiet_NaN() ),
+    maxNumOnsets( std::numeric_limits<float>::quiet_NaN() ),
+    minLoudness( std::numeric_limits<float>::quiet_NaN() ),
+    maxLoudness( std::numeric_limits<float>::quiet_NaN() )
+{
+}
+
+
+
+bool LibraryIndex::load( const QString indexFilePath )
+{
+    m_dirPaths.clear();
+    m_entries.clear();
+
+    QFile file( indexFilePath );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+    {
+        return false;
+    }
+
+    QDataStream inStream( &file );
+    inStream.setFloatingPointPrecision( QDataStream::SinglePrecision );
+
+    quint32 magic = 0;
+    qint32 version = 0;
+
+    inStream >> magic >> version;
+
+    if ( magic != INDEX_MAGIC || version != INDEX_VERSION )
+    {
+        return false;
+    }
+
+    QStringList dirPaths;
+    qint32 numEntries = 0;
+
+    inStream >> dirPaths >> numEntries;
+
+    QHash<QString, Entry> entries;
+    entries.reserve( qMax( numEntries, 0 ) );
+
+    for ( int i = 0; i < numEntries && inStream.status() == QDataStream::Ok; i++ )
+    {
+        QByteArray filePath;
+        qint32 sampleRate = 0;
+        qint32 numOnsets = 0;
+
+        Entry entry;
+
+        inStream >> filePath >> entry.fileSize >> entry.lastModified >> entry.durationSecs
+                 >> sampleRate >> entry.bpm >> numOnsets >> entry.loudness;
+
+        entry.filePath = QString::fromUtf8( filePath );
+        entry.sampleRate = sampleRate;
+        entry.numOnsets = numOnsets;
+
+        entries.insert( entry.filePath, entry );
+    }
+
+    if ( inStream.status() != QDataStream::Ok )
+    {
+        return false;
+    }
+
+    m_dirPaths = dirPaths;
+    m_entries = entries;
+
+    return true;
+}
+
+
+
+bool LibraryIndex::save( const QString indexFilePath ) const
+{
+    QDir().mkpath( QFileInfo( indexFilePath ).absolutePath() );
+
+    // Written under a temporary name so that a failed save doesn't lose the previous index
+    const QString partFilePath = indexFilePath + ".part";
+    QFile file( partFilePath );
+
+    if ( ! file.open( QIODevice::WriteOnly ) )
+    {
+        return false;
+    }
+
+    QDataStream outStream( &file );
+    outStream.setFloatingPointPrecision( QDataStream::SinglePrecision );
+
+    outStream << INDEX_MAGIC << INDEX_VERSION;
+    outStream << m_dirPaths << (qint32) m_entries.size();
+
+    foreach ( const Entry& entry, m_entries )
+    {
+        outStream << entry.filePath.toUtf8() << entry.fileSize << entry.lastModified << entry.durationSecs
+                  << (qint32) entry.sampleRate << entry.bpm << (qint32) entry.numOnsets << entry.loudness;
+    }
+
+    file.close();
+
+    if ( outStream.status() != QDataStream::Ok )
+    {
+        QFile::remove( partFilePath );
+        return false;
+    }
+
+    QFile::remove( indexFilePath );
+
+    return QFile::rename( partFilePath, indexFilePath );
+}
+
+
+
+void LibraryIndex::setDirPaths( const QStringList dirPaths )
+{
+    m_dirPaths.clear();
+
+    foreach ( QString dirPath, dirPaths )
+    {
+        const QString absolutePath = QDir( dirPath ).absolutePath();
+
+        if ( ! m_dirPaths.contains( absolutePath ) )
+        {
+            m_dirPaths << absolutePath;
+        }
+    }
+}
+
+
+
+int LibraryIndex::update( JobScheduler::Job* const job )
+{
+    const QStringList nameFilters = AudioFileReader::getFileNameFilters();
+
+    QHash<QString, Entry> entries;
+    QStringList filePathsToAnalyse;
+
+    // Keep the entries of unchanged files; files in more than one library dir are only indexed once
+    foreach ( QString dirPath, m_dirPaths )
+    {
+        QDirIterator iterator( dirPath, nameFilters, QDir::Files, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks );
+
+        while ( iterator.hasNext() )
+        {
+            if ( job != NULL && job->isCancelled() )
+            {
+                return 0;
+            }
+
+            const QString filePath = iterator.next();
+
+            if ( entries.contains( filePath ) )
+            {
+                continue;
+            }
+
+            const QFileInfo fileInfo = iterator.fileInfo();
+            const Entry entry = m_entries.value( filePath );
+
+            if ( ! entry.filePath.isEmpty() &&
+                 entry.fileSize == fileInfo.size() &&
+                 entry.lastModified == fileInfo.lastModified().toMSecsSinceEpoch() )
+            {
+                entries.insert( filePath, entry );
+            }
+            else
+            {
+                entries.insert( filePath, Entry() );
+                filePathsToAnalyse << filePath;
+            }
+        }
+    }
+
+    // Files are decoded and analysed concurrently. Analyses only take aubio's mutex while creating or
+    // deleting their detectors, as aubio's FFT setup and cleanup aren't thread-safe
+    const int numFiles = filePathsToAnalyse.size();
+
+    QVector<Entry> results( numFiles );
+
+    QList<JobScheduler::SharedTask> tasks;
+
+    for ( int i = 0; i < numFiles; i++ )
+    {
+        const JobScheduler::SharedTask task( new AnalysisTask( filePathsToAnalyse.at( i ), results.data() + i, job ) );
+
+        if ( job != NULL )
+        {
+            job->startTask( task );
+        }
+        tasks << task;
+    }
+
+    // Tasks that no worker has picked up yet are run here, so this also works without a job
+    for ( int i = 0; i < numFiles; i++ )
+    {
+        tasks.at( i )->wait();
+
+        if ( job != NULL )
+        {
+            job->setProgress( ( i + 1 ) * 100 / numFiles );
+        }
+    }
+
+    // Files that weren't analysed before the job was cancelled are left out until the next update
+    int numFilesAnalysed = 0;
+
+    for ( int i = 0; i < numFiles; i++ )
+    {
+        if ( results.at( i ).filePath.isEmpty() )
+        {
+            entries.remove( filePathsToAnalyse.at( i ) );
+        }
+        else
+        {
+            entries.insert( filePathsToAnalyse.at( i ), results.at( i ) );
+            numFilesAnalysed++;
+        }
+    }
+
+    m_entries = entries;
+
+    return numFilesAnalysed;
+}
+
+
+
+QList<LibraryIndex::Entry> LibraryIndex::find( const Query& query ) const
+{
+    QList<Entry> results;
+
+    foreach ( const Entry& entry, m_entries )
+    {
+        if ( matches( entry, query ) )
+        {
+            results << entry;
+        }
+    }
+
+    std::sort( results.begin(), results.end(), isPathLessThan );
+
+    return results;
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+QString LibraryIndex::getDefaultFilePath()
+{
+    return QString::fromUtf8( File( LIBRARY_INDEX_FILE_PATH ).getFullPathName().toRawUTF8() );
+}
+
+
+
+LibraryIndex::Entry LibraryIndex::analyseFile( const QString filePath )
+{
+    const QFileInfo fileInfo( filePath );
+
+    Entry entry;
+    entry.filePath = fileInfo.absoluteFilePath();
+    entry.fileSize = fileInfo.size();
+    entry.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+    Thumbnailer::DecodedFile decodedFile;
+
+    if ( Thumbnailer::decode( filePath, 1, decodedFile ) )
+    {
+        const AudioAnalyser::DetectionSettings settings = Thumbnailer::getAnalysisSettings( decodedFile );
+
+        entry.durationSecs = decodedFile.numFrames / (float) decodedFile.sampleRate;
+        entry.sampleRate = decodedFile.sampleRate;
+        entry.bpm = (float) Thumbnailer::guessBPM( decodedFile );
+        entry.numOnsets = AudioAnalyser::findOnsetFrameNums( decodedFile.analysisBuffer, settings ).size();
+        entry.loudness = Decibels::gainToDecibels( decodedFile.rmsLevel );
+    }
+
+    return entry;
+}
+
+
+
+bool LibraryIndex::matches( const Entry& entry, const Query& query )
+{
+    if ( ! entry.isValid() )
+    {
+        return false;
+    }
+
+    const bool isBPMQuery = ! std::isnan( query.minBPM ) || ! std::isnan( query.maxBPM );
+
+    // Files without a tempo never match a BPM query
+    if ( isBPMQuery && ( entry.bpm <= 0.0f || ! isInRange( entry.bpm, query.minBPM, query.maxBPM ) ) )
+    {
+        return false;
+    }
+
+    if ( ! isInRange( entry.durationSecs, query.minDurationSecs, query.maxDurationSecs ) ||
+         ! isInRange( entry.numOnsets, query.minNumOnsets, query.maxNumOnsets ) ||
+         ! isInRange( entry.loudness, query.minLoudness, query.maxLoudness ) )
+    {
+        return false;
+    }
+
+    return query.nameContains.isEmpty() ||
+           QFileInfo( entry.filePath ).fileName().contains( query.nameContains, Qt::CaseInsensitive );
+}
+
+
+
+bool LibraryIndex::parseQuery( const QStringList terms, Query& query )
+{
+    query = Query();
+
+    foreach ( QString term, terms )
+    {
+        const int equalsPos = term.indexOf( '=' );
+
+        if ( equalsPos < 1 )
+        {
+            return false;
+        }
+
+        const QString key = term.left( equalsPos ).toLower();
+        const QString value = term.mid( equalsPos + 1 );
+
+        bool isValid = true;
+
+        if ( key == "bpm" )
+        {
+            isValid = parseRange( value, query.minBPM, query.maxBPM );
+        }
+        else if ( key == "duration" )
+        {
+            isValid = parseRange( value, query.minDurationSecs, query.maxDurationSecs );
+        }
+        else if ( key == "onsets" )
+        {
+            isValid = parseRange( value, query.minNumOnsets, query.maxNumOnsets );
+        }
+        else if ( key == "loudness" )
+        {
+            isValid = parseRange( value, query.minLoudness, query.maxLoudness );
+        }
+        else if ( key == "name" )
+        {
+            query.nameContains = value;
+        }
+        else
+        {
+            isValid = false;
+        }
+
+        if ( ! isValid )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+bool LibraryIndex::isInRange( const float value, const float min, const float max )
+{
+    return ( std::isnan( min ) || value >= min ) && ( std::isnan( max ) || value <= max );
+}
+
+
+
+bool LibraryIndex::parseRange( const QString text, float& min, float& max )
+{
+    const int separatorPos = text.indexOf( ".." );
+
+    const QString minText = separatorPos < 0 ? text : text.left( separatorPos );
+    const QString maxText = separatorPos < 0 ? text : text.mid( separatorPos + 2 );
+
+    bool isMinValid = true;
+    bool isMaxValid = true;
+
+    min = minText.isEmpty() ? std::numeric_limits<float>::quiet_NaN() : minText.toFloat( &isMinValid );
+    max = maxText.isEmpty() ? std::numeric_limits<float>::quiet_NaN() : maxText.toFloat( &isMaxValid );
+
+    // ".." on its own is almost certainly a mistake
+    return isMinValid && isMaxValid && ! ( minText.isEmpty() && maxText.isEmpty() );
+}
+
+
+
+bool LibraryIndex::isPathLessThan( const Entry& entry1, const Entry& entry2 )
+{
+    return entry1.filePath < entry2.filePath;
+}
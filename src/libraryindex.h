@@ -0,0 +1,164 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "JuceHeader.h"
+#include "jobscheduler.h"
+
+
+// Analysis results for every audio file under a set of library directories, so that loops can be found by
+// tempo, length, etc. without decoding them again. Updating only analyses files that are new or whose size
+// or modification time has changed
+class LibraryIndex
+{
+public:
+    struct Entry
+    {
+        Entry() : fileSize( 0 ), lastModified( 0 ), durationSecs( 0.0f ), sampleRate( 0 ), bpm( 0.0f ),
+                  numOnsets( 0 ), loudness( 0.0f ) {}
+
+        // Files that couldn't be read are kept as invalid entries so they're not retried until they change
+        bool isValid() const                { return sampleRate > 0; }
+
+        QString filePath;
+        qint64 fileSize;
+        qint64 lastModified;                // Milliseconds since the epoch
+        float durationSecs;
+        int sampleRate;
+        float bpm;                          // 0.0 if no tempo was found
+        int numOnsets;                      // Within the first two minutes
+        float loudness;                     // RMS level in dBFS
+    };
+
+    // A limit is ignored if it's NaN, so a default query matches every valid entry
+    struct Query
+    {
+        Query();
+
+        float minBPM, maxBPM;
+        float minDurationSecs, maxDurationSecs;
+        float minNumOnsets, maxNumOnsets;
+        float minLoudness, maxLoudness;
+        QString nameContains;               // Case insensitive
+    };
+
+    // Where the GUI and command line keep the index
+    static QString getDefaultFilePath();
+
+    bool load( QString indexFilePath );
+    bool save( QString indexFilePath ) const;
+
+    QStringList getDirPaths() const         { return m_dirPaths; }
+    void setDirPaths( QStringList dirPaths );
+
+    int getNumEntries() const               { return m_entries.size(); }
+
+    // Rescans the library dirs, analysing new and changed files concurrently as tasks of "job", and returns
+    // the no. of files analysed. If "job" is cancelled during analysis, the files already done are kept
+    int update( JobScheduler::Job* job = NULL );
+
+    // Results are sorted by file path
+    QList<Entry> find( const Query& query ) const;
+
+    // Invalid entries never match, nor do entries without a tempo if the query limits the BPM
+    static bool matches( const Entry& entry, const Query& query );
+
+    static Entry analyseFile( QString filePath );
+
+    // Terms are e.g. "bpm=120..125", "duration=..4", "onsets=8" or "name=kick". "bpm", "duration", "onsets"
+    // and "loudness" take a single value or a range with either end left open. Returns false if a term is invalid
+    static bool parseQuery( QStringList terms, Query& query );
+
+    // Updates a copy of the index on a JobScheduler worker thread, so that the original can still be
+    // queried meanwhile. The updated copy should be applied in the GUI thread once the job has finished
+    class UpdateJob;
+
+private:
+    static const quint32 INDEX_MAGIC = 0x53484c49;  // "SHLI"
+    static const qint32 INDEX_VERSION = 1;
+
+    static bool isInRange( float value, float min, float max );
+    static bool parseRange( QString text, float& min, float& max );
+    static bool isPathLessThan( const Entry& entry1, const Entry& entry2 );
+
+    QStringList m_dirPaths;
+    QHash<QString, Entry> m_entries;
+
+    class AnalysisTask : public JobScheduler::Task
+    {
+    public:
+        AnalysisTask( const QString filePath, Entry* result, JobScheduler::Job* job ) :
+            JobScheduler::Task(),
+            m_filePath( filePath ),
+            m_result( result ),
+            m_job( job )
+        {
+        }
+
+        void run()
+        {
+            if ( m_job == NULL || ! m_job->isCancelled() )
+            {
+                *m_result = analyseFile( m_filePath );
+            }
+        }
+
+    private:
+        const QString m_filePath;
+        Entry* const m_result;
+        JobScheduler::Job* const m_job;
+    };
+};
+
+
+class LibraryIndex::UpdateJob : public JobScheduler::Job
+{
+public:
+    UpdateJob( const LibraryIndex& index ) :
+        JobScheduler::Job(),
+        m_index( index ),
+        m_numFilesAnalysed( 0 )
+    {
+    }
+
+    void run()
+    {
+        m_numFilesAnalysed = m_index.update( this );
+    }
+
+    LibraryIndex getIndex() const               { return m_index; }
+    int getNumFilesAnalysed() const             { return m_numFilesAnalysed; }
+
+private:
+    LibraryIndex m_index;
+    int m_numFilesAnalysed;
+};
+
+
+#endif // LIBRARYINDEX_H
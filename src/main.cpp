@@ -23,11 +23,14 @@
 #include <QApplication>
 #include "mainwindow.h"
 #include <signal.h>
+#include <string.h>
 #include "signallistener.h"
 #include "JuceHeader.h"
 #include <QtDebug>
 #include <QFile>
 #include <QTextStream>
+#include <QCoreApplication>
+#include "libraryindex.h"
 
 
 void messageHandler( QtMsgType messageType, const char* message )
@@ -97,8 +100,97 @@ static void setupSignalHandlers()
 
 
 
+// "--index-library [DIR...]" adds any dirs to the loop library and updates the index.
+// "--query-library TERM..." prints the matching files, see LibraryIndex::parseQuery()
+static bool isLibraryCommand( const int argc, char* argv[] )
+{
+    return argc > 1 && ( strcmp( argv[ 1 ], "--index-library" ) == 0 || strcmp( argv[ 1 ], "--query-library" ) == 0 );
+}
+
+
+
+static int runLibraryCommand( const QStringList arguments )
+{
+    QTextStream out( stdout );
+    QTextStream err( stderr );
+
+    const QString command = arguments.at( 1 );
+    const QStringList params = arguments.mid( 2 );
+    const QString indexFilePath = LibraryIndex::getDefaultFilePath();
+
+    LibraryIndex index;
+    const bool isIndexLoaded = index.load( indexFilePath );
+
+    if ( command == "--index-library" )
+    {
+        index.setDirPaths( index.getDirPaths() + params );
+
+        if ( index.getDirPaths().isEmpty() )
+        {
+            err << "No library directories given" << endl;
+            return 1;
+        }
+
+        // Analyse files concurrently on the scheduler's workers, as the library dialog does
+        JobScheduler jobScheduler;
+        const QSharedPointer<LibraryIndex::UpdateJob> job( new LibraryIndex::UpdateJob( index ) );
+
+        jobScheduler.start( job, JobScheduler::PRIORITY_NORMAL, QObject::tr("Indexing library") );
+        job->waitUntilFinished();
+
+        index = job->getIndex();
+        const int numFilesAnalysed = job->getNumFilesAnalysed();
+
+        if ( ! index.save( indexFilePath ) )
+        {
+            err << "Couldn't save " << indexFilePath << endl;
+            return 1;
+        }
+
+        out << index.getNumEntries() << " files indexed, " << numFilesAnalysed << " analysed" << endl;
+    }
+    else
+    {
+        LibraryIndex::Query query;
+
+        if ( ! LibraryIndex::parseQuery( params, query ) )
+        {
+            err << "Usage: --query-library [bpm=MIN..MAX] [duration=MIN..MAX] [onsets=MIN..MAX] "
+                   "[loudness=MIN..MAX] [name=TEXT]" << endl;
+            return 2;
+        }
+
+        if ( ! isIndexLoaded )
+        {
+            err << "No library index, run --index-library first" << endl;
+            return 1;
+        }
+
+        // Path, duration (secs), BPM, no. of onsets, loudness (dBFS)
+        foreach ( const LibraryIndex::Entry& entry, index.find( query ) )
+        {
+            out << entry.filePath << '\t'
+                << QString::number( entry.durationSecs, 'f', 2 ) << '\t'
+                << QString::number( entry.bpm, 'f', 1 ) << '\t'
+                << entry.numOnsets << '\t'
+                << QString::number( entry.loudness, 'f', 1 ) << endl;
+        }
+    }
+
+    return 0;
+}
+
+
+
 int main( int argc, char* argv[] )
 {
+    // Library commands don't need a display
+    if ( isLibraryCommand( argc, argv ) )
+    {
+        QCoreApplication app( argc, argv );
+        return runLibraryCommand( app.arguments() );
+    }
+
     QApplication app( argc, argv );
 
     // Register custom message handler. This is useful for debugging when Shuriken is launched by NSM
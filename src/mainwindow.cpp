@@ -35,6 +35,7 @@
 #include "messageboxes.h"
 #include "sampleutils.h"
 #include "textfilehandler.h"
+#include "spectrogramrenderer.h"
 #include <rubberband/RubberBandStretcher.h>
 #include <QtDebug>
 
@@ -51,7 +52,24 @@ MainWindow::MainWindow( QWidget* parent ) :
     m_lastOpenedImportDir( QDir::homePath() ),
     m_lastOpenedProjDir( QDir::homePath() ),
     m_appliedBPM( 0.0 ),
-    m_isProjectOpen( false )
+    m_isProjectOpen( false ),
+    m_pendingSaveId( -1 ),
+    m_isPendingSaveNsmExport( false ),
+    m_pendingSaveUndoIndex( 0 ),
+    m_projectLoadJobId( 0 ),
+    m_isProjectLoadRecovery( false ),
+    m_lastJournalledUndoIndex( 0 ),
+    m_detectionJobId( 0 ),
+    m_classificationJobId( 0 ),
+    m_stretchRenderJobId( 0 ),
+    m_stretchRenderCommand( NULL ),
+    m_importJobId( 0 ),
+    m_exportJobId( 0 ),
+    m_spillJobId( 0 ),
+    m_isMemoryCeilingCheckPending( false ),
+    m_editJobId( 0 ),
+    m_isLastEditCancelled( false ),
+    m_importBrowser( NULL )
 {
     // Check if a file path has been passed on the command line
     QString filePath;
@@ -61,6 +79,24 @@ MainWindow::MainWindow( QWidget* parent ) :
         filePath = QApplication::arguments().at( 1 );
     }
 
+    m_projectSaver = new ProjectSaver();
+
+    connect( m_projectSaver, SIGNAL( saveFinished(int,bool,QString,QString) ),
+             this, SLOT( projectSaveFinished(int,bool,QString,QString) ) );
+
+    m_jobScheduler = new JobScheduler();
+
+    connect( m_jobScheduler, SIGNAL( progressChanged(int,QString,int) ),
+             this, SLOT( jobProgress(int,QString,int) ) );
+
+    connect( m_jobScheduler, SIGNAL( jobFinished(int,bool) ),
+             this, SLOT( jobFinished(int,bool) ) );
+
+    // Any edit makes onsets, beats or BPM that are still being detected out of date, as well as
+    // a time stretch render that no longer belongs to the latest edit
+    connect( &m_undoStack, SIGNAL( indexChanged(int) ),
+             this, SLOT( cancelStaleJobs() ) );
+
     // Check if Non Session Manager is running
     const char* nsmUrl = getenv( "NSM_URL" );
 
@@ -82,20 +118,56 @@ MainWindow::MainWindow( QWidget* parent ) :
                  this, SLOT( on_actionSave_Project_triggered() ),
                  Qt::BlockingQueuedConnection );
 
-        m_nsmThread->start();
+        m_nsmThread->setProjectSaver( m_projectSaver );
     }
 
     // Set up audio and user interface
     initialiseAudio();
     setupUI();
 
+    // Keep memory use below the ceiling set in the options dialog; undo data is spilled to the temp dir
+    m_memoryAccountant = new MemoryAccountant( m_optionsDialog != NULL ? m_optionsDialog->getTempDirPath() : QString(),
+                                               m_fileHandler );
+
+    connect( &m_undoStack, SIGNAL( indexChanged(int) ),
+             this, SLOT( enforceMemoryCeiling() ) );
+
+    if ( m_optionsDialog != NULL )
+    {
+        connect( m_optionsDialog, SIGNAL( memoryCeilingChanged(int) ),
+                 this, SLOT( enforceMemoryCeiling() ) );
+    }
+
+    // Start journalling edits so the session can be recovered if Shuriken doesn't exit cleanly
+    if ( m_optionsDialog != NULL && ! m_optionsDialog->getTempDirPath().isEmpty() )
+    {
+        if ( nsmUrl == NULL && filePath.isEmpty() )
+        {
+            offerSessionRecovery();
+        }
+
+        m_editJournal = new EditJournal( m_optionsDialog->getTempDirPath() );
+
+        connect( &m_undoStack, SIGNAL( indexChanged(int) ),
+                 this, SLOT( recordJournalEntry(int) ) );
+
+        if ( m_isProjectOpen )
+        {
+            recordJournalEntry( m_undoStack.index() );
+        }
+    }
+
     // Load project or audio file if necessary
     if ( nsmUrl != NULL && filePath.isEmpty() )
     {
+        // Load in the background so the session isn't held up while the audio is decoded
         if ( QFileInfo( m_currentProjectFilePath ).exists() )
         {
             openProject( m_currentProjectFilePath );
         }
+
+        // Only start handling NSM messages now, so that a save request can't slip in before the load has started
+        m_nsmThread->start();
     }
     else if ( !filePath.isEmpty() )
     {
@@ -117,6 +189,27 @@ MainWindow::~MainWindow()
 {
     closeProject();
 
+    const bool isProjectLoading = m_projectLoadJobId != 0;
+
+    // Cancel any running jobs, including a project load or export, and wait for them to return
+    m_jobScheduler = NULL;
+
+    if ( m_nsmThread != NULL )
+    {
+        // Fail any NSM save that is waiting for the load to finish
+        if ( isProjectLoading )
+        {
+            m_nsmThread->projectLoadFinished( false );
+        }
+
+        m_nsmThread->quit();
+        m_nsmThread->wait( 2000 );
+    }
+
+    // Let any in-flight save finish before the temp dir is removed
+    m_projectSaver = NULL;
+    m_editJournal = NULL;
+
     if ( m_optionsDialog != NULL )
     {
         const QString tempDirPath = m_optionsDialog->getTempDirPath();
@@ -127,13 +220,51 @@ MainWindow::~MainWindow()
         }
     }
 
-    if ( m_nsmThread != NULL )
+    delete m_ui;
+}
+
+
+
+MemoryAccountant::Usage MainWindow::getMemoryUsage() const
+{
+    MemoryAccountant::Usage usage;
+
+    // Buffers shared between categories are counted in the first one they're found in
+    usage.addSampleBuffers( MemoryAccountant::SAMPLES, m_sampleBufferList );
+    usage.addSampleBuffers( MemoryAccountant::CLIPBOARD, m_copiedSampleBuffers );
+
+    for ( int i = 0; i < m_undoStack.count(); i++ )
     {
-        m_nsmThread->quit();
-        m_nsmThread->wait( 2000 );
+        usage.addSampleBuffers( MemoryAccountant::UNDO_HISTORY, getHeldSampleBuffers( m_undoStack.command( i ) ) );
     }
 
-    delete m_ui;
+    if ( ! m_stretchRenderJob.isNull() )
+    {
+        usage.addSampleBuffers( MemoryAccountant::STRETCHER, m_stretchRenderJob->getSampleBufferList() );
+    }
+
+    if ( m_rubberbandAudioSource != NULL )
+    {
+        usage.addNumBytes( MemoryAccountant::STRETCHER, m_rubberbandAudioSource->getNumBytesAllocated() );
+    }
+
+    if ( m_graphicsScene != NULL )
+    {
+        foreach ( SharedWaveformItem item, m_graphicsScene->getWaveformList() )
+        {
+            usage.addNumBytes( MemoryAccountant::WAVEFORM_CACHE, item->getSampleBinsNumBytes() );
+        }
+    }
+
+    usage.addNumBytes( MemoryAccountant::SPECTROGRAM_CACHE, SpectrogramRenderer::getTileCacheNumBytes() );
+
+    if ( m_memoryAccountant != NULL )
+    {
+        usage.numSpilledBytes = m_memoryAccountant->getNumSpilledBytes();
+        usage.numTempFileBytes = m_memoryAccountant->getTempDirNumBytes();
+    }
+
+    return usage;
 }
 
 
@@ -172,7 +303,15 @@ void MainWindow::closeEvent( QCloseEvent* event )
         {
         case QMessageBox::Save:
             on_actionSave_Project_triggered();
-            event->accept();
+
+            if ( waitForProjectSaves() )
+            {
+                event->accept();
+            }
+            else
+            {
+                event->ignore();
+            }
             break;
         case QMessageBox::Discard:
             event->accept();
@@ -332,6 +471,11 @@ void MainWindow::setUpSampler()
         m_samplerAudioSource = new SamplerAudioSource( isMonophonyEnabled, currentAudioDevice );
 
         m_samplerAudioSource->setSamples( m_sampleBufferList, m_sampleHeader->sampleRate );
+        m_samplerAudioSource->setVoiceLimit( m_optionsDialog->getVoiceLimit() );
+        applyDrumNoteMap();
+
+        connect( m_optionsDialog, SIGNAL( voiceLimitChanged(int) ),
+                 m_samplerAudioSource, SLOT( setVoiceLimit(int) ) );
 
         on_pushButton_Loop_clicked( m_ui->pushButton_Loop->isChecked() );
 
@@ -344,8 +488,13 @@ void MainWindow::setUpSampler()
 
             const RubberBandStretcher::Options options = m_optionsDialog->getStretcherOptions();
             const bool isJackSyncEnabled = m_optionsDialog->isJackSyncEnabled();
+            const bool isAdaptiveQualityEnabled = m_optionsDialog->isAdaptiveQualityEnabled();
 
-            m_rubberbandAudioSource = new RubberbandAudioSource( m_samplerAudioSource, numOutputChans, options, isJackSyncEnabled );
+            m_rubberbandAudioSource = new RubberbandAudioSource( m_samplerAudioSource,
+                                                                 numOutputChans,
+                                                                 options,
+                                                                 isJackSyncEnabled,
+                                                                 isAdaptiveQualityEnabled );
             m_audioSourcePlayer.setSource( m_rubberbandAudioSource );
 
             connect( m_optionsDialog, SIGNAL( transientsOptionChanged(RubberBandStretcher::Options) ),
@@ -363,6 +512,9 @@ void MainWindow::setUpSampler()
             connect( m_optionsDialog, SIGNAL( jackSyncToggled(bool) ),
                      m_rubberbandAudioSource, SLOT( enableJackSync(bool) ) );
 
+            connect( m_optionsDialog, SIGNAL( adaptiveQualityToggled(bool) ),
+                     m_rubberbandAudioSource, SLOT( enableAdaptiveQuality(bool) ) );
+
             on_checkBox_TimeStretch_toggled( m_ui->checkBox_TimeStretch->isChecked() );
         }
         else // Offline time stretch mode
@@ -396,6 +548,7 @@ void MainWindow::setupUI()
     // Initialise user interface
     m_ui->setupUi( this );
     m_graphicsScene = m_ui->waveGraphicsView->getScene();
+    m_graphicsScene->setJobScheduler( m_jobScheduler );
 
 #if QT_VERSION < 0x040700
     // This must be set in Qt 4.6, otherwise the proprietary AMD video driver may cause the CPU to max out when scrolling
@@ -576,8 +729,8 @@ void MainWindow::setupUI()
 
 
     // Connect signals to slots
-    connect( m_graphicsScene, SIGNAL( slicePointPosChanged(SharedSlicePointItem,int,int,int,int) ),
-             this, SLOT( recordSlicePointItemMove(SharedSlicePointItem,int,int,int,int) ) );
+    connect( m_graphicsScene, SIGNAL( slicePointPosChanged(SharedSlicePointItem,int,FrameNum,FrameNum,FrameNum) ),
+             this, SLOT( recordSlicePointItemMove(SharedSlicePointItem,int,FrameNum,FrameNum,FrameNum) ) );
 
     connect( m_ui->waveGraphicsView, SIGNAL( minDetailLevelReached() ),
              this, SLOT( disableZoomOut() ) );
@@ -588,6 +741,12 @@ void MainWindow::setupUI()
     connect( m_graphicsScene, SIGNAL( playheadFinishedScrolling() ),
              this, SLOT( resetPlayStopButtonIcon() ) );
 
+    connect( m_graphicsScene, SIGNAL( slicePointDragged(FrameNum) ),
+             this, SLOT( scrubSlicePoint(FrameNum) ) );
+
+    connect( m_graphicsScene, SIGNAL( slicePointDragFinished() ),
+             this, SLOT( stopScrubbing() ) );
+
     connect( m_graphicsScene, SIGNAL( selectionChanged() ),
              this, SLOT( enableEditActions() ) );
 
@@ -598,10 +757,10 @@ void MainWindow::setupUI()
              m_ui->actionRedo, SLOT( setEnabled(bool) ) );
 
     connect( m_ui->actionUndo, SIGNAL( triggered() ),
-             &m_undoStack, SLOT( undo() ) );
+             this, SLOT( undo() ) );
 
     connect( m_ui->actionRedo, SIGNAL( triggered() ),
-             &m_undoStack, SLOT( redo() ) );
+             this, SLOT( redo() ) );
 
     connect( &m_undoStack, SIGNAL( cleanChanged(bool) ),
              m_ui->actionSave_Project, SLOT( setDisabled(bool) ) );
@@ -645,6 +804,18 @@ void MainWindow::setupUI()
     }
 
 
+    // Create loop library dialog
+    m_libraryDialog = new LibraryDialog( *m_jobScheduler, this );
+
+    if ( m_libraryDialog != NULL )
+    {
+        centreWindow( m_libraryDialog );
+
+        connect( m_libraryDialog, SIGNAL( importRequested(QString) ),
+                 this, SLOT( importFromBrowser(QString) ) );
+    }
+
+
     // Create options dialog
     m_optionsDialog = new OptionsDialog( m_deviceManager, this );
 
@@ -670,8 +841,28 @@ void MainWindow::setupUI()
         connect( m_optionsDialog, SIGNAL( audioDeviceChanged() ),
                  this, SLOT( recreateSampler() ) );
 
+        connect( m_optionsDialog, SIGNAL( rendererChanged() ),
+                 this, SLOT( updateWaveformRenderer() ) );
+
         m_optionsDialog->disableTab( OptionsDialog::TIME_STRETCH_TAB );
     }
+
+
+    // Create import browser, hidden until it's chosen from the "File" menu
+    m_importBrowserDock = new QDockWidget( tr( "Import Browser" ), this );
+    m_importBrowserDock->setObjectName( "dockWidget_ImportBrowser" );
+
+    m_importBrowser = new ImportBrowser( m_deviceManager, *m_jobScheduler, m_importBrowserDock );
+
+    m_importBrowserDock->setWidget( m_importBrowser );
+    addDockWidget( Qt::LeftDockWidgetArea, m_importBrowserDock );
+    m_importBrowserDock->hide();
+
+    connect( m_importBrowser, SIGNAL( importRequested(QString) ),
+             this, SLOT( importFromBrowser(QString) ) );
+
+    connect( m_importBrowserDock, SIGNAL( visibilityChanged(bool) ),
+             m_ui->actionImport_Browser, SLOT( setChecked(bool) ) );
 }
 
 
@@ -725,6 +916,7 @@ void MainWindow::enableUI()
     m_ui->actionMulti_Select->setEnabled( true );
     m_ui->actionAudition->setEnabled( true );
     m_ui->actionMonophonic->setEnabled( true );
+    m_ui->actionMap_To_GM_Drums->setEnabled( true );
     if ( m_optionsDialog->isJackAudioEnabled() )
     {
         m_ui->actionJack_Outputs->setEnabled( true );
@@ -792,6 +984,11 @@ void MainWindow::disableUI()
     m_ui->actionAudition->setEnabled( false );
     m_ui->actionMonophonic->setEnabled( false );
     m_ui->actionJack_Outputs->setEnabled( false );
+    m_ui->actionMap_To_GM_Drums->setChecked( false );
+    m_ui->actionMap_To_GM_Drums->setEnabled( false );
+
+    m_drumMappedSampleBuffers.clear();
+    m_drumNoteNums.clear();
 
     if ( m_ui->actionSelective_Time_Stretch->isChecked() )
     {
@@ -843,13 +1040,90 @@ void MainWindow::getDetectionSettings( AudioAnalyser::DetectionSettings& setting
     const qreal percentage = m_ui->comboBox_HopSize->itemData( currentIndex ).toReal();
     settings.hopSize = (uint_t) ( settings.windowSize * ( percentage / 100.0 ) );
 
-    settings.sampleRate = (uint_t) m_sampleHeader->sampleRate;
+    // No sample is loaded when setting up detection for a recording, which supplies its own sample rate
+    settings.sampleRate = m_sampleHeader.isNull() ? 0 : (uint_t) m_sampleHeader->sampleRate;
+}
+
+
+
+void MainWindow::snapToZeroCrossings( QList<FrameNum>& frameNums )
+{
+    if ( m_ui->comboBox_ZeroCrossings->currentText() == tr( "Closest" ) )
+    {
+        for ( int i = 0; i < frameNums.size(); i++ )
+        {
+            FrameNum frameNum = frameNums.at( i );
+
+            frameNum = SampleUtils::getClosestZeroCrossing( m_sampleBufferList.first(), frameNum );
+
+            frameNums.replace( i, frameNum );
+        }
+    }
+    else if ( m_ui->comboBox_ZeroCrossings->currentText() == tr( "Next" ) )
+    {
+        for ( int i = 0; i < frameNums.size(); i++ )
+        {
+            FrameNum frameNum = frameNums.at( i );
+
+            frameNum = SampleUtils::getNextZeroCrossing( m_sampleBufferList.first(), frameNum );
+
+            frameNums.replace( i, frameNum );
+        }
+    }
+    else if ( m_ui->comboBox_ZeroCrossings->currentText() == tr( "Previous" ) )
+    {
+        for ( int i = 0; i < frameNums.size(); i++ )
+        {
+            FrameNum frameNum = frameNums.at( i );
+
+            frameNum = SampleUtils::getPrevZeroCrossing( m_sampleBufferList.first(), frameNum );
+
+            frameNums.replace( i, frameNum );
+        }
+    }
+}
+
+
+
+void MainWindow::replaceSlicePoints( const QList<FrameNum> slicePointFrameNumList, const QString commandText )
+{
+    if ( slicePointFrameNumList.count() > 0 )
+    {
+        QUndoCommand* parentCommand = new QUndoCommand();
+        parentCommand->setText( commandText );
+
+        // Remove current slice point items if present
+        const QList<SharedSlicePointItem> slicePointItemList = m_graphicsScene->getSlicePointList();
+
+        foreach ( SharedSlicePointItem item, slicePointItemList )
+        {
+            new DeleteSlicePointItemCommand( item, m_graphicsScene, m_ui->pushButton_Slice, m_ui->comboBox_SnapValues, parentCommand );
+        }
+
+        // Add new slice point items
+        foreach ( FrameNum frameNum, slicePointFrameNumList )
+        {
+            new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->pushButton_Slice, m_ui->comboBox_SnapValues, parentCommand );
+        }
+
+        m_undoStack.push( parentCommand );
+    }
 }
 
 
 
 void MainWindow::closeProject()
 {
+    // Only jobs working on the project are cancelled; an export goes on with its own copy of the
+    // samples, and the import browser and loop library look after their own jobs
+    m_jobScheduler->cancel( m_projectLoadJobId );
+    m_jobScheduler->cancel( m_importJobId );
+    m_jobScheduler->cancel( m_detectionJobId );
+    m_jobScheduler->cancel( m_classificationJobId );
+    m_jobScheduler->cancel( m_stretchRenderJobId );
+    m_jobScheduler->cancel( m_editJobId );
+    m_jobScheduler->cancel( m_spillJobId );
+
     m_copiedSampleBuffers.clear();
     m_copiedEnvelopes.attackValues.clear();
     m_copiedEnvelopes.releaseValues.clear();
@@ -873,8 +1147,17 @@ void MainWindow::closeProject()
 
     m_undoStack.clear();
 
+    if ( m_editJournal != NULL )
+    {
+        m_editJournal->clear();
+    }
+    m_lastJournalledUndoIndex = 0;
+
     m_appliedBPM = 0.0;
 
+    // Saves still in progress belong to the old project so they mustn't change the undo stack
+    m_pendingSaveId = -1;
+
     if ( m_nsmThread == NULL )
     {
         m_currentProjectFilePath.clear();
@@ -884,9 +1167,9 @@ void MainWindow::closeProject()
 
 
 
-bool MainWindow::isSelectiveTimeStretchInUse() const
+QList<qreal> MainWindow::getNoteTimeRatios() const
 {
-    bool isSelectiveTimeStretchInUse = false;
+    QList<qreal> timeRatioList;
 
     if ( m_samplerAudioSource != NULL && m_rubberbandAudioSource != NULL )
     {
@@ -894,48 +1177,59 @@ bool MainWindow::isSelectiveTimeStretchInUse() const
 
         for ( int i = 0; i < m_sampleBufferList.size(); i++ )
         {
-            const int midiNote = lowestAssignedMidiNote + i;
-            const qreal timeRatio = m_rubberbandAudioSource->getNoteTimeRatio( midiNote );
-
-            if ( timeRatio != 1.0 )
-            {
-                isSelectiveTimeStretchInUse = true;
-                break;
-            }
+            timeRatioList << m_rubberbandAudioSource->getNoteTimeRatio( lowestAssignedMidiNote + i );
         }
     }
 
-    return isSelectiveTimeStretchInUse;
+    return timeRatioList;
 }
 
 
 
-QUndoCommand* MainWindow::createRenderCommand( QUndoCommand* parent )
+bool MainWindow::isSelectiveTimeStretchInUse() const
 {
-    const QString tempDirPath = m_optionsDialog->getTempDirPath();
-
-    QUndoCommand* command = NULL;
-
-    if ( ! tempDirPath.isEmpty() )
+    foreach ( qreal timeRatio, getNoteTimeRatios() )
     {
-        if ( m_samplerAudioSource != NULL && m_rubberbandAudioSource != NULL )
+        if ( timeRatio != 1.0 )
         {
-            const QString fileBaseName = QString::number( m_undoStack.index() );
-
-            command = new RenderTimeStretchCommand( this,
-                                                    m_graphicsScene,
-                                                    tempDirPath,
-                                                    fileBaseName,
-                                                    parent );
+            return true;
         }
     }
-    else
+
+    return false;
+}
+
+
+
+RenderTimeStretchCommand* MainWindow::createRenderCommand( const QList<qreal> timeRatioList,
+                                                           QSharedPointer<OfflineTimeStretcher::RenderJob>& job,
+                                                           QUndoCommand* parent )
+{
+    QString errorInfo;
+
+    if ( ! OfflineTimeStretcher::canStretch( m_sampleBufferList, timeRatioList, errorInfo ) )
     {
-        MessageBoxes::showWarningDialog( tr("Temp dir invalid!"),
-                                         tr("This operation needs to save temporary files, please change \"Temp Dir\" in options") );
+        MessageBoxes::showWarningDialog( tr("Couldn't time stretch!"), errorInfo );
+        return NULL;
     }
 
-    return command;
+    const RubberBandStretcher::Options options = m_optionsDialog->getStretcherOptions() & ~RubberBandStretcher::OptionProcessRealTime;
+
+    // When part of a larger command the next child needs the final audio straight away
+    const OfflineTimeStretcher::RenderJob::Quality quality = parent == NULL ?
+                                                             OfflineTimeStretcher::RenderJob::QUALITY_PREVIEW :
+                                                             OfflineTimeStretcher::RenderJob::QUALITY_FULL;
+
+    job = QSharedPointer<OfflineTimeStretcher::RenderJob>(
+            new OfflineTimeStretcher::RenderJob( m_sampleBufferList,
+                                                 m_sampleHeader->sampleRate,
+                                                 m_sampleHeader->numChans,
+                                                 options,
+                                                 timeRatioList,
+                                                 1.0,
+                                                 quality ) );
+
+    return new RenderTimeStretchCommand( this, m_graphicsScene, timeRatioList, options, parent );
 }
 
 
@@ -952,127 +1246,324 @@ void MainWindow::resetSamples()
         m_samplerAudioSource->setSamples( m_sampleBufferList, m_sampleHeader->sampleRate );
 
         m_samplerAudioSource->setEnvelopeSettings( envelopes );
+
+        applyDrumNoteMap();
     }
 }
 
 
 
-void MainWindow::copySelectedSamplesToClipboard()
+void MainWindow::applyDrumNoteMap()
 {
-    const QList<int> orderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
-
-    // Copy sample buffers
-    m_copiedSampleBuffers.clear();
+    QList<int> noteNums;
 
-    const int numChans = m_sampleHeader->numChans;
-    const int startFrame = 0;
-
-    foreach ( int orderPos, orderPositions )
+    if ( ! m_drumMappedSampleBuffers.isEmpty() )
     {
-        SharedSampleBuffer origSampleBuffer = m_sampleBufferList.at( orderPos );
+        foreach ( SharedSampleBuffer sampleBuffer, m_sampleBufferList )
+        {
+            const int index = m_drumMappedSampleBuffers.indexOf( sampleBuffer );
 
-        const int numFrames = origSampleBuffer->getNumFrames();
+            noteNums << ( index >= 0 ? m_drumNoteNums.at( index ) : -1 );
+        }
+    }
 
-        SharedSampleBuffer copiedSampleBuffer( new SampleBuffer( numChans, numFrames ) );
+    m_samplerAudioSource->setInputNoteMap( noteNums );
 
-        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
-        {
-            copiedSampleBuffer->copyFrom( chanNum, startFrame, *origSampleBuffer.data(), chanNum, startFrame, numFrames );
-        }
+    for ( int sampleNum = 0; sampleNum < m_sampleBufferList.size(); sampleNum++ )
+    {
+        const int noteNum = sampleNum < noteNums.size() ? noteNums.at( sampleNum ) : -1;
 
-        m_copiedSampleBuffers << copiedSampleBuffer;
+        m_samplerAudioSource->setChokeGroup( sampleNum, SliceClassifier::getGMChokeGroup( noteNum ) );
     }
+}
 
-    // Copy envelopes
-    m_copiedEnvelopes.attackValues.clear();
-    m_copiedEnvelopes.releaseValues.clear();
-    m_copiedEnvelopes.oneShotSettings.clear();
-
-    SamplerAudioSource::EnvelopeSettings envelopes;
 
-    m_samplerAudioSource->getEnvelopeSettings( envelopes );
 
-    foreach ( int orderPos, orderPositions )
+void MainWindow::applyDetectionResults( const QSharedPointer<AudioAnalyser::DetectionJob> job )
+{
+    // Edits cancel the job, but the audio may also have been replaced by opening another file
+    if ( m_sampleBufferList.isEmpty() || m_sampleBufferList.first() != job->getSampleBuffer() )
     {
-        m_copiedEnvelopes.attackValues << envelopes.attackValues.at( orderPos );
-        m_copiedEnvelopes.releaseValues << envelopes.releaseValues.at( orderPos );
-        m_copiedEnvelopes.oneShotSettings << envelopes.oneShotSettings.at( orderPos );
+        return;
     }
 
-    // If real-time time streching is enabled then also copy per-note time stretch ratios
-    m_copiedNoteTimeRatios.clear();
-
-    if ( m_rubberbandAudioSource != NULL )
+    if ( job->getType() == AudioAnalyser::DetectionJob::CALC_BPM )
     {
-        const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
+        applyCalculatedBPM( job->getBPM() );
+    }
+    else if ( m_sampleBufferList.size() == 1 )
+    {
+        QList<FrameNum> slicePointFrameNumList = job->getFrameNums();
 
-        foreach ( int orderPos, orderPositions )
+        // Adjust slice points according to zero-crossing settings
+        snapToZeroCrossings( slicePointFrameNumList );
+
+        if ( job->getType() == AudioAnalyser::DetectionJob::FIND_ONSETS )
         {
-            m_copiedNoteTimeRatios << m_rubberbandAudioSource->getNoteTimeRatio( startMidiNote + orderPos );
+            replaceSlicePoints( slicePointFrameNumList, tr("Find Onsets") );
         }
-    }
-    else
-    {
-        for ( int i = 0; i < orderPositions.size(); i++ )
+        else
         {
-            m_copiedNoteTimeRatios << 1.0;
+            replaceSlicePoints( slicePointFrameNumList, tr("Find Beats") );
         }
     }
 }
 
 
 
-QList<int> MainWindow::getSnapFrameNums() const
+void MainWindow::applyClassificationResults( const QSharedPointer<SliceClassifier::ClassificationJob> job )
 {
-    QList<int> slicePointFrameNumList;
-    int divisionsPerBeat = m_ui->comboBox_SnapValues->itemData( m_ui->comboBox_SnapValues->currentIndex() ).toInt();
-
-    if ( divisionsPerBeat > 0 )
+    // Slices may have been added, removed or replaced since the job was started
+    if ( job->getSampleBufferList() != m_sampleBufferList || ! m_ui->actionMap_To_GM_Drums->isChecked() )
     {
-        int totalNumFrames = 0;
-        int numBeats = 0;
+        m_ui->actionMap_To_GM_Drums->setChecked( false );
+        return;
+    }
 
-        foreach ( SharedSampleBuffer sampleBuffer, m_sampleBufferList )
-        {
-            totalNumFrames += sampleBuffer->getNumFrames();
-        }
+    const QList<SliceClassifier::DrumType> drumTypes = job->getDrumTypes();
 
-        if ( m_ui->comboBox_Units->currentText() == tr("Bars") )
-        {
-            int numBars = m_ui->spinBox_Length->value();
+    m_drumNoteNums = job->getNoteNums();
+    m_drumMappedSampleBuffers = job->getSampleBufferList();
 
-            numBeats = numBars * m_ui->comboBox_TimeSigNumerator->currentText().toInt();
-        }
-        else // Units set to "Beats"
+    // Summarise the result in the status bar, e.g. "Kick: 2, Snare: 3, Tom: 1 (4 slices unmapped)"
+    QStringList summary;
+
+    for ( int drumType = 0; drumType < SliceClassifier::NUM_DRUM_TYPES; drumType++ )
+    {
+        const int count = drumTypes.count( SliceClassifier::DrumType( drumType ) );
+
+        if ( count > 0 )
         {
-            numBeats = m_ui->spinBox_Length->value();
+            summary << SliceClassifier::getDrumTypeName( SliceClassifier::DrumType( drumType ) ) + ": " + QString::number( count );
         }
+    }
 
-        if ( numBeats > 0 )
-        {
-            int audioSliceLength = totalNumFrames / ( numBeats * divisionsPerBeat );
+    QString message = summary.join( ", " );
 
-            int frameNum = audioSliceLength;
+    const int numUnmapped = m_drumNoteNums.count( -1 );
 
-            while ( frameNum <= totalNumFrames - audioSliceLength )
-            {
-                slicePointFrameNumList.append( frameNum );
-                frameNum += audioSliceLength;
-            }
-        }
+    if ( numUnmapped > 0 )
+    {
+        message += tr(" (%n slice(s) unmapped)", "", numUnmapped );
     }
 
-    return slicePointFrameNumList;
+    m_ui->statusBar->showMessage( message, 10000 );
+
+    applyDrumNoteMap();
 }
 
 
 
-void MainWindow::calculateBPM()
+void MainWindow::applyStretchRender( const QSharedPointer<OfflineTimeStretcher::RenderJob> job )
 {
-    const int numerator = m_ui->comboBox_TimeSigNumerator->currentText().toInt();
+    const QList<SharedSampleBuffer> sampleBufferList = job->getSampleBufferList();
 
-    int numBeats = 0;
-    qreal bpm = 0;
+    // Any later edit has been made to the preview, so the render no longer fits
+    if ( ! isStretchRenderCommandCurrent() || sampleBufferList.size() != m_sampleBufferList.size() )
+    {
+        return;
+    }
+
+    // The render should be the same length as the preview, so slice points and sampler sounds stay as they are
+    for ( int i = 0; i < sampleBufferList.size(); i++ )
+    {
+        if ( sampleBufferList.at( i )->getNumFrames() != m_sampleBufferList.at( i )->getNumFrames() ||
+             sampleBufferList.at( i )->getNumChannels() != m_sampleBufferList.at( i )->getNumChannels() )
+        {
+            m_ui->statusBar->showMessage( tr("The time stretch render doesn't match the preview and couldn't be used"), 10000 );
+            return;
+        }
+    }
+
+    // Onsets or beats being found in the preview are about to be out of date
+    m_jobScheduler->cancel( m_detectionJobId );
+
+    if ( m_samplerAudioSource != NULL && ! m_samplerAudioSource->replaceSampleData( sampleBufferList ) )
+    {
+        m_ui->statusBar->showMessage( tr("The time stretch render couldn't be used"), 10000 );
+        return;
+    }
+
+    // The render takes the place of the preview
+    replaceSampleBuffers( m_sampleBufferList, sampleBufferList );
+
+    m_graphicsScene->redrawWaveforms();
+
+    // Replace the journal entry that was made with the preview
+    recordJournalEntry( m_undoStack.index() );
+}
+
+
+
+void MainWindow::startStretchRender( const QUndoCommand* const command,
+                                     const QList<SharedSampleBuffer> sampleBufferList,
+                                     const QList<qreal> timeRatioList,
+                                     const qreal pitchScale,
+                                     const RubberBandStretcher::Options options )
+{
+    m_jobScheduler->cancel( m_stretchRenderJobId );
+
+    m_stretchRenderJob = QSharedPointer<OfflineTimeStretcher::RenderJob>(
+            new OfflineTimeStretcher::RenderJob( sampleBufferList,
+                                                 m_sampleHeader->sampleRate,
+                                                 m_sampleHeader->numChans,
+                                                 options,
+                                                 timeRatioList,
+                                                 pitchScale ) );
+
+    m_stretchRenderCommand = command;
+
+    m_stretchRenderJobId = m_jobScheduler->start( m_stretchRenderJob,
+                                                  JobScheduler::PRIORITY_NORMAL,
+                                                  tr("Rendering time stretch") );
+}
+
+
+
+void MainWindow::cancelStretchRender()
+{
+    m_jobScheduler->cancel( m_stretchRenderJobId );
+}
+
+
+
+bool MainWindow::isStretchRenderCommandCurrent() const
+{
+    const int undoIndex = m_undoStack.index();
+
+    return undoIndex > 0 && m_undoStack.command( undoIndex - 1 ) == m_stretchRenderCommand;
+}
+
+
+
+bool MainWindow::isMainWindowJob( const int jobId ) const
+{
+    return jobId == m_projectLoadJobId ||
+           jobId == m_importJobId ||
+           jobId == m_exportJobId ||
+           jobId == m_detectionJobId ||
+           jobId == m_classificationJobId ||
+           jobId == m_stretchRenderJobId ||
+           jobId == m_editJobId;
+}
+
+
+
+void MainWindow::copySelectedSamplesToClipboard()
+{
+    const QList<int> orderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
+
+    // Copy sample buffers
+    m_copiedSampleBuffers.clear();
+
+    const int numChans = m_sampleHeader->numChans;
+    const int startFrame = 0;
+
+    foreach ( int orderPos, orderPositions )
+    {
+        SharedSampleBuffer origSampleBuffer = m_sampleBufferList.at( orderPos );
+
+        const int numFrames = origSampleBuffer->getNumFrames();
+
+        SharedSampleBuffer copiedSampleBuffer( new SampleBuffer( numChans, numFrames ) );
+
+        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+        {
+            copiedSampleBuffer->copyFrom( chanNum, startFrame, *origSampleBuffer.data(), chanNum, startFrame, numFrames );
+        }
+
+        m_copiedSampleBuffers << copiedSampleBuffer;
+    }
+
+    // Copy envelopes
+    m_copiedEnvelopes.attackValues.clear();
+    m_copiedEnvelopes.releaseValues.clear();
+    m_copiedEnvelopes.oneShotSettings.clear();
+
+    SamplerAudioSource::EnvelopeSettings envelopes;
+
+    m_samplerAudioSource->getEnvelopeSettings( envelopes );
+
+    foreach ( int orderPos, orderPositions )
+    {
+        m_copiedEnvelopes.attackValues << envelopes.attackValues.at( orderPos );
+        m_copiedEnvelopes.releaseValues << envelopes.releaseValues.at( orderPos );
+        m_copiedEnvelopes.oneShotSettings << envelopes.oneShotSettings.at( orderPos );
+    }
+
+    // If real-time time streching is enabled then also copy per-note time stretch ratios
+    m_copiedNoteTimeRatios.clear();
+
+    if ( m_rubberbandAudioSource != NULL )
+    {
+        const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
+
+        foreach ( int orderPos, orderPositions )
+        {
+            m_copiedNoteTimeRatios << m_rubberbandAudioSource->getNoteTimeRatio( startMidiNote + orderPos );
+        }
+    }
+    else
+    {
+        for ( int i = 0; i < orderPositions.size(); i++ )
+        {
+            m_copiedNoteTimeRatios << 1.0;
+        }
+    }
+}
+
+
+
+QList<FrameNum> MainWindow::getSnapFrameNums() const
+{
+    QList<FrameNum> slicePointFrameNumList;
+    int divisionsPerBeat = m_ui->comboBox_SnapValues->itemData( m_ui->comboBox_SnapValues->currentIndex() ).toInt();
+
+    if ( divisionsPerBeat > 0 )
+    {
+        FrameNum totalNumFrames = 0;
+        int numBeats = 0;
+
+        foreach ( SharedSampleBuffer sampleBuffer, m_sampleBufferList )
+        {
+            totalNumFrames += sampleBuffer->getNumFrames();
+        }
+
+        if ( m_ui->comboBox_Units->currentText() == tr("Bars") )
+        {
+            int numBars = m_ui->spinBox_Length->value();
+
+            numBeats = numBars * m_ui->comboBox_TimeSigNumerator->currentText().toInt();
+        }
+        else // Units set to "Beats"
+        {
+            numBeats = m_ui->spinBox_Length->value();
+        }
+
+        if ( numBeats > 0 )
+        {
+            FrameNum audioSliceLength = totalNumFrames / ( numBeats * divisionsPerBeat );
+
+            FrameNum frameNum = audioSliceLength;
+
+            while ( frameNum <= totalNumFrames - audioSliceLength )
+            {
+                slicePointFrameNumList.append( frameNum );
+                frameNum += audioSliceLength;
+            }
+        }
+    }
+
+    return slicePointFrameNumList;
+}
+
+
+
+void MainWindow::calculateBPM()
+{
+    const int numerator = m_ui->comboBox_TimeSigNumerator->currentText().toInt();
+
+    int numBeats = 0;
 
     if ( m_ui->comboBox_Units->currentText() == tr("Bars") )
     {
@@ -1083,35 +1574,375 @@ void MainWindow::calculateBPM()
         numBeats = m_ui->spinBox_Length->value();
     }
 
-    if ( numBeats > 0 )
-    {
-        const int numFrames = SampleUtils::getTotalNumFrames( m_sampleBufferList );
+    if ( numBeats > 0 )
+    {
+        const FrameNum numFrames = SampleUtils::getTotalNumFrames( m_sampleBufferList );
+
+        const qreal numSeconds = numFrames / m_sampleHeader->sampleRate;
+
+        applyCalculatedBPM( numBeats / ( numSeconds / 60 ) );
+    }
+    else
+    {
+        AudioAnalyser::DetectionSettings settings;
+        getDetectionSettings( settings );
+
+        m_jobScheduler->cancel( m_detectionJobId );
+
+        m_detectionJob = QSharedPointer<AudioAnalyser::DetectionJob>(
+                new AudioAnalyser::DetectionJob( m_sampleBufferList.first(), settings, AudioAnalyser::DetectionJob::CALC_BPM ) );
+
+        m_detectionJobId = m_jobScheduler->start( m_detectionJob,
+                                                  JobScheduler::PRIORITY_INTERACTIVE,
+                                                  tr("Calculating BPM") );
+    }
+}
+
+
+
+void MainWindow::applyCalculatedBPM( const qreal bpm )
+{
+    const int numerator = m_ui->comboBox_TimeSigNumerator->currentText().toInt();
+
+    m_ui->doubleSpinBox_OriginalBPM->setValue( bpm );
+    m_ui->doubleSpinBox_NewBPM->setValue( bpm );
+
+    const int index = m_ui->comboBox_SnapValues->currentIndex();
+    const int divisionsPerBeat = m_ui->comboBox_SnapValues->itemData( index ).toInt();
+
+    m_graphicsScene->setBpmRulerMarks( m_ui->doubleSpinBox_OriginalBPM->value(),
+                                       numerator,
+                                       divisionsPerBeat  );
+
+    if ( m_rubberbandAudioSource != NULL )
+    {
+        m_rubberbandAudioSource->setOriginalBPM( m_ui->doubleSpinBox_OriginalBPM->value() );
+    }
+}
+
+
+
+void MainWindow::applyBatchProcess( BatchProcessor::Settings settings )
+{
+    if ( deferEdit( [=] { applyBatchProcess( settings ); } ) )
+    {
+        return;
+    }
+
+    const QList<int> orderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
+
+    if ( orderPositions.isEmpty() || m_sampleHeader.isNull() )
+    {
+        return;
+    }
+
+    settings.sampleRate = m_sampleHeader->sampleRate;
+
+    QList<SharedSampleBuffer> sampleBufferList;
+
+    foreach ( int orderPos, orderPositions )
+    {
+        sampleBufferList << m_graphicsScene->getWaveformAt( orderPos )->getSampleBuffer();
+    }
+
+    BatchProcessCommand* const command = new BatchProcessCommand( this, settings, orderPositions, m_graphicsScene );
+
+    const QSharedPointer<BatchProcessor::ProcessJob> job( new BatchProcessor::ProcessJob( sampleBufferList, settings ) );
+
+    startEdit( command, job, command->text(), [=] { command->setProcessedSampleBuffers( job->getSampleBufferList() ); } );
+}
+
+
+
+void MainWindow::startEdit( QUndoCommand* const command,
+                            const JobScheduler::SharedJob job,
+                            const QString description,
+                            const JobScheduler::Callback applyResult )
+{
+    m_editCommand = command;
+    m_applyEditResult = applyResult;
+
+    m_editJobId = m_jobScheduler->start( job, JobScheduler::PRIORITY_INTERACTIVE, description );
+}
+
+
+
+bool MainWindow::deferEdit( const JobScheduler::Callback retry )
+{
+    if ( m_editJobId == 0 )
+    {
+        return false;
+    }
+
+    m_jobScheduler->whenFinished( m_editJobId, [=]
+    {
+        // A cancelled edit means the project has changed, so the user's next step may no longer make sense
+        if ( ! m_isLastEditCancelled )
+        {
+            retry();
+        }
+    } );
+
+    return true;
+}
+
+
+
+void MainWindow::swapSampleData( const QList<SharedSampleBuffer> sampleBufferList,
+                                 QList<SharedSampleBuffer>& heldSampleBufferList )
+{
+    Q_ASSERT( sampleBufferList.size() == heldSampleBufferList.size() );
+
+    replaceSampleBuffers( sampleBufferList, heldSampleBufferList );
+
+    if ( m_samplerAudioSource != NULL && ! m_samplerAudioSource->replaceSampleData( m_sampleBufferList ) )
+    {
+        stopPlayback();
+
+        SamplerAudioSource::EnvelopeSettings envelopes;
+
+        m_samplerAudioSource->getEnvelopeSettings( envelopes );
+        m_samplerAudioSource->setSamples( m_sampleBufferList, m_sampleHeader->sampleRate );
+        m_samplerAudioSource->setEnvelopeSettings( envelopes );
+
+        applyDrumNoteMap();
+    }
+
+    // The command takes over the previous audio rather than a copy of it
+    heldSampleBufferList = sampleBufferList;
+}
+
+
+
+void MainWindow::replaceSampleBuffers( const QList<SharedSampleBuffer> oldSampleBufferList,
+                                       const QList<SharedSampleBuffer> newSampleBufferList )
+{
+    for ( int i = 0; i < oldSampleBufferList.size(); i++ )
+    {
+        const int sampleNum = m_sampleBufferList.indexOf( oldSampleBufferList.at( i ) );
+
+        if ( sampleNum >= 0 )
+        {
+            m_sampleBufferList.replace( sampleNum, newSampleBufferList.at( i ) );
+        }
+
+        const int drumMapIndex = m_drumMappedSampleBuffers.indexOf( oldSampleBufferList.at( i ) );
+
+        if ( drumMapIndex >= 0 )
+        {
+            m_drumMappedSampleBuffers.replace( drumMapIndex, newSampleBufferList.at( i ) );
+        }
+    }
+
+    foreach ( SharedWaveformItem item, m_graphicsScene->getWaveformList() )
+    {
+        const int i = oldSampleBufferList.indexOf( item->getSampleBuffer() );
+
+        if ( i >= 0 )
+        {
+            item->setSampleBuffer( newSampleBufferList.at( i ) );
+        }
+    }
+}
+
+
+
+void MainWindow::replaceHeldSampleBuffer( SampleDataHolder* const holder,
+                                          const SharedSampleBuffer oldSampleBuffer,
+                                          const SharedSampleBuffer newSampleBuffer )
+{
+    holder->replaceHeldSampleBuffer( oldSampleBuffer, newSampleBuffer );
+
+    // Deleted slices keep their drum notes in case the deletion is undone
+    const int drumMapIndex = m_drumMappedSampleBuffers.indexOf( oldSampleBuffer );
+
+    if ( drumMapIndex >= 0 )
+    {
+        m_drumMappedSampleBuffers.replace( drumMapIndex, newSampleBuffer );
+    }
+}
+
+
+
+bool MainWindow::restoreSpilledSampleData( const QUndoCommand* const command )
+{
+    if ( m_memoryAccountant == NULL )
+    {
+        return true;
+    }
+
+    foreach ( SampleDataHolder* holder, getSampleDataHolders( command ) )
+    {
+        foreach ( SharedSampleBuffer sampleBuffer, holder->getHeldSampleBuffers() )
+        {
+            const SharedSampleBuffer restoredBuffer = m_memoryAccountant->restore( sampleBuffer );
+
+            if ( restoredBuffer.isNull() )
+            {
+                MessageBoxes::showWarningDialog( tr("Couldn't undo or redo!"),
+                                                 tr("Audio moved to the temp dir to save memory couldn't be read back in. ") +
+                                                 m_fileHandler.getLastErrorInfo() );
+                return false;
+            }
+
+            if ( restoredBuffer != sampleBuffer )
+            {
+                replaceHeldSampleBuffer( holder, sampleBuffer, restoredBuffer );
+            }
+        }
+    }
+
+    return true;
+}
+
+
+
+QList<SharedSampleBuffer> MainWindow::getInUseSampleBuffers() const
+{
+    QList<SharedSampleBuffer> sampleBufferList = m_sampleBufferList + m_copiedSampleBuffers;
+
+    if ( ! m_stretchRenderJob.isNull() )
+    {
+        sampleBufferList << m_stretchRenderJob->getSampleBufferList();
+    }
+
+    return sampleBufferList;
+}
+
+
+
+void MainWindow::spillSampleData( const QList<SharedSampleBuffer>& sampleBufferList )
+{
+    if ( sampleBufferList.isEmpty() || m_spillJobId != 0 )
+    {
+        return;
+    }
+
+    m_spillJob = m_memoryAccountant->createSpillJob( sampleBufferList, m_sampleHeader->sampleRate );
+
+    if ( ! m_spillJob.isNull() )
+    {
+        m_spillJobId = m_jobScheduler->start( m_spillJob, JobScheduler::PRIORITY_BACKGROUND, tr("Saving undo history to disk") );
+    }
+}
+
+
+
+void MainWindow::applySpill( const QSharedPointer<MemoryAccountant::SpillJob> job )
+{
+    const QHash<const SampleBuffer*, SharedSampleBuffer> placeholders = m_memoryAccountant->takePlaceholders( *job );
+
+    // An undo or redo may have put some of the buffers back in use while they were being written
+    const QList<SharedSampleBuffer> inUseSampleBuffers = getInUseSampleBuffers();
+
+    for ( int i = 0; i < m_undoStack.count(); i++ )
+    {
+        foreach ( SampleDataHolder* holder, getSampleDataHolders( m_undoStack.command( i ) ) )
+        {
+            foreach ( SharedSampleBuffer sampleBuffer, holder->getHeldSampleBuffers() )
+            {
+                if ( placeholders.contains( sampleBuffer.data() ) && ! inUseSampleBuffers.contains( sampleBuffer ) )
+                {
+                    replaceHeldSampleBuffer( holder, sampleBuffer, placeholders.value( sampleBuffer.data() ) );
+                }
+            }
+        }
+    }
+}
+
+
+
+void MainWindow::unslice()
+{
+    QUndoCommand* parentCommand = new QUndoCommand();
+    parentCommand->setText( tr("Unslice") );
+
+    RenderTimeStretchCommand* renderCommand = NULL;
+    QSharedPointer<OfflineTimeStretcher::RenderJob> renderJob;
+
+    if ( isSelectiveTimeStretchInUse() )
+    {
+        const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
+        FrameNum frameNum = 0;
+
+        for ( int i = 0; i < m_sampleBufferList.size() - 1; i++ )
+        {
+            const int midiNote = startMidiNote + i;
+            const qreal timeRatio = m_rubberbandAudioSource->getNoteTimeRatio( midiNote );
+
+            frameNum += roundToFrameNum( m_sampleBufferList.at( i )->getNumFrames() * timeRatio );
+
+            new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->comboBox_SnapValues, parentCommand );
+        }
+
+        renderCommand = createRenderCommand( getNoteTimeRatios(), renderJob, parentCommand );
+
+        if ( renderCommand == NULL )
+        {
+            delete parentCommand;
+            m_ui->pushButton_Slice->setChecked( true );
+            return;
+        }
+    }
+    else
+    {
+        FrameNum frameNum = 0;
+
+        for ( int i = 0; i < m_sampleBufferList.size() - 1; i++ )
+        {
+            frameNum += m_sampleBufferList.at( i )->getNumFrames();
+
+            new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->comboBox_SnapValues, parentCommand );
+        }
+    }
+
+    new UnsliceCommand( this,
+                        m_graphicsScene,
+                        m_ui->pushButton_Slice,
+                        m_ui->pushButton_Find,
+                        m_ui->comboBox_SnapValues,
+                        m_ui->actionAdd_Slice_Point,
+                        m_ui->actionSelect_Move,
+                        m_ui->actionAudition,
+                        m_ui->actionSelective_Time_Stretch,
+                        parentCommand );
 
-        const qreal numSeconds = numFrames / m_sampleHeader->sampleRate;
+    if ( renderCommand != NULL )
+    {
+        // Stay sliced until the render has finished and the command is pushed
+        m_ui->pushButton_Slice->setChecked( true );
 
-        bpm = numBeats / ( numSeconds / 60 );
+        startEdit( parentCommand, renderJob, tr("Rendering time stretch"),
+                   [=] { renderCommand->setStretchedSampleBuffers( renderJob->getSampleBufferList() ); } );
     }
     else
     {
-        AudioAnalyser::DetectionSettings settings;
-        getDetectionSettings( settings );
+        m_undoStack.push( parentCommand );
+    }
+}
+
 
-        bpm = AudioAnalyser::calcBPM( m_sampleBufferList.first(), settings );
+
+void MainWindow::renderSelectiveTimeStretch( const QList<qreal> timeRatioList )
+{
+    if ( deferEdit( [=] { renderSelectiveTimeStretch( timeRatioList ); } ) )
+    {
+        return;
     }
 
-    m_ui->doubleSpinBox_OriginalBPM->setValue( bpm );
-    m_ui->doubleSpinBox_NewBPM->setValue( bpm );
+    if ( timeRatioList.size() != m_sampleBufferList.size() )
+    {
+        return;
+    }
 
-    const int index = m_ui->comboBox_SnapValues->currentIndex();
-    const int divisionsPerBeat = m_ui->comboBox_SnapValues->itemData( index ).toInt();
+    QSharedPointer<OfflineTimeStretcher::RenderJob> job;
 
-    m_graphicsScene->setBpmRulerMarks( m_ui->doubleSpinBox_OriginalBPM->value(),
-                                       numerator,
-                                       divisionsPerBeat  );
+    RenderTimeStretchCommand* const command = createRenderCommand( timeRatioList, job );
 
-    if ( m_rubberbandAudioSource != NULL )
+    if ( command != NULL )
     {
-        m_rubberbandAudioSource->setOriginalBPM( m_ui->doubleSpinBox_OriginalBPM->value() );
+        startEdit( command, job, tr("Rendering time stretch"),
+                   [=] { command->setStretchedSampleBuffers( job->getSampleBufferList() ); } );
     }
 }
 
@@ -1162,6 +1993,42 @@ void MainWindow::centreWindow( QWidget* const window )
 
 
 
+QList<SharedSampleBuffer> MainWindow::getHeldSampleBuffers( const QUndoCommand* const command )
+{
+    QList<SharedSampleBuffer> sampleBufferList;
+
+    foreach ( const SampleDataHolder* holder, getSampleDataHolders( command ) )
+    {
+        sampleBufferList << holder->getHeldSampleBuffers();
+    }
+
+    return sampleBufferList;
+}
+
+
+
+QList<SampleDataHolder*> MainWindow::getSampleDataHolders( const QUndoCommand* const command )
+{
+    QList<SampleDataHolder*> holderList;
+
+    // QUndoStack only gives access to const commands, but the buffers they hold may still be swapped
+    SampleDataHolder* const holder = dynamic_cast<SampleDataHolder*>( const_cast<QUndoCommand*>( command ) );
+
+    if ( holder != NULL )
+    {
+        holderList << holder;
+    }
+
+    for ( int i = 0; i < command->childCount(); i++ )
+    {
+        holderList << getSampleDataHolders( command->child( i ) );
+    }
+
+    return holderList;
+}
+
+
+
 //==================================================================================================
 // Private Slots:
 
@@ -1175,9 +2042,9 @@ void MainWindow::recordWaveformItemMove( QList<int> oldOrderPositions, const int
 
 void MainWindow::recordSlicePointItemMove( const SharedSlicePointItem slicePoint,
                                            const int orderPos,
-                                           const int numFramesFromPrevSlicePoint,
-                                           const int numFramesToNextSlicePoint,
-                                           const int oldFrameNum )
+                                           const FrameNum numFramesFromPrevSlicePoint,
+                                           const FrameNum numFramesToNextSlicePoint,
+                                           const FrameNum oldFrameNum )
 {
     if ( m_ui->actionSelective_Time_Stretch->isChecked() )
     {
@@ -1228,15 +2095,15 @@ void MainWindow::playSample( const WaveformItem* waveformItem, const QPointF mou
     qreal startPosX = waveformItem->scenePos().x();
     qreal endPosX = startPosX + waveformItem->rect().width();
 
-    const QList<int> slicePointFrameNums = m_graphicsScene->getSlicePointFrameNums();
+    const QList<FrameNum> slicePointFrameNums = m_graphicsScene->getSlicePointFrameNums();
 
     // If slice points are present and the waveform has not yet been sliced...
     if ( slicePointFrameNums.size() > 0 && m_sampleBufferList.size() == 1 )
     {
-        const int mousePosFrameNum = m_graphicsScene->getFrameNum( mouseScenePos.x() );
-        int endFrame = sampleRange->numFrames;
+        const FrameNum mousePosFrameNum = m_graphicsScene->getFrameNum( mouseScenePos.x() );
+        FrameNum endFrame = sampleRange->numFrames;
 
-        foreach ( int frameNum, slicePointFrameNums )
+        foreach ( FrameNum frameNum, slicePointFrameNums )
         {
             if ( frameNum <= mousePosFrameNum )
             {
@@ -1279,6 +2146,39 @@ void MainWindow::playSample( const WaveformItem* waveformItem, const QPointF mou
 
 
 
+void MainWindow::scrubSlicePoint( const FrameNum frameNum )
+{
+    if ( m_samplerAudioSource == NULL )
+    {
+        return;
+    }
+
+    // Find the slice containing the frame
+    const int orderPos = m_graphicsScene->getWaveformOrderPosAt( frameNum );
+
+    if ( orderPos >= 0 && orderPos < m_sampleBufferList.size() )
+    {
+        // Scene frames are time stretched, so map back to a frame in the slice's sample data
+        const SharedWaveformItem item = m_graphicsScene->getWaveformAt( orderPos );
+        const FrameNum frameNumInSlice = static_cast<FrameNum>( ( frameNum - m_graphicsScene->getWaveformStartFrameNum( orderPos ) ) /
+                                                                item->getStretchRatio() );
+
+        m_samplerAudioSource->scrub( orderPos, frameNumInSlice );
+    }
+}
+
+
+
+void MainWindow::stopScrubbing()
+{
+    if ( m_samplerAudioSource != NULL )
+    {
+        m_samplerAudioSource->stopScrubbing();
+    }
+}
+
+
+
 void MainWindow::stopPlayback()
 {
     if ( m_samplerAudioSource != NULL )
@@ -1291,6 +2191,26 @@ void MainWindow::stopPlayback()
 
 
 
+void MainWindow::undo()
+{
+    if ( m_undoStack.canUndo() && restoreSpilledSampleData( m_undoStack.command( m_undoStack.index() - 1 ) ) )
+    {
+        m_undoStack.undo();
+    }
+}
+
+
+
+void MainWindow::redo()
+{
+    if ( m_undoStack.canRedo() && restoreSpilledSampleData( m_undoStack.command( m_undoStack.index() ) ) )
+    {
+        m_undoStack.redo();
+    }
+}
+
+
+
 void MainWindow::resetPlayStopButtonIcon()
 {
     m_ui->pushButton_PlayStop->setIcon( QIcon( ":/resources/images/media-playback-start.png" ) );
@@ -1339,12 +2259,7 @@ void MainWindow::enableRealtimeControls( const bool isEnabled )
 
         if ( isSelectiveTimeStretchInUse() )
         {
-            QUndoCommand* command = createRenderCommand();
-
-            if ( command != NULL )
-            {
-                m_undoStack.push( command );
-            }
+            renderSelectiveTimeStretch( getNoteTimeRatios() );
         }
     }
 
@@ -1399,6 +2314,7 @@ void MainWindow::enableEditActions()
         m_ui->actionApply_Gain->setEnabled( true );
         m_ui->actionApply_Gain_Ramp->setEnabled( true );
         m_ui->actionNormalise->setEnabled( true );
+        m_ui->actionRemove_DC_Offset->setEnabled( true );
         m_ui->actionReverse->setEnabled( true );
     }
     else
@@ -1407,6 +2323,7 @@ void MainWindow::enableEditActions()
         m_ui->actionApply_Gain->setEnabled( false );
         m_ui->actionApply_Gain_Ramp->setEnabled( false );
         m_ui->actionNormalise->setEnabled( false );
+        m_ui->actionRemove_DC_Offset->setEnabled( false );
         m_ui->actionReverse->setEnabled( false );
     }
 
@@ -1522,20 +2439,360 @@ void MainWindow::enableJackOutputsAction( const bool isJackAudioEnabled )
     }
     else
     {
-        m_ui->actionJack_Outputs->setEnabled( false );
+        m_ui->actionJack_Outputs->setEnabled( false );
+    }
+}
+
+
+
+void MainWindow::openRecentProject()
+{
+    QAction* action = qobject_cast<QAction*>( sender() );
+
+    if ( action != NULL )
+    {
+        openProject( action->data().toString() );
+    }
+}
+
+
+
+void MainWindow::recordJournalEntry( const int undoIndex )
+{
+    if ( m_editJournal == NULL || m_sampleBufferList.isEmpty() || m_samplerAudioSource == NULL )
+    {
+        m_lastJournalledUndoIndex = undoIndex;
+        return;
+    }
+
+    QString description;
+
+    if ( undoIndex >= m_lastJournalledUndoIndex && undoIndex > 0 )
+    {
+        description = m_undoStack.text( undoIndex - 1 );
+    }
+    else
+    {
+        description = tr("Undo ") + m_undoStack.text( undoIndex );
+    }
+
+    TextFileHandler::ProjectSettings settings;
+    getProjectSettings( settings );
+
+    m_editJournal->addEntry( description, undoIndex, m_sampleBufferList, m_sampleHeader->sampleRate, settings );
+
+    m_lastJournalledUndoIndex = undoIndex;
+}
+
+
+
+void MainWindow::jobProgress( const int jobId, const QString description, const int percent )
+{
+    if ( ! isMainWindowJob( jobId ) )
+    {
+        return;
+    }
+
+    m_ui->statusBar->showMessage( description + "... " + QString::number( percent ) + "%" );
+
+    if ( jobId == m_projectLoadJobId && m_nsmThread != NULL )
+    {
+        m_nsmThread->sendProgress( percent / 100.0f );
+    }
+}
+
+
+
+void MainWindow::jobFinished( const int jobId, const bool isCancelled )
+{
+    // Jobs that were replaced by a newer one are ignored
+    if ( jobId == m_detectionJobId )
+    {
+        const QSharedPointer<AudioAnalyser::DetectionJob> job = m_detectionJob;
+
+        m_detectionJob.clear();
+        m_detectionJobId = 0;
+
+        m_ui->statusBar->clearMessage();
+
+        if ( ! isCancelled )
+        {
+            applyDetectionResults( job );
+        }
+    }
+    else if ( jobId == m_classificationJobId )
+    {
+        const QSharedPointer<SliceClassifier::ClassificationJob> job = m_classificationJob;
+
+        m_classificationJob.clear();
+        m_classificationJobId = 0;
+
+        m_ui->statusBar->clearMessage();
+
+        if ( isCancelled )
+        {
+            m_ui->actionMap_To_GM_Drums->setChecked( false );
+        }
+        else
+        {
+            applyClassificationResults( job );
+        }
+    }
+    else if ( jobId == m_stretchRenderJobId )
+    {
+        const QSharedPointer<OfflineTimeStretcher::RenderJob> job = m_stretchRenderJob;
+
+        m_stretchRenderJob.clear();
+        m_stretchRenderJobId = 0;
+
+        m_ui->statusBar->clearMessage();
+
+        if ( ! isCancelled )
+        {
+            applyStretchRender( job );
+        }
+
+        m_stretchRenderCommand = NULL;
+    }
+    else if ( jobId == m_editJobId )
+    {
+        m_editJobId = 0;
+        m_isLastEditCancelled = isCancelled;
+
+        m_ui->statusBar->clearMessage();
+
+        if ( ! isCancelled )
+        {
+            m_applyEditResult();
+            m_undoStack.push( m_editCommand.release() );
+        }
+
+        m_editCommand = NULL;
+        m_applyEditResult = JobScheduler::Callback();
+    }
+    else if ( jobId == m_projectLoadJobId )
+    {
+        m_projectLoadJobId = 0;
+
+        projectLoadFinished( isCancelled );
+    }
+    else if ( jobId == m_importJobId )
+    {
+        const QSharedPointer<AudioFileHandler::ReadJob> job = m_importJob;
+
+        m_importJob.clear();
+        m_importJobId = 0;
+
+        m_ui->statusBar->clearMessage();
+
+        if ( ! isCancelled )
+        {
+            if ( job->getSampleBuffer().isNull() )
+            {
+                MessageBoxes::showWarningDialog( job->getErrorTitle(), job->getErrorInfo() );
+            }
+            else
+            {
+                openSampleBuffer( job->getSampleBuffer(), job->getSampleHeader(), QFileInfo( job->getFilePath() ).fileName() );
+            }
+        }
+    }
+    else if ( jobId == m_exportJobId )
+    {
+        const QSharedPointer<Exporter::ExportJob> job = m_exportJob;
+
+        m_exportJob.clear();
+        m_exportJobId = 0;
+
+        if ( isCancelled )
+        {
+            m_ui->statusBar->clearMessage();
+        }
+        else if ( job->isSuccessful() )
+        {
+            m_ui->statusBar->showMessage( tr("Export finished"), 3000 );
+        }
+        else
+        {
+            m_ui->statusBar->clearMessage();
+            MessageBoxes::showWarningDialog( job->getErrorTitle(), job->getErrorInfo() );
+        }
+    }
+    else if ( jobId == m_spillJobId )
+    {
+        const QSharedPointer<MemoryAccountant::SpillJob> job = m_spillJob;
+
+        m_spillJob.clear();
+        m_spillJobId = 0;
+
+        // A cancelled job may still have written some of its buffers
+        applySpill( job );
+
+        // Only check again if something changed while writing, so a failing temp dir isn't retried forever
+        if ( m_isMemoryCeilingCheckPending )
+        {
+            m_isMemoryCeilingCheckPending = false;
+            enforceMemoryCeiling();
+        }
+    }
+}
+
+
+
+void MainWindow::cancelStaleJobs()
+{
+    m_jobScheduler->cancel( m_detectionJobId );
+
+    // An edit in progress is based on audio that may just have changed
+    m_jobScheduler->cancel( m_editJobId );
+
+    if ( ! isStretchRenderCommandCurrent() )
+    {
+        cancelStretchRender();
+    }
+}
+
+
+
+void MainWindow::enforceMemoryCeiling()
+{
+    if ( m_memoryAccountant == NULL )
+    {
+        return;
+    }
+
+    const int ceilingMB = m_optionsDialog != NULL ? m_optionsDialog->getMemoryCeilingMB() : 0;
+    const qint64 ceilingNumBytes = static_cast<qint64>( ceilingMB ) * 1024 * 1024;
+
+    qint64 numBytesInUse = getMemoryUsage().getTotalNumBytes();
+
+    // Caches are cheapest to rebuild so they go first
+    if ( ceilingMB > 0 && numBytesInUse > ceilingNumBytes && SpectrogramRenderer::getTileCacheNumBytes() > 0 )
+    {
+        numBytesInUse -= SpectrogramRenderer::getTileCacheNumBytes();
+        SpectrogramRenderer::clearTileCache();
+    }
+
+    if ( m_sampleHeader.isNull() )
+    {
+        return;
+    }
+
+    // Buffers being written are still counted, so wait for the spill to finish before picking more
+    if ( m_spillJobId != 0 )
+    {
+        m_isMemoryCeilingCheckPending = true;
+        return;
+    }
+
+    // Buffers that are also in use elsewhere would gain nothing and must stay in memory.
+    // Placeholders for audio that has already been spilled have no frames
+    const QList<SharedSampleBuffer> inUseSampleBuffers = getInUseSampleBuffers();
+
+    QList<SharedSampleBuffer> spillSampleBufferList;
+
+    for ( int i = 0; i < m_undoStack.count(); i++ )
+    {
+        foreach ( const SampleDataHolder* holder, getSampleDataHolders( m_undoStack.command( i ) ) )
+        {
+            if ( holder->isSpilledEagerly() )
+            {
+                foreach ( SharedSampleBuffer sampleBuffer, holder->getHeldSampleBuffers() )
+                {
+                    if ( sampleBuffer->getNumFrames() > 0 &&
+                         ! inUseSampleBuffers.contains( sampleBuffer ) &&
+                         ! spillSampleBufferList.contains( sampleBuffer ) )
+                    {
+                        spillSampleBufferList << sampleBuffer;
+                        numBytesInUse -= MemoryAccountant::getNumBytes( *sampleBuffer );
+                    }
+                }
+            }
+        }
+    }
+
+    // Then, if still over the ceiling, spill other undo data, starting with the oldest as it's least
+    // likely to be needed again
+    for ( int i = 0; i < m_undoStack.count() && ceilingMB > 0 && numBytesInUse > ceilingNumBytes; i++ )
+    {
+        foreach ( SharedSampleBuffer sampleBuffer, getHeldSampleBuffers( m_undoStack.command( i ) ) )
+        {
+            if ( numBytesInUse <= ceilingNumBytes )
+            {
+                break;
+            }
+
+            if ( sampleBuffer->getNumFrames() > 0 &&
+                 ! inUseSampleBuffers.contains( sampleBuffer ) &&
+                 ! spillSampleBufferList.contains( sampleBuffer ) )
+            {
+                spillSampleBufferList << sampleBuffer;
+                numBytesInUse -= MemoryAccountant::getNumBytes( *sampleBuffer );
+            }
+        }
+    }
+
+    spillSampleData( spillSampleBufferList );
+}
+
+
+
+void MainWindow::importFromBrowser( const QString filePath )
+{
+    // Check for unsaved changes before continuing
+    if ( m_undoStack.isClean() )
+    {
+        importAudioFile( filePath );
+    }
+    else
+    {
+        const int buttonClicked = MessageBoxes::showUnsavedChangesDialog();
+
+        switch ( buttonClicked )
+        {
+        case QMessageBox::Save:
+            on_actionSave_Project_triggered();
+            importAudioFile( filePath );
+            break;
+        case QMessageBox::Discard:
+            importAudioFile( filePath );
+            break;
+        case QMessageBox::Cancel:
+            // Do nothing
+            break;
+        default:
+            // Should never be reached
+            break;
+        }
     }
 }
 
 
 
-void MainWindow::openRecentProject()
+void MainWindow::updateWaveformRenderer()
 {
-    QAction* action = qobject_cast<QAction*>( sender() );
+    bool isOpenGLEnabled = false;
 
-    if ( action != NULL )
+    switch ( m_optionsDialog->getRenderer() )
     {
-        openProject( action->data().toString() );
+    case OptionsDialog::AUTOMATIC_RENDERER:
+        isOpenGLEnabled = WaveGraphicsView::isHardwareOpenGLAvailable();
+        break;
+    case OptionsDialog::OPENGL_RENDERER:
+        isOpenGLEnabled = true;
+        break;
+    case OptionsDialog::SOFTWARE_RENDERER:
+        isOpenGLEnabled = false;
+        break;
     }
+
+    if ( isOpenGLEnabled != m_ui->waveGraphicsView->isOpenGLEnabled() )
+    {
+        m_ui->waveGraphicsView->setOpenGLEnabled( isOpenGLEnabled );
+    }
+
+    m_optionsDialog->setRendererStatus( m_ui->waveGraphicsView->isOpenGLEnabled(),
+                                        m_ui->waveGraphicsView->getAverageFrameTimeMs() );
 }
 
 
@@ -1666,6 +2923,60 @@ void MainWindow::on_actionImport_Audio_File_triggered()
 
 
 
+void MainWindow::on_actionImport_Browser_triggered( const bool isChecked )
+{
+    // Thumbnails aren't made until the browser is first shown
+    if ( isChecked && m_importBrowser->getDirectory().isEmpty() )
+    {
+        m_importBrowser->setDirectory( m_lastOpenedImportDir );
+    }
+
+    m_importBrowserDock->setVisible( isChecked );
+}
+
+
+
+void MainWindow::on_actionLoop_Library_triggered()
+{
+    m_libraryDialog->show();
+    m_libraryDialog->raise();
+    m_libraryDialog->activateWindow();
+}
+
+
+
+void MainWindow::on_actionRecord_triggered()
+{
+    // Check for unsaved changes before continuing
+    if ( m_undoStack.isClean() )
+    {
+        recordAudioDialog();
+    }
+    else
+    {
+        const int buttonClicked = MessageBoxes::showUnsavedChangesDialog();
+
+        switch ( buttonClicked )
+        {
+        case QMessageBox::Save:
+            on_actionSave_Project_triggered();
+            recordAudioDialog();
+            break;
+        case QMessageBox::Discard:
+            recordAudioDialog();
+            break;
+        case QMessageBox::Cancel:
+            // Do nothing
+            break;
+        default:
+            // Should never be reached
+            break;
+        }
+    }
+}
+
+
+
 void MainWindow::on_actionExport_As_triggered()
 {
     exportAsDialog();
@@ -1689,7 +3000,11 @@ void MainWindow::on_actionQuit_triggered()
         {
         case QMessageBox::Save:
             on_actionSave_Project_triggered();
-            QCoreApplication::quit();
+
+            if ( waitForProjectSaves() )
+            {
+                QCoreApplication::quit();
+            }
             break;
         case QMessageBox::Discard:
             QCoreApplication::quit();
@@ -1726,6 +3041,7 @@ void MainWindow::on_actionSelect_None_triggered()
 void MainWindow::on_actionCopy_triggered()
 {
     copySelectedSamplesToClipboard();
+    enforceMemoryCeiling();
 
     m_ui->actionPaste->setEnabled( true );
 }
@@ -1734,7 +3050,12 @@ void MainWindow::on_actionCopy_triggered()
 
 void MainWindow::on_actionPaste_triggered()
 {
-    if ( m_copiedSampleBuffers.size() > 0 )
+    if ( m_sampleBufferList.size() + m_copiedSampleBuffers.size() > Midi::NUM_KEYS )
+    {
+        MessageBoxes::showWarningDialog( tr("Too many slices!"),
+                                         tr("Each slice needs a MIDI key of its own, so there can be no more than %1").arg( Midi::NUM_KEYS ) );
+    }
+    else if ( m_copiedSampleBuffers.size() > 0 )
     {
         QList<int> selectedOrderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
 
@@ -1799,7 +3120,7 @@ void MainWindow::on_actionAdd_Slice_Point_triggered()
 {
     const QPoint mousePos = m_ui->waveGraphicsView->mapFromGlobal( QCursor::pos() );
     const QPointF mouseScenePos = m_ui->waveGraphicsView->mapToScene( mousePos );
-    const int frameNum = m_graphicsScene->getFrameNum( mouseScenePos.x() );
+    const FrameNum frameNum = m_graphicsScene->getFrameNum( mouseScenePos.x() );
 
     QUndoCommand* command = new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->pushButton_Slice, m_ui->comboBox_SnapValues );
     m_undoStack.push( command );
@@ -1809,45 +3130,18 @@ void MainWindow::on_actionAdd_Slice_Point_triggered()
 
 void MainWindow::on_actionApply_Gain_triggered()
 {
-    const QString tempDirPath = m_optionsDialog->getTempDirPath();
-
-    if ( ! tempDirPath.isEmpty() )
-    {
-        ApplyGainDialog dialog;
-
-        const int result = dialog.exec();
-
-        if ( result == QDialog::Accepted )
-        {
-            const QList<int> orderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
-
-            QUndoCommand* parentCommand = new QUndoCommand();
-            parentCommand->setText( tr("Apply Gain") );
-
-            const QString stackIndex = QString::number( m_undoStack.index() );
-            int i = 0;
-
-            foreach ( int orderPos, orderPositions )
-            {
-                QString fileBaseName = stackIndex + "_" + QString::number( i++ );
+    ApplyGainDialog dialog;
 
-                new ApplyGainCommand( dialog.getGainValue(),
-                                      orderPos,
-                                      m_graphicsScene,
-                                      m_sampleHeader->sampleRate,
-                                      m_fileHandler,
-                                      tempDirPath,
-                                      fileBaseName,
-                                      parentCommand );
-            }
+    const int result = dialog.exec();
 
-            m_undoStack.push( parentCommand );
-        }
-    }
-    else
+    if ( result == QDialog::Accepted )
     {
-        MessageBoxes::showWarningDialog( tr( "Temp dir invalid!" ),
-                                         tr( "This operation needs to save temporary files, please change \"Temp Dir\" in options" ) );
+        BatchProcessor::Settings settings;
+        settings.operation = BatchProcessor::APPLY_GAIN;
+        settings.startGain = dialog.getGainValue();
+        settings.endGain = dialog.getGainValue();
+
+        applyBatchProcess( settings );
     }
 }
 
@@ -1855,46 +3149,18 @@ void MainWindow::on_actionApply_Gain_triggered()
 
 void MainWindow::on_actionApply_Gain_Ramp_triggered()
 {
-    const QString tempDirPath = m_optionsDialog->getTempDirPath();
+    ApplyGainRampDialog dialog;
 
-    if ( ! tempDirPath.isEmpty() )
-    {
-        ApplyGainRampDialog dialog;
-
-        const int result = dialog.exec();
-
-        if ( result == QDialog::Accepted )
-        {
-            const QList<int> orderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
-
-            QUndoCommand* parentCommand = new QUndoCommand();
-            parentCommand->setText( tr("Apply Gain Ramp") );
+    const int result = dialog.exec();
 
-            const QString stackIndex = QString::number( m_undoStack.index() );
-            int i = 0;
-
-            foreach ( int orderPos, orderPositions )
-            {
-                QString fileBaseName = stackIndex + "_" + QString::number( i++ );
-
-                new ApplyGainRampCommand( dialog.getStartGainValue(),
-                                          dialog.getEndGainValue(),
-                                          orderPos,
-                                          m_graphicsScene,
-                                          m_sampleHeader->sampleRate,
-                                          m_fileHandler,
-                                          tempDirPath,
-                                          fileBaseName,
-                                          parentCommand );
-            }
-
-            m_undoStack.push( parentCommand );
-        }
-    }
-    else
+    if ( result == QDialog::Accepted )
     {
-        MessageBoxes::showWarningDialog( tr( "Temp dir invalid!" ),
-                                         tr( "This operation needs to save temporary files, please change \"Temp Dir\" in options" ) );
+        BatchProcessor::Settings settings;
+        settings.operation = BatchProcessor::APPLY_GAIN_RAMP;
+        settings.startGain = dialog.getStartGainValue();
+        settings.endGain = dialog.getEndGainValue();
+
+        applyBatchProcess( settings );
     }
 }
 
@@ -1902,55 +3168,36 @@ void MainWindow::on_actionApply_Gain_Ramp_triggered()
 
 void MainWindow::on_actionNormalise_triggered()
 {
-    const QString tempDirPath = m_optionsDialog->getTempDirPath();
-
-    if ( ! tempDirPath.isEmpty() )
-    {
-        const QList<int> orderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
+    BatchProcessor::Settings settings;
+    settings.operation = BatchProcessor::NORMALISE;
+    settings.startGain = 1.0f;
+    settings.endGain = 1.0f;
 
-        QUndoCommand* parentCommand = new QUndoCommand();
-        parentCommand->setText( tr("Normalise") );
+    applyBatchProcess( settings );
+}
 
-        const QString stackIndex = QString::number( m_undoStack.index() );
-        int i = 0;
 
-        foreach ( int orderPos, orderPositions )
-        {
-            QString fileBaseName = stackIndex + "_" + QString::number( i++ );
 
-            new NormaliseCommand( orderPos,
-                                  m_graphicsScene,
-                                  m_sampleHeader->sampleRate,
-                                  m_fileHandler,
-                                  tempDirPath,
-                                  fileBaseName,
-                                  parentCommand );
-        }
+void MainWindow::on_actionRemove_DC_Offset_triggered()
+{
+    BatchProcessor::Settings settings;
+    settings.operation = BatchProcessor::REMOVE_DC_OFFSET;
+    settings.startGain = 1.0f;
+    settings.endGain = 1.0f;
 
-        m_undoStack.push( parentCommand );
-    }
-    else
-    {
-        MessageBoxes::showWarningDialog( tr( "Temp dir invalid!" ),
-                                         tr( "This operation needs to save temporary files, please change \"Temp Dir\" in options" ) );
-    }
+    applyBatchProcess( settings );
 }
 
 
 
 void MainWindow::on_actionReverse_triggered()
 {
-    const QList<int> orderPositions = m_graphicsScene->getSelectedWaveformsOrderPositions();
-
-    QUndoCommand* parentCommand = new QUndoCommand();
-    parentCommand->setText( tr("Reverse") );
-
-    foreach ( int orderPos, orderPositions )
-    {
-        new ReverseCommand( orderPos, m_graphicsScene, parentCommand );
-    }
+    BatchProcessor::Settings settings;
+    settings.operation = BatchProcessor::REVERSE;
+    settings.startGain = 1.0f;
+    settings.endGain = 1.0f;
 
-    m_undoStack.push( parentCommand );
+    applyBatchProcess( settings );
 }
 
 
@@ -1968,6 +3215,8 @@ void MainWindow::on_actionOptions_triggered()
 
     m_optionsDialog->move( pos );
     m_optionsDialog->setCurrentTab( OptionsDialog::AUDIO_SETUP_TAB );
+    m_optionsDialog->setRendererStatus( m_ui->waveGraphicsView->isOpenGLEnabled(),
+                                        m_ui->waveGraphicsView->getAverageFrameTimeMs() );
     m_optionsDialog->show();
 }
 
@@ -2030,6 +3279,14 @@ void MainWindow::on_pushButton_Slice_clicked( const bool isChecked )
         {
             m_ui->pushButton_Slice->setChecked( false );
         }
+        else if ( m_graphicsScene->getSlicePointFrameNums().size() + 1 > Midi::NUM_KEYS )
+        {
+            m_ui->pushButton_Slice->setChecked( false );
+
+            MessageBoxes::showWarningDialog( tr("Too many slices!"),
+                                             tr("Each slice needs a MIDI key of its own, so there can be no more than %1. "
+                                                "Please remove some slice points").arg( Midi::NUM_KEYS ) );
+        }
         else
         {
             QUndoCommand* parentCommand = new QUndoCommand();
@@ -2058,50 +3315,15 @@ void MainWindow::on_pushButton_Slice_clicked( const bool isChecked )
     }
     else // Unslice
     {
-        QUndoCommand* parentCommand = new QUndoCommand();
-        parentCommand->setText( tr("Unslice") );
-
-        if ( isSelectiveTimeStretchInUse() )
+        if ( deferEdit( [=] { unslice(); } ) )
         {
-            const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
-            int frameNum = 0;
-
-            for ( int i = 0; i < m_sampleBufferList.size() - 1; i++ )
-            {
-                const int midiNote = startMidiNote + i;
-                const qreal timeRatio = m_rubberbandAudioSource->getNoteTimeRatio( midiNote );
-
-                frameNum += roundToIntAccurate( m_sampleBufferList.at( i )->getNumFrames() * timeRatio );
-
-                new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->comboBox_SnapValues, parentCommand );
-            }
-
-            createRenderCommand( parentCommand );
+            // Stay sliced until the edit in progress has been pushed
+            m_ui->pushButton_Slice->setChecked( true );
         }
         else
         {
-            int frameNum = 0;
-
-            for ( int i = 0; i < m_sampleBufferList.size() - 1; i++ )
-            {
-                frameNum += m_sampleBufferList.at( i )->getNumFrames();
-
-                new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->comboBox_SnapValues, parentCommand );
-            }
+            unslice();
         }
-
-        new UnsliceCommand( this,
-                            m_graphicsScene,
-                            m_ui->pushButton_Slice,
-                            m_ui->pushButton_Find,
-                            m_ui->comboBox_SnapValues,
-                            m_ui->actionAdd_Slice_Point,
-                            m_ui->actionSelect_Move,
-                            m_ui->actionAudition,
-                            m_ui->actionSelective_Time_Stretch,
-                            parentCommand );
-
-        m_undoStack.push( parentCommand );
     }
 }
 
@@ -2116,98 +3338,35 @@ void MainWindow::on_horizontalSlider_Threshold_valueChanged( const int value )
 
 void MainWindow::on_pushButton_Find_clicked()
 {
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
-    // Get detection settings
-    AudioAnalyser::DetectionSettings settings;
-    getDetectionSettings( settings );
-
-    // Find slice points
-    QList<int> slicePointFrameNumList;
-
-    if ( m_ui->comboBox_Find->currentText() == tr( "Onsets" ) )
-    {
-        slicePointFrameNumList = AudioAnalyser::findOnsetFrameNums( m_sampleBufferList.first(), settings );
-    }
-    else // Find Beats
-    {
-        if ( m_ui->comboBox_DetectMethod->currentText() == tr( "Snap Values" ) )
-        {
-            slicePointFrameNumList = getSnapFrameNums();
-        }
-        else
-        {
-            slicePointFrameNumList = AudioAnalyser::findBeatFrameNums( m_sampleBufferList.first(), settings );
-        }
-    }
-
-    // Adjust slice points according to zero-crossing settings
-    if ( m_ui->comboBox_ZeroCrossings->currentText() == tr( "Closest" ) )
-    {
-        for ( int i = 0; i < slicePointFrameNumList.size(); i++ )
-        {
-            int frameNum = slicePointFrameNumList.at( i );
-
-            frameNum = SampleUtils::getClosestZeroCrossing( m_sampleBufferList.first(), frameNum );
-
-            slicePointFrameNumList.replace( i, frameNum );
-        }
-    }
-    else if ( m_ui->comboBox_ZeroCrossings->currentText() == tr( "Next" ) )
-    {
-        for ( int i = 0; i < slicePointFrameNumList.size(); i++ )
-        {
-            int frameNum = slicePointFrameNumList.at( i );
-
-            frameNum = SampleUtils::getNextZeroCrossing( m_sampleBufferList.first(), frameNum );
+    const bool isFindOnsets = m_ui->comboBox_Find->currentText() == tr( "Onsets" );
 
-            slicePointFrameNumList.replace( i, frameNum );
-        }
-    }
-    else if ( m_ui->comboBox_ZeroCrossings->currentText() == tr( "Previous" ) )
+    // Snap values are calculated straight away, onsets and beats are detected in the background
+    if ( ! isFindOnsets && m_ui->comboBox_DetectMethod->currentText() == tr( "Snap Values" ) )
     {
-        for ( int i = 0; i < slicePointFrameNumList.size(); i++ )
-        {
-            int frameNum = slicePointFrameNumList.at( i );
+        QList<FrameNum> slicePointFrameNumList = getSnapFrameNums();
 
-            frameNum = SampleUtils::getPrevZeroCrossing( m_sampleBufferList.first(), frameNum );
+        // Adjust slice points according to zero-crossing settings
+        snapToZeroCrossings( slicePointFrameNumList );
 
-            slicePointFrameNumList.replace( i, frameNum );
-        }
+        replaceSlicePoints( slicePointFrameNumList, tr("Find Beats") );
     }
-
-    if ( slicePointFrameNumList.count() > 0 )
+    else
     {
-        QUndoCommand* parentCommand = new QUndoCommand();
-
-        // Set command text
-        if ( m_ui->comboBox_Find->currentText() == tr( "Onsets" ) )
-        {
-            parentCommand->setText( tr("Find Onsets") );
-        }
-        else
-        {
-            parentCommand->setText( tr("Find Beats") );
-        }
-
-        // Remove current slice point items if present
-        const QList<SharedSlicePointItem> slicePointItemList = m_graphicsScene->getSlicePointList();
+        // Get detection settings
+        AudioAnalyser::DetectionSettings settings;
+        getDetectionSettings( settings );
 
-        foreach ( SharedSlicePointItem item, slicePointItemList )
-        {
-            new DeleteSlicePointItemCommand( item, m_graphicsScene, m_ui->pushButton_Slice, m_ui->comboBox_SnapValues, parentCommand );
-        }
+        const AudioAnalyser::DetectionJob::Type type = isFindOnsets ? AudioAnalyser::DetectionJob::FIND_ONSETS :
+                                                                      AudioAnalyser::DetectionJob::FIND_BEATS;
+        m_jobScheduler->cancel( m_detectionJobId );
 
-        // Add new slice point items
-        foreach ( int frameNum, slicePointFrameNumList )
-        {
-            new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->pushButton_Slice, m_ui->comboBox_SnapValues, parentCommand );
-        }
+        m_detectionJob = QSharedPointer<AudioAnalyser::DetectionJob>(
+                new AudioAnalyser::DetectionJob( m_sampleBufferList.first(), settings, type ) );
 
-        m_undoStack.push( parentCommand );
+        m_detectionJobId = m_jobScheduler->start( m_detectionJob,
+                                                  JobScheduler::PRIORITY_INTERACTIVE,
+                                                  isFindOnsets ? tr("Finding onsets") : tr("Finding beats") );
     }
-
-    QApplication::restoreOverrideCursor();
 }
 
 
@@ -2390,28 +3549,105 @@ void MainWindow::on_actionZoom_Original_triggered()
 
 
 
-void MainWindow::on_pushButton_Apply_clicked()
+void MainWindow::on_actionSpectrogram_triggered( const bool isChecked )
+{
+    m_graphicsScene->setSpectrogramEnabled( isChecked );
+}
+
+
+
+void MainWindow::on_actionMemory_Usage_triggered()
 {
-    const QString tempDirPath = m_optionsDialog->getTempDirPath();
+    const MemoryAccountant::Usage usage = getMemoryUsage();
+    const qreal bytesPerMB = 1024.0 * 1024.0;
 
-    if ( ! tempDirPath.isEmpty() )
+    QString text;
+
+    for ( int i = 0; i < MemoryAccountant::NUM_CATEGORIES; i++ )
     {
-        const QString fileBaseName = QString::number( m_undoStack.index() );
+        const MemoryAccountant::Category category = static_cast<MemoryAccountant::Category>( i );
 
-        QUndoCommand* command = new GlobalTimeStretchCommand( this,
-                                                              m_graphicsScene,
-                                                              m_ui->doubleSpinBox_OriginalBPM,
-                                                              m_ui->doubleSpinBox_NewBPM,
-                                                              m_ui->checkBox_PitchCorrection,
-                                                              tempDirPath,
-                                                              fileBaseName );
-        m_undoStack.push( command );
+        text += tr( "%1: %2 MB\n" ).arg( MemoryAccountant::getCategoryName( category ) )
+                                   .arg( usage.getNumBytes( category ) / bytesPerMB, 0, 'f', 1 );
     }
-    else
+
+    text += tr( "\nTotal: %1 MB\n" ).arg( usage.getTotalNumBytes() / bytesPerMB, 0, 'f', 1 );
+    text += tr( "Undo data spilled to disk: %1 MB\n" ).arg( usage.numSpilledBytes / bytesPerMB, 0, 'f', 1 );
+    text += tr( "Temp files: %1 MB" ).arg( usage.numTempFileBytes / bytesPerMB, 0, 'f', 1 );
+
+    QMessageBox::information( this, tr( "Memory Usage" ), text );
+}
+
+
+
+void MainWindow::on_actionMap_To_GM_Drums_triggered( const bool isChecked )
+{
+    m_jobScheduler->cancel( m_classificationJobId );
+
+    m_drumMappedSampleBuffers.clear();
+    m_drumNoteNums.clear();
+
+    if ( isChecked )
+    {
+        m_classificationJob = QSharedPointer<SliceClassifier::ClassificationJob>(
+                new SliceClassifier::ClassificationJob( m_sampleBufferList, (int) m_sampleHeader->sampleRate ) );
+
+        m_classificationJobId = m_jobScheduler->start( m_classificationJob,
+                                                       JobScheduler::PRIORITY_INTERACTIVE,
+                                                       tr("Classifying slices") );
+    }
+
+    applyDrumNoteMap();
+}
+
+
+
+void MainWindow::on_pushButton_Apply_clicked()
+{
+    if ( deferEdit( [=] { on_pushButton_Apply_clicked(); } ) )
+    {
+        return;
+    }
+
+    const qreal originalBPM = m_ui->doubleSpinBox_OriginalBPM->value();
+    const qreal newBPM = m_ui->doubleSpinBox_NewBPM->value();
+
+    const qreal timeRatio = originalBPM / newBPM;
+    const qreal pitchScale = m_ui->checkBox_PitchCorrection->isChecked() ? 1.0 : newBPM / originalBPM;
+
+    QList<qreal> timeRatioList;
+
+    for ( int i = 0; i < m_sampleBufferList.size(); i++ )
+    {
+        timeRatioList << timeRatio;
+    }
+
+    QString errorInfo;
+
+    if ( ! OfflineTimeStretcher::canStretch( m_sampleBufferList, timeRatioList, errorInfo ) )
     {
-        MessageBoxes::showWarningDialog( tr("Temp dir invalid!"),
-                                         tr("This operation needs to save temporary files, please change \"Temp Dir\" in options") );
+        MessageBoxes::showWarningDialog( tr("Couldn't time stretch!"), errorInfo );
+        return;
     }
+
+    GlobalTimeStretchCommand* const command = new GlobalTimeStretchCommand( this,
+                                                                            m_graphicsScene,
+                                                                            m_ui->doubleSpinBox_OriginalBPM,
+                                                                            m_ui->doubleSpinBox_NewBPM,
+                                                                            m_ui->checkBox_PitchCorrection );
+
+    // A quick preview is made first; the command then starts a full quality render to replace it
+    const QSharedPointer<OfflineTimeStretcher::RenderJob> job(
+            new OfflineTimeStretcher::RenderJob( m_sampleBufferList,
+                                                 m_sampleHeader->sampleRate,
+                                                 m_sampleHeader->numChans,
+                                                 m_optionsDialog->getStretcherOptions(),
+                                                 timeRatioList,
+                                                 pitchScale,
+                                                 OfflineTimeStretcher::RenderJob::QUALITY_PREVIEW ) );
+
+    startEdit( command, job, tr("Time stretching"),
+               [=] { command->setStretchedSampleBuffers( job->getSampleBufferList() ); } );
 }
 
 
@@ -2460,13 +3696,13 @@ void MainWindow::on_actionSelective_Time_Stretch_triggered( const bool isChecked
 
         const int lowestAssignedMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
 
-        int frameNum = 0;
+        FrameNum frameNum = 0;
 
         for ( int i = 0; i < m_sampleBufferList.size() - 1; i++ )
         {
             const qreal timeRatio = m_rubberbandAudioSource->getNoteTimeRatio( lowestAssignedMidiNote + i );
 
-            const int numFrames = roundToIntAccurate( m_sampleBufferList.at( i )->getNumFrames() * timeRatio );
+            const FrameNum numFrames = roundToFrameNum( m_sampleBufferList.at( i )->getNumFrames() * timeRatio );
 
             frameNum += numFrames;
 
@@ -2517,6 +3753,8 @@ void MainWindow::on_pushButton_TimestretchOptions_clicked()
 
     m_optionsDialog->move( pos );
     m_optionsDialog->setCurrentTab( OptionsDialog::TIME_STRETCH_TAB );
+    m_optionsDialog->setRendererStatus( m_ui->waveGraphicsView->isOpenGLEnabled(),
+                                        m_ui->waveGraphicsView->getAverageFrameTimeMs() );
     m_optionsDialog->show();
 }
 
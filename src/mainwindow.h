@@ -27,6 +27,7 @@
 #include <QList>
 #include <QUndoStack>
 #include <QActionGroup>
+#include <QDockWidget>
 #include "JuceHeader.h"
 #include "samplebuffer.h"
 #include "optionsdialog.h"
@@ -41,6 +42,18 @@
 #include "exportdialog.h"
 #include "nsmlistenerthread.h"
 #include "jackoutputsdialog.h"
+#include "batchprocessor.h"
+#include "projectsaver.h"
+#include "projectloader.h"
+#include "editjournal.h"
+#include "textfilehandler.h"
+#include "sliceclassifier.h"
+#include "jobscheduler.h"
+#include "offlinetimestretcher.h"
+#include "memoryaccountant.h"
+#include "importbrowser.h"
+#include "librarydialog.h"
+#include "exporter.h"
 
 
 namespace Ui
@@ -48,6 +61,9 @@ namespace Ui
     class MainWindow;
 }
 
+class RenderTimeStretchCommand;
+class SampleDataHolder;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -59,6 +75,7 @@ class MainWindow : public QMainWindow
     friend class MoveWaveformItemCommand;
     friend class SliceCommand;
     friend class UnsliceCommand;
+    friend class BatchProcessCommand;
     friend class GlobalTimeStretchCommand;
     friend class RenderTimeStretchCommand;
     friend class SelectiveTimeStretchCommand;
@@ -67,6 +84,9 @@ public:
     MainWindow( QWidget* parent = NULL );
     ~MainWindow();
 
+    // Tally the memory held by samples, the clipboard, undo history, the time stretcher and caches
+    MemoryAccountant::Usage getMemoryUsage() const;
+
 protected:
     void changeEvent( QEvent* event );
     void closeEvent( QCloseEvent* event );
@@ -86,38 +106,137 @@ private:
 
     void getDetectionSettings( AudioAnalyser::DetectionSettings& settings );
 
+    // Move each frame number to a zero crossing according to the "Zero Crossings" setting
+    void snapToZeroCrossings( QList<FrameNum>& frameNums );
+
+    // Push an undoable command replacing all current slice points with new ones
+    void replaceSlicePoints( QList<FrameNum> slicePointFrameNumList, QString commandText );
+
     void closeProject();
 
+    // Snapshots the project and writes it in the background, see projectSaveFinished()
     void saveProject( QString filePath, bool isNsmSessionExport = false );
+
+    // Blocks until the last save requested is on disk, shows a warning and returns false if it failed
+    bool waitForProjectSaves();
+
+    // Decompress and decode a project in the background, see projectLoadFinished()
     void openProject( QString filePath );
+
+    // Read a project with a ProjectLoader job; "isRecovery" is passed on to projectLoadFinished()
+    void startProjectLoad( QSharedPointer<ProjectLoader> loader, bool isRecovery );
+    void projectLoadFinished( bool isCancelled );
+
+    // Create waveforms and restore settings from a project that has been read from disk
+    void applyProject( const ProjectLoader::Project& project );
+
+    void getProjectSettings( TextFileHandler::ProjectSettings& settings );
+
+    // If a previous session didn't exit cleanly, offer to restore it from its edit journal
+    void offerSessionRecovery();
+
+    // Read an audio file in the background, then open it with openSampleBuffer()
     void importAudioFile( QString filePath );
-    void exportAs( QString tempDirPath,
-                   QString outputDirPath,
-                   QString samplesDirPath,
-                   QString fileName,
-                   int exportType,
-                   int sndFileFormat,
-                   int outputSampleRate,
-                   int numSamplesToExport );
+
+    // Replace the current project with a single waveform holding the given sample
+    void openSampleBuffer( SharedSampleBuffer sampleBuffer, SharedSampleHeader sampleHeader, QString name );
+
+    // Export copies of the samples in the background once any time stretch render has finished
+    void startExport( Exporter::Settings settings );
 
     void saveProjectDialog();
     void openProjectDialog();
     void importAudioFileDialog();
+    void recordAudioDialog();
     void exportAsDialog();
 
     void addPathToRecentProjects( QString filePath );
 
+    // The time ratio of each sample in the realtime time stretcher, or an empty list if there isn't one
+    QList<qreal> getNoteTimeRatios() const;
     bool isSelectiveTimeStretchInUse() const;
-    QUndoCommand* createRenderCommand( QUndoCommand* parent = NULL );
+
+    // Returns NULL if the samples can't be stretched. Otherwise "job" is set to render the stretched audio
+    // the command needs: a preview if the command has no parent and is rendered in the background
+    RenderTimeStretchCommand* createRenderCommand( QList<qreal> timeRatioList,
+                                                   QSharedPointer<OfflineTimeStretcher::RenderJob>& job,
+                                                   QUndoCommand* parent = NULL );
 
     // Pass sample buffers to the sampler audio source, preserving current envelope settings
     void resetSamples();
 
     void copySelectedSamplesToClipboard();
 
-    QList<int> getSnapFrameNums() const;
+    QList<FrameNum> getSnapFrameNums() const;
 
     void calculateBPM();
+    void applyCalculatedBPM( qreal bpm );
+
+    // Apply an operation to all selected waveforms as a single undoable command
+    void applyBatchProcess( BatchProcessor::Settings settings );
+
+    // Join the slices back together, rendering any selective time stretch first
+    void unslice();
+
+    // Bake the realtime time stretch ratios into the audio when switching to offline mode
+    void renderSelectiveTimeStretch( QList<qreal> timeRatioList );
+
+    // Run "job" in the background and then call "applyResult" and push "command", unless the job was
+    // cancelled by closing the project or by a change to the undo stack in the meantime
+    void startEdit( QUndoCommand* command, JobScheduler::SharedJob job, QString description,
+                    JobScheduler::Callback applyResult );
+
+    // If an edit is still being processed, "retry" is called once it has been pushed and true is
+    // returned; edits are based on the current audio so they mustn't overlap
+    bool deferEdit( JobScheduler::Callback retry );
+
+    // Called by undo commands to put the buffers in "heldSampleBufferList" in place of those in
+    // "sampleBufferList", which are then held instead. Nothing is copied; sample data is never
+    // changed once it's part of the project, so it can be shared with other threads as it is
+    void swapSampleData( QList<SharedSampleBuffer> sampleBufferList, QList<SharedSampleBuffer>& heldSampleBufferList );
+
+    // Put each new buffer in place of the old one in the sample list, the waveforms and the drum map.
+    // The sampler audio source is left for the caller to update
+    void replaceSampleBuffers( QList<SharedSampleBuffer> oldSampleBufferList, QList<SharedSampleBuffer> newSampleBufferList );
+
+    // Swap a buffer held by an undo command, keeping the drum map in step
+    void replaceHeldSampleBuffer( SampleDataHolder* holder, SharedSampleBuffer oldSampleBuffer, SharedSampleBuffer newSampleBuffer );
+
+    // Read back any sample data that "command" or its children hold in the temp dir, before the command is
+    // undone or redone. Shows a warning and returns false if it couldn't be read
+    bool restoreSpilledSampleData( const QUndoCommand* command );
+
+    // Sample buffers that spilling would gain nothing from, as something other than the undo history holds them
+    QList<SharedSampleBuffer> getInUseSampleBuffers() const;
+
+    // Write the given undo data to the temp dir in the background; applySpill() then frees it
+    void spillSampleData( const QList<SharedSampleBuffer>& sampleBufferList );
+
+    // Swap spilled buffers for placeholders in the undo commands that still hold them, so their memory
+    // is freed
+    void applySpill( QSharedPointer<MemoryAccountant::SpillJob> job );
+
+    // Pass the GM drum notes of any classified slices to the sampler audio source
+    void applyDrumNoteMap();
+
+    // Called on the GUI thread once a background job has finished
+    void applyDetectionResults( QSharedPointer<AudioAnalyser::DetectionJob> job );
+    void applyClassificationResults( QSharedPointer<SliceClassifier::ClassificationJob> job );
+    void applyStretchRender( QSharedPointer<OfflineTimeStretcher::RenderJob> job );
+
+    // Called by a time stretch command once it has put a quick preview in place. A full quality render
+    // of "sampleBufferList" replaces the preview once it's done, provided "command" is still the last
+    // one on the undo stack
+    void startStretchRender( const QUndoCommand* command,
+                             QList<SharedSampleBuffer> sampleBufferList,
+                             QList<qreal> timeRatioList,
+                             qreal pitchScale,
+                             RubberBandStretcher::Options options );
+    void cancelStretchRender();
+    bool isStretchRenderCommandCurrent() const;
+
+    // Jobs started by the import browser and loop library share the scheduler but aren't ours to report
+    bool isMainWindowJob( int jobId ) const;
 
 
     Ui::MainWindow* m_ui; // "Go to slot..." in Qt Designer won't work if this is changed to ScopedPointer<Ui::MainWindow>
@@ -130,6 +249,7 @@ private:
     OptionsDialog* m_optionsDialog;
     ScopedPointer<HelpForm> m_helpForm;
     ExportDialog* m_exportDialog;
+    LibraryDialog* m_libraryDialog;
 
     AudioDeviceManager m_deviceManager;
     AudioFileHandler m_fileHandler;
@@ -137,6 +257,11 @@ private:
     SharedSampleHeader m_sampleHeader;
     QList<SharedSampleBuffer> m_sampleBufferList;
 
+    // GM drum notes assigned by "Map Slices to GM Drum Notes". Notes are tied to sample buffers
+    // rather than order positions so that they follow slices as they are moved
+    QList<SharedSampleBuffer> m_drumMappedSampleBuffers;
+    QList<int> m_drumNoteNums;
+
     ScopedPointer<SamplerAudioSource> m_samplerAudioSource;
     ScopedPointer<RubberbandAudioSource> m_rubberbandAudioSource;
     AudioSourcePlayer m_audioSourcePlayer;
@@ -153,11 +278,55 @@ private:
 
     ScopedPointer<NsmListenerThread> m_nsmThread;
 
+    ScopedPointer<ProjectSaver> m_projectSaver;
+    int m_pendingSaveId;
+    QString m_pendingSaveFilePath;
+    bool m_isPendingSaveNsmExport;
+    int m_pendingSaveUndoIndex;
+
+    QSharedPointer<ProjectLoader> m_projectLoader;
+    int m_projectLoadJobId;
+    bool m_isProjectLoadRecovery;
+
+    ScopedPointer<EditJournal> m_editJournal;
+    int m_lastJournalledUndoIndex;
+
+    // Long-running analyses and renders; results are applied in jobFinished() if the audio hasn't changed meanwhile
+    ScopedPointer<JobScheduler> m_jobScheduler;
+    QSharedPointer<AudioAnalyser::DetectionJob> m_detectionJob;
+    int m_detectionJobId;
+    QSharedPointer<SliceClassifier::ClassificationJob> m_classificationJob;
+    int m_classificationJobId;
+    QSharedPointer<OfflineTimeStretcher::RenderJob> m_stretchRenderJob;
+    int m_stretchRenderJobId;
+    const QUndoCommand* m_stretchRenderCommand;
+    QSharedPointer<AudioFileHandler::ReadJob> m_importJob;
+    int m_importJobId;
+    QSharedPointer<Exporter::ExportJob> m_exportJob;
+    int m_exportJobId;
+
+    // Undo data being written to the temp dir, see spillSampleData()
+    QSharedPointer<MemoryAccountant::SpillJob> m_spillJob;
+    int m_spillJobId;
+    bool m_isMemoryCeilingCheckPending;
+
+    // An edit whose audio is being processed, see startEdit()
+    int m_editJobId;
+    ScopedPointer<QUndoCommand> m_editCommand;
+    JobScheduler::Callback m_applyEditResult;
+    bool m_isLastEditCancelled;
+
     // Internal "clipboard"
     QList<SharedSampleBuffer> m_copiedSampleBuffers;
     SamplerAudioSource::EnvelopeSettings m_copiedEnvelopes;
     QList<qreal> m_copiedNoteTimeRatios;
 
+    ScopedPointer<MemoryAccountant> m_memoryAccountant;
+
+    // Declared after m_deviceManager so that the browser's preview player is deleted first
+    ScopedPointer<QDockWidget> m_importBrowserDock;
+    ImportBrowser* m_importBrowser;
+
 private:
     // Make sure window isn't larger than desktop
     static void setMaxWindowSize( QWidget* window );
@@ -165,6 +334,10 @@ private:
     // Centre window in desktop
     static void centreWindow( QWidget* window );
 
+    // Sample buffers held by an undo command and its children for undoing or redoing
+    static QList<SharedSampleBuffer> getHeldSampleBuffers( const QUndoCommand* command );
+    static QList<SampleDataHolder*> getSampleDataHolders( const QUndoCommand* command );
+
 private slots:
     // Automatically connected...
     void on_actionPaste_triggered();
@@ -186,6 +359,9 @@ private slots:
     void on_actionSelect_Move_triggered();
     void on_pushButton_Apply_clicked();
     void on_actionZoom_Original_triggered();
+    void on_actionSpectrogram_triggered( bool isChecked );
+    void on_actionMemory_Usage_triggered();
+    void on_actionMap_To_GM_Drums_triggered( bool isChecked );
     void on_actionZoom_Out_triggered();
     void on_actionZoom_In_triggered();
     void on_pushButton_Loop_clicked( bool isChecked );
@@ -199,6 +375,7 @@ private slots:
     void on_pushButton_Find_clicked();
     void on_horizontalSlider_Threshold_valueChanged( int value );
     void on_pushButton_Slice_clicked( bool isChecked );
+    void on_actionRemove_DC_Offset_triggered();
     void on_actionNormalise_triggered();
     void on_actionApply_Gain_Ramp_triggered();
     void on_actionApply_Gain_triggered();
@@ -213,6 +390,9 @@ private slots:
     void on_actionQuit_triggered();
     void on_actionExport_As_triggered();
     void on_actionImport_Audio_File_triggered();
+    void on_actionImport_Browser_triggered( bool isChecked );
+    void on_actionLoop_Library_triggered();
+    void on_actionRecord_triggered();
     void on_actionClose_Project_triggered();
     void on_actionSave_As_triggered();
     void on_actionSave_Project_triggered();
@@ -223,14 +403,22 @@ private slots:
 
     void recordSlicePointItemMove( SharedSlicePointItem slicePoint,
                                    int orderPos,
-                                   int numFramesFromPrevSlicePoint,
-                                   int numFramesToNextSlicePoint,
-                                   int oldFrameNum );
+                                   FrameNum numFramesFromPrevSlicePoint,
+                                   FrameNum numFramesToNextSlicePoint,
+                                   FrameNum oldFrameNum );
 
     void playSample( const WaveformItem* waveformItem, QPointF mouseScenePos );
 
+    // 'frameNum' counts from the start of the first waveform
+    void scrubSlicePoint( FrameNum frameNum );
+    void stopScrubbing();
+
     void stopPlayback();
 
+    // Restore any spilled sample data the next command needs first
+    void undo();
+    void redo();
+
     void resetPlayStopButtonIcon();
 
     void disableZoomIn();
@@ -253,6 +441,24 @@ private slots:
 
     void openRecentProject();
 
+    void projectSaveFinished( int saveId, bool isSuccessful, QString errorTitle, QString errorInfo );
+
+    void recordJournalEntry( int undoIndex );
+
+    void jobProgress( int jobId, QString description, int percent );
+    void jobFinished( int jobId, bool isCancelled );
+    void cancelStaleJobs();
+
+    // Spill the undo data of commands that ask for it to the temp dir in the background. Then, if memory use
+    // is over the ceiling, free caches and spill other undo data until it's below
+    void enforceMemoryCeiling();
+
+    // Switch the waveform view between OpenGL and software rendering as chosen in the options dialog
+    void updateWaveformRenderer();
+
+    // Import a file chosen in the import browser or loop library, checking for unsaved changes first
+    void importFromBrowser( QString filePath );
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( MainWindow );
 };
@@ -27,7 +27,7 @@
 #include <QDesktopWidget>
 #include "commands.h"
 #include "globals.h"
-#include "zipper.h"
+#include "recorddialog.h"
 #include "messageboxes.h"
 #include "textfilehandler.h"
 #include "akaifilehandler.h"
@@ -50,142 +50,103 @@ void MainWindow::saveProject( const QString filePath, const bool isNsmSessionExp
 
     if ( tempDirPath.isEmpty() )
     {
+        m_pendingSaveId = m_projectSaver->reportError( tr("Temp directory is invalid!") );
+
         MessageBoxes::showWarningDialog( tr("Temp directory is invalid!"),
                                          tr("This operation needs to save temporary files, please change \"Temp Dir\" in options") );
         return;
     }
 
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
-    const QString zipFileName = QFileInfo( filePath ).fileName();
-    const QString projectName = QFileInfo( filePath ).baseName();
+    // Only take a snapshot here, the audio files are encoded and written by the project saver thread.
+    // Edits replace sample buffers rather than changing them, so the snapshot can share them
+    ProjectSaver::Snapshot snapshot;
 
-    QDir tempDir( tempDirPath );
+    snapshot.filePath = filePath;
+    snapshot.tempDirPath = tempDirPath;
+    snapshot.sampleBufferList = m_sampleBufferList;
+    snapshot.sampleRate = m_sampleHeader->sampleRate;
 
-    // Should not happen, but just as a precaution...
-    if ( tempDir.exists( projectName ) )
+    // Save the full quality audio rather than a time stretch preview
+    if ( ! m_stretchRenderJob.isNull() && isStretchRenderCommandCurrent() )
     {
-        tempDir.rename( projectName, projectName + ".bak" );
+        snapshot.stretchRenderJob = m_stretchRenderJob;
     }
 
-    tempDir.mkdir( projectName );
+    getProjectSettings( snapshot.settings );
 
-    QDir projTempDir( tempDir.absoluteFilePath( projectName ) );
+    m_pendingSaveId = m_projectSaver->save( snapshot );
+    m_pendingSaveFilePath = filePath;
+    m_isPendingSaveNsmExport = isNsmSessionExport;
+    m_pendingSaveUndoIndex = m_undoStack.index();
 
-    const QString zipFilePath = tempDir.absoluteFilePath( zipFileName );
+    m_ui->statusBar->showMessage( tr("Saving ") + QFileInfo( filePath ).fileName() + "..." );
+}
 
-    const QString xmlFilePath = projTempDir.absoluteFilePath( "shuriken.xml" );
 
-    bool isOkToContinue = true;
-    QStringList audioFileNames;
 
-    for ( int i = 0; i < m_sampleBufferList.size(); i++ )
-    {
-        const QString audioFilePath = m_fileHandler.saveAudioFile( projTempDir.absolutePath(),
-                                                                   "audio" + QString::number( i ),
-                                                                   m_sampleBufferList.at( i ),
-                                                                   m_sampleHeader->sampleRate,
-                                                                   m_sampleHeader->sampleRate,
-                                                                   AudioFileHandler::SAVE_FORMAT );
+bool MainWindow::waitForProjectSaves()
+{
+    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
 
-        if ( ! audioFilePath.isEmpty() )
-        {
-            audioFileNames << QFileInfo( audioFilePath ).fileName();
-        }
-        else
-        {
-            isOkToContinue = false;
-            break;
-        }
-    }
+    QString errorInfo;
+    const bool isSuccessful = m_projectSaver->waitForSave( m_pendingSaveId, errorInfo );
+
+    QApplication::restoreOverrideCursor();
 
-    if ( isOkToContinue )
+    if ( ! isSuccessful )
     {
-        TextFileHandler::ProjectSettings settings;
+        MessageBoxes::showWarningDialog( tr( "Could not save project!" ), errorInfo );
+    }
 
-        settings.projectName = projectName;
+    return isSuccessful;
+}
 
-        if ( m_rubberbandAudioSource != NULL )
-        {
-            const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
 
-            for ( int i = 0; i < m_sampleBufferList.size(); i++ )
-            {
-                settings.midiNotes << startMidiNote + i;
-                settings.noteTimeRatios << m_rubberbandAudioSource->getNoteTimeRatio( startMidiNote + i );
-            }
 
-            settings.originalBpm = m_ui->doubleSpinBox_OriginalBPM->value();
-            settings.newBpm = m_ui->doubleSpinBox_NewBPM->value();
-            settings.appliedBpm = m_appliedBPM;
-        }
-        else
+void MainWindow::getProjectSettings( TextFileHandler::ProjectSettings& settings )
+{
+    if ( m_rubberbandAudioSource != NULL )
+    {
+        const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
+
+        for ( int i = 0; i < m_sampleBufferList.size(); i++ )
         {
-            settings.originalBpm = m_appliedBPM > 0.0 ? m_appliedBPM : m_ui->doubleSpinBox_OriginalBPM->value();
-            settings.newBpm = settings.originalBpm;
-            settings.appliedBpm = m_appliedBPM;
+            settings.midiNotes << startMidiNote + i;
+            settings.noteTimeRatios << m_rubberbandAudioSource->getNoteTimeRatio( startMidiNote + i );
         }
 
-        SamplerAudioSource::EnvelopeSettings envelopes;
-
-        m_samplerAudioSource->getEnvelopeSettings( envelopes );
-
-        settings.attackValues = envelopes.attackValues;
-        settings.releaseValues = envelopes.releaseValues;
-        settings.oneShotSettings = envelopes.oneShotSettings;
-
-        settings.isTimeStretchChecked = m_ui->checkBox_TimeStretch->isChecked();
-        settings.isPitchCorrectionChecked = m_ui->checkBox_PitchCorrection->isChecked();
-        settings.options = m_optionsDialog->getStretcherOptions();
-        settings.isJackSyncChecked = m_optionsDialog->isJackSyncEnabled();
-
-        settings.timeSigNumerator = m_ui->comboBox_TimeSigNumerator->currentText().toInt();
-        settings.timeSigDenominator = m_ui->comboBox_TimeSigDenominator->currentText().toInt();
-        settings.length = m_ui->spinBox_Length->value();
-        settings.units = m_ui->comboBox_Units->currentIndex();
-
-        settings.audioFileNames = audioFileNames;
-
-        settings.slicePointFrameNums = m_graphicsScene->getSlicePointFrameNums();
+        settings.originalBpm = m_ui->doubleSpinBox_OriginalBPM->value();
+        settings.newBpm = m_ui->doubleSpinBox_NewBPM->value();
+        settings.appliedBpm = m_appliedBPM;
+    }
+    else
+    {
+        settings.originalBpm = m_appliedBPM > 0.0 ? m_appliedBPM : m_ui->doubleSpinBox_OriginalBPM->value();
+        settings.newBpm = settings.originalBpm;
+        settings.appliedBpm = m_appliedBPM;
+    }
 
-        settings.isMonophonyEnabled = m_ui->actionMonophonic->isChecked();
+    SamplerAudioSource::EnvelopeSettings envelopes;
 
-        TextFileHandler::createProjectXmlFile( xmlFilePath, settings );
+    m_samplerAudioSource->getEnvelopeSettings( envelopes );
 
-        Zipper::compress( projTempDir.absolutePath(), zipFilePath );
+    settings.attackValues = envelopes.attackValues;
+    settings.releaseValues = envelopes.releaseValues;
+    settings.oneShotSettings = envelopes.oneShotSettings;
 
-        QFile::remove( filePath );
-        QFile::copy( zipFilePath, filePath );
-        QFile::remove( zipFilePath );
-        File( projTempDir.absolutePath().toLocal8Bit().data() ).deleteRecursively();
+    settings.isTimeStretchChecked = m_ui->checkBox_TimeStretch->isChecked();
+    settings.isPitchCorrectionChecked = m_ui->checkBox_PitchCorrection->isChecked();
+    settings.options = m_optionsDialog->getStretcherOptions();
+    settings.isJackSyncChecked = m_optionsDialog->isJackSyncEnabled();
 
-        if ( m_nsmThread != NULL )
-        {
-            if ( m_undoStack.isClean() && ! isNsmSessionExport )
-            {
-                m_nsmThread->sendMessage( NsmListenerThread::MSG_IS_CLEAN );
-                m_ui->actionSave_Project->setEnabled( false );
-            }
-        }
-        else
-        {
-            m_currentProjectFilePath = filePath;
-            addPathToRecentProjects( filePath );
-        }
+    settings.timeSigNumerator = m_ui->comboBox_TimeSigNumerator->currentText().toInt();
+    settings.timeSigDenominator = m_ui->comboBox_TimeSigDenominator->currentText().toInt();
+    settings.length = m_ui->spinBox_Length->value();
+    settings.units = m_ui->comboBox_Units->currentIndex();
 
-        if ( ! isNsmSessionExport )
-        {
-            m_undoStack.setClean();
-            m_ui->actionSave_Project->setEnabled( false );
-        }
+    settings.slicePointFrameNums = m_graphicsScene->getSlicePointFrameNums();
 
-        QApplication::restoreOverrideCursor();
-    }
-    else // An error occurred while writing the audio files
-    {
-        QApplication::restoreOverrideCursor();
-        MessageBoxes::showWarningDialog( m_fileHandler.getLastErrorTitle(), m_fileHandler.getLastErrorInfo() );
-    }
+    settings.isMonophonyEnabled = m_ui->actionMonophonic->isChecked();
 }
 
 
@@ -206,432 +167,313 @@ void MainWindow::openProject( const QString filePath )
         return;
     }
 
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
-    Zipper::decompress( filePath, tempDirPath );
-
-    const QFileInfo zipFileInfo( filePath );
-    const QString projectName = zipFileInfo.baseName();
-
-    const QDir tempDir( tempDirPath );
-    QDir projTempDir = tempDir.absoluteFilePath( projectName );
+    // Whatever was opened last wins
+    m_jobScheduler->cancel( m_importJobId );
 
-    const QString xmlFilePath = projTempDir.absoluteFilePath( "shuriken.xml" );
-    TextFileHandler::ProjectSettings settings;
-
-    const bool isSuccessful = TextFileHandler::readProjectXmlFile( xmlFilePath, settings );
-
-    if ( isSuccessful )
-    {
-        closeProject();
+    startProjectLoad( QSharedPointer<ProjectLoader>( new ProjectLoader( filePath, tempDirPath ) ), false );
+}
 
-        bool isOkToContinue = true;
 
-        // Try to load the audio files
-        foreach ( QString fileName, settings.audioFileNames )
-        {
-            const QString audioFilePath = projTempDir.absoluteFilePath( fileName );
-            SharedSampleBuffer sampleBuffer = m_fileHandler.getSampleData( audioFilePath );
 
-            if ( ! sampleBuffer.isNull() )
-            {
-                m_sampleBufferList << sampleBuffer;
-            }
-            else
-            {
-                isOkToContinue = false;
-                break;
-            }
-        }
+void MainWindow::startProjectLoad( const QSharedPointer<ProjectLoader> loader, const bool isRecovery )
+{
+    m_jobScheduler->cancel( m_projectLoadJobId );
 
-        // Try to read the audio file header info
-        {
-            const QString audioFilePath = projTempDir.absoluteFilePath( settings.audioFileNames.first() );
-            m_sampleHeader = m_fileHandler.getSampleHeader( audioFilePath );
-        }
+    m_projectLoader = loader;
+    m_isProjectLoadRecovery = isRecovery;
 
-        if ( m_sampleHeader.isNull() )
-        {
-            isOkToContinue = false;
-        }
+    m_projectLoadJobId = m_jobScheduler->start( m_projectLoader,
+                                                JobScheduler::PRIORITY_INTERACTIVE,
+                                                isRecovery ? tr("Recovering session") : tr("Loading project") );
 
-        // If the audio files were read successfully
-        if ( isOkToContinue )
-        {
-            // Deal with sample ranges - provides backward compatibility with older save file format
-            if ( ! settings.sampleRangeList.isEmpty() )
-            {
-                const int numChans = m_sampleHeader->numChans;
+    if ( m_nsmThread != NULL )
+    {
+        m_nsmThread->projectLoadStarted();
+        m_nsmThread->sendProgress( 0.0f );
+    }
+}
 
-                QList<SharedSampleBuffer> tempSampleBuffers;
 
-                foreach ( SharedSampleRange range, settings.sampleRangeList )
-                {
-                    SharedSampleBuffer sampleBuffer( new SampleBuffer( numChans, range->numFrames ) );
 
-                    for ( int chanNum = 0; chanNum < numChans; chanNum++ )
-                    {
-                        sampleBuffer->copyFrom( chanNum, 0, *m_sampleBufferList.first().data(), chanNum, range->startFrame, range->numFrames );
-                    }
+void MainWindow::projectLoadFinished( const bool isCancelled )
+{
+    const QSharedPointer<ProjectLoader> loader = m_projectLoader;
 
-                    tempSampleBuffers << sampleBuffer;
-                }
+    m_projectLoader.clear();
 
-                m_sampleBufferList = tempSampleBuffers;
-            }
+    m_ui->statusBar->clearMessage();
 
-            // Only one sample buffer - waveform has not been sliced
-            if ( m_sampleBufferList.size() == 1 )
-            {
-                const SharedWaveformItem item = m_graphicsScene->createWaveform( m_sampleBufferList.first(),
-                                                                                 m_sampleHeader );
-                connectWaveformToMainWindow( item );
+    const bool isSuccessful = ! isCancelled && loader->isSuccessful();
 
-                enableUI();
-                m_ui->comboBox_SnapValues->setEnabled( true );
+    if ( isSuccessful )
+    {
+        applyProject( loader->getProject() );
 
-                if ( ! settings.slicePointFrameNums.isEmpty() )
-                {
-                    QUndoCommand* parentCommand = new QUndoCommand();
+        if ( m_isProjectLoadRecovery )
+        {
+            // The recovered project hasn't been saved anywhere, so make sure the undo stack isn't clean
+            QUndoCommand* command = new QUndoCommand();
+            command->setText( tr( "Recover Session" ) );
+            m_undoStack.push( command );
 
-                    foreach ( int frameNum, settings.slicePointFrameNums )
-                    {
-                        new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->pushButton_Slice, m_ui->comboBox_SnapValues, parentCommand );
-                    }
-                    m_undoStack.push( parentCommand );
-                }
-            }
-            else // Multiple sample buffers - waveform has been sliced
+            m_ui->statusBar->showMessage( tr("Recovered session") );
+        }
+        else
+        {
+            // Store file path for later use unless under NSM management
+            if ( m_nsmThread == NULL )
             {
-                const QList<SharedWaveformItem> waveformItems = m_graphicsScene->createWaveforms( m_sampleBufferList, m_sampleHeader );
-
-                foreach ( SharedWaveformItem item, waveformItems )
-                {
-                    connectWaveformToMainWindow( item );
-                }
-
-                enableUI();
-                m_ui->actionAdd_Slice_Point->setEnabled( false );
-                m_ui->pushButton_Find->setEnabled( false );
-                m_ui->pushButton_Slice->setEnabled( true );
-                m_ui->pushButton_Slice->setChecked( true );
-
+                m_currentProjectFilePath = loader->getFilePath();
+                addPathToRecentProjects( loader->getFilePath() );
             }
 
-            m_appliedBPM = settings.appliedBpm;
+            m_ui->statusBar->showMessage( tr("Project: ") + QFileInfo( loader->getFilePath() ).baseName() );
+        }
+    }
+    else if ( ! isCancelled && ! loader->getErrorTitle().isEmpty() )
+    {
+        MessageBoxes::showWarningDialog( loader->getErrorTitle(), loader->getErrorInfo() );
+    }
 
-            m_ui->actionMonophonic->setChecked( settings.isMonophonyEnabled );
+    if ( m_nsmThread != NULL )
+    {
+        // Being replaced by something else isn't a failure as far as a pending NSM save is concerned
+        m_nsmThread->sendProgress( 1.0f );
+        m_nsmThread->projectLoadFinished( isSuccessful || isCancelled );
+    }
+}
 
-            m_optionsDialog->setStretcherOptions( settings.options );
 
-            if ( m_samplerAudioSource != NULL && m_rubberbandAudioSource != NULL )
-            {
-                const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
 
-                QList<int> orderPositions;
+void MainWindow::applyProject( const ProjectLoader::Project& project )
+{
+    closeProject();
 
-                for ( int i = 0; i < settings.midiNotes.size() && i < settings.noteTimeRatios.size(); i++ )
-                {
-                    m_rubberbandAudioSource->setNoteTimeRatio( settings.midiNotes.at( i ),
-                                                               settings.noteTimeRatios.at( i ) );
+    m_sampleBufferList = project.sampleBufferList;
+    m_sampleHeader = project.sampleHeader;
 
-                    orderPositions << settings.midiNotes.at( i ) - startMidiNote;
-                }
+    const TextFileHandler::ProjectSettings& settings = project.settings;
 
-                m_graphicsScene->stretchWaveforms( orderPositions, settings.noteTimeRatios );
-            }
+    // Only one sample buffer - waveform has not been sliced
+    if ( m_sampleBufferList.size() == 1 )
+    {
+        const SharedWaveformItem item = m_graphicsScene->createWaveform( m_sampleBufferList.first(),
+                                                                         m_sampleHeader );
+        connectWaveformToMainWindow( item );
 
-            if ( settings.isJackSyncChecked )
-            {
-                m_optionsDialog->enableJackSync();
-            }
+        enableUI();
+        m_ui->comboBox_SnapValues->setEnabled( true );
 
-            m_ui->checkBox_TimeStretch->setChecked( settings.isTimeStretchChecked );
-            m_ui->checkBox_PitchCorrection->setChecked( settings.isPitchCorrectionChecked );
+        if ( ! settings.slicePointFrameNums.isEmpty() )
+        {
+            QUndoCommand* parentCommand = new QUndoCommand();
 
-            if ( settings.originalBpm > 0.0 )
-            {
-                m_ui->doubleSpinBox_OriginalBPM->setValue( settings.originalBpm );
-            }
-            if ( settings.newBpm > 0.0 )
+            foreach ( FrameNum frameNum, settings.slicePointFrameNums )
             {
-                m_ui->doubleSpinBox_NewBPM->setValue( settings.newBpm );
+                new AddSlicePointItemCommand( frameNum, true, m_graphicsScene, m_ui->pushButton_Slice, m_ui->comboBox_SnapValues, parentCommand );
             }
+            m_undoStack.push( parentCommand );
+        }
+    }
+    else // Multiple sample buffers - waveform has been sliced
+    {
+        const QList<SharedWaveformItem> waveformItems = m_graphicsScene->createWaveforms( m_sampleBufferList, m_sampleHeader );
 
-            {
-                const int i = m_ui->comboBox_TimeSigNumerator->findText( QString::number( settings.timeSigNumerator ) );
-                m_ui->comboBox_TimeSigNumerator->setCurrentIndex( i );
-            }
-            {
-                const int i = m_ui->comboBox_TimeSigDenominator->findText( QString::number( settings.timeSigDenominator ) );
-                m_ui->comboBox_TimeSigDenominator->setCurrentIndex( i );
-            }
-            m_ui->spinBox_Length->setValue( settings.length );
-            m_ui->comboBox_Units->setCurrentIndex( settings.units );
+        foreach ( SharedWaveformItem item, waveformItems )
+        {
+            connectWaveformToMainWindow( item );
+        }
 
-            SamplerAudioSource::EnvelopeSettings envelopes;
+        enableUI();
+        m_ui->actionAdd_Slice_Point->setEnabled( false );
+        m_ui->pushButton_Find->setEnabled( false );
+        m_ui->pushButton_Slice->setEnabled( true );
+        m_ui->pushButton_Slice->setChecked( true );
 
-            envelopes.attackValues = settings.attackValues;
-            envelopes.releaseValues = settings.releaseValues;
-            envelopes.oneShotSettings = settings.oneShotSettings;
+        // Shuriken won't slice this finely, but a project file could have been made elsewhere
+        if ( m_sampleBufferList.size() > Midi::NUM_KEYS )
+        {
+            MessageBoxes::showWarningDialog( tr("Too many slices!"),
+                                             tr("Only the first %1 slices can be played or exported as SFZ or MIDI").arg( Midi::NUM_KEYS ) );
+        }
+    }
 
-            m_samplerAudioSource->setEnvelopeSettings( envelopes );
+    m_appliedBPM = settings.appliedBpm;
 
-            // Clean up temp dir
-            File( projTempDir.absolutePath().toLocal8Bit().data() ).deleteRecursively();
+    m_ui->actionMonophonic->setChecked( settings.isMonophonyEnabled );
 
-            // Store file path for later use unless under NSM management
-            if ( m_nsmThread == NULL )
-            {
-                m_currentProjectFilePath = filePath;
-                addPathToRecentProjects( filePath );
-            }
+    m_optionsDialog->setStretcherOptions( settings.options );
 
-            m_ui->statusBar->showMessage( tr("Project: ") + projectName );
+    if ( m_samplerAudioSource != NULL && m_rubberbandAudioSource != NULL )
+    {
+        const int startMidiNote = m_samplerAudioSource->getLowestAssignedMidiNote();
 
-            m_isProjectOpen = true;
+        QList<int> orderPositions;
 
-            QApplication::restoreOverrideCursor();
-        }
-        else // Error loading audio files
+        for ( int i = 0; i < settings.midiNotes.size() && i < settings.noteTimeRatios.size(); i++ )
         {
-            m_sampleBufferList.clear();
-            m_sampleHeader.clear();
+            m_rubberbandAudioSource->setNoteTimeRatio( settings.midiNotes.at( i ),
+                                                       settings.noteTimeRatios.at( i ) );
 
-            QApplication::restoreOverrideCursor();
-
-            MessageBoxes::showWarningDialog( m_fileHandler.getLastErrorTitle(), m_fileHandler.getLastErrorInfo() );
+            orderPositions << settings.midiNotes.at( i ) - startMidiNote;
         }
-    }
-}
-
 
+        m_graphicsScene->stretchWaveforms( orderPositions, settings.noteTimeRatios );
+    }
 
-void MainWindow::importAudioFile( const QString filePath )
-{
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
-    const QFileInfo fileInfo( filePath );
-    const QString fileName = fileInfo.fileName();
+    if ( settings.isJackSyncChecked )
+    {
+        m_optionsDialog->enableJackSync();
+    }
 
-    m_lastOpenedImportDir = fileInfo.absolutePath();
+    m_ui->checkBox_TimeStretch->setChecked( settings.isTimeStretchChecked );
+    m_ui->checkBox_PitchCorrection->setChecked( settings.isPitchCorrectionChecked );
 
-    SharedSampleBuffer sampleBuffer = m_fileHandler.getSampleData( filePath );
-    SharedSampleHeader sampleHeader = m_fileHandler.getSampleHeader( filePath );
+    if ( settings.originalBpm > 0.0 )
+    {
+        m_ui->doubleSpinBox_OriginalBPM->setValue( settings.originalBpm );
+    }
+    if ( settings.newBpm > 0.0 )
+    {
+        m_ui->doubleSpinBox_NewBPM->setValue( settings.newBpm );
+    }
 
-    if ( sampleBuffer.isNull() || sampleHeader.isNull() )
     {
-        QApplication::restoreOverrideCursor();
-        MessageBoxes::showWarningDialog( m_fileHandler.getLastErrorTitle(), m_fileHandler.getLastErrorInfo() );
+        const int i = m_ui->comboBox_TimeSigNumerator->findText( QString::number( settings.timeSigNumerator ) );
+        m_ui->comboBox_TimeSigNumerator->setCurrentIndex( i );
     }
-    else
     {
-        closeProject();
+        const int i = m_ui->comboBox_TimeSigDenominator->findText( QString::number( settings.timeSigDenominator ) );
+        m_ui->comboBox_TimeSigDenominator->setCurrentIndex( i );
+    }
+    m_ui->spinBox_Length->setValue( settings.length );
+    m_ui->comboBox_Units->setCurrentIndex( settings.units );
 
-        m_sampleBufferList << sampleBuffer;
-        m_sampleHeader = sampleHeader;
+    SamplerAudioSource::EnvelopeSettings envelopes;
 
-        const SharedWaveformItem item = m_graphicsScene->createWaveform( sampleBuffer, sampleHeader );
-        connectWaveformToMainWindow( item );
+    envelopes.attackValues = settings.attackValues;
+    envelopes.releaseValues = settings.releaseValues;
+    envelopes.oneShotSettings = settings.oneShotSettings;
 
-        setUpSampler();
+    m_samplerAudioSource->setEnvelopeSettings( envelopes );
 
-        enableUI();
-        m_ui->comboBox_SnapValues->setEnabled( true );
+    m_isProjectOpen = true;
+}
 
-        // Set status bar message
-        {
-            const QString channels = sampleHeader->numChans == 1 ? "Mono" : "Stereo";
 
-            const QString bits = QString::number( sampleHeader->bitsPerSample ) + " bits";
 
-            const QString rate = QString::number( sampleHeader->sampleRate ) + " Hz";
+void MainWindow::offerSessionRecovery()
+{
+    const QString tempDirPath = m_optionsDialog->getTempDirPath();
 
-            QString message = fileName + ", " + channels + ", " + bits + ", " + rate + ", " + sampleHeader->format;
-            m_ui->statusBar->showMessage( message );
-        }
+    const QString journalDirPath = EditJournal::findOrphanedJournal( tempDirPath );
 
-        if ( m_nsmThread != NULL )
+    QString xmlFilePath;
+    QString description;
+
+    if ( ! journalDirPath.isEmpty() && EditJournal::readLastEntry( journalDirPath, xmlFilePath, description ) )
+    {
+        const int buttonClicked = MessageBoxes::showQuestionDialog( tr( "Recover unsaved changes?" ),
+                                                                    tr( "Shuriken didn't exit cleanly last time. Do you want to recover the last session?\n\nLast edit: " ) + description,
+                                                                    QMessageBox::Yes | QMessageBox::No );
+        if ( buttonClicked == QMessageBox::Yes )
         {
-            m_nsmThread->sendMessage( NsmListenerThread::MSG_IS_DIRTY );
-            m_ui->actionSave_Project->setEnabled( true );
+            startProjectLoad( QSharedPointer<ProjectLoader>( new ProjectLoader( xmlFilePath ) ), true );
         }
-
-        m_isProjectOpen = true;
-
-        QApplication::restoreOverrideCursor();
     }
+
+    // Once the recovered audio is in memory the old temp dirs are no longer needed
+    m_jobScheduler->whenFinished( m_projectLoadJobId, [=] { EditJournal::removeOrphanedTempDirs( tempDirPath ); } );
 }
 
 
 
-void MainWindow::exportAs( const QString tempDirPath,
-                           const QString outputDirPath,
-                           const QString samplesDirPath,
-                           const QString fileName,
-                           const int exportType,
-                           const int sndFileFormat,
-                           const int outputSampleRate,
-                           const int numSamplesToExport )
+void MainWindow::importAudioFile( const QString filePath )
 {
-    QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
-    const QDir outputDir( outputDirPath );
+    m_lastOpenedImportDir = QFileInfo( filePath ).absolutePath();
 
-    const bool isExportTypeAudioFiles = exportType & ExportDialog::EXPORT_AUDIO_FILES;
-    const bool isExportTypeH2Drumkit  = exportType & ExportDialog::EXPORT_H2DRUMKIT;
-    const bool isExportTypeSFZ        = exportType & ExportDialog::EXPORT_SFZ;
-    const bool isExportTypeAkaiPgm    = exportType & ExportDialog::EXPORT_AKAI_PGM;
-    const bool isExportTypeMidiFile   = exportType & ExportDialog::EXPORT_MIDI_FILE;
+    // Whatever was opened last wins
+    m_jobScheduler->cancel( m_projectLoadJobId );
+    m_jobScheduler->cancel( m_importJobId );
 
-    if ( isExportTypeAudioFiles )
-    {
-        outputDir.mkdir( fileName );
-    }
+    m_importJob = QSharedPointer<AudioFileHandler::ReadJob>( new AudioFileHandler::ReadJob( filePath ) );
 
-    QStringList audioFileNames;
-    bool isSuccessful = true;
+    m_importJobId = m_jobScheduler->start( m_importJob, JobScheduler::PRIORITY_INTERACTIVE, tr("Importing audio file") );
+}
 
-    // Export audio files
-    if ( isExportTypeAudioFiles )
-    {
-        for ( int i = 0; i < numSamplesToExport; i++ )
-        {
-            QString audioFileName = fileName;
 
-            if ( isExportTypeAkaiPgm && audioFileName.size() > 14 )
-            {
-                audioFileName.resize( 14 );
-            }
 
-            if ( m_exportDialog->getNumberingStyle() == ExportDialog::NUMBERING_PREFIX )
-            {
-                audioFileName.prepend( QString::number( i + 1 ).rightJustified( 2, '0' ) );
-            }
-            else // SUFFIX
-            {
-                audioFileName.append( QString::number( i + 1 ).rightJustified( 2, '0' ) );
-            }
-
-            const QString path = m_fileHandler.saveAudioFile( samplesDirPath,
-                                                              audioFileName,
-                                                              m_sampleBufferList.at( i ),
-                                                              m_sampleHeader->sampleRate,
-                                                              outputSampleRate,
-                                                              sndFileFormat );
-
-            if ( ! path.isEmpty() )
-            {
-                if ( isExportTypeAkaiPgm )
-                {
-                    audioFileNames << audioFileName;    // File base name, no extension
-                }
-                else
-                {
-                    audioFileNames << QFileInfo( path ).fileName(); // File name including extension
-                }
-            }
-            else
-            {
-                isSuccessful = false;
-                break;
-            }
-        }
-    }
+void MainWindow::openSampleBuffer( const SharedSampleBuffer sampleBuffer, const SharedSampleHeader sampleHeader, const QString name )
+{
+    closeProject();
 
-    // Export Hydrogen drumkit
-    if ( isSuccessful && isExportTypeH2Drumkit )
-    {
-        SamplerAudioSource::EnvelopeSettings envelopes;
+    m_sampleBufferList << sampleBuffer;
+    m_sampleHeader = sampleHeader;
 
-        m_samplerAudioSource->getEnvelopeSettings( envelopes );
+    const SharedWaveformItem item = m_graphicsScene->createWaveform( sampleBuffer, sampleHeader );
+    connectWaveformToMainWindow( item );
 
-        TextFileHandler::createH2DrumkitXmlFile( samplesDirPath, fileName, audioFileNames, envelopes );
-#ifdef LINUX
-        const QString cdCommand  = "cd '" + outputDirPath + "'";
-        const QString tarCommand = "tar --create --gzip --file '" + fileName + ".h2drumkit' '" + fileName + "'";
+    setUpSampler();
 
-        const QString command = cdCommand + " && " + tarCommand;
+    enableUI();
+    m_ui->comboBox_SnapValues->setEnabled( true );
 
-        system( command.toLocal8Bit().data() );
-#endif
-        File( samplesDirPath.toLocal8Bit().data() ).deleteRecursively();
-    }
-    // Export SFZ
-    else if ( isSuccessful && isExportTypeSFZ )
+    // Set status bar message
     {
-        SamplerAudioSource::EnvelopeSettings envelopes;
+        const QString channels = sampleHeader->numChans == 1 ? "Mono" : "Stereo";
 
-        m_samplerAudioSource->getEnvelopeSettings( envelopes );
+        const QString bits = QString::number( sampleHeader->bitsPerSample ) + " bits";
 
-        const QString sfzFilePath = outputDir.absoluteFilePath( fileName + ".sfz" );
-        const QString samplesDirName = QFileInfo( samplesDirPath ).fileName();
+        const QString rate = QString::number( sampleHeader->sampleRate ) + " Hz";
 
-        TextFileHandler::createSFZFile( sfzFilePath, samplesDirName, audioFileNames, m_sampleBufferList, m_sampleHeader->sampleRate, envelopes );
+        QString message = name + ", " + channels + ", " + bits + ", " + rate + ", " + sampleHeader->format;
+        m_ui->statusBar->showMessage( message );
     }
-    // Export Akai PGM
-    else if ( isSuccessful && isExportTypeAkaiPgm )
-    {
-        SamplerAudioSource::EnvelopeSettings envelopes;
 
-        m_samplerAudioSource->getEnvelopeSettings( envelopes );
+    if ( m_nsmThread != NULL )
+    {
+        m_nsmThread->sendMessage( NsmListenerThread::MSG_IS_DIRTY );
+        m_ui->actionSave_Project->setEnabled( true );
+    }
 
-        const int modelID = m_exportDialog->getAkaiModelID();
+    m_isProjectOpen = true;
+}
 
-        const bool isVoiceOverlapMono = m_exportDialog->isVoiceOverlapMono();
-        const int muteGroup = m_exportDialog->getMuteGroup();
 
-        switch ( modelID )
-        {
-        case AkaiModelID::MPC1000_ID:
-            AkaiFileHandler::writePgmFileMPC1000( audioFileNames, fileName, samplesDirPath, tempDirPath, isVoiceOverlapMono, muteGroup, envelopes );
-            break;
-        case AkaiModelID::MPC500_ID:
-            AkaiFileHandler::writePgmFileMPC500( audioFileNames, fileName, samplesDirPath, tempDirPath, isVoiceOverlapMono, muteGroup, envelopes );
-            break;
-        default:
-            break;
-        }
-    }
 
-    // Export MIDI file
-    if ( isSuccessful && isExportTypeMidiFile )
+void MainWindow::startExport( Exporter::Settings settings )
+{
+    // Export the full quality audio rather than a time stretch preview
+    if ( m_stretchRenderJobId != 0 )
     {
-        const qreal bpm = m_ui->doubleSpinBox_OriginalBPM->value();
-        const ConfirmBpmDialog::TimeSigNumerator numerator = (ConfirmBpmDialog::TimeSigNumerator) m_ui->comboBox_TimeSigNumerator->currentIndex();
-        const ConfirmBpmDialog::TimeSigDenominator denominator = (ConfirmBpmDialog::TimeSigDenominator) m_ui->comboBox_TimeSigDenominator->currentIndex();
-
-        QApplication::restoreOverrideCursor();
+        const QList<SharedSampleBuffer> sampleBufferList = m_sampleBufferList;
 
-        ConfirmBpmDialog dialog( bpm, numerator, denominator );
-        const int result = dialog.exec();
+        m_ui->statusBar->showMessage( tr("Waiting for time stretch to finish...") );
 
-        if ( result == QDialog::Accepted )
+        m_jobScheduler->whenFinished( m_stretchRenderJobId, [=]
         {
-            QApplication::setOverrideCursor( QCursor(Qt::WaitCursor) );
-
-            const qreal bpm = dialog.getBpm();
-            const int timeSigNumerator = dialog.getTimeSigNumerator();
-            const int timeSigDenominator = dialog.getTimeSigDenominator();
-            const MidiFileHandler::MidiFileType type = (MidiFileHandler::MidiFileType) m_exportDialog->getMidiFileType();
-
-            if ( isExportTypeAkaiPgm )
+            // Nothing is exported if the project has been closed or replaced meanwhile
+            if ( m_sampleBufferList == sampleBufferList )
             {
-                MidiFileHandler::SaveMidiFile( fileName, samplesDirPath, m_sampleBufferList, numSamplesToExport, m_sampleHeader->sampleRate, bpm, timeSigNumerator, timeSigDenominator, type );
+                startExport( settings );
             }
             else
             {
-                MidiFileHandler::SaveMidiFile( fileName, outputDirPath, m_sampleBufferList, numSamplesToExport, m_sampleHeader->sampleRate, bpm, timeSigNumerator, timeSigDenominator, type );
+                m_ui->statusBar->clearMessage();
             }
-        }
+        } );
+
+        return;
     }
 
-    QApplication::restoreOverrideCursor();
+    // Editing can go on meanwhile, as edits replace sample buffers rather than changing them
+    settings.sampleBufferList = m_sampleBufferList;
 
-    if ( ! isSuccessful )
-    {
-        MessageBoxes::showWarningDialog( m_fileHandler.getLastErrorTitle(), m_fileHandler.getLastErrorInfo() );
-    }
+    m_jobScheduler->cancel( m_exportJobId );
+
+    m_exportJob = QSharedPointer<Exporter::ExportJob>( new Exporter::ExportJob( settings ) );
+
+    m_exportJobId = m_jobScheduler->start( m_exportJob, JobScheduler::PRIORITY_INTERACTIVE, tr("Exporting") );
 }
 
 
@@ -758,6 +600,56 @@ void MainWindow::importAudioFileDialog()
 
 
 
+void MainWindow::recordAudioDialog()
+{
+    if ( m_optionsDialog == NULL )
+    {
+        return;
+    }
+
+    const QString tempDirPath = m_optionsDialog->getTempDirPath();
+
+    if ( tempDirPath.isEmpty() )
+    {
+        MessageBoxes::showWarningDialog( tr("Temp dir invalid!"),
+                                         tr("Recording needs to save temporary files, please change \"Temp Dir\" in options") );
+        return;
+    }
+
+    AudioAnalyser::DetectionSettings detectionSettings;
+    getDetectionSettings( detectionSettings );
+
+    RecordDialog dialog( m_deviceManager, tempDirPath, detectionSettings, this );
+
+    const int result = dialog.exec();
+
+    if ( result == QDialog::Accepted && ! dialog.getTake().isNull() )
+    {
+        const SharedSampleBuffer sampleBuffer = dialog.getTake();
+
+        SharedSampleHeader sampleHeader( new SampleHeader );
+        sampleHeader->format = "Recording";
+        sampleHeader->numChans = sampleBuffer->getNumChannels();
+        sampleHeader->bitsPerSample = 32;
+        sampleHeader->sampleRate = dialog.getSampleRate();
+
+        openSampleBuffer( sampleBuffer, sampleHeader, tr("Recording") );
+
+        // The take was analysed while it was being recorded so it arrives already sliced
+        QList<FrameNum> onsetFrameNums = dialog.getOnsetFrameNums();
+        snapToZeroCrossings( onsetFrameNums );
+        replaceSlicePoints( onsetFrameNums, tr("Find Onsets") );
+
+        if ( dialog.getBPM() > 0.0 )
+        {
+            m_ui->doubleSpinBox_OriginalBPM->setValue( dialog.getBPM() );
+            m_ui->doubleSpinBox_NewBPM->setValue( dialog.getBPM() );
+        }
+    }
+}
+
+
+
 void MainWindow::exportAsDialog()
 {
     if ( m_exportDialog == NULL || m_optionsDialog == NULL )
@@ -841,7 +733,7 @@ void MainWindow::exportAsDialog()
         return;
     }
 
-    if ( isExportTypeAudioFiles && QFileInfo( samplesDirPath ).exists() )
+    if ( isExportTypeAudioFiles && ! isExportTypeH2Drumkit && QFileInfo( samplesDirPath ).exists() )
     {
         if ( isOverwriteEnabled )
         {
@@ -900,8 +792,50 @@ void MainWindow::exportAsDialog()
     }
 
 
+    Exporter::Settings settings;
+
+    settings.tempDirPath = tempDirPath;
+    settings.outputDirPath = outputDirPath;
+    settings.samplesDirPath = samplesDirPath;
+    settings.fileName = fileName;
+    settings.exportType = exportType;
+    settings.numberingStyle = m_exportDialog->getNumberingStyle();
+    settings.sndFileFormat = sndFileFormat;
+    settings.outputSampleRate = outputSampleRate;
+    settings.numSamplesToExport = numSamplesToExport;
+    settings.akaiModelID = m_exportDialog->getAkaiModelID();
+    settings.isVoiceOverlapMono = m_exportDialog->isVoiceOverlapMono();
+    settings.muteGroup = m_exportDialog->getMuteGroup();
+    settings.sampleRate = m_sampleHeader->sampleRate;
+
+    m_samplerAudioSource->getEnvelopeSettings( settings.envelopes );
+
+    // Ask for the MIDI file's tempo up front so that nothing needs asking once the export is under way
+    settings.isMidiFileConfirmed = false;
+    settings.bpm = 0.0;
+    settings.timeSigNumerator = 0;
+    settings.timeSigDenominator = 0;
+    settings.midiFileType = (MidiFileHandler::MidiFileType) m_exportDialog->getMidiFileType();
+
+    if ( isExportTypeMidiFile )
+    {
+        const qreal bpm = m_ui->doubleSpinBox_OriginalBPM->value();
+        const ConfirmBpmDialog::TimeSigNumerator numerator = (ConfirmBpmDialog::TimeSigNumerator) m_ui->comboBox_TimeSigNumerator->currentIndex();
+        const ConfirmBpmDialog::TimeSigDenominator denominator = (ConfirmBpmDialog::TimeSigDenominator) m_ui->comboBox_TimeSigDenominator->currentIndex();
+
+        ConfirmBpmDialog dialog( bpm, numerator, denominator );
+
+        if ( dialog.exec() == QDialog::Accepted )
+        {
+            settings.isMidiFileConfirmed = true;
+            settings.bpm = dialog.getBpm();
+            settings.timeSigNumerator = dialog.getTimeSigNumerator();
+            settings.timeSigDenominator = dialog.getTimeSigDenominator();
+        }
+    }
+
     // Checks complete, now do export
-    exportAs( tempDirPath, outputDirPath, samplesDirPath, fileName, exportType, sndFileFormat, outputSampleRate, numSamplesToExport );
+    startExport( settings );
 }
 
 
@@ -935,3 +869,49 @@ void MainWindow::addPathToRecentProjects( QString filePath )
         m_recentProjectsActions.at( i )->setVisible( true );
     }
 }
+
+
+
+//==================================================================================================
+// Private Slots:
+
+void MainWindow::projectSaveFinished( const int saveId,
+                                      const bool isSuccessful,
+                                      const QString errorTitle,
+                                      const QString errorInfo )
+{
+    if ( ! isSuccessful )
+    {
+        m_ui->statusBar->clearMessage();
+        MessageBoxes::showWarningDialog( errorTitle, errorInfo );
+        return;
+    }
+
+    // Ignore saves that have since been superseded or whose project has been closed
+    if ( saveId != m_pendingSaveId )
+    {
+        return;
+    }
+
+    m_ui->statusBar->showMessage( tr("Saved ") + QFileInfo( m_pendingSaveFilePath ).fileName(), 3000 );
+
+    if ( m_nsmThread == NULL )
+    {
+        m_currentProjectFilePath = m_pendingSaveFilePath;
+        addPathToRecentProjects( m_pendingSaveFilePath );
+    }
+
+    // Only mark the undo stack clean if nothing has been edited since the snapshot was taken
+    if ( ! m_isPendingSaveNsmExport && m_undoStack.index() == m_pendingSaveUndoIndex )
+    {
+        m_undoStack.setClean();
+        m_ui->actionSave_Project->setEnabled( false );
+
+        if ( m_nsmThread != NULL )
+        {
+            m_nsmThread->sendMessage( NsmListenerThread::MSG_IS_CLEAN );
+        }
+    }
+
+    m_pendingSaveId = -1;
+}
@@ -0,0 +1,304 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "memoryaccountant.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QObject>
+
+
+//==================================================================================================
+// Public:
+
+MemoryAccountant::Usage::Usage() :
+    numSpilledBytes( 0 ),
+    numTempFileBytes( 0 )
+{
+    for ( int i = 0; i < NUM_CATEGORIES; i++ )
+    {
+        m_numBytes[ i ] = 0;
+    }
+}
+
+
+
+void MemoryAccountant::Usage::addSampleBuffers( const Category category, const QList<SharedSampleBuffer>& sampleBufferList )
+{
+    foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
+    {
+        if ( ! m_countedSampleBuffers.contains( sampleBuffer.data() ) )
+        {
+            m_countedSampleBuffers.insert( sampleBuffer.data() );
+            m_numBytes[ category ] += MemoryAccountant::getNumBytes( *sampleBuffer );
+        }
+    }
+}
+
+
+
+qint64 MemoryAccountant::Usage::getTotalNumBytes() const
+{
+    qint64 totalNumBytes = 0;
+
+    for ( int i = 0; i < NUM_CATEGORIES; i++ )
+    {
+        totalNumBytes += m_numBytes[ i ];
+    }
+
+    return totalNumBytes;
+}
+
+
+
+MemoryAccountant::SpillJob::SpillJob( const QList<SharedSampleBuffer> sampleBufferList,
+                                      const QString tempDirPath,
+                                      const QStringList fileBaseNames,
+                                      const int sampleRate ) :
+    JobScheduler::Job(),
+    m_sampleBufferList( sampleBufferList ),
+    m_tempDirPath( tempDirPath ),
+    m_fileBaseNames( fileBaseNames ),
+    m_sampleRate( sampleRate )
+{
+}
+
+
+
+void MemoryAccountant::SpillJob::run()
+{
+    AudioFileHandler fileHandler;
+
+    for ( int i = 0; i < m_sampleBufferList.size(); i++ )
+    {
+        QString filePath;
+
+        if ( ! isCancelled() )
+        {
+            filePath = fileHandler.saveAudioFile( m_tempDirPath,
+                                                  m_fileBaseNames.at( i ),
+                                                  m_sampleBufferList.at( i ),
+                                                  m_sampleRate,
+                                                  m_sampleRate,
+                                                  AudioFileHandler::TEMP_FORMAT );
+        }
+
+        m_filePaths << filePath;
+
+        setProgress( ( i + 1 ) * 100 / m_sampleBufferList.size() );
+    }
+}
+
+
+
+MemoryAccountant::MemoryAccountant( const QString tempDirPath, AudioFileHandler& fileHandler ) :
+    m_tempDirPath( tempDirPath ),
+    m_fileHandler( fileHandler ),
+    m_nextFileNum( 0 )
+{
+}
+
+
+
+MemoryAccountant::~MemoryAccountant()
+{
+    foreach ( const SpilledBuffer& spilledBuffer, m_spilledBuffers )
+    {
+        QFile::remove( spilledBuffer.filePath );
+    }
+}
+
+
+
+QSharedPointer<MemoryAccountant::SpillJob> MemoryAccountant::createSpillJob( const QList<SharedSampleBuffer>& sampleBufferList,
+                                                                             const int sampleRate )
+{
+    if ( m_tempDirPath.isEmpty() )
+    {
+        return QSharedPointer<SpillJob>();
+    }
+
+    QStringList fileBaseNames;
+
+    for ( int i = 0; i < sampleBufferList.size(); i++ )
+    {
+        fileBaseNames << QString( "spill_%1" ).arg( m_nextFileNum++ );
+    }
+
+    return QSharedPointer<SpillJob>( new SpillJob( sampleBufferList, m_tempDirPath, fileBaseNames, sampleRate ) );
+}
+
+
+
+QHash<const SampleBuffer*, SharedSampleBuffer> MemoryAccountant::takePlaceholders( const SpillJob& job )
+{
+    removeDeletedPlaceholders();
+
+    QHash<const SampleBuffer*, SharedSampleBuffer> placeholders;
+
+    const QList<SharedSampleBuffer> sampleBufferList = job.getSampleBufferList();
+    const QStringList filePaths = job.getFilePaths();
+
+    for ( int i = 0; i < filePaths.size(); i++ )
+    {
+        if ( ! filePaths.at( i ).isEmpty() )
+        {
+            const SharedSampleBuffer sampleBuffer = sampleBufferList.at( i );
+            const SharedSampleBuffer placeholder( new SampleBuffer( sampleBuffer->getNumChannels(), 0 ) );
+
+            SpilledBuffer spilledBuffer;
+            spilledBuffer.placeholder = placeholder.toWeakRef();
+            spilledBuffer.filePath = filePaths.at( i );
+            spilledBuffer.numBytes = getNumBytes( *sampleBuffer );
+
+            m_spilledBuffers.insert( placeholder.data(), spilledBuffer );
+            placeholders.insert( sampleBuffer.data(), placeholder );
+        }
+    }
+
+    return placeholders;
+}
+
+
+
+SharedSampleBuffer MemoryAccountant::restore( const SharedSampleBuffer& sampleBuffer )
+{
+    removeDeletedPlaceholders();
+
+    if ( ! m_spilledBuffers.contains( sampleBuffer.data() ) )
+    {
+        return sampleBuffer;
+    }
+
+    SpilledBuffer& spilledBuffer = m_spilledBuffers[ sampleBuffer.data() ];
+
+    SharedSampleBuffer restoredBuffer = spilledBuffer.restoredBuffer.toStrongRef();
+
+    if ( restoredBuffer.isNull() )
+    {
+        restoredBuffer = m_fileHandler.getSampleData( spilledBuffer.filePath );
+
+        if ( restoredBuffer.isNull() || restoredBuffer->getNumChannels() != sampleBuffer->getNumChannels() )
+        {
+            return SharedSampleBuffer();
+        }
+
+        // The file is removed along with the placeholder
+        spilledBuffer.restoredBuffer = restoredBuffer.toWeakRef();
+    }
+
+    return restoredBuffer;
+}
+
+
+
+qint64 MemoryAccountant::getNumSpilledBytes()
+{
+    removeDeletedPlaceholders();
+
+    qint64 numBytes = 0;
+
+    foreach ( const SpilledBuffer& spilledBuffer, m_spilledBuffers )
+    {
+        // Restored data is counted wherever it's held
+        if ( spilledBuffer.restoredBuffer.isNull() )
+        {
+            numBytes += spilledBuffer.numBytes;
+        }
+    }
+
+    return numBytes;
+}
+
+
+
+qint64 MemoryAccountant::getTempDirNumBytes() const
+{
+    qint64 numBytes = 0;
+
+    if ( ! m_tempDirPath.isEmpty() )
+    {
+        QDirIterator iterator( m_tempDirPath, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories );
+
+        while ( iterator.hasNext() )
+        {
+            iterator.next();
+            numBytes += iterator.fileInfo().size();
+        }
+    }
+
+    return numBytes;
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+QString MemoryAccountant::getCategoryName( const Category category )
+{
+    switch ( category )
+    {
+    case SAMPLES:
+        return QObject::tr( "Samples" );
+    case CLIPBOARD:
+        return QObject::tr( "Clipboard" );
+    case UNDO_HISTORY:
+        return QObject::tr( "Undo History" );
+    case STRETCHER:
+        return QObject::tr( "Time Stretcher" );
+    case WAVEFORM_CACHE:
+        return QObject::tr( "Waveform Cache" );
+    case SPECTROGRAM_CACHE:
+        return QObject::tr( "Spectrogram Cache" );
+    default:
+        return QString();
+    }
+}
+
+
+
+qint64 MemoryAccountant::getNumBytes( const SampleBuffer& sampleBuffer )
+{
+    return static_cast<qint64>( sampleBuffer.getNumChannels() ) * sampleBuffer.getNumFrames() * sizeof( float );
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void MemoryAccountant::removeDeletedPlaceholders()
+{
+    QMutableHashIterator<const SampleBuffer*, SpilledBuffer> iterator( m_spilledBuffers );
+
+    while ( iterator.hasNext() )
+    {
+        iterator.next();
+
+        if ( iterator.value().placeholder.isNull() )
+        {
+            QFile::remove( iterator.value().filePath );
+            iterator.remove();
+        }
+    }
+}
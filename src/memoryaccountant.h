@@ -0,0 +1,140 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef MEMORYACCOUNTANT_H
+#define MEMORYACCOUNTANT_H
+
+#include <QHash>
+#include <QSet>
+#include <QWeakPointer>
+#include <QStringList>
+#include "samplebuffer.h"
+#include "audiofilehandler.h"
+#include "jobscheduler.h"
+#include "JuceHeader.h"
+
+
+// Tallies the memory held by each part of Shuriken and frees some of it when a ceiling is exceeded,
+// by spilling sample data that only the undo history needs into the temp dir.
+// Sample buffers are never changed once they're in use, as other threads may be reading them, so a
+// spilled buffer is swapped for an empty placeholder by whatever held it, and the sample data is freed
+// once nothing else refers to it. restore() must be called on a placeholder before its data is used again
+class MemoryAccountant
+{
+public:
+    enum Category
+    {
+        SAMPLES,            // The slices being edited
+        CLIPBOARD,
+        UNDO_HISTORY,       // Sample data only reachable through the undo stack
+        STRETCHER,          // Time stretch render and real-time stretcher buffers
+        WAVEFORM_CACHE,     // Min/max sample bins used to draw zoomed-out waveforms
+        SPECTROGRAM_CACHE,
+        NUM_CATEGORIES
+    };
+
+    // A tally by category. Each sample buffer is only counted once, in the first category it's added to
+    class Usage
+    {
+    public:
+        Usage();
+
+        void addSampleBuffers( Category category, const QList<SharedSampleBuffer>& sampleBufferList );
+        void addNumBytes( Category category, qint64 numBytes )  { m_numBytes[ category ] += numBytes; }
+
+        qint64 getNumBytes( Category category ) const           { return m_numBytes[ category ]; }
+        qint64 getTotalNumBytes() const;
+
+        qint64 numSpilledBytes;     // Undo data that has been spilled to the temp dir
+        qint64 numTempFileBytes;    // Everything in the temp dir, including spilled undo data
+
+    private:
+        qint64 m_numBytes[ NUM_CATEGORIES ];
+        QSet<const SampleBuffer*> m_countedSampleBuffers;
+    };
+
+    // Writes sample buffers to the temp dir on a JobScheduler worker thread, leaving the buffers untouched
+    class SpillJob : public JobScheduler::Job
+    {
+    public:
+        SpillJob( QList<SharedSampleBuffer> sampleBufferList, QString tempDirPath, QStringList fileBaseNames, int sampleRate );
+
+        void run();
+
+        QList<SharedSampleBuffer> getSampleBufferList() const   { return m_sampleBufferList; }
+
+        // An empty string for each buffer that wasn't written
+        QStringList getFilePaths() const                        { return m_filePaths; }
+
+    private:
+        const QList<SharedSampleBuffer> m_sampleBufferList;
+        const QString m_tempDirPath;
+        const QStringList m_fileBaseNames;
+        const int m_sampleRate;
+        QStringList m_filePaths;
+    };
+
+    static QString getCategoryName( Category category );
+
+    static qint64 getNumBytes( const SampleBuffer& sampleBuffer );
+
+    MemoryAccountant( QString tempDirPath, AudioFileHandler& fileHandler );
+    ~MemoryAccountant();
+
+    // Returns a job that writes the given buffers to the temp dir, or a null pointer if there is no temp dir
+    QSharedPointer<SpillJob> createSpillJob( const QList<SharedSampleBuffer>& sampleBufferList, int sampleRate );
+
+    // Once a spill job has finished, returns an empty placeholder for each buffer that was written, keyed
+    // by the buffer it should be swapped for. Placeholders that are never used are forgotten
+    QHash<const SampleBuffer*, SharedSampleBuffer> takePlaceholders( const SpillJob& job );
+
+    // Read the sample data of a placeholder back in. Buffers that aren't placeholders are returned as they
+    // are. Returns a null pointer if the data couldn't be read, in which case it's kept so that restoring
+    // can be tried again
+    SharedSampleBuffer restore( const SharedSampleBuffer& sampleBuffer );
+
+    qint64 getNumSpilledBytes();
+    qint64 getTempDirNumBytes() const;
+
+private:
+    // Forget placeholders that have since been deleted and remove their files
+    void removeDeletedPlaceholders();
+
+    struct SpilledBuffer
+    {
+        QWeakPointer<SampleBuffer> placeholder;     // Lets deleted placeholders be detected, as their addresses may be reused
+        QWeakPointer<SampleBuffer> restoredBuffer;  // So that a placeholder held in more than one place is only read once
+        QString filePath;
+        qint64 numBytes;
+    };
+
+    const QString m_tempDirPath;
+    AudioFileHandler& m_fileHandler;
+
+    QHash<const SampleBuffer*, SpilledBuffer> m_spilledBuffers;
+    int m_nextFileNum;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( MemoryAccountant );
+};
+
+#endif // MEMORYACCOUNTANT_H
@@ -0,0 +1,312 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "memorylocker.h"
+
+#if JUCE_LINUX || JUCE_MAC
+  #include <sys/mman.h>
+  #include <sys/resource.h>
+  #include <unistd.h>
+#endif
+
+
+//==================================================================================================
+// Private Static:
+
+CriticalSection MemoryLocker::s_entriesLock;
+QHash<const AudioSampleBuffer*, MemoryLocker::Entry> MemoryLocker::s_entries;
+bool MemoryLocker::s_isEnabled = false;
+
+
+
+//==================================================================================================
+// Public Static:
+
+void MemoryLocker::setEnabled( const bool isEnabled )
+{
+    const ScopedLock sl( s_entriesLock );
+
+    if ( isEnabled == s_isEnabled )
+    {
+        return;
+    }
+
+    s_isEnabled = isEnabled;
+
+    for ( QHash<const AudioSampleBuffer*, Entry>::iterator iter = s_entries.begin(); iter != s_entries.end(); ++iter )
+    {
+        if ( isEnabled )
+            lockEntry( *iter );
+        else
+            unlockEntry( *iter );
+    }
+}
+
+
+
+bool MemoryLocker::isEnabled()
+{
+    const ScopedLock sl( s_entriesLock );
+
+    return s_isEnabled;
+}
+
+
+
+void MemoryLocker::lock( const AudioSampleBuffer& buffer )
+{
+    const ScopedLock sl( s_entriesLock );
+
+    if ( s_entries.contains( &buffer ) )
+    {
+        s_entries[ &buffer ].refCount++;
+        return;
+    }
+
+    Entry entry;
+    entry.regions = getRegions( buffer );
+    entry.refCount = 1;
+    entry.isLocked = false;
+
+    if ( s_isEnabled )
+    {
+        lockEntry( entry );
+    }
+
+    s_entries.insert( &buffer, entry );
+}
+
+
+
+void MemoryLocker::unlock( const AudioSampleBuffer& buffer )
+{
+    const ScopedLock sl( s_entriesLock );
+
+    if ( ! s_entries.contains( &buffer ) )
+    {
+        return;
+    }
+
+    Entry& entry = s_entries[ &buffer ];
+
+    if ( --entry.refCount > 0 )
+    {
+        return;
+    }
+
+    // If the buffer has been reallocated since it was locked, its old memory has already been
+    // freed and may now belong to something else, so leave it alone
+    if ( getRegions( buffer ) == entry.regions )
+    {
+        unlockEntry( entry );
+    }
+
+    s_entries.remove( &buffer );
+}
+
+
+
+MemoryLocker::Status MemoryLocker::getStatus()
+{
+    const ScopedLock sl( s_entriesLock );
+
+    Status status;
+    status.numBytesLocked = 0;
+    status.numBytesNotLocked = 0;
+    status.lockLimit = -1;
+
+    if ( s_isEnabled )
+    {
+        foreach ( const Entry& entry, s_entries )
+        {
+            if ( entry.isLocked )
+                status.numBytesLocked += getNumBytes( entry.regions );
+            else
+                status.numBytesNotLocked += getNumBytes( entry.regions );
+        }
+    }
+
+#if JUCE_LINUX || JUCE_MAC
+    struct rlimit limit;
+
+    if ( getrlimit( RLIMIT_MEMLOCK, &limit ) == 0 && limit.rlim_cur != RLIM_INFINITY )
+    {
+        status.lockLimit = static_cast<int64>( limit.rlim_cur );
+    }
+#endif
+
+    return status;
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+size_t MemoryLocker::getPageSize()
+{
+#if JUCE_LINUX || JUCE_MAC
+    static const size_t pageSize = static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+    return pageSize;
+#else
+    return 4096;
+#endif
+}
+
+
+
+QList<MemoryLocker::Region> MemoryLocker::getRegions( const AudioSampleBuffer& buffer )
+{
+    QList<Region> regions;
+
+    const size_t numBytesPerChan = static_cast<size_t>( buffer.getNumSamples() ) * sizeof( float );
+
+    if ( numBytesPerChan == 0 )
+    {
+        return regions;
+    }
+
+    // The channels of a buffer that owns its data are contiguous, so they're merged into one region
+    for ( int chanNum = 0; chanNum < buffer.getNumChannels(); chanNum++ )
+    {
+        char* const start = reinterpret_cast<char*>( const_cast<float*>( buffer.getReadPointer( chanNum ) ) );
+
+        if ( ! regions.isEmpty() && regions.last().start + regions.last().numBytes == start )
+        {
+            regions.last().numBytes += numBytesPerChan;
+        }
+        else
+        {
+            const Region region = { start, numBytesPerChan };
+            regions << region;
+        }
+    }
+
+    return regions;
+}
+
+
+
+size_t MemoryLocker::getNumBytes( const QList<Region>& regions )
+{
+    size_t numBytes = 0;
+
+    foreach ( const Region& region, regions )
+    {
+        numBytes += region.numBytes;
+    }
+
+    return numBytes;
+}
+
+
+
+void MemoryLocker::prefault( const QList<Region>& regions )
+{
+    const size_t pageSize = getPageSize();
+
+    foreach ( const Region& region, regions )
+    {
+        // Reading one byte per page is enough to bring the whole page in
+        volatile char sum = 0;
+
+        for ( size_t offset = 0; offset < region.numBytes; offset += pageSize )
+        {
+            sum += region.start[ offset ];
+        }
+
+        sum += region.start[ region.numBytes - 1 ];
+    }
+}
+
+
+
+bool MemoryLocker::lockRegions( const QList<Region>& regions )
+{
+#if JUCE_LINUX || JUCE_MAC
+    const size_t pageSize = getPageSize();
+
+    for ( int i = 0; i < regions.size(); i++ )
+    {
+        // Round outwards to whole pages, since pages part-filled by the region are read too
+        const size_t start = reinterpret_cast<size_t>( regions.at( i ).start ) & ~( pageSize - 1 );
+        const size_t end = reinterpret_cast<size_t>( regions.at( i ).start ) + regions.at( i ).numBytes;
+
+        if ( mlock( reinterpret_cast<void*>( start ), end - start ) != 0 )
+        {
+            unlockRegions( regions.mid( 0, i ) );
+            return false;
+        }
+    }
+
+    return true;
+#else
+    Q_UNUSED( regions );
+    return false;
+#endif
+}
+
+
+
+void MemoryLocker::unlockRegions( const QList<Region>& regions )
+{
+#if JUCE_LINUX || JUCE_MAC
+    const size_t pageSize = getPageSize();
+
+    foreach ( const Region& region, regions )
+    {
+        // Locks don't nest, so round inwards to avoid unlocking pages shared with a neighbouring
+        // buffer that is still locked. At most two pages per region stay locked until freed
+        const size_t start = ( reinterpret_cast<size_t>( region.start ) + pageSize - 1 ) & ~( pageSize - 1 );
+        const size_t end = ( reinterpret_cast<size_t>( region.start ) + region.numBytes ) & ~( pageSize - 1 );
+
+        if ( end > start )
+        {
+            munlock( reinterpret_cast<void*>( start ), end - start );
+        }
+    }
+#else
+    Q_UNUSED( regions );
+#endif
+}
+
+
+
+void MemoryLocker::lockEntry( Entry& entry )
+{
+    prefault( entry.regions );
+
+    // mlock() fails with ENOMEM or EPERM once RLIMIT_MEMLOCK would be exceeded; the buffer is
+    // still prefaulted, so it's left registered but unlocked
+    entry.isLocked = lockRegions( entry.regions );
+}
+
+
+
+void MemoryLocker::unlockEntry( Entry& entry )
+{
+    if ( entry.isLocked )
+    {
+        unlockRegions( entry.regions );
+        entry.isLocked = false;
+    }
+}
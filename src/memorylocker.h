@@ -0,0 +1,93 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef MEMORYLOCKER_H
+#define MEMORYLOCKER_H
+
+#include <QHash>
+#include <QList>
+#include "JuceHeader.h"
+
+
+// Keeps the sample memory that the audio thread reads resident in RAM, so that the first trigger
+// of a slice that hasn't been touched since loading can't page fault and cause an xrun.
+// Buffers are registered with lock() and unregistered with unlock(). While locking is enabled,
+// every registered buffer is prefaulted and then locked with mlock(), as far as RLIMIT_MEMLOCK
+// allows. A buffer that doesn't fit within the limit is still prefaulted, so the usual case of
+// lazily faulted memory is covered, but it may be swapped out again under memory pressure.
+// All functions are thread safe, but they may block, so they mustn't be called from the audio thread
+
+class MemoryLocker
+{
+public:
+    static void setEnabled( bool isEnabled );
+    static bool isEnabled();
+
+    // Calls may be nested; a buffer stays registered until unlock() has been called as many times
+    // as lock(). A buffer that's resized while registered must be unlocked and locked again
+    static void lock( const AudioSampleBuffer& buffer );
+    static void unlock( const AudioSampleBuffer& buffer );
+
+    struct Status
+    {
+        int64 numBytesLocked;
+        int64 numBytesNotLocked;    // Prefaulted only, because the lock limit was reached
+        int64 lockLimit;            // -1 if there is no limit
+    };
+
+    static Status getStatus();
+
+private:
+    struct Region
+    {
+        char* start;
+        size_t numBytes;
+
+        bool operator==( const Region& other ) const    { return start == other.start && numBytes == other.numBytes; }
+    };
+
+    struct Entry
+    {
+        QList<Region> regions;
+        int refCount;
+        bool isLocked;
+    };
+
+    static size_t getPageSize();
+
+    static QList<Region> getRegions( const AudioSampleBuffer& buffer );
+    static size_t getNumBytes( const QList<Region>& regions );
+
+    static void prefault( const QList<Region>& regions );
+    static bool lockRegions( const QList<Region>& regions );
+    static void unlockRegions( const QList<Region>& regions );
+
+    static void lockEntry( Entry& entry );
+    static void unlockEntry( Entry& entry );
+
+    // Registered buffers, and whether locking is enabled. Guarded by s_entriesLock
+    static CriticalSection s_entriesLock;
+    static QHash<const AudioSampleBuffer*, Entry> s_entries;
+    static bool s_isEnabled;
+};
+
+#endif // MEMORYLOCKER_H
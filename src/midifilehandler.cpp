@@ -44,6 +44,12 @@ bool MidiFileHandler::SaveMidiFile( const QString fileBaseName,
     Q_ASSERT( sampleRate > 0.0 );
     Q_ASSERT( bpm > 0.0 );
 
+    // Every slice needs a key of its own; leaving some out would silently shorten the sequence
+    if ( numSampleBuffers > Midi::NUM_KEYS )
+    {
+        return false;
+    }
+
     const QString filePath = QDir( outputDirPath ).absoluteFilePath( fileBaseName + getFileExtension() );
 
     File file( filePath.toLocal8Bit().data() );
@@ -76,13 +82,12 @@ bool MidiFileHandler::SaveMidiFile( const QString fileBaseName,
         midiSeq.clear();
     }
 
-    midiSeq.addEvent( MidiMessage::midiChannelMetaEvent( chanNum ) );
+    // The same keys as the sampler, so slices beyond the first 128 are on channels 2 and above
+    const int startKeyNum = Midi::getStartKeyNum( numSampleBuffers );
 
-    int startNote = Midi::MIDDLE_C;
-
-    if ( numSampleBuffers > Midi::MAX_POLYPHONY - Midi::MIDDLE_C )
+    if ( numSampleBuffers <= Midi::NUM_NOTES )
     {
-        startNote = qMax( Midi::MAX_POLYPHONY - numSampleBuffers, 0 );
+        midiSeq.addEvent( MidiMessage::midiChannelMetaEvent( chanNum ) );
     }
 
     const qreal secondsPerTick = ( SECONDS_PER_MINUTE / bpm ) / TICKS_PER_QUART_NOTE;
@@ -91,22 +96,24 @@ bool MidiFileHandler::SaveMidiFile( const QString fileBaseName,
     qreal noteStart = 0.0;
     int i = 0;
 
-    while (  i < numSampleBuffers && i < Midi::MAX_POLYPHONY )
+    while ( i < numSampleBuffers )
     {
+        const int keyNum = startKeyNum + i;
         const qreal noteLength = ( sampleBufferList.at( i )->getNumFrames() / sampleRate ) / secondsPerTick;
 
-        midiSeq.addEvent( MidiMessage::noteOn( chanNum, startNote + i, velocity ),
+        midiSeq.addEvent( MidiMessage::noteOn( Midi::getChannel( keyNum ), Midi::getNoteNum( keyNum ), velocity ),
                           roundToIntAccurate( noteStart ) );
 
-        midiSeq.addEvent( MidiMessage::noteOff( chanNum, startNote + i ),
+        midiSeq.addEvent( MidiMessage::noteOff( Midi::getChannel( keyNum ), Midi::getNoteNum( keyNum ) ),
                           roundToIntAccurate( noteStart + noteLength ) );
 
-        midiSeq.updateMatchedPairs();
-
         noteStart += noteLength;
         i++;
     }
 
+    // Matching takes time proportional to the square of the no. of events, so it's done once
+    midiSeq.updateMatchedPairs();
+
     midiSeq.addEvent( MidiMessage::endOfTrack(), midiSeq.getEndTime() );
 
     midiFile.addTrack( midiSeq );
@@ -32,6 +32,8 @@ class MidiFileHandler
 public:
     enum MidiFileType { MIDI_FILE_TYPE_0 = 0, MIDI_FILE_TYPE_1 = 1 };
 
+    // Slices are on the same keys as in the sampler. Returns false without writing anything if
+    // "numSampleBuffers" is more than Midi::NUM_KEYS or the file exists and can't be overwritten
     static bool SaveMidiFile( QString fileBaseName,
                               QString outputDirPath,
                               QList<SharedSampleBuffer> sampleBufferList,
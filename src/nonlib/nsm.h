@@ -150,6 +150,20 @@ nsm_get_session_manager_name ( nsm_client_t *nsm )
     return _NSM()->_session_manager_name;
 }
 
+/* Not part of upstream nsm.h: the socket that the OSC server receives NSM messages on, so that
+   it can be watched with select() or a QSocketNotifier instead of being polled. This is the
+   only place outside this file that needs to know about the client's internals. Returns -1 if
+   nsm_init() hasn't succeeded */
+NSM_EXPORT
+int
+nsm_get_socket_fd ( nsm_client_t *nsm )
+{
+    if ( ! _NSM()->_server )
+        return -1;
+
+    return lo_server_get_socket_fd( _NSM()->_server );
+}
+
 NSM_EXPORT
 nsm_client_t *
 nsm_new ( void )
@@ -21,8 +21,10 @@
 */
 
 #include "nsmlistenerthread.h"
-#include <QTimer>
+#include <QSocketNotifier>
 #include <QApplication>
+#include <QMutexLocker>
+#include <cstring>
 //#include <QtDebug>
 
 
@@ -30,7 +32,10 @@
 // Public:
 
 NsmListenerThread::NsmListenerThread() :
-    m_nsmClient( NULL )
+    m_nsmClient( NULL ),
+    m_projectSaver( NULL ),
+    m_isProjectLoading( false ),
+    m_hasLoadFailed( false )
 {
     const char* nsmUrl = getenv( "NSM_URL" );
 
@@ -93,25 +98,53 @@ void NsmListenerThread::sendMessage( const Message message )
 
 
 
+void NsmListenerThread::sendProgress( const float progress )
+{
+    if ( m_nsmClient != NULL )
+    {
+        nsm_send_progress( m_nsmClient, progress );
+    }
+}
+
+
+
+void NsmListenerThread::projectLoadStarted()
+{
+    QMutexLocker locker( &m_loadMutex );
+
+    m_isProjectLoading = true;
+    m_hasLoadFailed = false;
+}
+
+
+
+void NsmListenerThread::projectLoadFinished( const bool isSuccessful )
+{
+    QMutexLocker locker( &m_loadMutex );
+
+    m_isProjectLoading = false;
+    m_hasLoadFailed = ! isSuccessful;
+    m_loadFinished.wakeAll();
+}
+
+
+
 //==================================================================================================
 // Protected:
 
 void NsmListenerThread::run()
 {
-    QTimer timer;
+    ScopedPointer<QSocketNotifier> notifier;
 
-    if ( m_nsmClient != NULL )
+    // Only check for messages when the OSC server's socket has something to read
+    if ( m_nsmClient != NULL && nsm_get_socket_fd( m_nsmClient ) >= 0 )
     {
-        connect( &timer, SIGNAL(timeout()), this, SLOT(checkForMessages()), Qt::DirectConnection );
-        timer.start( 100 );
+        notifier = new QSocketNotifier( nsm_get_socket_fd( m_nsmClient ), QSocketNotifier::Read );
+
+        connect( notifier, SIGNAL( activated(int) ), this, SLOT( checkForMessages() ), Qt::DirectConnection );
     }
 
     exec();
-
-    if ( m_nsmClient != NULL )
-    {
-        timer.stop();
-    }
 }
 
 
@@ -140,8 +173,44 @@ int NsmListenerThread::saveCallback( char** outMessage, void* userData )
 {
     NsmListenerThread* listenerThread = static_cast<NsmListenerThread*>( userData );
 
+    // Saving now would store an empty project in place of the one being loaded
+    {
+        QMutexLocker locker( &listenerThread->m_loadMutex );
+
+        const bool isWaitingForLoad = listenerThread->m_isProjectLoading;
+
+        while ( listenerThread->m_isProjectLoading )
+        {
+            listenerThread->m_loadFinished.wait( &listenerThread->m_loadMutex );
+        }
+
+        if ( isWaitingForLoad && listenerThread->m_hasLoadFailed )
+        {
+            *outMessage = strdup( "The project could not be loaded so there is nothing to save" );
+            return ERR_GENERAL;
+        }
+    }
+
+    // The save slot only queues a snapshot of the project, so wait here for it to reach the disk.
+    // Only the save requested here counts; earlier failures have already been reported
+    ProjectSaver* const projectSaver = listenerThread->m_projectSaver;
+    const int lastSaveId = projectSaver != NULL ? projectSaver->getLastSaveId() : -1;
+
     emit listenerThread->save();
 
+    if ( projectSaver != NULL )
+    {
+        const int saveId = projectSaver->getLastSaveId();
+
+        QString errorInfo;
+
+        if ( saveId != lastSaveId && ! projectSaver->waitForSave( saveId, errorInfo ) )
+        {
+            *outMessage = strdup( errorInfo.toLocal8Bit().data() );
+            return ERR_GENERAL;
+        }
+    }
+
     return ERR_OK;
 }
 
@@ -24,7 +24,10 @@
 #define NSMLISTENERTHREAD_H
 
 #include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 #include "nonlib/nsm.h"
+#include "projectsaver.h"
 #include "JuceHeader.h"
 
 
@@ -42,17 +45,34 @@ public:
     enum Message { MSG_IS_CLEAN, MSG_IS_DIRTY };
     void sendMessage( Message message );
 
+    // Report how far the project has got loading, from 0.0 to 1.0
+    void sendProgress( float progress );
+
+    // If set, NSM save requests are only acknowledged once the project saver has finished writing
+    void setProjectSaver( ProjectSaver* projectSaver )  { m_projectSaver = projectSaver; }
+
+    // While a project is loading in the background, NSM save requests wait for it to finish. If
+    // the load fails the waiting requests are answered with an error, as there is nothing to save
+    void projectLoadStarted();
+    void projectLoadFinished( bool isSuccessful );
+
 protected:
     void run();
 
 private:
     nsm_client_t* m_nsmClient;
+    ProjectSaver* m_projectSaver;
 
     QString m_clientId;
     QString m_savePath;
 
     bool m_isOpenComplete;
 
+    QMutex m_loadMutex;
+    QWaitCondition m_loadFinished;
+    bool m_isProjectLoading;
+    bool m_hasLoadFailed;
+
 private:
     static int openCallback( const char* savePath,
                              const char* displayName,
@@ -21,6 +21,7 @@
 */
 
 #include "offlinetimestretcher.h"
+#include <QObject>
 #include <unistd.h>
 
 
@@ -32,7 +33,8 @@ int OfflineTimeStretcher::stretch( const SharedSampleBuffer sampleBuffer,
                                    const int numChans,
                                    RubberBandStretcher::Options options,
                                    const qreal timeRatio,
-                                   const qreal pitchScale )
+                                   const qreal pitchScale,
+                                   RenderJob* const job )
 {
     RubberBandStretcher stretcher( sampleRate, numChans, options, timeRatio, pitchScale );
 
@@ -40,7 +42,10 @@ int OfflineTimeStretcher::stretch( const SharedSampleBuffer sampleBuffer,
     SharedSampleBuffer tempBuffer( new SampleBuffer( *sampleBuffer.data() ) );
 
     const int origNumFrames = tempBuffer->getNumFrames();
-    const int newBufferSize = roundToIntAccurate( origNumFrames * timeRatio );
+
+    jassert( getStretchedNumFrames( origNumFrames, timeRatio ) <= MAX_NUM_FRAMES );
+
+    const int newBufferSize = static_cast<int>( getStretchedNumFrames( origNumFrames, timeRatio ) );
 
     const float** inFloatBuffer = new const float*[ numChans ];
     float** outFloatBuffer = new float*[ numChans ];
@@ -102,11 +107,17 @@ int OfflineTimeStretcher::stretch( const SharedSampleBuffer sampleBuffer,
             inFloatBuffer[ chanNum ] += numFramesToProcess;
         }
         inFrameNum += numFramesToProcess;
+
+        if ( job != NULL && ! job->addNumFramesProcessed( numFramesToProcess ) )
+        {
+            break;
+        }
     }
 
     int numAvailable;
 
-    while ( (numAvailable = stretcher.available()) >= 0 )
+    // The remaining output only becomes available once the final block has been processed
+    while ( inFrameNum == origNumFrames && (numAvailable = stretcher.available()) >= 0 )
     {
         if ( numAvailable > 0 )
         {
@@ -148,3 +159,186 @@ int OfflineTimeStretcher::stretch( const SharedSampleBuffer sampleBuffer,
 
     return totalNumFramesRetrieved;
 }
+
+
+
+void OfflineTimeStretcher::stretchPreview( const SharedSampleBuffer sampleBuffer,
+                                          const int sampleRate,
+                                          const int numChans,
+                                          RubberBandStretcher::Options options,
+                                          const qreal timeRatio,
+                                          const qreal pitchScale )
+{
+    const int origNumFrames = sampleBuffer->getNumFrames();
+
+    jassert( getStretchedNumFrames( origNumFrames, timeRatio ) <= MAX_NUM_FRAMES );
+
+    const int newNumFrames = static_cast<int>( getStretchedNumFrames( origNumFrames, timeRatio ) );
+
+    // Without pitch correction a time stretch is the same as playing back at a different speed
+    if ( qFuzzyCompare( timeRatio * pitchScale, 1.0 ) )
+    {
+        const qreal speedRatio = 1.0 / timeRatio;
+
+        // The interpolator can read a few frames past the end of the input
+        const int numPaddingFrames = static_cast<int>( std::ceil( speedRatio ) ) + 8;
+
+        SampleBuffer tempBuffer( numChans, origNumFrames + numPaddingFrames );
+        tempBuffer.clear();
+
+        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+        {
+            tempBuffer.copyFrom( chanNum, 0, *sampleBuffer.data(), chanNum, 0, origNumFrames );
+        }
+
+        sampleBuffer->setSize( numChans, newNumFrames );
+
+        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+        {
+            LagrangeInterpolator interpolator;
+
+            interpolator.process( speedRatio,
+                                  tempBuffer.getReadPointer( chanNum ),
+                                  sampleBuffer->getWritePointer( chanNum ),
+                                  newNumFrames );
+        }
+    }
+    else
+    {
+        options &= ~( RubberBandStretcher::OptionProcessRealTime |
+                      RubberBandStretcher::OptionWindowLong |
+                      RubberBandStretcher::OptionPitchHighQuality |
+                      RubberBandStretcher::OptionPitchHighConsistency );
+
+        options |= RubberBandStretcher::OptionWindowShort | RubberBandStretcher::OptionPhaseIndependent;
+
+        stretch( sampleBuffer, sampleRate, numChans, options, timeRatio, pitchScale );
+
+        setNumFrames( sampleBuffer, numChans, newNumFrames );
+    }
+}
+
+
+
+FrameNum OfflineTimeStretcher::getStretchedNumFrames( const int numFrames, const qreal timeRatio )
+{
+    return roundToFrameNum( numFrames * timeRatio );
+}
+
+
+
+bool OfflineTimeStretcher::canStretch( const QList<SharedSampleBuffer> sampleBufferList,
+                                       const QList<qreal> timeRatioList,
+                                       QString& errorInfo )
+{
+    for ( int i = 0; i < sampleBufferList.size(); i++ )
+    {
+        const FrameNum newNumFrames = getStretchedNumFrames( sampleBufferList.at( i )->getNumFrames(), timeRatioList.at( i ) );
+
+        if ( newNumFrames > MAX_NUM_FRAMES )
+        {
+            errorInfo = QObject::tr( "Stretched by this much the audio would be " ) + QString::number( newNumFrames ) +
+                        QObject::tr( " frames long, but no more than " ) + QString::number( MAX_NUM_FRAMES ) +
+                        QObject::tr( " frames can be held in a single sample buffer" );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+//==================================================================================================
+// Public:
+
+OfflineTimeStretcher::RenderJob::RenderJob( const QList<SharedSampleBuffer> sampleBufferList,
+                                            const int sampleRate,
+                                            const int numChans,
+                                            const RubberBandStretcher::Options options,
+                                            const QList<qreal> timeRatioList,
+                                            const qreal pitchScale,
+                                            const Quality quality ) :
+    JobScheduler::Job(),
+    m_sampleRate( sampleRate ),
+    m_numChans( numChans ),
+    m_options( options ),
+    m_timeRatioList( timeRatioList ),
+    m_pitchScale( pitchScale ),
+    m_quality( quality ),
+    m_totalNumFrames( 0 ),
+    m_numFramesProcessed( 0 )
+{
+    // Work on copies so the originals can go on being played and edited meanwhile
+    foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
+    {
+        m_sampleBufferList << SharedSampleBuffer( new SampleBuffer( *sampleBuffer.data() ) );
+        m_totalNumFrames += sampleBuffer->getNumFrames();
+    }
+}
+
+
+
+void OfflineTimeStretcher::RenderJob::run()
+{
+    for ( int i = 0; i < m_sampleBufferList.size() && ! isCancelled(); i++ )
+    {
+        const SharedSampleBuffer sampleBuffer = m_sampleBufferList.at( i );
+        const qreal timeRatio = m_timeRatioList.at( i );
+
+        if ( m_quality == QUALITY_PREVIEW )
+        {
+            const int numFrames = sampleBuffer->getNumFrames();
+
+            stretchPreview( sampleBuffer, m_sampleRate, m_numChans, m_options, timeRatio, m_pitchScale );
+
+            addNumFramesProcessed( numFrames );
+        }
+        else
+        {
+            const int newNumFrames = static_cast<int>( getStretchedNumFrames( sampleBuffer->getNumFrames(), timeRatio ) );
+
+            stretch( sampleBuffer, m_sampleRate, m_numChans, m_options, timeRatio, m_pitchScale, this );
+
+            setNumFrames( sampleBuffer, m_numChans, newNumFrames );
+        }
+    }
+
+    if ( ! isCancelled() )
+    {
+        m_isComplete = 1;
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+bool OfflineTimeStretcher::RenderJob::addNumFramesProcessed( const int numFrames )
+{
+    m_numFramesProcessed += numFrames;
+
+    if ( m_totalNumFrames > 0 )
+    {
+        setProgress( static_cast<int>( m_numFramesProcessed * 100 / m_totalNumFrames ) );
+    }
+
+    return ! isCancelled();
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+void OfflineTimeStretcher::setNumFrames( const SharedSampleBuffer sampleBuffer, const int numChans, const int numFrames )
+{
+    if ( sampleBuffer->getNumFrames() != numFrames )
+    {
+        sampleBuffer->setSize( numChans,    // No. of channels
+                               numFrames,   // New no. of frames
+                               true,        // Keep existing content
+                               true );      // Clear any extra space
+    }
+}
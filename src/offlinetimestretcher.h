@@ -24,6 +24,10 @@
 #define OFFLINETIMESTRETCHER_H
 
 #include "samplebuffer.h"
+#include "jobscheduler.h"
+#include <QList>
+#include <QString>
+#include <limits>
 #include <rubberband/RubberBandStretcher.h>
 
 using namespace RubberBand;
@@ -32,12 +36,82 @@ using namespace RubberBand;
 class OfflineTimeStretcher
 {
 public:
+    class RenderJob;
+
+    // If "job" is given, progress is reported to it and stretching stops early if it's cancelled
     static int stretch( SharedSampleBuffer sampleBuffer,
                         int sampleRate,
                         int numChans,
                         RubberBandStretcher::Options options,
                         qreal timeRatio,
-                        qreal pitchScale );
+                        qreal pitchScale,
+                        RenderJob* job = NULL );
+
+    // A much quicker, lower quality version of stretch() to be heard while RenderJob is running.
+    // If the pitch follows the speed the audio is simply resampled, otherwise Rubber Band is used
+    // with its cheapest settings. The result is exactly getStretchedNumFrames() long
+    static void stretchPreview( SharedSampleBuffer sampleBuffer,
+                                int sampleRate,
+                                int numChans,
+                                RubberBandStretcher::Options options,
+                                qreal timeRatio,
+                                qreal pitchScale );
+
+    // The stretched length can exceed what a single sample buffer is able to hold
+    static FrameNum getStretchedNumFrames( int numFrames, qreal timeRatio );
+
+    // Returns false and sets "errorInfo" if any buffer would be too long for a sample buffer once
+    // stretched by its time ratio. Should be checked before calling any of the above
+    static bool canStretch( QList<SharedSampleBuffer> sampleBufferList,
+                            QList<qreal> timeRatioList,
+                            QString& errorInfo );
+
+    static const int MAX_NUM_FRAMES = std::numeric_limits<int>::max();
+
+    // Stretches copies of a list of sample buffers on a JobScheduler worker thread, either as quick
+    // previews or at full quality. Each full quality result is trimmed or padded to the same length
+    // as the preview it's going to replace. The results aren't modified once the job has finished
+    class RenderJob : public JobScheduler::Job
+    {
+    public:
+        enum Quality { QUALITY_PREVIEW, QUALITY_FULL };
+
+        RenderJob( QList<SharedSampleBuffer> sampleBufferList,
+                   int sampleRate,
+                   int numChans,
+                   RubberBandStretcher::Options options,
+                   QList<qreal> timeRatioList,
+                   qreal pitchScale,
+                   Quality quality = QUALITY_FULL );
+
+        void run();
+
+        // True once every buffer has been stretched, i.e. the job finished without being cancelled
+        bool isComplete() const                                     { return m_isComplete.get() != 0; }
+
+        QList<SharedSampleBuffer> getSampleBufferList() const     { return m_sampleBufferList; }
+
+    private:
+        friend class OfflineTimeStretcher;
+
+        // Returns false if the job has been cancelled
+        bool addNumFramesProcessed( int numFrames );
+
+        QList<SharedSampleBuffer> m_sampleBufferList;
+        const int m_sampleRate;
+        const int m_numChans;
+        const RubberBandStretcher::Options m_options;
+        const QList<qreal> m_timeRatioList;
+        const qreal m_pitchScale;
+        const Quality m_quality;
+
+        Atomic<int> m_isComplete;
+        qint64 m_totalNumFrames;
+        qint64 m_numFramesProcessed;
+    };
+
+private:
+    static void setNumFrames( SharedSampleBuffer sampleBuffer, int numChans, int numFrames );
 };
 
 
@@ -25,6 +25,7 @@
 #include "globals.h"
 #include "messageboxes.h"
 #include "textfilehandler.h"
+#include "memorylocker.h"
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QProcessEnvironment>
@@ -228,6 +229,48 @@ void OptionsDialog::enableJackSync()
 
 
 
+bool OptionsDialog::isAdaptiveQualityEnabled() const
+{
+    return m_ui->checkBox_AdaptiveQuality->isChecked();
+}
+
+
+
+int OptionsDialog::getVoiceLimit() const
+{
+    return m_ui->spinBox_VoiceLimit->value();
+}
+
+
+
+int OptionsDialog::getMemoryCeilingMB() const
+{
+    return m_ui->spinBox_MemoryCeiling->value();
+}
+
+
+
+OptionsDialog::Renderer OptionsDialog::getRenderer() const
+{
+    return static_cast<Renderer>( m_ui->comboBox_Renderer->currentIndex() );
+}
+
+
+
+void OptionsDialog::setRendererStatus( const bool isOpenGLEnabled, const qreal averageFrameTimeMs )
+{
+    QString text = isOpenGLEnabled ? tr( "Using OpenGL" ) : tr( "Using the software renderer" );
+
+    if ( averageFrameTimeMs > 0.0 )
+    {
+        text += tr( "; %1 ms per frame" ).arg( averageFrameTimeMs, 0, 'f', 2 );
+    }
+
+    m_ui->label_RendererStatus->setText( text );
+}
+
+
+
 bool OptionsDialog::isJackAudioEnabled() const
 {
     return ( m_deviceManager.getCurrentAudioDeviceType() == "JACK" );
@@ -271,6 +314,8 @@ void OptionsDialog::showEvent( QShowEvent* event )
         {
             setUpMidiInputTestSynth();
         }
+
+        updateLockedMemoryStatus();
     }
 
     QDialog::showEvent( event );
@@ -619,6 +664,35 @@ void OptionsDialog::disableStretcherOptions( const RubberBandStretcher::Options
 
 
 
+void OptionsDialog::updateLockedMemoryStatus()
+{
+    QString text;
+
+    if ( MemoryLocker::isEnabled() )
+    {
+        const MemoryLocker::Status status = MemoryLocker::getStatus();
+        const qreal bytesPerMB = 1024.0 * 1024.0;
+
+        text = tr( "%1 MB locked" ).arg( status.numBytesLocked / bytesPerMB, 0, 'f', 1 );
+
+        if ( status.numBytesNotLocked > 0 )
+        {
+            text += tr( "; %1 MB could not be locked" ).arg( status.numBytesNotLocked / bytesPerMB, 0, 'f', 1 );
+
+            if ( status.lockLimit >= 0 )
+            {
+                text += tr( " (the memory lock limit is %1 MB)" ).arg( status.lockLimit / bytesPerMB, 0, 'f', 1 );
+            }
+
+            text += tr( ". It has been paged in, but may be swapped out again" );
+        }
+    }
+
+    m_ui->label_LockedMemoryStatus->setText( text );
+}
+
+
+
 void OptionsDialog::saveConfig()
 {
     // Save audio setup config
@@ -975,6 +1049,21 @@ void OptionsDialog::on_checkBox_MidiInputTestTone_clicked( const bool isChecked
 
 
 
+void OptionsDialog::on_checkBox_LockMemory_toggled( const bool isChecked )
+{
+    MemoryLocker::setEnabled( isChecked );
+    updateLockedMemoryStatus();
+}
+
+
+
+void OptionsDialog::on_spinBox_VoiceLimit_valueChanged( const int maxNumVoices )
+{
+    emit voiceLimitChanged( maxNumVoices );
+}
+
+
+
 //====================
 // "Time Stretch" tab:
 
@@ -995,6 +1084,9 @@ void OptionsDialog::on_radioButton_Offline_clicked()
     m_ui->checkBox_JackSync->setEnabled( false );
     m_ui->checkBox_JackSync->setChecked( false );
 
+    m_ui->checkBox_AdaptiveQuality->setEnabled( false );
+    m_ui->checkBox_AdaptiveQuality->setChecked( false );
+
     disableStretcherOptions( RubberBandStretcher::OptionProcessRealTime );
     disableStretcherOptions( RubberBandStretcher::OptionStretchPrecise );
     disableStretcherOptions( RubberBandStretcher::OptionPitchHighConsistency );
@@ -1029,6 +1121,8 @@ void OptionsDialog::on_radioButton_RealTime_clicked()
         m_ui->checkBox_JackSync->setChecked( false );
     }
 
+    m_ui->checkBox_AdaptiveQuality->setEnabled( true );
+
     enableStretcherOptions( RubberBandStretcher::OptionProcessRealTime );
     enableStretcherOptions( RubberBandStretcher::OptionStretchPrecise );
     enableStretcherOptions( RubberBandStretcher::OptionPitchHighConsistency );
@@ -1188,6 +1282,13 @@ void OptionsDialog::on_checkBox_JackSync_toggled( const bool isChecked )
 
 
 
+void OptionsDialog::on_checkBox_AdaptiveQuality_toggled( const bool isChecked )
+{
+    emit adaptiveQualityToggled( isChecked );
+}
+
+
+
 //====================
 // "Paths" tab:
 
@@ -1198,3 +1299,19 @@ void OptionsDialog::on_pushButton_ChooseTempDir_clicked()
 
     m_ui->lineEdit_TempDir->setText( dir );
 }
+
+
+
+void OptionsDialog::on_spinBox_MemoryCeiling_valueChanged( const int numMegabytes )
+{
+    emit memoryCeilingChanged( numMegabytes );
+}
+
+
+
+void OptionsDialog::on_comboBox_Renderer_activated( const int index )
+{
+    Q_UNUSED( index );
+
+    emit rendererChanged();
+}
@@ -46,6 +46,7 @@ class OptionsDialog : public QDialog
 
 public:
     enum Tab { AUDIO_SETUP_TAB = 0, TIME_STRETCH_TAB = 1, PATHS_TAB = 2 };
+    enum Renderer { AUTOMATIC_RENDERER = 0, OPENGL_RENDERER = 1, SOFTWARE_RENDERER = 2 };
     
     OptionsDialog( AudioDeviceManager& deviceManager, QWidget* parent = NULL );
     ~OptionsDialog();
@@ -66,12 +67,25 @@ public:
     bool isJackSyncEnabled() const;
     void enableJackSync();
 
+    bool isAdaptiveQualityEnabled() const;
+
+    // 0 means no limit
+    int getVoiceLimit() const;
+
     bool isJackAudioEnabled() const;
 
     // Returns the absolute path of the user-defined temp directory if
     // it is valid and writable, otherwise returns an empty string
     QString getTempDirPath() const                              { return m_tempDirPath; }
 
+    // 0 means no ceiling
+    int getMemoryCeilingMB() const;
+
+    Renderer getRenderer() const;
+
+    // Show which renderer the waveform view is using and how long it takes to paint
+    void setRendererStatus( bool isOpenGLEnabled, qreal averageFrameTimeMs );
+
 protected:
     void changeEvent( QEvent* event );
     void showEvent( QShowEvent* event );
@@ -93,6 +107,8 @@ private:
     void enableStretcherOptions( RubberBandStretcher::Options options );
     void disableStretcherOptions( RubberBandStretcher::Options options );
 
+    void updateLockedMemoryStatus();
+
     void saveConfig();
 
     Ui::OptionsDialog* m_ui;
@@ -124,12 +140,19 @@ signals:
     void formantOptionChanged( RubberBandStretcher::Options option );
     void pitchOptionChanged( RubberBandStretcher::Options option );
     void jackSyncToggled( bool isEnabled );
+    void adaptiveQualityToggled( bool isEnabled );
+    void voiceLimitChanged( int maxNumVoices );
     void jackAudioEnabled( bool isEnabled );
     void audioDeviceChanged();
+    void memoryCeilingChanged( int numMegabytes );
+    void rendererChanged();
 
 private slots:
     void on_pushButton_ChooseTempDir_clicked();
+    void on_spinBox_MemoryCeiling_valueChanged( int numMegabytes );
+    void on_comboBox_Renderer_activated( int index );
     void on_checkBox_JackSync_toggled( bool isChecked );
+    void on_checkBox_AdaptiveQuality_toggled( bool isChecked );
     void on_radioButton_HighConsistency_clicked();
     void on_radioButton_HighQuality_clicked();
     void on_radioButton_HighSpeed_clicked();
@@ -147,6 +170,8 @@ private slots:
     void on_radioButton_Elastic_clicked();
     void on_radioButton_Offline_clicked();
     void on_radioButton_RealTime_clicked();
+    void on_checkBox_LockMemory_toggled( bool isChecked );
+    void on_spinBox_VoiceLimit_valueChanged( int maxNumVoices );
     void on_checkBox_MidiInputTestTone_clicked( bool isChecked );
     void on_listWidget_MidiInput_itemClicked( QListWidgetItem* item );
     void on_comboBox_BufferSize_activated( int index );
@@ -0,0 +1,164 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "previewplayer.h"
+
+
+//==================================================================================================
+// Public:
+
+PreviewPlayer::PreviewPlayer( AudioDeviceManager& deviceManager ) :
+    m_deviceManager( deviceManager ),
+    m_readAheadThread( "Preview read-ahead" )
+{
+    m_readAheadThread.startThread();
+
+    m_sourcePlayer.setSource( &m_transportSource );
+    m_deviceManager.addAudioCallback( &m_sourcePlayer );
+}
+
+
+
+PreviewPlayer::~PreviewPlayer()
+{
+    m_deviceManager.removeAudioCallback( &m_sourcePlayer );
+    m_sourcePlayer.setSource( NULL );
+
+    stop();
+
+    m_readAheadThread.stopThread( 1000 );
+}
+
+
+
+bool PreviewPlayer::play( const QString filePath )
+{
+    stop();
+
+    ScopedPointer<FileSource> fileSource( new FileSource() );
+
+    if ( ! fileSource->open( filePath ) )
+    {
+        return false;
+    }
+
+    m_fileSource = fileSource.release();
+
+    m_transportSource.setSource( m_fileSource,
+                                 READ_AHEAD_SIZE,
+                                 &m_readAheadThread,
+                                 m_fileSource->getSampleRate(),
+                                 MAX_NUM_CHANNELS );
+    m_transportSource.start();
+
+    return true;
+}
+
+
+
+void PreviewPlayer::stop()
+{
+    m_transportSource.stop();
+
+    // The transport source must let go of the file source before it's deleted
+    m_transportSource.setSource( NULL );
+    m_fileSource = NULL;
+}
+
+
+
+//==================================================================================================
+// Private:
+
+PreviewPlayer::FileSource::FileSource() :
+    PositionableAudioSource(),
+    m_nextReadPos( 0 ),
+    m_readerPos( 0 )
+{
+}
+
+
+
+bool PreviewPlayer::FileSource::open( const QString filePath )
+{
+    m_nextReadPos = 0;
+    m_readerPos = 0;
+
+    return m_reader.open( filePath );
+}
+
+
+
+void PreviewPlayer::FileSource::prepareToPlay( int /*samplesPerBlockExpected*/, double /*sampleRate*/ )
+{
+}
+
+
+
+void PreviewPlayer::FileSource::releaseResources()
+{
+}
+
+
+
+void PreviewPlayer::FileSource::getNextAudioBlock( const AudioSourceChannelInfo& bufferToFill )
+{
+    AudioSampleBuffer& buffer = *bufferToFill.buffer;
+    const int numFileChans = m_reader.getNumChannels();
+    int numFramesRead = 0;
+
+    if ( buffer.getNumChannels() >= numFileChans )
+    {
+        if ( m_readerPos != m_nextReadPos )
+        {
+            m_readerPos = m_reader.seek( m_nextReadPos ) ? m_nextReadPos : -1;
+        }
+
+        if ( m_readerPos >= 0 )
+        {
+            numFramesRead = m_reader.read( buffer, bufferToFill.startSample, bufferToFill.numSamples );
+            m_readerPos += numFramesRead;
+        }
+    }
+
+    // Silence after the end of the file
+    for ( int chanNum = 0; chanNum < numFileChans && chanNum < buffer.getNumChannels(); chanNum++ )
+    {
+        buffer.clear( chanNum, bufferToFill.startSample + numFramesRead, bufferToFill.numSamples - numFramesRead );
+    }
+
+    // Play mono files through every channel
+    for ( int chanNum = numFileChans; chanNum < buffer.getNumChannels(); chanNum++ )
+    {
+        buffer.copyFrom( chanNum, bufferToFill.startSample, buffer, 0, bufferToFill.startSample, bufferToFill.numSamples );
+    }
+
+    m_nextReadPos += bufferToFill.numSamples;
+}
+
+
+
+void PreviewPlayer::FileSource::setNextReadPosition( const int64 newPosition )
+{
+    m_nextReadPos = newPosition;
+}
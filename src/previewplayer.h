@@ -0,0 +1,83 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef PREVIEWPLAYER_H
+#define PREVIEWPLAYER_H
+
+#include <QString>
+#include "JuceHeader.h"
+#include "audiofilereader.h"
+
+
+// Auditions an audio file straight from disk without loading it. A background thread reads ahead of the
+// audio callback and the file is resampled to the device's sample rate
+class PreviewPlayer
+{
+public:
+    PreviewPlayer( AudioDeviceManager& deviceManager );
+    ~PreviewPlayer();
+
+    // Stops any file that's already playing. Returns false if the file can't be read
+    bool play( QString filePath );
+    void stop();
+
+    bool isPlaying() const                  { return m_transportSource.isPlaying(); }
+
+private:
+    static const int READ_AHEAD_SIZE = 32768;
+    static const int MAX_NUM_CHANNELS = 2;
+
+    class FileSource : public PositionableAudioSource
+    {
+    public:
+        FileSource();
+
+        bool open( QString filePath );
+        int getSampleRate() const           { return m_reader.getSampleRate(); }
+
+        void prepareToPlay( int samplesPerBlockExpected, double sampleRate ) override;
+        void releaseResources() override;
+        void getNextAudioBlock( const AudioSourceChannelInfo& bufferToFill ) override;
+
+        void setNextReadPosition( int64 newPosition ) override;
+        int64 getNextReadPosition() const override          { return m_nextReadPos; }
+        int64 getTotalLength() const override               { return m_reader.getNumFrames(); }
+        bool isLooping() const override                     { return false; }
+
+    private:
+        AudioFileReader m_reader;
+        int64 m_nextReadPos;
+        int64 m_readerPos;
+    };
+
+    AudioDeviceManager& m_deviceManager;
+    TimeSliceThread m_readAheadThread;
+    AudioTransportSource m_transportSource;
+    AudioSourcePlayer m_sourcePlayer;
+    ScopedPointer<FileSource> m_fileSource;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( PreviewPlayer );
+};
+
+#endif // PREVIEWPLAYER_H
@@ -0,0 +1,178 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "projectloader.h"
+#include <QDir>
+#include <QFileInfo>
+#include "zipper.h"
+
+
+Atomic<int> ProjectLoader::s_nextLoadNum;
+
+
+
+//==================================================================================================
+// Public:
+
+ProjectLoader::ProjectLoader( const QString filePath, const QString tempDirPath ) :
+    JobScheduler::Job(),
+    m_filePath( filePath ),
+    m_tempDirPath( tempDirPath ),
+    m_isZipped( true ),
+    m_isSuccessful( false )
+{
+}
+
+
+
+ProjectLoader::ProjectLoader( const QString xmlFilePath ) :
+    JobScheduler::Job(),
+    m_filePath( xmlFilePath ),
+    m_isZipped( false ),
+    m_isSuccessful( false )
+{
+}
+
+
+
+void ProjectLoader::run()
+{
+    if ( ! m_isZipped )
+    {
+        m_isSuccessful = readProject( m_filePath, m_fileHandler, m_project, m_errorTitle, m_errorInfo, this );
+        return;
+    }
+
+    // Each load extracts to a dir of its own, as a cancelled load of the same project may still be running
+    const QString extractDirPath = QDir( m_tempDirPath ).absoluteFilePath( "loading" + QString::number( ++s_nextLoadNum ) );
+
+    Zipper::decompress( m_filePath, extractDirPath );
+
+    const QString projectName = QFileInfo( m_filePath ).baseName();
+    const QDir projTempDir( QDir( extractDirPath ).absoluteFilePath( projectName ) );
+
+    m_isSuccessful = readProject( projTempDir.absoluteFilePath( "shuriken.xml" ),
+                                  m_fileHandler,
+                                  m_project,
+                                  m_errorTitle,
+                                  m_errorInfo,
+                                  this );
+
+    File( extractDirPath.toLocal8Bit().data() ).deleteRecursively();
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+bool ProjectLoader::readProject( const QString xmlFilePath,
+                                 AudioFileHandler& fileHandler,
+                                 Project& project,
+                                 QString& errorTitle,
+                                 QString& errorInfo,
+                                 JobScheduler::Job* const job )
+{
+    const QDir projTempDir = QFileInfo( xmlFilePath ).absoluteDir();
+
+    if ( ! TextFileHandler::readProjectXmlFile( xmlFilePath, project.settings, errorInfo ) ||
+         project.settings.audioFileNames.isEmpty() )
+    {
+        errorTitle = QObject::tr( "Couldn't open project" );
+
+        if ( errorInfo.isEmpty() )
+        {
+            errorInfo = QObject::tr( "The project file \"" ) + xmlFilePath + QObject::tr( "\" could not be read" );
+        }
+        return false;
+    }
+
+    const int numFiles = project.settings.audioFileNames.size();
+
+    // Try to load the audio files
+    for ( int i = 0; i < numFiles; i++ )
+    {
+        if ( job != NULL && job->isCancelled() )
+        {
+            project.sampleBufferList.clear();
+            return false;
+        }
+
+        const QString audioFilePath = projTempDir.absoluteFilePath( project.settings.audioFileNames.at( i ) );
+        SharedSampleBuffer sampleBuffer = fileHandler.getSampleData( audioFilePath );
+
+        if ( sampleBuffer.isNull() )
+        {
+            errorTitle = fileHandler.getLastErrorTitle();
+            errorInfo = fileHandler.getLastErrorInfo();
+            project.sampleBufferList.clear();
+            return false;
+        }
+
+        project.sampleBufferList << sampleBuffer;
+
+        if ( job != NULL )
+        {
+            job->setProgress( ( i + 1 ) * 100 / numFiles );
+        }
+    }
+
+    // Try to read the audio file header info
+    {
+        const QString audioFilePath = projTempDir.absoluteFilePath( project.settings.audioFileNames.first() );
+        project.sampleHeader = fileHandler.getSampleHeader( audioFilePath );
+    }
+
+    if ( project.sampleHeader.isNull() )
+    {
+        errorTitle = fileHandler.getLastErrorTitle();
+        errorInfo = fileHandler.getLastErrorInfo();
+        project.sampleBufferList.clear();
+        return false;
+    }
+
+    // Deal with sample ranges - provides backward compatibility with older save file format
+    if ( ! project.settings.sampleRangeList.isEmpty() )
+    {
+        const int numChans = project.sampleHeader->numChans;
+
+        QList<SharedSampleBuffer> tempSampleBuffers;
+
+        foreach ( SharedSampleRange range, project.settings.sampleRangeList )
+        {
+            const int numFrames = static_cast<int>( range->numFrames );
+
+            SharedSampleBuffer sampleBuffer( new SampleBuffer( numChans, numFrames ) );
+
+            for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+            {
+                sampleBuffer->copyFrom( chanNum, 0, *project.sampleBufferList.first().data(), chanNum, static_cast<int>( range->startFrame ), numFrames );
+            }
+
+            tempSampleBuffers << sampleBuffer;
+        }
+
+        project.sampleBufferList = tempSampleBuffers;
+    }
+
+    return true;
+}
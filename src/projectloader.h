@@ -0,0 +1,87 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef PROJECTLOADER_H
+#define PROJECTLOADER_H
+
+#include "samplebuffer.h"
+#include "audiofilehandler.h"
+#include "textfilehandler.h"
+#include "jobscheduler.h"
+#include "JuceHeader.h"
+
+
+// Decompresses and decodes a project on a JobScheduler worker thread. Once the job has finished
+// the GUI thread can build the waveforms from getProject()
+class ProjectLoader : public JobScheduler::Job
+{
+public:
+    struct Project
+    {
+        TextFileHandler::ProjectSettings settings;
+        QList<SharedSampleBuffer> sampleBufferList;
+        SharedSampleHeader sampleHeader;
+    };
+
+    // Load a zipped project, extracting it to "tempDirPath" first
+    ProjectLoader( QString filePath, QString tempDirPath );
+
+    // Load a project that has already been extracted, e.g. one recovered from the edit journal
+    ProjectLoader( QString xmlFilePath );
+
+    void run();
+
+    bool isSuccessful() const           { return m_isSuccessful; }
+    const Project& getProject() const   { return m_project; }
+    QString getFilePath() const         { return m_filePath; }
+    QString getErrorTitle() const       { return m_errorTitle; }
+    QString getErrorInfo() const        { return m_errorInfo; }
+
+    // Read an extracted project XML file and the audio files alongside it. If a job is given then
+    // its progress is set as each audio file is read
+    static bool readProject( QString xmlFilePath,
+                             AudioFileHandler& fileHandler,
+                             Project& project,
+                             QString& errorTitle,
+                             QString& errorInfo,
+                             JobScheduler::Job* job = NULL );
+
+private:
+    const QString m_filePath;
+    const QString m_tempDirPath;
+    const bool m_isZipped;
+
+    AudioFileHandler m_fileHandler;
+
+    bool m_isSuccessful;
+    Project m_project;
+    QString m_errorTitle;
+    QString m_errorInfo;
+
+    static Atomic<int> s_nextLoadNum;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( ProjectLoader );
+};
+
+
+#endif // PROJECTLOADER_H
@@ -0,0 +1,349 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "projectsaver.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include "zipper.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+
+
+//==================================================================================================
+// Public:
+
+ProjectSaver::ProjectSaver() :
+    QThread(),
+    m_nextSaveId( 0 ),
+    m_writingSaveId( -1 ),
+    m_isStopping( false )
+{
+    start( QThread::LowPriority );
+}
+
+
+
+ProjectSaver::~ProjectSaver()
+{
+    // Finish writing anything still in the queue before stopping
+    m_mutex.lock();
+    m_isStopping = true;
+    m_saveQueued.wakeAll();
+    m_mutex.unlock();
+
+    wait();
+}
+
+
+
+int ProjectSaver::save( const Snapshot& snapshot )
+{
+    QMutexLocker locker( &m_mutex );
+
+    const int saveId = m_nextSaveId++;
+
+    m_queue.enqueue( qMakePair( saveId, snapshot ) );
+    m_saveQueued.wakeOne();
+
+    return saveId;
+}
+
+
+
+bool ProjectSaver::waitForSave( const int saveId, QString& errorInfo )
+{
+    if ( saveId < 0 )
+    {
+        return true;
+    }
+
+    QMutexLocker locker( &m_mutex );
+
+    while ( isPending( saveId ) )
+    {
+        m_saveFinished.wait( &m_mutex );
+    }
+
+    if ( m_failedSaves.contains( saveId ) )
+    {
+        errorInfo = m_failedSaves.take( saveId );
+        return false;
+    }
+
+    return true;
+}
+
+
+
+int ProjectSaver::reportError( const QString errorInfo )
+{
+    QMutexLocker locker( &m_mutex );
+
+    const int saveId = m_nextSaveId++;
+
+    recordFailure( saveId, errorInfo );
+
+    return saveId;
+}
+
+
+
+int ProjectSaver::getLastSaveId()
+{
+    QMutexLocker locker( &m_mutex );
+
+    return m_nextSaveId - 1;
+}
+
+
+
+bool ProjectSaver::isSaving()
+{
+    QMutexLocker locker( &m_mutex );
+
+    return ! m_queue.isEmpty() || m_writingSaveId >= 0;
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+bool ProjectSaver::syncPath( const QString path )
+{
+    const int fd = ::open( path.toLocal8Bit().data(), O_RDONLY );
+
+    if ( fd < 0 )
+    {
+        return false;
+    }
+
+    const bool isSynced = fsync( fd ) == 0;
+
+    ::close( fd );
+
+    return isSynced;
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+void ProjectSaver::run()
+{
+    forever
+    {
+        m_mutex.lock();
+
+        while ( m_queue.isEmpty() && ! m_isStopping )
+        {
+            m_saveQueued.wait( &m_mutex );
+        }
+
+        if ( m_queue.isEmpty() )
+        {
+            m_mutex.unlock();
+            break;
+        }
+
+        const QPair<int, Snapshot> queuedSave = m_queue.dequeue();
+        m_writingSaveId = queuedSave.first;
+
+        m_mutex.unlock();
+
+        QString errorTitle;
+        QString errorInfo;
+
+        const bool isSuccessful = writeProject( queuedSave.second, errorTitle, errorInfo );
+
+        m_mutex.lock();
+
+        m_writingSaveId = -1;
+
+        if ( ! isSuccessful )
+        {
+            recordFailure( queuedSave.first, errorTitle + ": " + errorInfo );
+        }
+
+        m_saveFinished.wakeAll();
+
+        m_mutex.unlock();
+
+        emit saveFinished( queuedSave.first, isSuccessful, errorTitle, errorInfo );
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+bool ProjectSaver::writeProject( const Snapshot& snapshot, QString& errorTitle, QString& errorInfo )
+{
+    const QFileInfo projectFile( snapshot.filePath );
+    const QString zipFileName = projectFile.fileName();
+    const QString projectName = projectFile.baseName();
+
+    // Stage files in a separate dir so they can't collide with a project being opened
+    QDir stagingDir( snapshot.tempDirPath );
+    stagingDir.mkpath( "saving" );
+    stagingDir.cd( "saving" );
+
+    if ( stagingDir.exists( projectName ) )
+    {
+        File( stagingDir.absoluteFilePath( projectName ).toLocal8Bit().data() ).deleteRecursively();
+    }
+
+    stagingDir.mkdir( projectName );
+
+    const QDir projTempDir( stagingDir.absoluteFilePath( projectName ) );
+    const QString zipFilePath = stagingDir.absoluteFilePath( zipFileName );
+    const QString xmlFilePath = projTempDir.absoluteFilePath( "shuriken.xml" );
+
+    TextFileHandler::ProjectSettings settings = snapshot.settings;
+    settings.projectName = projectName;
+
+    QList<SharedSampleBuffer> sampleBufferList = snapshot.sampleBufferList;
+
+    if ( ! snapshot.stretchRenderJob.isNull() )
+    {
+        snapshot.stretchRenderJob->waitUntilFinished();
+
+        if ( snapshot.stretchRenderJob->isComplete() )
+        {
+            sampleBufferList = snapshot.stretchRenderJob->getSampleBufferList();
+        }
+    }
+
+    bool isSuccessful = true;
+
+    for ( int i = 0; i < sampleBufferList.size(); i++ )
+    {
+        const QString audioFilePath = m_fileHandler.saveAudioFile( projTempDir.absolutePath(),
+                                                                   "audio" + QString::number( i ),
+                                                                   sampleBufferList.at( i ),
+                                                                   snapshot.sampleRate,
+                                                                   snapshot.sampleRate,
+                                                                   AudioFileHandler::SAVE_FORMAT );
+
+        if ( ! audioFilePath.isEmpty() )
+        {
+            settings.audioFileNames << QFileInfo( audioFilePath ).fileName();
+        }
+        else
+        {
+            errorTitle = m_fileHandler.getLastErrorTitle();
+            errorInfo = m_fileHandler.getLastErrorInfo();
+            isSuccessful = false;
+            break;
+        }
+    }
+
+    if ( isSuccessful )
+    {
+        isSuccessful = TextFileHandler::createProjectXmlFile( xmlFilePath, settings );
+
+        if ( ! isSuccessful )
+        {
+            errorTitle = tr( "Couldn't save project" );
+            errorInfo = tr( "The project file \"" ) + xmlFilePath + tr( "\" could not be written" );
+        }
+    }
+
+    if ( isSuccessful && ! Zipper::compress( projTempDir.absolutePath(), zipFilePath ) )
+    {
+        errorTitle = tr( "Couldn't save project" );
+        errorInfo = tr( "The archive \"" ) + zipFilePath + tr( "\" could not be written" );
+        isSuccessful = false;
+    }
+
+    if ( isSuccessful )
+    {
+        // Write to a partial file next to the destination, sync it, then atomically rename it
+        // over the old project so that a crash can never leave a half-written project behind
+        const QString partFilePath = snapshot.filePath + ".part";
+
+        QFile::remove( partFilePath );
+
+        isSuccessful = QFile::copy( zipFilePath, partFilePath ) &&
+                       syncPath( partFilePath ) &&
+                       std::rename( partFilePath.toLocal8Bit().data(), snapshot.filePath.toLocal8Bit().data() ) == 0 &&
+                       syncPath( projectFile.absolutePath() );
+
+        if ( ! isSuccessful )
+        {
+            QFile::remove( partFilePath );
+
+            errorTitle = tr( "Couldn't save project" );
+            errorInfo = tr( "The file \"" ) + snapshot.filePath + tr( "\" could not be written" );
+        }
+
+        QFile::remove( zipFilePath );
+    }
+
+    File( projTempDir.absolutePath().toLocal8Bit().data() ).deleteRecursively();
+
+    return isSuccessful;
+}
+
+
+
+bool ProjectSaver::isPending( const int saveId ) const
+{
+    if ( saveId == m_writingSaveId )
+    {
+        return true;
+    }
+
+    for ( int i = 0; i < m_queue.size(); i++ )
+    {
+        if ( m_queue.at( i ).first == saveId )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+void ProjectSaver::recordFailure( const int saveId, const QString errorInfo )
+{
+    QMutableHashIterator<int, QString> iterator( m_failedSaves );
+
+    while ( iterator.hasNext() )
+    {
+        iterator.next();
+
+        if ( iterator.key() < saveId - MAX_REMEMBERED_SAVES )
+        {
+            iterator.remove();
+        }
+    }
+
+    m_failedSaves.insert( saveId, errorInfo );
+}
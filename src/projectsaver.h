@@ -0,0 +1,114 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef PROJECTSAVER_H
+#define PROJECTSAVER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QPair>
+#include <QHash>
+#include "samplebuffer.h"
+#include "audiofilehandler.h"
+#include "textfilehandler.h"
+#include "offlinetimestretcher.h"
+#include "JuceHeader.h"
+
+
+// Encodes, zips and writes projects on a background thread. Each save works on its own
+// snapshot of the sample data and settings so editing and playback can continue meanwhile
+class ProjectSaver : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Snapshot
+    {
+        QString filePath;
+        QString tempDirPath;
+        QList<SharedSampleBuffer> sampleBufferList;
+        int sampleRate;
+        TextFileHandler::ProjectSettings settings;
+
+        // If the sample buffers hold a time stretch preview, the render that will replace it. Its
+        // full quality audio is saved instead once it's finished, provided it wasn't cancelled
+        QSharedPointer<OfflineTimeStretcher::RenderJob> stretchRenderJob;
+    };
+
+    ProjectSaver();
+    ~ProjectSaver();
+
+    // Queue a snapshot for saving and return an ID that identifies it in saveFinished() and waitForSave()
+    int save( const Snapshot& snapshot );
+
+    // Block until the save with this ID, and any queued before it, has been written and synced to disk.
+    // Returns false if that particular save failed. An ID < 0 means no save and always succeeds
+    bool waitForSave( int saveId, QString& errorInfo );
+
+    // Record a save that failed before it could be queued, e.g. for want of a temp dir, and return its ID
+    int reportError( QString errorInfo );
+
+    // The ID most recently returned by save() or reportError(), or -1 if there hasn't been one
+    int getLastSaveId();
+
+    bool isSaving();
+
+    // Flush a file, or the entries of a dir, to disk. Returns false if it couldn't be opened or synced
+    static bool syncPath( QString path );
+
+signals:
+    void saveFinished( int saveId, bool isSuccessful, QString errorTitle, QString errorInfo );
+
+protected:
+    void run();
+
+private:
+    bool writeProject( const Snapshot& snapshot, QString& errorTitle, QString& errorInfo );
+
+    bool isPending( int saveId ) const;
+    void recordFailure( int saveId, QString errorInfo );
+
+    // Failures nobody waits for, e.g. ones already shown by the GUI, are forgotten after this many saves
+    static const int MAX_REMEMBERED_SAVES = 100;
+
+    AudioFileHandler m_fileHandler;
+
+    QMutex m_mutex;
+    QWaitCondition m_saveQueued;
+    QWaitCondition m_saveFinished;
+
+    QQueue< QPair<int, Snapshot> > m_queue;
+    int m_nextSaveId;
+    int m_writingSaveId;    // -1 when idle
+    bool m_isStopping;
+
+    // Error info of failed saves, kept until they're waited for
+    QHash<int, QString> m_failedSaves;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( ProjectSaver );
+};
+
+
+#endif // PROJECTSAVER_H
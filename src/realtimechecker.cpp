@@ -0,0 +1,503 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+// Only built with "CONFIG+=rtcheck". The functions below replace the C library's allocator and
+// blocking calls for the whole process; each forwards to the real function after checking whether
+// it was called from a real-time context
+
+#include "realtimechecker.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// glibc's allocator, which the replacements forward to without the need for dlsym()
+extern "C"
+{
+    void* __libc_malloc( size_t size );
+    void* __libc_calloc( size_t numElements, size_t elementSize );
+    void* __libc_realloc( void* ptr, size_t size );
+    void  __libc_free( void* ptr );
+    void* __libc_memalign( size_t alignment, size_t size );
+    void* __libc_valloc( size_t size );
+}
+
+
+static const int MAX_NUM_STACK_FRAMES = 64;
+static const int MAX_NUM_REPORTED_STACKS = 1024;
+static const int MAX_NUM_ALLOWED_LOCKS = 64;
+
+static __thread int realtimeContextDepth = 0;
+static __thread int lockAllowanceDepth = 0;
+static __thread bool isReporting = false;
+
+static bool isAbortOnViolationEnabled = false;
+static volatile int numViolations = 0;
+static uint64_t reportedStackHashes[ MAX_NUM_REPORTED_STACKS ];
+static const void* volatile allowedLocks[ MAX_NUM_ALLOWED_LOCKS ];
+
+typedef int (*MutexLockFunction)( pthread_mutex_t* );
+typedef int (*CondWaitFunction)( pthread_cond_t*, pthread_mutex_t* );
+typedef int (*CondTimedWaitFunction)( pthread_cond_t*, pthread_mutex_t*, const struct timespec* );
+typedef int (*RwLockFunction)( pthread_rwlock_t* );
+typedef int (*SemWaitFunction)( sem_t* );
+typedef int (*NanosleepFunction)( const struct timespec*, struct timespec* );
+typedef int (*UsleepFunction)( useconds_t );
+typedef unsigned int (*SleepFunction)( unsigned int );
+typedef int (*OpenFunction)( const char*, int, ... );
+typedef ssize_t (*ReadFunction)( int, void*, size_t );
+typedef ssize_t (*WriteFunction)( int, const void*, size_t );
+
+static MutexLockFunction realMutexLock = NULL;
+static CondWaitFunction realCondWait = NULL;
+static CondTimedWaitFunction realCondTimedWait = NULL;
+static RwLockFunction realRwLockRdLock = NULL;
+static RwLockFunction realRwLockWrLock = NULL;
+static SemWaitFunction realSemWait = NULL;
+static NanosleepFunction realNanosleep = NULL;
+static UsleepFunction realUsleep = NULL;
+static SleepFunction realSleep = NULL;
+static OpenFunction realOpen = NULL;
+static ReadFunction realRead = NULL;
+static WriteFunction realWrite = NULL;
+
+
+
+// Returns the next definition of the given function after this one, looking it up the first time it's
+// needed. Shared library initialisers, and static initialisers that run before
+// initialiseRealtimeChecker(), can call the interposed functions before anything else has been looked up
+template <typename FunctionType>
+static FunctionType getRealFunction( FunctionType& function, const char* const name, const char* const version = NULL )
+{
+    if ( function == NULL )
+    {
+        void* const symbol = ( version == NULL ) ? dlsym( RTLD_NEXT, name ) : dlvsym( RTLD_NEXT, name, version );
+
+        function = reinterpret_cast<FunctionType>( symbol );
+    }
+
+    return function;
+}
+
+
+
+// Looks up the real functions before main() runs, so that no lookup ever happens on an audio thread
+__attribute__((constructor))
+static void initialiseRealtimeChecker()
+{
+    getRealFunction( realMutexLock, "pthread_mutex_lock" );
+    getRealFunction( realCondWait, "pthread_cond_wait", "GLIBC_2.3.2" );
+    getRealFunction( realCondTimedWait, "pthread_cond_timedwait", "GLIBC_2.3.2" );
+    getRealFunction( realRwLockRdLock, "pthread_rwlock_rdlock" );
+    getRealFunction( realRwLockWrLock, "pthread_rwlock_wrlock" );
+    getRealFunction( realSemWait, "sem_wait" );
+    getRealFunction( realNanosleep, "nanosleep" );
+    getRealFunction( realUsleep, "usleep" );
+    getRealFunction( realSleep, "sleep" );
+    getRealFunction( realOpen, "open" );
+    getRealFunction( realRead, "read" );
+    getRealFunction( realWrite, "write" );
+
+    // The first call to backtrace() loads the unwinder, which allocates
+    void* frames[ MAX_NUM_STACK_FRAMES ];
+    backtrace( frames, MAX_NUM_STACK_FRAMES );
+
+    const char* const abortSetting = getenv( "SHURIKEN_RTCHECK_ABORT" );
+    isAbortOnViolationEnabled = ( abortSetting != NULL && strcmp( abortSetting, "1" ) == 0 );
+}
+
+
+
+// Returns true the first time a stack is seen. Lock-free, as it's called on audio threads
+static bool isNewStack( void* const* frames, const int numFrames )
+{
+    uint64_t hash = 14695981039346656037ULL;    // FNV-1a
+
+    for ( int i = 0; i < numFrames; i++ )
+    {
+        hash = ( hash ^ reinterpret_cast<uintptr_t>( frames[ i ] ) ) * 1099511628211ULL;
+    }
+
+    if ( hash == 0 )
+    {
+        hash = 1;
+    }
+
+    for ( int i = 0; i < MAX_NUM_REPORTED_STACKS; i++ )
+    {
+        const int index = static_cast<int>( ( hash + i ) % MAX_NUM_REPORTED_STACKS );
+
+        if ( __sync_bool_compare_and_swap( &reportedStackHashes[ index ], 0, hash ) )
+        {
+            return true;
+        }
+
+        if ( reportedStackHashes[ index ] == hash )
+        {
+            return false;
+        }
+    }
+
+    return false;   // The table is full; stop reporting rather than flood stderr
+}
+
+
+
+static void writeToStderr( const char* text )
+{
+    getRealFunction( realWrite, "write" )( STDERR_FILENO, text, strlen( text ) );
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+void RealtimeChecker::check( const char* const functionName )
+{
+    if ( realtimeContextDepth == 0 || isReporting )
+    {
+        return;
+    }
+
+    isReporting = true;
+
+    void* frames[ MAX_NUM_STACK_FRAMES ];
+    const int numFrames = backtrace( frames, MAX_NUM_STACK_FRAMES );
+
+    __sync_fetch_and_add( &numViolations, 1 );
+
+    if ( isNewStack( frames, numFrames ) )
+    {
+        writeToStderr( "\n*** Real-time safety violation: " );
+        writeToStderr( functionName );
+        writeToStderr( "() called on an audio thread\n" );
+
+        // Skip this function and the interposed function that called it
+        backtrace_symbols_fd( frames + 2, numFrames - 2, STDERR_FILENO );
+
+        if ( isAbortOnViolationEnabled )
+        {
+            abort();
+        }
+    }
+
+    isReporting = false;
+}
+
+
+
+int RealtimeChecker::getNumViolations()
+{
+    return __sync_fetch_and_add( &numViolations, 0 );
+}
+
+
+
+void RealtimeChecker::allowLock( const void* const lock )
+{
+    for ( int i = 0; i < MAX_NUM_ALLOWED_LOCKS; i++ )
+    {
+        if ( __sync_bool_compare_and_swap( &allowedLocks[ i ], (const void*) NULL, lock ) )
+        {
+            return;
+        }
+    }
+
+    writeToStderr( "\n*** Too many locks allowed in real-time contexts\n" );
+    abort();
+}
+
+
+
+void RealtimeChecker::disallowLock( const void* const lock )
+{
+    for ( int i = 0; i < MAX_NUM_ALLOWED_LOCKS; i++ )
+    {
+        if ( __sync_bool_compare_and_swap( &allowedLocks[ i ], lock, (const void*) NULL ) )
+        {
+            return;
+        }
+    }
+}
+
+
+
+bool RealtimeChecker::isLockAllowed( const void* const lock )
+{
+    if ( lockAllowanceDepth > 0 )
+    {
+        return true;
+    }
+
+    for ( int i = 0; i < MAX_NUM_ALLOWED_LOCKS; i++ )
+    {
+        if ( allowedLocks[ i ] == lock )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+void RealtimeChecker::enterRealtimeContext()
+{
+    realtimeContextDepth++;
+}
+
+
+
+void RealtimeChecker::exitRealtimeContext()
+{
+    realtimeContextDepth--;
+}
+
+
+
+void RealtimeChecker::enterLockAllowance()
+{
+    lockAllowanceDepth++;
+}
+
+
+
+void RealtimeChecker::exitLockAllowance()
+{
+    lockAllowanceDepth--;
+}
+
+
+
+//==================================================================================================
+// Interposed functions:
+
+extern "C"
+{
+
+void* malloc( size_t size )
+{
+    RealtimeChecker::check( "malloc" );
+    return __libc_malloc( size );
+}
+
+
+
+void* calloc( size_t numElements, size_t elementSize )
+{
+    RealtimeChecker::check( "calloc" );
+    return __libc_calloc( numElements, elementSize );
+}
+
+
+
+void* realloc( void* ptr, size_t size )
+{
+    RealtimeChecker::check( "realloc" );
+    return __libc_realloc( ptr, size );
+}
+
+
+
+void free( void* ptr )
+{
+    if ( ptr != NULL )
+    {
+        RealtimeChecker::check( "free" );
+    }
+
+    __libc_free( ptr );
+}
+
+
+
+void* memalign( size_t alignment, size_t size )
+{
+    RealtimeChecker::check( "memalign" );
+    return __libc_memalign( alignment, size );
+}
+
+
+
+void* aligned_alloc( size_t alignment, size_t size )
+{
+    RealtimeChecker::check( "aligned_alloc" );
+    return __libc_memalign( alignment, size );
+}
+
+
+
+int posix_memalign( void** ptr, size_t alignment, size_t size )
+{
+    RealtimeChecker::check( "posix_memalign" );
+
+    if ( alignment % sizeof( void* ) != 0 || ( alignment & ( alignment - 1 ) ) != 0 )
+    {
+        return EINVAL;
+    }
+
+    void* const memory = __libc_memalign( alignment, size );
+
+    if ( memory == NULL )
+    {
+        return ENOMEM;
+    }
+
+    *ptr = memory;
+    return 0;
+}
+
+
+
+void* valloc( size_t size )
+{
+    RealtimeChecker::check( "valloc" );
+    return __libc_valloc( size );
+}
+
+
+
+int pthread_mutex_lock( pthread_mutex_t* mutex )
+{
+    if ( realtimeContextDepth > 0 && ! RealtimeChecker::isLockAllowed( mutex ) )
+    {
+        RealtimeChecker::check( "pthread_mutex_lock" );
+    }
+
+    return getRealFunction( realMutexLock, "pthread_mutex_lock" )( mutex );
+}
+
+
+
+int pthread_cond_wait( pthread_cond_t* cond, pthread_mutex_t* mutex )
+{
+    RealtimeChecker::check( "pthread_cond_wait" );
+    return getRealFunction( realCondWait, "pthread_cond_wait", "GLIBC_2.3.2" )( cond, mutex );
+}
+
+
+
+int pthread_cond_timedwait( pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* time )
+{
+    RealtimeChecker::check( "pthread_cond_timedwait" );
+    return getRealFunction( realCondTimedWait, "pthread_cond_timedwait", "GLIBC_2.3.2" )( cond, mutex, time );
+}
+
+
+
+int pthread_rwlock_rdlock( pthread_rwlock_t* lock )
+{
+    RealtimeChecker::check( "pthread_rwlock_rdlock" );
+    return getRealFunction( realRwLockRdLock, "pthread_rwlock_rdlock" )( lock );
+}
+
+
+
+int pthread_rwlock_wrlock( pthread_rwlock_t* lock )
+{
+    RealtimeChecker::check( "pthread_rwlock_wrlock" );
+    return getRealFunction( realRwLockWrLock, "pthread_rwlock_wrlock" )( lock );
+}
+
+
+
+int sem_wait( sem_t* semaphore )
+{
+    RealtimeChecker::check( "sem_wait" );
+    return getRealFunction( realSemWait, "sem_wait" )( semaphore );
+}
+
+
+
+int nanosleep( const struct timespec* duration, struct timespec* remaining )
+{
+    RealtimeChecker::check( "nanosleep" );
+    return getRealFunction( realNanosleep, "nanosleep" )( duration, remaining );
+}
+
+
+
+int usleep( useconds_t duration )
+{
+    RealtimeChecker::check( "usleep" );
+    return getRealFunction( realUsleep, "usleep" )( duration );
+}
+
+
+
+unsigned int sleep( unsigned int numSecs )
+{
+    RealtimeChecker::check( "sleep" );
+    return getRealFunction( realSleep, "sleep" )( numSecs );
+}
+
+
+
+int open( const char* path, int flags, ... )
+{
+    RealtimeChecker::check( "open" );
+
+    mode_t mode = 0;
+
+    if ( flags & O_CREAT )
+    {
+        va_list args;
+        va_start( args, flags );
+        mode = va_arg( args, mode_t );
+        va_end( args );
+    }
+
+    return getRealFunction( realOpen, "open" )( path, flags, mode );
+}
+
+
+
+ssize_t read( int fileDescriptor, void* buffer, size_t numBytes )
+{
+    RealtimeChecker::check( "read" );
+    return getRealFunction( realRead, "read" )( fileDescriptor, buffer, numBytes );
+}
+
+
+
+ssize_t write( int fileDescriptor, const void* buffer, size_t numBytes )
+{
+    RealtimeChecker::check( "write" );
+    return getRealFunction( realWrite, "write" )( fileDescriptor, buffer, numBytes );
+}
+
+} // extern "C"
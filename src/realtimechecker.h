@@ -0,0 +1,97 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef REALTIMECHECKER_H
+#define REALTIMECHECKER_H
+
+
+// Reports code that may block on the audio thread.
+// Build with "qmake CONFIG+=rtcheck" to enable. Audio callbacks mark themselves as real-time by
+// creating a ScopedRealtimeContext; while one exists, any heap allocation, mutex lock, condition
+// wait, sleep or file I/O on that thread is reported on stderr with its stack trace. Each distinct
+// stack is only reported once. Set SHURIKEN_RTCHECK_ABORT=1 to abort on the first report instead,
+// so that a debugger stops at the offending call.
+// Every mutex locked in a real-time context is reported, whether or not another thread holds it at
+// the time, unless it has been allowed. Only the short locks that the audio thread must share with
+// other threads are allowed: the Synthesiser's lock, passed to allowLock(), and the lock that
+// JUCE's MidiMessageCollector keeps to itself, allowed by a ScopedLockAllowance around the call.
+// Locks taken by JUCE before our callbacks are called, e.g. in AudioSourcePlayer, are outside of any
+// real-time context and so aren't reported. In normal builds the classes below do nothing
+
+class RealtimeChecker
+{
+public:
+    class ScopedRealtimeContext
+    {
+    public:
+#ifdef SHURIKEN_RTCHECK
+        ScopedRealtimeContext()     { enterRealtimeContext(); }
+        ~ScopedRealtimeContext()    { exitRealtimeContext(); }
+#else
+        ScopedRealtimeContext()     {}
+#endif
+    };
+
+    // Locks taken on this thread while one of these exists aren't reported, for third-party code whose
+    // locks can't be passed to allowLock()
+    class ScopedLockAllowance
+    {
+    public:
+#ifdef SHURIKEN_RTCHECK
+        ScopedLockAllowance()       { enterLockAllowance(); }
+        ~ScopedLockAllowance()      { exitLockAllowance(); }
+#else
+        ScopedLockAllowance()       {}
+#endif
+    };
+
+#ifdef SHURIKEN_RTCHECK
+    // Stop reporting the given mutex, e.g. a CriticalSection, which wraps a pthread_mutex_t, when it's
+    // locked in a real-time context. Must be undone with disallowLock() before the mutex is destroyed
+    static void allowLock( const void* lock );
+    static void disallowLock( const void* lock );
+#else
+    static void allowLock( const void* )        {}
+    static void disallowLock( const void* )     {}
+#endif
+
+#ifdef SHURIKEN_RTCHECK
+    // Called by the interposed functions; reports the current stack if this thread is in a
+    // real-time context
+    static void check( const char* functionName );
+
+    // The no. of calls reported so far, e.g. for a test to check that there were none
+    static int getNumViolations();
+
+    // Called by the interposed pthread_mutex_lock()
+    static bool isLockAllowed( const void* lock );
+
+private:
+    static void enterRealtimeContext();
+    static void exitRealtimeContext();
+
+    static void enterLockAllowance();
+    static void exitLockAllowance();
+#endif
+};
+
+#endif // REALTIMECHECKER_H
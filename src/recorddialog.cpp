@@ -0,0 +1,325 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "recorddialog.h"
+#include "ui_recorddialog.h"
+#include "messageboxes.h"
+#include <QPushButton>
+#include <QPainter>
+#include <QDir>
+
+
+//==================================================================================================
+// Public:
+
+RecordDialog::RecordDialog( AudioDeviceManager& deviceManager,
+                            const QString tempDirPath,
+                            const AudioAnalyser::DetectionSettings detectionSettings,
+                            QWidget* parent ) :
+    QDialog( parent ),
+    m_ui( new Ui::RecordDialog ),
+    m_deviceManager( deviceManager ),
+    m_tempDirPath( tempDirPath ),
+    m_detectionSettings( detectionSettings ),
+    m_recorder( new AudioRecorder() ),
+    m_numPeaksDrawn( 0 ),
+    m_peaksPerPixel( 1 ),
+    m_numOnsetsDrawn( 0 ),
+    m_bpm( 0.0 )
+{
+    m_ui->setupUi( this );
+
+    m_ui->buttonBox->button( QDialogButtonBox::Ok )->setEnabled( false );
+
+    m_waveformPixmap = QPixmap( m_ui->label_Waveform->minimumSize() );
+    clearWaveform();
+
+    m_deviceManager.addAudioCallback( m_recorder );
+
+    if ( m_recorder->getNumChannels() == 0 )
+    {
+        m_ui->pushButton_Record->setEnabled( false );
+        m_ui->label_Status->setText( tr( "The current audio device has no active input channels" ) );
+    }
+
+    connect( &m_updateTimer, SIGNAL( timeout() ), this, SLOT( updateDisplay() ) );
+
+    // The take is read back on the recorder's own thread, which then finishes
+    connect( m_recorder, SIGNAL( finished() ), this, SLOT( recorderFinished() ) );
+}
+
+
+
+RecordDialog::~RecordDialog()
+{
+    m_updateTimer.stop();
+
+    // Make sure the audio callback is gone before the recorder is destroyed
+    m_deviceManager.removeAudioCallback( m_recorder );
+
+    m_recorder = NULL;
+
+    delete m_ui;
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+void RecordDialog::changeEvent( QEvent* event )
+{
+    QDialog::changeEvent( event );
+
+    switch ( event->type() )
+    {
+    case QEvent::LanguageChange:
+        m_ui->retranslateUi( this );
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void RecordDialog::clearWaveform()
+{
+    m_waveformPixmap.fill( Qt::white );
+
+    QPainter painter( &m_waveformPixmap );
+    painter.setPen( Qt::lightGray );
+
+    const int centreY = m_waveformPixmap.height() / 2;
+    painter.drawLine( 0, centreY, m_waveformPixmap.width(), centreY );
+
+    m_numPeaksDrawn = 0;
+    m_numOnsetsDrawn = 0;
+}
+
+
+
+void RecordDialog::drawNewPeaks()
+{
+    const int width = m_waveformPixmap.width();
+
+    // Once the take no longer fits, halve the horizontal scale and redraw from the start
+    if ( m_peaks.size() > width * m_peaksPerPixel )
+    {
+        while ( m_peaks.size() > width * m_peaksPerPixel )
+        {
+            m_peaksPerPixel *= 2;
+        }
+
+        clearWaveform();
+    }
+
+    const int firstPixel = m_numPeaksDrawn / m_peaksPerPixel;
+    const int endPixel = m_peaks.size() / m_peaksPerPixel;
+
+    if ( endPixel <= firstPixel )
+    {
+        return;
+    }
+
+    QPainter painter( &m_waveformPixmap );
+    painter.setPen( QColor( 0, 0, 255 ) );
+
+    const qreal halfHeight = m_waveformPixmap.height() / 2.0;
+
+    for ( int x = firstPixel; x < endPixel; x++ )
+    {
+        float peak = 0.0f;
+
+        for ( int i = x * m_peaksPerPixel; i < ( x + 1 ) * m_peaksPerPixel; i++ )
+        {
+            peak = jmax( peak, m_peaks.getUnchecked( i ) );
+        }
+
+        const int lineHeight = roundToInt( jmin( peak, 1.0f ) * halfHeight );
+
+        painter.drawLine( x, roundToInt( halfHeight ) - lineHeight, x, roundToInt( halfHeight ) + lineHeight );
+    }
+
+    m_numPeaksDrawn = endPixel * m_peaksPerPixel;
+}
+
+
+
+void RecordDialog::drawNewOnsets()
+{
+    const int framesPerPixel = AudioRecorder::PEAK_BLOCK_SIZE * m_peaksPerPixel;
+    const int endPixel = m_numPeaksDrawn / m_peaksPerPixel;
+
+    QPainter painter( &m_waveformPixmap );
+    painter.setPen( QColor( 255, 0, 0 ) );
+
+    // Only draw onsets over the part of the waveform that has been drawn so far
+    while ( m_numOnsetsDrawn < m_onsetFrameNums.size() &&
+            m_onsetFrameNums.at( m_numOnsetsDrawn ) / framesPerPixel < endPixel )
+    {
+        const int x = static_cast<int>( m_onsetFrameNums.at( m_numOnsetsDrawn ) / framesPerPixel );
+
+        painter.drawLine( x, 0, x, m_waveformPixmap.height() );
+
+        m_numOnsetsDrawn++;
+    }
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+QString RecordDialog::formatTime( const FrameNum numFrames, const int sampleRate )
+{
+    const qreal totalSecs = sampleRate > 0 ? (qreal) numFrames / sampleRate : 0.0;
+
+    const int mins = (int) totalSecs / 60;
+    const qreal secs = totalSecs - mins * 60;
+
+    return QString::number( mins ) + ":" + QString::number( secs, 'f', 1 ).rightJustified( 4, '0' );
+}
+
+
+
+//==================================================================================================
+// Private Slots:
+
+void RecordDialog::updateDisplay()
+{
+    m_recorder->getPeaks( m_peaks.size(), m_peaks );
+
+    StreamingAnalyser* analyser = m_recorder->getAnalyser();
+
+    if ( analyser != NULL )
+    {
+        analyser->getOnsetFrameNums( m_onsetFrameNums.size(), m_onsetFrameNums );
+        m_bpm = analyser->getBPM();
+
+        if ( m_bpm > 0.0 )
+        {
+            m_ui->label_BPM->setText( QString::number( m_bpm ) + tr( " BPM" ) );
+        }
+    }
+
+    drawNewPeaks();
+    drawNewOnsets();
+
+    m_ui->label_Waveform->setPixmap( m_waveformPixmap );
+
+    m_ui->label_Time->setText( formatTime( m_recorder->getNumFramesRecorded(), m_recorder->getSampleRate() ) );
+
+    if ( m_recorder->hasOverflowed() )
+    {
+        m_ui->label_Status->setText( tr( "Input overflow: " ) + QString::number( m_recorder->getNumFramesDropped() ) +
+                                     tr( " frames were dropped" ) );
+    }
+
+    // The recorder stops by itself if the temp file fails or the device changes format
+    if ( m_ui->pushButton_Record->isChecked() && ! m_recorder->isRecording() )
+    {
+        m_ui->pushButton_Record->setChecked( false );
+        on_pushButton_Record_clicked( false );
+    }
+}
+
+
+
+void RecordDialog::on_pushButton_Record_clicked( const bool isChecked )
+{
+    if ( isChecked )
+    {
+        m_take.clear();
+        m_peaks.clearQuick();
+        m_peaksPerPixel = 1;
+        m_onsetFrameNums.clear();
+        m_bpm = 0.0;
+        clearWaveform();
+        m_ui->label_Waveform->setPixmap( m_waveformPixmap );
+        m_ui->label_Status->clear();
+        m_ui->label_BPM->clear();
+
+        m_recorder->setAnalysisEnabled( m_ui->checkBox_DetectOnsets->isChecked(), m_detectionSettings );
+
+        const QString tempFilePath = QDir( m_tempDirPath ).absoluteFilePath( "recording.au" );
+
+        if ( m_recorder->startRecording( tempFilePath ) )
+        {
+            m_ui->pushButton_Record->setText( tr( "Stop" ) );
+            m_ui->checkBox_DetectOnsets->setEnabled( false );
+            m_ui->buttonBox->button( QDialogButtonBox::Ok )->setEnabled( false );
+            m_updateTimer.start( UPDATE_INTERVAL_MS );
+        }
+        else
+        {
+            m_ui->pushButton_Record->setChecked( false );
+            MessageBoxes::showWarningDialog( tr( "Couldn't start recording!" ), m_recorder->getErrorInfo() );
+        }
+    }
+    else
+    {
+        m_recorder->stopRecording();
+
+        // Leave the timer running so the last of the waveform is drawn while the take is read back
+        m_ui->pushButton_Record->setEnabled( false );
+        m_ui->label_Status->setText( tr( "Reading take..." ) );
+    }
+}
+
+
+
+void RecordDialog::recorderFinished()
+{
+    m_take = m_recorder->getTake();
+
+    m_updateTimer.stop();
+    m_ui->label_Status->clear();
+    updateDisplay();
+
+    m_ui->pushButton_Record->setText( tr( "Record" ) );
+    m_ui->pushButton_Record->setEnabled( true );
+    m_ui->checkBox_DetectOnsets->setEnabled( true );
+
+    if ( m_take.isNull() )
+    {
+        m_ui->label_Status->clear();
+        MessageBoxes::showWarningDialog( tr( "Couldn't record take!" ), m_recorder->getErrorInfo() );
+        return;
+    }
+
+    if ( m_recorder->wasInterrupted() )
+    {
+        m_ui->label_Status->setText( tr( "Recording stopped because the audio device's sample rate or channels changed" ) );
+    }
+
+    // Padding the final hop can place an onset past the end of the take
+    while ( ! m_onsetFrameNums.isEmpty() && m_onsetFrameNums.last() >= m_take->getNumFrames() )
+    {
+        m_onsetFrameNums.removeLast();
+    }
+
+    m_ui->buttonBox->button( QDialogButtonBox::Ok )->setEnabled( m_take->getNumFrames() > 0 );
+}
@@ -0,0 +1,96 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef RECORDDIALOG_H
+#define RECORDDIALOG_H
+
+#include <QDialog>
+#include <QTimer>
+#include <QPixmap>
+#include "JuceHeader.h"
+#include "audiorecorder.h"
+
+namespace Ui
+{
+    class RecordDialog;
+}
+
+class RecordDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    RecordDialog( AudioDeviceManager& deviceManager,
+                  QString tempDirPath,
+                  AudioAnalyser::DetectionSettings detectionSettings,
+                  QWidget* parent = NULL );
+    ~RecordDialog();
+
+    SharedSampleBuffer getTake() const  { return m_take; }
+    int getSampleRate() const           { return m_recorder->getSampleRate(); }
+
+    // Onsets and tempo found while recording the take; empty and 0.0 if detection was disabled
+    QList<FrameNum> getOnsetFrameNums() const    { return m_onsetFrameNums; }
+    qreal getBPM() const                    { return m_bpm; }
+
+protected:
+    void changeEvent( QEvent* event );
+
+private:
+    void clearWaveform();
+    void drawNewPeaks();
+    void drawNewOnsets();
+
+    static QString formatTime( FrameNum numFrames, int sampleRate );
+
+    Ui::RecordDialog* m_ui;
+
+    AudioDeviceManager& m_deviceManager;
+    const QString m_tempDirPath;
+    const AudioAnalyser::DetectionSettings m_detectionSettings;
+
+    ScopedPointer<AudioRecorder> m_recorder;
+    SharedSampleBuffer m_take;
+
+    QTimer m_updateTimer;
+
+    QPixmap m_waveformPixmap;
+    Array<float> m_peaks;
+    int m_numPeaksDrawn;
+    int m_peaksPerPixel;
+
+    QList<FrameNum> m_onsetFrameNums;
+    int m_numOnsetsDrawn;
+    qreal m_bpm;
+
+    static const int UPDATE_INTERVAL_MS = 40;
+
+private slots:
+    void updateDisplay();
+    void on_pushButton_Record_clicked( bool isChecked );
+    void recorderFinished();
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( RecordDialog );
+};
+
+#endif // RECORDDIALOG_H
@@ -22,6 +22,8 @@
 
 #include "rubberbandaudiosource.h"
 #include "globals.h"
+#include "memorylocker.h"
+#include "realtimechecker.h"
 #include <QDebug>
 
 
@@ -31,7 +33,8 @@
 RubberbandAudioSource::RubberbandAudioSource( SamplerAudioSource* const source,
                                               const int numChans,
                                               const RubberBandStretcher::Options options,
-                                              const bool isJackSyncEnabled ) :
+                                              const bool isJackSyncEnabled,
+                                              const bool isAdaptiveQualityEnabled ) :
     QObject(),
     AudioSource(),
     m_source( source ),
@@ -54,9 +57,13 @@ RubberbandAudioSource::RubberbandAudioSource( SamplerAudioSource* const source,
     m_pitchOption( 0 ),
     m_prevPitchOption( 0 ),
     m_originalBPM( 0.0 ),
-    m_isJackSyncEnabled( isJackSyncEnabled )
+    m_isJackSyncEnabled( isJackSyncEnabled ),
+    m_isAdaptiveQualityEnabled( isAdaptiveQualityEnabled ),
+    m_sampleRate( 0.0 )
 {
     m_inFloatBuffer = new const float*[ numChans ];
+
+    MemoryLocker::lock( m_inSampleBuffer );
 }
 
 
@@ -65,6 +72,8 @@ RubberbandAudioSource::~RubberbandAudioSource()
 {
     releaseResources();
 
+    MemoryLocker::unlock( m_inSampleBuffer );
+
     delete[] m_inFloatBuffer;
 }
 
@@ -84,8 +93,13 @@ void RubberbandAudioSource::prepareToPlay( int samplesPerBlockExpected, double s
         m_prevPhaseOption = 0;
         m_prevFormantOption = 0;
         m_prevPitchOption = 0;
+
+        m_governor.reset();
     }
 
+    m_sampleRate = sampleRate;
+    m_midiBuffer.ensureSize( 2048 );
+
     m_source->prepareToPlay( samplesPerBlockExpected, sampleRate );
 }
 
@@ -106,6 +120,15 @@ void RubberbandAudioSource::releaseResources()
 
 void RubberbandAudioSource::getNextAudioBlock( const AudioSourceChannelInfo& info )
 {
+    const RealtimeChecker::ScopedRealtimeContext realtimeContext;
+
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    if ( ! m_isAdaptiveQualityEnabled && m_governor.getLevel() != StretcherGovernor::LEVEL_FULL_QUALITY )
+    {
+        m_governor.reset();
+    }
+
     // JACK Sync
     if ( m_isJackSyncEnabled )
     {
@@ -146,28 +169,33 @@ void RubberbandAudioSource::getNextAudioBlock( const AudioSourceChannelInfo& inf
     }
 
     // Options
-    if ( m_transientsOption != m_prevTransientsOption )
+    const RubberBandStretcher::Options transientsOption = m_governor.getTransientsOption( m_transientsOption );
+    const RubberBandStretcher::Options phaseOption = m_governor.getPhaseOption( m_phaseOption );
+    const RubberBandStretcher::Options formantOption = m_governor.getFormantOption( m_formantOption );
+    const RubberBandStretcher::Options pitchOption = m_governor.getPitchOption( m_pitchOption );
+
+    if ( transientsOption != m_prevTransientsOption )
     {
-        m_stretcher->setTransientsOption( m_transientsOption );
-        m_prevTransientsOption = m_transientsOption;
+        m_stretcher->setTransientsOption( transientsOption );
+        m_prevTransientsOption = transientsOption;
     }
 
-    if ( m_phaseOption != m_prevPhaseOption )
+    if ( phaseOption != m_prevPhaseOption )
     {
-        m_stretcher->setPhaseOption( m_phaseOption );
-        m_prevPhaseOption = m_phaseOption;
+        m_stretcher->setPhaseOption( phaseOption );
+        m_prevPhaseOption = phaseOption;
     }
 
-    if ( m_formantOption != m_prevFormantOption )
+    if ( formantOption != m_prevFormantOption )
     {
-        m_stretcher->setFormantOption( m_formantOption );
-        m_prevFormantOption = m_formantOption;
+        m_stretcher->setFormantOption( formantOption );
+        m_prevFormantOption = formantOption;
     }
 
-    if ( m_pitchOption != m_prevPitchOption )
+    if ( pitchOption != m_prevPitchOption )
     {
-        m_stretcher->setPitchOption( m_pitchOption );
-        m_prevPitchOption = m_pitchOption;
+        m_stretcher->setPitchOption( pitchOption );
+        m_prevPitchOption = pitchOption;
     }
 
 //    const int latency = m_stretcher->getLatency() + m_reserveSize;
@@ -179,6 +207,17 @@ void RubberbandAudioSource::getNextAudioBlock( const AudioSourceChannelInfo& inf
     }
 
     m_stretcher->retrieve( info.buffer->getArrayOfWritePointers(), info.numSamples );
+
+    // Scrubbing bypasses the stretcher, which would add its latency
+    m_source->renderScrubVoice( info );
+
+    // Any change of level takes effect from the next block
+    if ( m_isAdaptiveQualityEnabled && m_sampleRate > 0.0 )
+    {
+        const double processSecs = Time::highResolutionTicksToSeconds( Time::getHighResolutionTicks() - startTicks );
+
+        m_governor.update( processSecs, info.numSamples / m_sampleRate );
+    }
 }
 
 
@@ -232,7 +271,7 @@ void RubberbandAudioSource::processNextAudioBlock()
 
                 if ( isEventValid )
                 {
-                    m_noteTimeRatio = m_noteTimeRatioTable.value( message.getNoteNumber(), 1.0 );
+                    m_noteTimeRatio = m_noteTimeRatioTable.value( Midi::getKeyNum( message.getChannel(), message.getNoteNumber() ), 1.0 );
                     m_stretcher->setTimeRatio( m_globalTimeRatio * m_noteTimeRatio );
                 }
 
@@ -27,6 +27,7 @@
 #include "JuceHeader.h"
 #include "samplebuffer.h"
 #include "sampleraudiosource.h"
+#include "stretchergovernor.h"
 #include <rubberband/RubberBandStretcher.h>
 
 using namespace RubberBand;
@@ -41,7 +42,8 @@ public:
     RubberbandAudioSource( SamplerAudioSource* source,
                            int numChans,
                            RubberBandStretcher::Options options,
-                           bool isJackSyncEnabled = false );
+                           bool isJackSyncEnabled = false,
+                           bool isAdaptiveQualityEnabled = false );
 
     ~RubberbandAudioSource();
 
@@ -49,12 +51,19 @@ public:
     void setPitchScale( qreal scale )                               { m_pitchScale = scale; }
     void enablePitchCorrection( bool isEnabled )                    { m_isPitchCorrectionEnabled = isEnabled; }
 
+    // Time ratios are looked up by key no., see Midi::getKeyNum()
     qreal getNoteTimeRatio( int midiNote ) const                    { return m_noteTimeRatioTable.value( midiNote, 1.0 ); }
     void setNoteTimeRatio( int midiNote, qreal ratio )              { m_noteTimeRatioTable.insert( midiNote, ratio ); }
 
     // Only has an effect when JACK Sync is enabled
     void setOriginalBPM( qreal bpm )                                { m_originalBPM = bpm; }
 
+    // Only counts buffers allocated here; Rubber Band's own working memory can't be measured
+    qint64 getNumBytesAllocated() const
+    {
+        return static_cast<qint64>( m_inSampleBuffer.getNumChannels() ) * m_inSampleBuffer.getNumFrames() * sizeof( float );
+    }
+
     // For JUCE use only!
     void prepareToPlay( int samplesPerBlockExpected, double sampleRate ) override;
     void releaseResources() override;
@@ -100,6 +109,11 @@ private:
 
     volatile bool m_isJackSyncEnabled;
 
+    // Lowers the quality of the options above while the audio thread is close to overrunning
+    StretcherGovernor m_governor;
+    volatile bool m_isAdaptiveQualityEnabled;
+    double m_sampleRate;
+
     QHash<int, qreal> m_noteTimeRatioTable;
 
 public slots:
@@ -108,6 +122,7 @@ public slots:
     void setFormantOption( RubberBandStretcher::Options option )          { m_formantOption = option; }
     void setPitchOption( RubberBandStretcher::Options option )            { m_pitchOption = option; }
     void enableJackSync( bool isEnabled )                                 { m_isJackSyncEnabled = isEnabled; }
+    void enableAdaptiveQuality( bool isEnabled )                          { m_isAdaptiveQualityEnabled = isEnabled; }
 
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( RubberbandAudioSource );
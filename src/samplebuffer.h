@@ -27,6 +27,16 @@
 #include "JuceHeader.h"
 
 
+// Frame positions and counts that may span more than one sample buffer, e.g. slice points in a
+// multi-hour recording.  An individual SampleBuffer is still indexed with an int
+typedef qint64 FrameNum;
+
+inline FrameNum roundToFrameNum( const double value )
+{
+    return static_cast<FrameNum>( std::floor( value + 0.5 ) );
+}
+
+
 class SampleBuffer : public AudioSampleBuffer
 {
 public:
@@ -89,8 +99,8 @@ struct SampleRange
     {
     }
 
-    int startFrame;
-    int numFrames;
+    FrameNum startFrame;
+    FrameNum numFrames;
 
     JUCE_LEAK_DETECTOR( SampleRange )
 };
@@ -21,8 +21,9 @@
 */
 
 #include "sampleraudiosource.h"
-#include "shurikensampler.h"
 #include "globals.h"
+#include "memorylocker.h"
+#include "realtimechecker.h"
 //#include <QtDebug>
 
 
@@ -35,22 +36,25 @@ SamplerAudioSource::SamplerAudioSource( const bool isMonophonic, AudioIODevice*
     m_isMonophonic( isMonophonic ),
     m_fileSampleRate( 0.0 ),
     m_playbackSampleRate( 0.0 ),
-    m_nextFreeNote( Midi::MIDDLE_C ),
-    m_lowestAssignedNote( Midi::MIDDLE_C ),
+    m_isInputNoteMapEnabled( false ),
+    m_nextFreeKeyNum( Midi::MIDDLE_C ),
+    m_lowestAssignedKeyNum( Midi::MIDDLE_C ),
     m_isPlaying( false ),
     m_isLoopingEnabled( false ),
     m_noteCounter( 0 ),
-    m_frameCounter( 0 ),
     m_jackDevice( audioDevice != NULL && audioDevice->canHandleMidiInput() ? audioDevice : NULL )
 {
+    // Held for a handful of voice updates at most, by the audio thread and the GUI thread
+    RealtimeChecker::allowLock( &m_sampler.getLock() );
 }
 
 
 
 SamplerAudioSource::~SamplerAudioSource()
 {
-    m_sampler.clearVoices();
-    m_sampler.clearSounds();
+    clearSamples();
+
+    RealtimeChecker::disallowLock( &m_sampler.getLock() );
 }
 
 
@@ -61,21 +65,26 @@ void SamplerAudioSource::setSamples( const QList<SharedSampleBuffer> sampleBuffe
     m_sampleBufferList = sampleBufferList;
     m_fileSampleRate = sampleRate;
 
-    if ( sampleBufferList.size() > Midi::MAX_POLYPHONY - Midi::MIDDLE_C )
+    foreach ( SharedSampleBuffer sampleBuffer, m_sampleBufferList )
     {
-        m_nextFreeNote = qMax( Midi::MAX_POLYPHONY - sampleBufferList.size(), 0 );
+        MemoryLocker::lock( *sampleBuffer );
     }
 
-    m_lowestAssignedNote = m_nextFreeNote;
+    m_nextFreeKeyNum = Midi::getStartKeyNum( sampleBufferList.size() );
+    m_lowestAssignedKeyNum = m_nextFreeKeyNum;
 
     if ( m_isMonophonic )
     {
         m_sampler.addVoice( new ShurikenSamplerVoice() );
     }
 
-    for ( int i = 0;  i < sampleBufferList.size() && i < Midi::MAX_POLYPHONY; i++ )
+    // Slices beyond Midi::NUM_KEYS have no key to play on. MainWindow won't create that many
+    // and warns about projects that have them
+    for ( int i = 0;  i < sampleBufferList.size() && i < Midi::NUM_KEYS; i++ )
     {
-        if ( ! m_isMonophonic )
+        // Every voice is visited for each note-on and block rendered, so beyond MAX_POLYPHONY
+        // the quietest voice is stolen rather than adding more
+        if ( ! m_isMonophonic && i < Midi::MAX_POLYPHONY )
         {
             m_sampler.addVoice( new ShurikenSamplerVoice() );
         }
@@ -85,6 +94,89 @@ void SamplerAudioSource::setSamples( const QList<SharedSampleBuffer> sampleBuffe
 
 
 
+bool SamplerAudioSource::replaceSampleData( const QList<SharedSampleBuffer> sampleBufferList )
+{
+    if ( sampleBufferList.size() != m_sampleBufferList.size() )
+    {
+        return false;
+    }
+
+    for ( int i = 0; i < sampleBufferList.size(); i++ )
+    {
+        if ( sampleBufferList.at( i )->getNumFrames() != m_sampleBufferList.at( i )->getNumFrames() ||
+             sampleBufferList.at( i )->getNumChannels() != m_sampleBufferList.at( i )->getNumChannels() )
+        {
+            return false;
+        }
+    }
+
+    // The scrub voice reads the current samples without taking the sampler's lock
+    m_scrubVoice.clear();
+
+    foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
+    {
+        MemoryLocker::lock( *sampleBuffer );
+    }
+
+    setSoundSampleBuffers( sampleBufferList );
+
+    foreach ( SharedSampleBuffer sampleBuffer, m_sampleBufferList )
+    {
+        MemoryLocker::unlock( *sampleBuffer );
+    }
+
+    m_sampleBufferList = sampleBufferList;
+
+    return true;
+}
+
+
+
+void SamplerAudioSource::clearSamples()
+{
+    m_isPlaying = false;
+    m_isInputNoteMapEnabled = false;
+    m_scrubVoice.clear();
+    m_sampler.clearVoices();
+    m_sampler.clearSamplerSounds();
+
+    foreach ( SharedSampleBuffer sampleBuffer, m_sampleBufferList )
+    {
+        MemoryLocker::unlock( *sampleBuffer );
+    }
+
+    m_sampleBufferList.clear();
+    m_nextFreeKeyNum = Midi::MIDDLE_C;
+    m_lowestAssignedKeyNum = Midi::MIDDLE_C;
+}
+
+
+
+void SamplerAudioSource::setInputNoteMap( const QList<int> noteNums )
+{
+    m_isInputNoteMapEnabled = false;
+
+    for ( int inputNoteNum = 0; inputNoteNum < NUM_MIDI_NOTES; inputNoteNum++ )
+    {
+        m_inputNoteMap[ inputNoteNum ] = -1;
+    }
+
+    for ( int sampleNum = 0; sampleNum < noteNums.size(); sampleNum++ )
+    {
+        const int inputNoteNum = noteNums.at( sampleNum );
+        const int sampleKeyNum = m_lowestAssignedKeyNum + sampleNum;
+
+        if ( inputNoteNum >= 0 && inputNoteNum < NUM_MIDI_NOTES && sampleKeyNum < Midi::NUM_KEYS )
+        {
+            m_inputNoteMap[ inputNoteNum ] = sampleKeyNum;
+        }
+    }
+
+    m_isInputNoteMapEnabled = ! noteNums.isEmpty();
+}
+
+
+
 void SamplerAudioSource::playSample( const int sampleNum, const SharedSampleRange sampleRange )
 {
     if ( m_isPlaying )
@@ -92,10 +184,10 @@ void SamplerAudioSource::playSample( const int sampleNum, const SharedSampleRang
         stop();
     }
     m_tempSampleRange = sampleRange;
-    m_seqStartNote = m_lowestAssignedNote + sampleNum;
+    m_seqStartKeyNum = m_lowestAssignedKeyNum + sampleNum;
     m_noteCounter = 0;
     m_noteCounterEnd = 1;
-    m_frameCounter = 0;
+    m_sequenceClock.reset();
     m_isPlaying = true;
 }
 
@@ -107,10 +199,10 @@ void SamplerAudioSource::playAll()
     {
         stop();
     }
-    m_seqStartNote = m_lowestAssignedNote;
+    m_seqStartKeyNum = m_lowestAssignedKeyNum;
     m_noteCounter = 0;
     m_noteCounterEnd = m_sampleBufferList.size();
-    m_frameCounter = 0;
+    m_sequenceClock.reset();
     m_isPlaying = true;
 }
 
@@ -118,7 +210,7 @@ void SamplerAudioSource::playAll()
 
 void SamplerAudioSource::stop()
 {
-    const int midiChannel = 1;
+    const int midiChannel = 0; // All channels
     const bool allowTailOff = false;
 
     m_isPlaying = false;
@@ -135,6 +227,30 @@ void SamplerAudioSource::setLooping( const bool isLoopingDesired )
 
 
 
+void SamplerAudioSource::scrub( const int sampleNum, const FrameNum frameNum )
+{
+    if ( sampleNum >= 0 && sampleNum < m_sampleBufferList.size() )
+    {
+        m_scrubVoice.setPosition( m_sampleBufferList.at( sampleNum ), m_fileSampleRate, frameNum );
+    }
+}
+
+
+
+void SamplerAudioSource::stopScrubbing()
+{
+    m_scrubVoice.stop();
+}
+
+
+
+void SamplerAudioSource::renderScrubVoice( const AudioSourceChannelInfo& info )
+{
+    m_scrubVoice.renderNextBlock( *info.buffer, info.startSample, info.numSamples );
+}
+
+
+
 qreal SamplerAudioSource::getAttack( const int sampleNum ) const
 {
     qreal value = 0.0;
@@ -276,11 +392,28 @@ int SamplerAudioSource::getOutputPairNum( const int sampleNum ) const
 
 
 
+void SamplerAudioSource::setChokeGroup( const int sampleNum, const int groupNum )
+{
+    SynthesiserSound* sound = m_sampler.getSound( sampleNum );
+
+    ShurikenSamplerSound* const samplerSound = static_cast<ShurikenSamplerSound*>( sound );
+
+    if ( samplerSound != NULL )
+    {
+        samplerSound->setChokeGroup( groupNum );
+    }
+}
+
+
+
 void SamplerAudioSource::prepareToPlay( int /*samplesPerBlockExpected*/, double sampleRate )
 {
     m_playbackSampleRate = sampleRate;
     m_midiCollector.reset( sampleRate );
+    m_midiBuffer.ensureSize( 2048 );
+    m_remappedMidiBuffer.ensureSize( 2048 );
     m_sampler.setCurrentPlaybackSampleRate( sampleRate );
+    m_scrubVoice.setPlaybackSampleRate( sampleRate );
 }
 
 
@@ -296,12 +429,15 @@ void SamplerAudioSource::releaseResources()
 void SamplerAudioSource::getNextAudioBlock( const AudioSourceChannelInfo& info )
 {
     getNextAudioBlock( info, m_midiBuffer );
+    renderScrubVoice( info );
 }
 
 
 
 void SamplerAudioSource::getNextAudioBlock( const AudioSourceChannelInfo& info, MidiBuffer& midiBuffer )
 {
+    const RealtimeChecker::ScopedRealtimeContext realtimeContext;
+
     // The sampler always adds its output to the audio buffer, so we have to clear it first
     info.clearActiveBufferRegion();
 
@@ -315,70 +451,72 @@ void SamplerAudioSource::getNextAudioBlock( const AudioSourceChannelInfo& info,
     }
     else
     {
+        // The collector's lock is private and is only held briefly by the MIDI input thread
+        const RealtimeChecker::ScopedLockAllowance allowance;
         m_midiCollector.removeNextBlockOfMessages( midiBuffer, info.numSamples );
     }
 
+    if ( m_isInputNoteMapEnabled )
+    {
+        remapInputNotes( midiBuffer );
+    }
+
 
     // If requested, play all samples in sequence by adding appropriate MIDI messages to the buffer
     if ( m_isPlaying )
     {
-        // End of note
-        if ( m_frameCounter > 0 && m_frameCounter <= info.numSamples )
-        {
-            m_noteCounter++;
+        m_sequenceClock.setSampleRates( m_fileSampleRate, m_playbackSampleRate );
 
-            if ( m_noteCounter == m_noteCounterEnd )
+        // A block can hold any no. of note-ons when the slices are short
+        while ( m_isPlaying && m_sequenceClock.isNoteOnDue( info.numSamples ) )
+        {
+            // End of sequence
+            if ( m_noteCounter >= m_noteCounterEnd )
             {
-                if ( m_isLoopingEnabled )
+                if ( m_isLoopingEnabled && m_noteCounterEnd > 0 )
                 {
                     m_noteCounter = 0;
                 }
                 else
                 {
-                    m_isPlaying = false;  // End of sequence reached
+                    m_isPlaying = false;
                     m_tempSampleRange.clear();
+                    break;
                 }
             }
-        }
 
-        if ( m_isPlaying )
-        {
-            // Start of note
-            if ( m_frameCounter < info.numSamples )
-            {
-                const MidiMessage message = MidiMessage::noteOn( 1,                                 // MIDI channel
-                                                                 m_seqStartNote + m_noteCounter,    // MIDI note no.
-                                                                 1.0f );                            // Velocity
-                const int noteOnFrameNum = m_frameCounter;
+            const int keyNum = m_seqStartKeyNum + m_noteCounter;
 
-                midiBuffer.addEvent( message, noteOnFrameNum );
+            const MidiMessage message = MidiMessage::noteOn( Midi::getChannel( keyNum ),   // MIDI channel
+                                                             Midi::getNoteNum( keyNum ),   // MIDI note no.
+                                                             1.0f );                       // Velocity
 
-                int numFrames = 0;
+            midiBuffer.addEvent( message, m_sequenceClock.getNoteOnOffset() );
 
-                if ( ! m_tempSampleRange.isNull() )
-                {
-                    SynthesiserSound* sound = m_sampler.getSound( m_seqStartNote - m_lowestAssignedNote + m_noteCounter );
+            FrameNum numFrames = 0;
 
-                    ShurikenSamplerSound* const samplerSound = static_cast<ShurikenSamplerSound*>( sound );
+            if ( ! m_tempSampleRange.isNull() )
+            {
+                SynthesiserSound* sound = m_sampler.getSound( keyNum - m_lowestAssignedKeyNum );
 
-                    if ( samplerSound != NULL )
-                    {
-                        samplerSound->setTempSampleRange( m_tempSampleRange );
-                    }
-                    numFrames = m_tempSampleRange->numFrames;
-                }
-                else
+                ShurikenSamplerSound* const samplerSound = static_cast<ShurikenSamplerSound*>( sound );
+
+                if ( samplerSound != NULL )
                 {
-                    numFrames = m_sampleBufferList.at( m_noteCounter )->getNumFrames();
+                    samplerSound->setTempSampleRange( m_tempSampleRange );
                 }
-                m_frameCounter = static_cast<int>( numFrames * (m_playbackSampleRate / m_fileSampleRate) );
-                m_frameCounter -= info.numSamples - noteOnFrameNum;
+                numFrames = m_tempSampleRange->numFrames;
             }
-            else // Middle of note
+            else
             {
-                m_frameCounter -= info.numSamples;
+                numFrames = m_sampleBufferList.at( m_noteCounter )->getNumFrames();
             }
+
+            m_sequenceClock.addNote( numFrames );
+            m_noteCounter++;
         }
+
+        m_sequenceClock.advanceBlock( info.numSamples );
     }
 
 
@@ -405,6 +543,13 @@ void SamplerAudioSource::setOutputPair( const int sampleNum, const int outputPai
 
 
 
+void SamplerAudioSource::setVoiceLimit( const int maxNumVoices )
+{
+    m_sampler.setVoiceLimit( maxNumVoices );
+}
+
+
+
 //==================================================================================================
 // Private:
 
@@ -412,18 +557,22 @@ bool SamplerAudioSource::addNewSoundToSampler( const SharedSampleBuffer sampleBu
 {
     bool isSampleAssignedToKey = false;
 
-    if ( m_nextFreeNote < Midi::MAX_POLYPHONY )
+    if ( m_nextFreeKeyNum < Midi::NUM_KEYS )
     {
+        const int midiChannel = Midi::getChannel( m_nextFreeKeyNum );
+        const int midiNoteNum = Midi::getNoteNum( m_nextFreeKeyNum );
+
         BigInteger noteNum;
         noteNum.clear();
-        noteNum.setBit( m_nextFreeNote );
+        noteNum.setBit( midiNoteNum );
 
-        m_sampler.addSound( new ShurikenSamplerSound( sampleBuffer,
-                                                      sampleRate,
-                                                      noteNum,           // MIDI note this sample should be assigned to
-                                                      m_nextFreeNote )); // Root/pitch-centre MIDI note
+        m_sampler.addSamplerSound( new ShurikenSamplerSound( sampleBuffer,
+                                                             sampleRate,
+                                                             midiChannel,
+                                                             noteNum,          // MIDI note this sample should be assigned to
+                                                             midiNoteNum ));   // Root/pitch-centre MIDI note
 
-        m_nextFreeNote++;
+        m_nextFreeKeyNum++;
         isSampleAssignedToKey = true;
     }
 
@@ -432,12 +581,46 @@ bool SamplerAudioSource::addNewSoundToSampler( const SharedSampleBuffer sampleBu
 
 
 
-void SamplerAudioSource::clearSamples()
+void SamplerAudioSource::setSoundSampleBuffers( const QList<SharedSampleBuffer>& sampleBufferList )
 {
-    m_isPlaying = false;
-    m_sampler.clearVoices();
-    m_sampler.clearSounds();
-    m_sampleBufferList.clear();
-    m_nextFreeNote = Midi::MIDDLE_C;
-    m_lowestAssignedNote = Midi::MIDDLE_C;
+    const ScopedLock renderLock( m_sampler.getLock() );
+
+    for ( int i = 0; i < sampleBufferList.size(); i++ )
+    {
+        ShurikenSamplerSound* const samplerSound = static_cast<ShurikenSamplerSound*>( m_sampler.getSound( i ) );
+
+        if ( samplerSound != NULL )
+        {
+            samplerSound->setSampleBuffer( sampleBufferList.at( i ) );
+        }
+    }
+}
+
+
+
+void SamplerAudioSource::remapInputNotes( MidiBuffer& midiBuffer )
+{
+    m_remappedMidiBuffer.clear();
+
+    MidiBuffer::Iterator iterator( midiBuffer );
+    MidiMessage message;
+    int frameNum;
+
+    while ( iterator.getNextEvent( message, frameNum ) )
+    {
+        if ( message.isNoteOnOrOff() || message.isAftertouch() )
+        {
+            const int mappedKeyNum = m_inputNoteMap[ message.getNoteNumber() ];
+
+            if ( mappedKeyNum >= 0 )
+            {
+                message.setChannel( Midi::getChannel( mappedKeyNum ) );
+                message.setNoteNumber( Midi::getNoteNum( mappedKeyNum ) );
+            }
+        }
+
+        m_remappedMidiBuffer.addEvent( message, frameNum );
+    }
+
+    midiBuffer.swapWith( m_remappedMidiBuffer );
 }
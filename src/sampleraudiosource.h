@@ -25,6 +25,9 @@
 
 #include "JuceHeader.h"
 #include "samplebuffer.h"
+#include "sequenceclock.h"
+#include "shurikensampler.h"
+#include "scrubvoice.h"
 #include <QObject>
 
 
@@ -38,11 +41,30 @@ public:
 
     void setSamples( QList<SharedSampleBuffer> sampleBufferList, qreal sampleRate );
 
+    // Play other buffers in place of the current samples without stopping playback, e.g. to replace a
+    // time stretch preview. 'sampleBufferList' should be built beforehand, off the audio thread, and not
+    // changed afterwards; buffers that aren't being replaced can be passed as they are. Returns false,
+    // leaving the samples unchanged, unless every buffer matches the size and no. of channels of the
+    // sample it replaces
+    bool replaceSampleData( QList<SharedSampleBuffer> sampleBufferList );
+
+    // Remove all samples from the sampler, e.g. before resizing their buffers. Call setSamples() afterwards
+    void clearSamples();
+
     void playSample( int sampleNum, SharedSampleRange sampleRange );
     void playAll();
     void stop();
     void setLooping( bool isLoopingDesired );
 
+    // Play short grains of a sample around 'frameNum', e.g. while a slice point is being dragged.
+    // The sampler's sounds are left alone, so this is cheap enough to call on every mouse move
+    void scrub( int sampleNum, FrameNum frameNum );
+    void stopScrubbing();
+
+    // Mix the scrub voice into 'info'. The single argument getNextAudioBlock() does this itself; an audio
+    // source that processes the output of the two argument version should call this afterwards
+    void renderScrubVoice( const AudioSourceChannelInfo& info );
+
     qreal getAttack( int sampleNum ) const;
     void setAttack( int sampleNum, qreal value );   // Value should be 0.00 - 1.00
 
@@ -64,7 +86,18 @@ public:
 
     int getOutputPairNum( int sampleNum ) const;
 
-    int getLowestAssignedMidiNote() const           { return m_lowestAssignedNote; }
+    // Slices sharing a choke group > 0 cut each other off; 0 means no choke group
+    void setChokeGroup( int sampleNum, int groupNum );
+
+    // Slices are assigned to consecutive keys from this one, see Midi::getKeyNum().
+    // A key no. is the same as the MIDI note no. on channel 1
+    int getLowestAssignedMidiNote() const           { return m_lowestAssignedKeyNum; }
+
+    // Route incoming MIDI notes to slices by an alternative note no., e.g. a General MIDI drum note.
+    // 'noteNums' holds a note for each slice, or -1 to leave that slice on its usual note only.
+    // Input notes in the map are remapped on any channel, those not in the map pass through unchanged. An empty list clears the map.
+    // The map is also cleared whenever setSamples() is called
+    void setInputNoteMap( QList<int> noteNums );
 
     MidiMessageCollector* getMidiMessageCollector() { return &m_midiCollector; }
 
@@ -79,9 +112,17 @@ public:
 public slots:
     void setOutputPair( int sampleNum, int outputPairNum );
 
+    // Limit the number of voices that can play at once, to bound the time taken to render each
+    // block. The quietest voices are faded out to make room for new notes. 0 means no limit
+    void setVoiceLimit( int maxNumVoices );
+
 private:
     bool addNewSoundToSampler( SharedSampleBuffer sampleBuffer, qreal sampleRate );
-    void clearSamples();
+
+    // Holds the sampler's lock only for as long as it takes to swap buffer pointers
+    void setSoundSampleBuffers( const QList<SharedSampleBuffer>& sampleBufferList );
+
+    void remapInputNotes( MidiBuffer& midiBuffer );
 
     const bool m_isMonophonic;
 
@@ -92,19 +133,25 @@ private:
     volatile qreal m_playbackSampleRate;
 
     MidiBuffer m_midiBuffer;
+    MidiBuffer m_remappedMidiBuffer;
     MidiMessageCollector m_midiCollector;
 
-    Synthesiser m_sampler;
+    static const int NUM_MIDI_NOTES = 128;
+    volatile int m_inputNoteMap[ NUM_MIDI_NOTES ];  // Key nos., -1 where there's no mapping
+    volatile bool m_isInputNoteMapEnabled;
+
+    ShurikenSampler m_sampler;
+    ScrubVoice m_scrubVoice;
 
-    int m_nextFreeNote;
-    volatile int m_lowestAssignedNote;
+    int m_nextFreeKeyNum;
+    volatile int m_lowestAssignedKeyNum;
 
     volatile bool m_isPlaying;
     volatile bool m_isLoopingEnabled;
-    volatile int m_seqStartNote;
+    volatile int m_seqStartKeyNum;
     volatile int m_noteCounter;
     volatile int m_noteCounterEnd;
-    volatile int m_frameCounter;
+    SequenceClock m_sequenceClock;
 
     AudioIODevice* const m_jackDevice;
 
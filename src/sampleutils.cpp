@@ -59,7 +59,7 @@ SharedSampleBuffer SampleUtils::joinSampleBuffers( const QList<SharedSampleBuffe
 
 
 QList<SharedSampleBuffer> SampleUtils::splitSampleBuffer( const SharedSampleBuffer sampleBuffer,
-                                                          QList<int> slicePointFrameNums )
+                                                          QList<FrameNum> slicePointFrameNums )
 {
     Q_ASSERT( ! slicePointFrameNums.isEmpty() );
 
@@ -67,7 +67,7 @@ QList<SharedSampleBuffer> SampleUtils::splitSampleBuffer( const SharedSampleBuff
 
     qSort( slicePointFrameNums );
 
-    const int totalNumFrames = sampleBuffer->getNumFrames();
+    const FrameNum totalNumFrames = sampleBuffer->getNumFrames();
 
     if ( slicePointFrameNums.last() != totalNumFrames )
     {
@@ -78,11 +78,11 @@ QList<SharedSampleBuffer> SampleUtils::splitSampleBuffer( const SharedSampleBuff
 
     int startFrame = 0;
 
-    foreach ( int frameNum, slicePointFrameNums )
+    foreach ( FrameNum frameNum, slicePointFrameNums )
     {
         if( frameNum <= totalNumFrames )
         {
-            const int numFrames = frameNum - startFrame;
+            const int numFrames = static_cast<int>( frameNum - startFrame );
 
             if ( numFrames > 0 )
             {
@@ -105,9 +105,9 @@ QList<SharedSampleBuffer> SampleUtils::splitSampleBuffer( const SharedSampleBuff
 
 
 
-int SampleUtils::getTotalNumFrames( const QList<SharedSampleBuffer> sampleBufferList )
+FrameNum SampleUtils::getTotalNumFrames( const QList<SharedSampleBuffer> sampleBufferList )
 {
-    int numFrames = 0;
+    FrameNum numFrames = 0;
 
     foreach ( SharedSampleBuffer sampleBuffer, sampleBufferList )
     {
@@ -119,7 +119,7 @@ int SampleUtils::getTotalNumFrames( const QList<SharedSampleBuffer> sampleBuffer
 
 
 
-int SampleUtils::getPrevZeroCrossing( const SharedSampleBuffer sampleBuffer, const int startFrameNum )
+FrameNum SampleUtils::getPrevZeroCrossing( const SharedSampleBuffer sampleBuffer, const FrameNum startFrameNum )
 {
     int zeroCrossingFrameNum = 0;
 
@@ -131,7 +131,7 @@ int SampleUtils::getPrevZeroCrossing( const SharedSampleBuffer sampleBuffer, con
 
         for ( int chanNum = 0; chanNum < numChans; ++chanNum )
         {
-            int frameNum = startFrameNum;
+            int frameNum = static_cast<int>( startFrameNum );
 
             // If the value of the start sample is positive then find the previous negative sample
             if ( sampleBuffer->getSample( chanNum, startFrameNum ) > 0.0f )
@@ -169,7 +169,7 @@ int SampleUtils::getPrevZeroCrossing( const SharedSampleBuffer sampleBuffer, con
 
 
 
-int SampleUtils::getNextZeroCrossing( const SharedSampleBuffer sampleBuffer, const int startFrameNum )
+FrameNum SampleUtils::getNextZeroCrossing( const SharedSampleBuffer sampleBuffer, const FrameNum startFrameNum )
 {
     int zeroCrossingFrameNum = sampleBuffer->getNumFrames() - 1;
 
@@ -181,7 +181,7 @@ int SampleUtils::getNextZeroCrossing( const SharedSampleBuffer sampleBuffer, con
 
         for ( int chanNum = 0; chanNum < numChans; ++chanNum )
         {
-            int frameNum = startFrameNum;
+            int frameNum = static_cast<int>( startFrameNum );
 
             // If the value of the start sample is positive then find the next negative sample
             if ( sampleBuffer->getSample( chanNum, startFrameNum ) > 0.0f )
@@ -219,10 +219,10 @@ int SampleUtils::getNextZeroCrossing( const SharedSampleBuffer sampleBuffer, con
 
 
 
-int SampleUtils::getClosestZeroCrossing( const SharedSampleBuffer sampleBuffer, const int startFrameNum )
+FrameNum SampleUtils::getClosestZeroCrossing( const SharedSampleBuffer sampleBuffer, const FrameNum startFrameNum )
 {
-    const int prevZeroCrossing = getPrevZeroCrossing( sampleBuffer, startFrameNum );
-    const int nextZeroCrossing = getNextZeroCrossing( sampleBuffer, startFrameNum );
+    const FrameNum prevZeroCrossing = getPrevZeroCrossing( sampleBuffer, startFrameNum );
+    const FrameNum nextZeroCrossing = getNextZeroCrossing( sampleBuffer, startFrameNum );
 
     if ( startFrameNum - prevZeroCrossing < nextZeroCrossing - startFrameNum )
     {
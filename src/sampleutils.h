@@ -33,15 +33,15 @@ public:
 
     // Split a sample buffer into multiple sample buffers at the specified slice points.
     // Slice points greater than or equal to the length of the sample buffer are ignored
-    static QList<SharedSampleBuffer> splitSampleBuffer( SharedSampleBuffer sampleBuffer, QList<int> slicePointFrameNums );
+    static QList<SharedSampleBuffer> splitSampleBuffer( SharedSampleBuffer sampleBuffer, QList<FrameNum> slicePointFrameNums );
 
-    static int getTotalNumFrames( QList<SharedSampleBuffer> sampleBufferList );
+    static FrameNum getTotalNumFrames( QList<SharedSampleBuffer> sampleBufferList );
 
-    static int getPrevZeroCrossing( SharedSampleBuffer sampleBuffer, int startFrameNum );
+    static FrameNum getPrevZeroCrossing( SharedSampleBuffer sampleBuffer, FrameNum startFrameNum );
 
-    static int getNextZeroCrossing( SharedSampleBuffer sampleBuffer, int startFrameNum );
+    static FrameNum getNextZeroCrossing( SharedSampleBuffer sampleBuffer, FrameNum startFrameNum );
 
-    static int getClosestZeroCrossing( SharedSampleBuffer sampleBuffer, int startFrameNum );
+    static FrameNum getClosestZeroCrossing( SharedSampleBuffer sampleBuffer, FrameNum startFrameNum );
 };
 
 
@@ -0,0 +1,200 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "scrubvoice.h"
+#include "realtimechecker.h"
+
+
+//==================================================================================================
+// Public:
+
+ScrubVoice::ScrubVoice() :
+    m_sourceSampleRate( 0.0 ),
+    m_playbackSampleRate( 0.0 ),
+    m_targetFrameNum( 0 ),
+    m_isScrubbing( false ),
+    m_lastGrainCentreFrameNum( -1 ),
+    m_numFramesUntilNextGrain( 0 )
+{
+    for ( int i = 0; i < NUM_GRAINS; i++ )
+    {
+        m_grains[ i ].sourcePos = 0.0;
+        m_grains[ i ].frameNum = 0;
+        m_grains[ i ].isActive = false;
+    }
+}
+
+
+
+void ScrubVoice::setPosition( const SharedSampleBuffer sampleBuffer, const qreal sampleRate, const FrameNum frameNum )
+{
+    if ( sampleBuffer != m_sampleBuffer || sampleRate != m_sourceSampleRate )
+    {
+        const SpinLock::ScopedLockType lock( m_lock );
+
+        m_sampleBuffer = sampleBuffer;
+        m_sourceSampleRate = sampleRate;
+        m_lastGrainCentreFrameNum = -1;
+
+        for ( int i = 0; i < NUM_GRAINS; i++ )
+        {
+            m_grains[ i ].isActive = false;
+        }
+    }
+
+    m_targetFrameNum = frameNum;
+    m_isScrubbing = true;
+}
+
+
+
+void ScrubVoice::clear()
+{
+    const SpinLock::ScopedLockType lock( m_lock );
+
+    m_isScrubbing = false;
+    m_sampleBuffer.clear();
+    m_lastGrainCentreFrameNum = -1;
+
+    for ( int i = 0; i < NUM_GRAINS; i++ )
+    {
+        m_grains[ i ].isActive = false;
+    }
+}
+
+
+
+void ScrubVoice::renderNextBlock( AudioSampleBuffer& outputBuffer, const int startFrame, const int numFrames )
+{
+    const RealtimeChecker::ScopedRealtimeContext realtimeContext;
+
+    const GenericScopedTryLock<SpinLock> tryLock( m_lock );
+
+    if ( ! tryLock.isLocked() || m_sampleBuffer.isNull() || m_playbackSampleRate <= 0.0 )
+    {
+        return;
+    }
+
+    const SampleBuffer& sampleBuffer = *m_sampleBuffer;
+    const FrameNum numSourceFrames = sampleBuffer.getNumFrames();
+    const int numSourceChans = sampleBuffer.getNumChannels();
+    const int numOutputChans = jmin( outputBuffer.getNumChannels(), 2 );
+
+    if ( numSourceFrames < 2 || numSourceChans == 0 )
+    {
+        return;
+    }
+
+    const double pitchRatio = m_sourceSampleRate / m_playbackSampleRate;
+    const int grainLength = jmax( 2, roundToInt( GRAIN_SECS * m_playbackSampleRate ) );
+
+    // Grains overlap by half, so their Hann windows sum to a constant gain
+    const int numFramesBetweenGrains = ( grainLength + 1 ) / NUM_GRAINS;
+
+    for ( int frameNum = 0; frameNum < numFrames; frameNum++ )
+    {
+        if ( m_numFramesUntilNextGrain <= 0 )
+        {
+            startGrain( numSourceFrames, grainLength, pitchRatio );
+            m_numFramesUntilNextGrain = numFramesBetweenGrains;
+        }
+        m_numFramesUntilNextGrain--;
+
+        for ( int i = 0; i < NUM_GRAINS; i++ )
+        {
+            Grain& grain = m_grains[ i ];
+
+            if ( ! grain.isActive )
+            {
+                continue;
+            }
+
+            const float gain = 0.5f - 0.5f * std::cos( float_Pi * 2.0f * grain.frameNum / grainLength );
+            const FrameNum sourceFrameNum = static_cast<FrameNum>( grain.sourcePos );
+            const float fraction = static_cast<float>( grain.sourcePos - sourceFrameNum );
+
+            for ( int chanNum = 0; chanNum < numOutputChans; chanNum++ )
+            {
+                const float* const source = sampleBuffer.getReadPointer( jmin( chanNum, numSourceChans - 1 ) );
+
+                const float sample = source[ sourceFrameNum ] + fraction * ( source[ sourceFrameNum + 1 ] - source[ sourceFrameNum ] );
+
+                outputBuffer.addSample( chanNum, startFrame + frameNum, sample * gain );
+            }
+
+            grain.sourcePos += pitchRatio;
+            grain.frameNum++;
+
+            if ( grain.frameNum >= grainLength || grain.sourcePos >= numSourceFrames - 1 )
+            {
+                grain.isActive = false;
+            }
+        }
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void ScrubVoice::startGrain( const FrameNum numSourceFrames, const int grainLength, const double pitchRatio )
+{
+    const FrameNum centreFrameNum = m_targetFrameNum;
+
+    if ( ! m_isScrubbing )
+    {
+        m_lastGrainCentreFrameNum = -1;
+        return;
+    }
+
+    if ( centreFrameNum == m_lastGrainCentreFrameNum )
+    {
+        return;
+    }
+
+    // Normally the earlier grain has just finished; if not, it's the one nearest its end
+    Grain* freeGrain = &m_grains[ 0 ];
+
+    for ( int i = 0; i < NUM_GRAINS; i++ )
+    {
+        if ( ! m_grains[ i ].isActive )
+        {
+            freeGrain = &m_grains[ i ];
+            break;
+        }
+
+        if ( m_grains[ i ].frameNum > freeGrain->frameNum )
+        {
+            freeGrain = &m_grains[ i ];
+        }
+    }
+
+    const double startPos = centreFrameNum - 0.5 * grainLength * pitchRatio;
+
+    freeGrain->sourcePos = jlimit( 0.0, static_cast<double>( numSourceFrames - 2 ), startPos );
+    freeGrain->frameNum = 0;
+    freeGrain->isActive = true;
+
+    m_lastGrainCentreFrameNum = centreFrameNum;
+}
@@ -0,0 +1,85 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef SCRUBVOICE_H
+#define SCRUBVOICE_H
+
+#include "JuceHeader.h"
+#include "samplebuffer.h"
+
+
+// Gives audio feedback while a position in a sample is being dragged about, by playing short
+// overlapping grains of the sample centred on the latest position. A new grain starts every
+// GRAIN_SECS / 2, so a change of position is heard within that time plus one audio block.
+// No grains are started while the position stays still.
+// The sample buffer is set on the GUI thread with a lock held; the audio thread only tries the lock,
+// and renders nothing for a block if it's unavailable, so rendering never blocks or allocates
+
+class ScrubVoice
+{
+public:
+    ScrubVoice();
+
+    void setPlaybackSampleRate( qreal sampleRate )  { m_playbackSampleRate = sampleRate; }
+
+    // GUI thread only. Grains already playing fade out as usual
+    void setPosition( SharedSampleBuffer sampleBuffer, qreal sampleRate, FrameNum frameNum );
+    void stop()                                     { m_isScrubbing = false; }
+
+    // GUI thread only. Stops immediately and releases the sample buffer
+    void clear();
+
+    // Audio thread only. Adds the grains to the first two channels of 'outputBuffer'
+    void renderNextBlock( AudioSampleBuffer& outputBuffer, int startFrame, int numFrames );
+
+private:
+    static constexpr double GRAIN_SECS = 0.008;
+    static const int NUM_GRAINS = 2;
+
+    void startGrain( FrameNum numSourceFrames, int grainLength, double pitchRatio );
+
+    struct Grain
+    {
+        double sourcePos;
+        int frameNum;
+        bool isActive;
+    };
+
+    SpinLock m_lock;
+    SharedSampleBuffer m_sampleBuffer;      // Only changed with m_lock held
+    qreal m_sourceSampleRate;               // Only changed with m_lock held
+
+    volatile qreal m_playbackSampleRate;
+    volatile FrameNum m_targetFrameNum;
+    volatile bool m_isScrubbing;
+
+    // Audio thread state
+    Grain m_grains[ NUM_GRAINS ];
+    FrameNum m_lastGrainCentreFrameNum;
+    int m_numFramesUntilNextGrain;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( ScrubVoice );
+};
+
+#endif // SCRUBVOICE_H
@@ -0,0 +1,90 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "sequenceclock.h"
+
+
+//==================================================================================================
+// Public:
+
+SequenceClock::SequenceClock() :
+    m_sourceSampleRate( 0 ),
+    m_playbackSampleRate( 0 ),
+    m_sourceFrameNum( 0 ),
+    m_noteOnFrameNum( 0 ),
+    m_blockStartFrameNum( 0 ),
+    m_originSourceFrameNum( 0 ),
+    m_originPlaybackFrameNum( 0 )
+{
+}
+
+
+
+void SequenceClock::setSampleRates( const qreal sourceSampleRate, const qreal playbackSampleRate )
+{
+    const qint64 newSourceSampleRate = roundToFrameNum( sourceSampleRate );
+    const qint64 newPlaybackSampleRate = roundToFrameNum( playbackSampleRate );
+
+    if ( newSourceSampleRate != m_sourceSampleRate || newPlaybackSampleRate != m_playbackSampleRate )
+    {
+        m_originSourceFrameNum = m_sourceFrameNum;
+        m_originPlaybackFrameNum = m_noteOnFrameNum;
+
+        m_sourceSampleRate = newSourceSampleRate;
+        m_playbackSampleRate = newPlaybackSampleRate;
+    }
+}
+
+
+
+void SequenceClock::reset()
+{
+    m_sourceFrameNum = 0;
+    m_noteOnFrameNum = 0;
+    m_blockStartFrameNum = 0;
+    m_originSourceFrameNum = 0;
+    m_originPlaybackFrameNum = 0;
+}
+
+
+
+void SequenceClock::addNote( const FrameNum numSourceFrames )
+{
+    m_sourceFrameNum += numSourceFrames;
+
+    // Always move forward by at least one frame so that empty slices can't stall the sequence
+    m_noteOnFrameNum = qMax( getPlaybackFrameNum( m_sourceFrameNum ), m_noteOnFrameNum + 1 );
+}
+
+
+
+FrameNum SequenceClock::getPlaybackFrameNum( const FrameNum sourceFrameNum ) const
+{
+    if ( m_sourceSampleRate <= 0 || m_playbackSampleRate <= 0 )
+    {
+        return m_originPlaybackFrameNum + ( sourceFrameNum - m_originSourceFrameNum );
+    }
+
+    // Integer arithmetic keeps this exact, and at 192 kHz it only overflows after several years of audio
+    return m_originPlaybackFrameNum +
+           ( sourceFrameNum - m_originSourceFrameNum ) * m_playbackSampleRate / m_sourceSampleRate;
+}
@@ -0,0 +1,75 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef SEQUENCECLOCK_H
+#define SEQUENCECLOCK_H
+
+#include "samplebuffer.h"
+
+
+// Keeps track of when each note in a sequence of slices should start.  The sequence position is
+// held as a whole no. of source frames and is only converted to playback frames when a note-on is
+// scheduled, so rounding never accumulates from note to note or from one loop to the next
+class SequenceClock
+{
+public:
+    SequenceClock();
+
+    // Sample rates are rounded to a whole no. of frames per second. If the rates change while a
+    // sequence is playing, conversion restarts from the next scheduled note-on
+    void setSampleRates( qreal sourceSampleRate, qreal playbackSampleRate );
+
+    // Schedule the first note-on at the start of the next block
+    void reset();
+
+    // Returns true if the next note-on falls inside a block of "numFrames" playback frames
+    bool isNoteOnDue( int numFrames ) const     { return m_noteOnFrameNum < m_blockStartFrameNum + numFrames; }
+
+    // Offset of the next note-on from the start of the current block
+    int getNoteOnOffset() const                 { return static_cast<int>( m_noteOnFrameNum - m_blockStartFrameNum ); }
+
+    // Schedule the note-on after a slice that is "numSourceFrames" long
+    void addNote( FrameNum numSourceFrames );
+
+    void advanceBlock( int numFrames )          { m_blockStartFrameNum += numFrames; }
+
+    // Converts a position in source frames, measured from the start of the sequence, to playback frames
+    FrameNum getPlaybackFrameNum( FrameNum sourceFrameNum ) const;
+
+private:
+    qint64 m_sourceSampleRate;
+    qint64 m_playbackSampleRate;
+
+    FrameNum m_sourceFrameNum;          // Total length of all notes scheduled so far, in source frames
+    FrameNum m_noteOnFrameNum;          // Next note-on, in playback frames
+    FrameNum m_blockStartFrameNum;      // Start of the current block, in playback frames
+
+    // Positions at which the current sample rates came into effect
+    FrameNum m_originSourceFrameNum;
+    FrameNum m_originPlaybackFrameNum;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( SequenceClock );
+};
+
+
+#endif // SEQUENCECLOCK_H
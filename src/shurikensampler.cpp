@@ -54,12 +54,14 @@
 
 ShurikenSamplerSound::ShurikenSamplerSound( const SharedSampleBuffer sampleBuffer,
                                             const qreal sampleRate,
+                                            const int midiChannel,
                                             const BigInteger& notes,
                                             const int midiNoteForNormalPitch ) :
     m_sampleBuffer( sampleBuffer ),
     m_originalStartFrame( 0 ),
     m_originalEndFrame( sampleBuffer->getNumFrames() - 1 ),
     m_sourceSampleRate( sampleRate ),
+    m_midiChannel( midiChannel ),
     m_midiNotes( notes ),
     m_midiRootNote( midiNoteForNormalPitch ),
     m_attackValue( 0 ),
@@ -70,7 +72,8 @@ ShurikenSamplerSound::ShurikenSamplerSound( const SharedSampleBuffer sampleBuffe
     m_tempEndFrame( m_originalEndFrame ),
     m_isTempSampleRangeSet( false ),
     m_isOneShotSet( true ),
-    m_outputPairNum( 0 )
+    m_outputPairNum( 0 ),
+    m_chokeGroupNum( 0 )
 {
 }
 
@@ -118,6 +121,16 @@ void ShurikenSamplerSound::setOutputPair( int outputPairNum )
 
 
 
+void ShurikenSamplerSound::setSampleBuffer( const SharedSampleBuffer sampleBuffer )
+{
+    jassert( sampleBuffer->getNumFrames() == m_sampleBuffer->getNumFrames() );
+    jassert( sampleBuffer->getNumChannels() == m_sampleBuffer->getNumChannels() );
+
+    m_sampleBuffer = sampleBuffer;
+}
+
+
+
 void ShurikenSamplerSound::setTempSampleRange( const SharedSampleRange sampleRange )
 {
     m_tempStartFrame = sampleRange->startFrame;
@@ -135,9 +148,9 @@ bool ShurikenSamplerSound::appliesToNote( const int midiNoteNumber )
 
 
 
-bool ShurikenSamplerSound::appliesToChannel( const int /*midiChannel*/ )
+bool ShurikenSamplerSound::appliesToChannel( const int midiChannel )
 {
-    return true;
+    return midiChannel == m_midiChannel;
 }
 
 
@@ -150,7 +163,8 @@ ShurikenSamplerVoice::ShurikenSamplerVoice() :
     m_sourceSamplePosition( 0.0 ),
     m_leftGain( 0.0f ), m_rightGain( 0.0f ),
     m_attackReleaseLevel( 0 ), m_attackDelta( 0 ), m_releaseDelta( 0 ),
-    m_isInAttack( false ), m_isInRelease( false )
+    m_fadeOutLevel( 1.0f ), m_fadeOutDelta( 0 ),
+    m_isInAttack( false ), m_isInRelease( false ), m_isFadingOut( false )
 {
 }
 
@@ -195,6 +209,8 @@ void ShurikenSamplerVoice::startNote( const int midiNoteNumber,
 
         m_isInAttack =( numAttackFrames > 0 );
         m_isInRelease = false;
+        m_isFadingOut = false;
+        m_fadeOutLevel = 1.0f;
 
         if ( m_isInAttack )
         {
@@ -335,7 +351,22 @@ void ShurikenSamplerVoice::renderNextBlock( AudioSampleBuffer& outputBuffer, int
 
                 m_attackReleaseLevel += m_releaseDelta;
 
-                if ( m_attackReleaseLevel <= 0.0f )
+                // Cull the voice as soon as the rest of its release would be inaudible
+                if ( m_attackReleaseLevel * jmax( m_leftGain, m_rightGain ) <= INAUDIBLE_LEVEL )
+                {
+                    stopNote( 0.0f, false );
+                    break;
+                }
+            }
+
+            if ( m_isFadingOut )
+            {
+                l *= m_fadeOutLevel;
+                r *= m_fadeOutLevel;
+
+                m_fadeOutLevel -= m_fadeOutDelta;
+
+                if ( m_fadeOutLevel <= 0.0f )
                 {
                     stopNote( 0.0f, false );
                     break;
@@ -362,3 +393,255 @@ void ShurikenSamplerVoice::renderNextBlock( AudioSampleBuffer& outputBuffer, int
         }
     }
 }
+
+
+
+void ShurikenSamplerVoice::fadeOut()
+{
+    if ( isVoiceActive() && ! m_isFadingOut )
+    {
+        const int numFadeOutFrames = jmax( 1, roundToInt( FADE_OUT_SECS * getSampleRate() ) );
+
+        m_fadeOutDelta = 1.0f / numFadeOutFrames;
+        m_isFadingOut = true;
+    }
+}
+
+
+
+float ShurikenSamplerVoice::getLevel() const
+{
+    if ( ! isVoiceActive() )
+    {
+        return 0.0f;
+    }
+
+    // A voice in its attack phase is on its way to full level, so judge it by where it's heading
+    const float envelopeLevel = m_isInAttack ? 1.0f : m_attackReleaseLevel;
+
+    return envelopeLevel * m_fadeOutLevel * jmax( m_leftGain, m_rightGain );
+}
+
+
+
+ShurikenSamplerSound* ShurikenSamplerVoice::getPlayingSound() const
+{
+    return static_cast<ShurikenSamplerSound*>( getCurrentlyPlayingSound().get() );
+}
+
+
+
+//==================================================================================================
+// Public:
+
+ShurikenSampler::ShurikenSampler() :
+    Synthesiser(),
+    m_voiceLimit( 0 )
+{
+    for ( int keyNum = 0; keyNum < Midi::NUM_KEYS; keyNum++ )
+    {
+        m_soundsByKeyNum[ keyNum ] = NULL;
+    }
+}
+
+
+
+void ShurikenSampler::addSamplerSound( ShurikenSamplerSound* const sound )
+{
+    const ScopedLock sl( lock );
+
+    addSound( sound );
+
+    const BigInteger& noteNums = sound->getMidiNotes();
+    int noteNum = noteNums.findNextSetBit( 0 );
+
+    while ( noteNum >= 0 && noteNum < Midi::NUM_NOTES )
+    {
+        m_soundsByKeyNum[ Midi::getKeyNum( sound->getMidiChannel(), noteNum ) ] = sound;
+        noteNum = noteNums.findNextSetBit( noteNum + 1 );
+    }
+}
+
+
+
+void ShurikenSampler::clearSamplerSounds()
+{
+    const ScopedLock sl( lock );
+
+    for ( int keyNum = 0; keyNum < Midi::NUM_KEYS; keyNum++ )
+    {
+        m_soundsByKeyNum[ keyNum ] = NULL;
+    }
+
+    clearSounds();
+}
+
+
+
+void ShurikenSampler::setVoiceLimit( const int maxNumVoices )
+{
+    m_voiceLimit = maxNumVoices > 0 ? maxNumVoices : 0;
+}
+
+
+
+void ShurikenSampler::noteOn( const int midiChannel, const int midiNoteNumber, const float velocity )
+{
+    const ScopedLock sl( lock );
+
+    if ( midiChannel < 1 || midiChannel > Midi::NUM_CHANNELS || midiNoteNumber < 0 || midiNoteNumber >= Midi::NUM_NOTES )
+    {
+        return;
+    }
+
+    // Unlike the base class this doesn't ask every sound whether it applies to the note
+    ShurikenSamplerSound* const sound = m_soundsByKeyNum[ Midi::getKeyNum( midiChannel, midiNoteNumber ) ];
+
+    if ( sound == NULL )
+    {
+        return;
+    }
+
+    if ( sound->getChokeGroup() > 0 )
+    {
+        chokeVoices( sound->getChokeGroup() );
+    }
+
+    enforceVoiceLimit();
+
+    // If hitting a note that's still ringing, stop it first
+    for ( int i = 0; i < voices.size(); i++ )
+    {
+        SynthesiserVoice* const voice = voices.getUnchecked( i );
+
+        if ( voice->getCurrentlyPlayingNote() == midiNoteNumber && voice->isPlayingChannel( midiChannel ) )
+        {
+            stopVoice( voice, 1.0f, true );
+        }
+    }
+
+    startVoice( findFreeVoice( sound, midiChannel, midiNoteNumber, isNoteStealingEnabled() ),
+                sound, midiChannel, midiNoteNumber, velocity );
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+SynthesiserVoice* ShurikenSampler::findVoiceToSteal( SynthesiserSound* /*soundToPlay*/,
+                                                     const int /*midiChannel*/,
+                                                     const int /*midiNoteNumber*/ ) const
+{
+    // Unlike the base class this doesn't allocate, as it's called on the audio thread.
+    // Voices that are already fading out are the first to go
+    ShurikenSamplerVoice* voice = findQuietestVoice( true );
+
+    if ( voice == NULL )
+    {
+        voice = findQuietestVoice( false );
+    }
+
+    return voice;
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void ShurikenSampler::chokeVoices( const int chokeGroupNum )
+{
+    for ( int i = 0; i < voices.size(); i++ )
+    {
+        ShurikenSamplerVoice* const voice = static_cast<ShurikenSamplerVoice*>( voices.getUnchecked( i ) );
+        const ShurikenSamplerSound* const playingSound = voice->getPlayingSound();
+
+        if ( playingSound != NULL && playingSound->getChokeGroup() == chokeGroupNum )
+        {
+            voice->fadeOut();
+        }
+    }
+}
+
+
+
+void ShurikenSampler::enforceVoiceLimit()
+{
+    if ( m_voiceLimit == 0 )
+    {
+        return;
+    }
+
+    int numPlayingVoices = 0;
+    int numFadingVoices = 0;
+
+    for ( int i = 0; i < voices.size(); i++ )
+    {
+        const ShurikenSamplerVoice* const voice = static_cast<ShurikenSamplerVoice*>( voices.getUnchecked( i ) );
+
+        if ( voice->isVoiceActive() )
+        {
+            if ( voice->isFadingOut() )
+                numFadingVoices++;
+            else
+                numPlayingVoices++;
+        }
+    }
+
+    // Make room for the note about to start
+    while ( numPlayingVoices >= m_voiceLimit )
+    {
+        ShurikenSamplerVoice* const voice = findQuietestVoice( false );
+
+        if ( voice == NULL )
+        {
+            break;
+        }
+
+        voice->fadeOut();
+        numPlayingVoices--;
+        numFadingVoices++;
+    }
+
+    while ( numFadingVoices > MAX_NUM_FADING_VOICES )
+    {
+        ShurikenSamplerVoice* const voice = findQuietestVoice( true );
+
+        if ( voice == NULL )
+        {
+            break;
+        }
+
+        stopVoice( voice, 0.0f, false );
+        numFadingVoices--;
+    }
+}
+
+
+
+ShurikenSamplerVoice* ShurikenSampler::findQuietestVoice( const bool isFadingOut ) const
+{
+    ShurikenSamplerVoice* quietestVoice = NULL;
+    float quietestLevel = 0.0f;
+
+    for ( int i = 0; i < voices.size(); i++ )
+    {
+        ShurikenSamplerVoice* const voice = static_cast<ShurikenSamplerVoice*>( voices.getUnchecked( i ) );
+
+        if ( voice->isVoiceActive() && voice->isFadingOut() == isFadingOut )
+        {
+            const float level = voice->getLevel();
+
+            if ( quietestVoice == NULL ||
+                 level < quietestLevel ||
+                 ( level == quietestLevel && voice->wasStartedBefore( *quietestVoice ) ) )
+            {
+                quietestVoice = voice;
+                quietestLevel = level;
+            }
+        }
+    }
+
+    return quietestVoice;
+}
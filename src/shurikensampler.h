@@ -50,6 +50,7 @@
 
 #include "JuceHeader.h"
 #include "samplebuffer.h"
+#include "globals.h"
 
 
 // A subclass of SynthesiserSound that represents a sampled audio clip.
@@ -61,6 +62,7 @@ class ShurikenSamplerSound : public SynthesiserSound
 public:
     ShurikenSamplerSound( SharedSampleBuffer sampleBuffer,
                           qreal sampleRate,
+                          int midiChannel,
                           const BigInteger& midiNotes,
                           int midiNoteForNormalPitch );
 
@@ -78,11 +80,22 @@ public:
     void setOutputPair( int outputPairNum );
     int getOutputPairNum() const                    { return m_outputPairNum; }
 
+    // Starting a sound cuts off any other sound in the same choke group, e.g. an open hi-hat
+    // is cut off by a closed hi-hat. 0 means no choke group
+    void setChokeGroup( int groupNum )              { m_chokeGroupNum = groupNum > 0 ? groupNum : 0; }
+    int getChokeGroup() const                       { return m_chokeGroupNum; }
+
     // Set temporary sample range; only lasts for duration of one note
     void setTempSampleRange( SharedSampleRange sampleRange );
 
     SharedSampleBuffer getSampleBuffer() const      { return m_sampleBuffer; }
 
+    // Play a different buffer of the same size and no. of channels. The sampler's lock must be held
+    void setSampleBuffer( SharedSampleBuffer sampleBuffer );
+
+    int getMidiChannel() const                      { return m_midiChannel; }
+    const BigInteger& getMidiNotes() const          { return m_midiNotes; }
+
     bool appliesToNote( int midiNoteNumber ) override;
     bool appliesToChannel( int midiChannel ) override;
 
@@ -90,18 +103,20 @@ public:
 private:
     friend class ShurikenSamplerVoice;
 
-    const SharedSampleBuffer m_sampleBuffer;
-    const int m_originalStartFrame, m_originalEndFrame;
+    SharedSampleBuffer m_sampleBuffer;
+    const FrameNum m_originalStartFrame, m_originalEndFrame;
     const qreal m_sourceSampleRate;
+    const int m_midiChannel;
     BigInteger m_midiNotes;
     int m_midiRootNote;
 
     volatile qreal m_attackValue, m_releaseValue;
-    volatile int m_startFrame, m_endFrame;
-    volatile int m_tempStartFrame, m_tempEndFrame;
+    volatile FrameNum m_startFrame, m_endFrame;
+    volatile FrameNum m_tempStartFrame, m_tempEndFrame;
     volatile bool m_isTempSampleRangeSet;
     volatile bool m_isOneShotSet;
     volatile int m_outputPairNum;
+    volatile int m_chokeGroupNum;
 };
 
 
@@ -126,11 +141,72 @@ public:
 
     void renderNextBlock( AudioSampleBuffer&, int startFrame, int numFrames ) override;
 
+    // Quickly fade out and stop, e.g. when the voice is stolen or choked
+    void fadeOut();
+    bool isFadingOut() const                        { return m_isFadingOut; }
+
+    // The current gain of the voice's envelope, ignoring the audio content of the sample
+    float getLevel() const;
+
+    ShurikenSamplerSound* getPlayingSound() const;
+
 private:
+    static constexpr float FADE_OUT_SECS = 0.005f;
+    static constexpr float INAUDIBLE_LEVEL = 0.0001f;   // -80 dB
+
     qreal m_pitchRatio;
     qreal m_sourceSamplePosition;
     float m_leftGain, m_rightGain, m_attackReleaseLevel, m_attackDelta, m_releaseDelta;
-    bool m_isInAttack, m_isInRelease;
+    float m_fadeOutLevel, m_fadeOutDelta;
+    bool m_isInAttack, m_isInRelease, m_isFadingOut;
+};
+
+
+
+//==================================================================================================
+// A Synthesiser that gives access to the lock held while it renders, so that the audio of its
+// sounds can be overwritten without interrupting playback.
+// It also bounds the number of voices rendering at once: when a new note would exceed the voice
+// limit, the quietest voice (or the oldest, if several are equally quiet) is faded out to make
+// room. Voices fading out still render, so only MAX_NUM_FADING_VOICES extra are allowed; beyond
+// that the quietest fading voice is cut off immediately.
+// Sounds are looked up by MIDI channel and note, so note-ons take the same time however many
+// sounds there are.
+
+class ShurikenSampler : public Synthesiser
+{
+public:
+    ShurikenSampler();
+
+    const CriticalSection& getLock() const noexcept     { return lock; }
+
+    // Use these rather than addSound() and clearSounds() so that the sound for each key is known
+    void addSamplerSound( ShurikenSamplerSound* sound );
+    void clearSamplerSounds();
+
+    // 0 means no limit other than the number of voices added to the sampler
+    void setVoiceLimit( int maxNumVoices );
+    int getVoiceLimit() const                           { return m_voiceLimit; }
+
+    void noteOn( int midiChannel, int midiNoteNumber, float velocity ) override;
+
+protected:
+    SynthesiserVoice* findVoiceToSteal( SynthesiserSound* soundToPlay,
+                                        int midiChannel,
+                                        int midiNoteNumber ) const override;
+
+private:
+    static const int MAX_NUM_FADING_VOICES = 8;
+
+    void chokeVoices( int chokeGroupNum );
+    void enforceVoiceLimit();
+
+    // Returns NULL if no voices match
+    ShurikenSamplerVoice* findQuietestVoice( bool isFadingOut ) const;
+
+    volatile int m_voiceLimit;
+
+    ShurikenSamplerSound* m_soundsByKeyNum[ Midi::NUM_KEYS ];   // NULL where no sound is assigned
 };
 
 #endif // SHURIKENSAMPLER_H
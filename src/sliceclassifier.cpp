@@ -0,0 +1,449 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "sliceclassifier.h"
+#include <QThread>
+#include <QObject>
+#include <emmintrin.h>
+
+
+//==================================================================================================
+// Public Static:
+
+QList<SliceClassifier::Features> SliceClassifier::extractFeatures( const QList<SharedSampleBuffer> sampleBufferList,
+                                                                   const int sampleRate,
+                                                                   JobScheduler::Job* const job )
+{
+    const int numSlices = sampleBufferList.size();
+
+    QVector<Features> results( numSlices );
+
+    if ( job == NULL || numSlices == 1 )
+    {
+        for ( int i = 0; i < numSlices; i++ )
+        {
+            results[ i ] = extractFeatures( sampleBufferList.at( i ), sampleRate );
+        }
+    }
+    else if ( numSlices > 1 )
+    {
+        // Slices are typically short so they are handed out in batches rather than one task each
+        const int numThreads = qMax( 1, QThread::idealThreadCount() );
+        const int numTasks = qMin( numSlices, numThreads * NUM_TASKS_PER_THREAD );
+
+        QList<JobScheduler::SharedTask> tasks;
+
+        for ( int taskNum = 0; taskNum < numTasks; taskNum++ )
+        {
+            const int startIndex = numSlices * taskNum / numTasks;
+            const int endIndex = numSlices * ( taskNum + 1 ) / numTasks;
+
+            const JobScheduler::SharedTask task( new FeatureTask( sampleBufferList, startIndex, endIndex, sampleRate, results.data() ) );
+            job->startTask( task );
+            tasks << task;
+        }
+
+        foreach ( JobScheduler::SharedTask task, tasks )
+        {
+            task->wait();
+        }
+    }
+
+    return results.toList();
+}
+
+
+
+SliceClassifier::Features SliceClassifier::extractFeatures( const SharedSampleBuffer sampleBuffer, const int sampleRate )
+{
+    Features features = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+    const int numChans = sampleBuffer->getNumChannels();
+    const int numFrames = sampleBuffer->getNumFrames();
+
+    if ( numChans == 0 || numFrames == 0 || sampleRate <= 0 )
+    {
+        return features;
+    }
+
+    // Mix down to mono
+    HeapBlock<float> mono( numFrames );
+
+    FloatVectorOperations::copyWithMultiply( mono, sampleBuffer->getReadPointer( 0 ), 1.0f / numChans, numFrames );
+
+    for ( int chanNum = 1; chanNum < numChans; chanNum++ )
+    {
+        FloatVectorOperations::addWithMultiply( mono, sampleBuffer->getReadPointer( chanNum ), 1.0f / numChans, numFrames );
+    }
+
+    // Mean-square envelope
+    const int numBlocks = ( numFrames + ENVELOPE_BLOCK_SIZE - 1 ) / ENVELOPE_BLOCK_SIZE;
+
+    HeapBlock<float> envelope( numBlocks );
+    int peakBlockNum = 0;
+
+    for ( int blockNum = 0; blockNum < numBlocks; blockNum++ )
+    {
+        const int startFrame = blockNum * ENVELOPE_BLOCK_SIZE;
+        const int blockSize = qMin( ENVELOPE_BLOCK_SIZE, numFrames - startFrame );
+
+        envelope[ blockNum ] = calcSumOfSquares( mono + startFrame, blockSize ) / blockSize;
+
+        if ( envelope[ blockNum ] > envelope[ peakBlockNum ] )
+        {
+            peakBlockNum = blockNum;
+        }
+    }
+
+    if ( envelope[ peakBlockNum ] <= 0.0f )
+    {
+        return features;
+    }
+
+    // Decay time
+    const float decayGain = Decibels::decibelsToGain( DECAY_DB );
+    const float decayThreshold = envelope[ peakBlockNum ] * decayGain * decayGain;
+    const int maxNumDecayBlocks = roundToInt( MAX_ANALYSIS_SECS * sampleRate / ENVELOPE_BLOCK_SIZE );
+
+    int decayBlockNum = peakBlockNum;
+
+    while ( decayBlockNum < numBlocks - 1 &&
+            decayBlockNum - peakBlockNum < maxNumDecayBlocks &&
+            envelope[ decayBlockNum ] > decayThreshold )
+    {
+        decayBlockNum++;
+    }
+
+    features.decayTime = float( ( decayBlockNum - peakBlockNum ) * ENVELOPE_BLOCK_SIZE ) / sampleRate;
+
+    // Zero-crossing rate and spectrum are both taken from the frames following the peak
+    const int hopSize = FFT_SIZE / 2;
+    const int analysisStartFrame = peakBlockNum * ENVELOPE_BLOCK_SIZE;
+    const int numAnalysisFrames = qMin( numFrames - analysisStartFrame, hopSize * ( NUM_SPECTRAL_FRAMES + 1 ) );
+
+    if ( numAnalysisFrames > 1 )
+    {
+        features.zeroCrossingRate = float( countZeroCrossings( mono + analysisStartFrame, numAnalysisFrames ) ) *
+                                    sampleRate / numAnalysisFrames;
+    }
+
+    // Power spectrum averaged over several Hann windowed frames, zero-padded past the end of the slice
+    static const FFT fft( FFT_ORDER, false );
+    static const QVector<float> window = createHannWindow( FFT_SIZE );
+
+    const int numBins = FFT_SIZE / 2;
+
+    HeapBlock<float> fftData( FFT_SIZE * 2 );
+    HeapBlock<float> powerSpectrum( numBins, true );
+
+    for ( int spectralFrameNum = 0; spectralFrameNum < NUM_SPECTRAL_FRAMES; spectralFrameNum++ )
+    {
+        const int startFrame = analysisStartFrame + spectralFrameNum * hopSize;
+
+        if ( startFrame >= numFrames )
+        {
+            break;
+        }
+
+        const int numFramesToCopy = qMin( FFT_SIZE, numFrames - startFrame );
+
+        FloatVectorOperations::clear( fftData, FFT_SIZE * 2 );
+        FloatVectorOperations::multiply( fftData, mono + startFrame, window.constData(), numFramesToCopy );
+
+        fft.performFrequencyOnlyForwardTransform( fftData );
+
+        FloatVectorOperations::multiply( fftData, fftData, numBins );
+        FloatVectorOperations::add( powerSpectrum, fftData, numBins );
+    }
+
+    const float binWidth = float( sampleRate ) / FFT_SIZE;
+
+    double totalEnergy = 0.0;
+    double weightedFreqSum = 0.0;
+    double lowBandEnergy = 0.0;
+    double highBandEnergy = 0.0;
+
+    // Bin 0 is skipped as any DC offset says nothing about the type of drum
+    for ( int binNum = 1; binNum < numBins; binNum++ )
+    {
+        const float freq = binNum * binWidth;
+        const float power = powerSpectrum[ binNum ];
+
+        totalEnergy += power;
+        weightedFreqSum += freq * power;
+
+        if ( freq < LOW_BAND_MAX_HZ )
+        {
+            lowBandEnergy += power;
+        }
+        else if ( freq >= HIGH_BAND_MIN_HZ )
+        {
+            highBandEnergy += power;
+        }
+    }
+
+    if ( totalEnergy > 0.0 )
+    {
+        features.spectralCentroid = float( weightedFreqSum / totalEnergy );
+        features.lowBandEnergy = float( lowBandEnergy / totalEnergy );
+        features.highBandEnergy = float( highBandEnergy / totalEnergy );
+        features.midBandEnergy = 1.0f - features.lowBandEnergy - features.highBandEnergy;
+    }
+
+    return features;
+}
+
+
+
+SliceClassifier::DrumType SliceClassifier::classify( const Features& features )
+{
+    // Mostly high frequency content: hi-hats and cymbals are told apart by how long they ring for
+    if ( features.highBandEnergy >= 0.65f || features.spectralCentroid >= 10000.0f )
+    {
+        if ( features.decayTime < 0.12f )
+            return CLOSED_HI_HAT;
+        else if ( features.decayTime < 0.5f )
+            return OPEN_HI_HAT;
+        else
+            return CYMBAL;
+    }
+
+    // Dominated by low frequencies
+    if ( features.lowBandEnergy >= 0.5f && features.spectralCentroid < 800.0f )
+    {
+        return KICK;
+    }
+
+    // Noisy mid-range content, e.g. snares and claps
+    if ( features.zeroCrossingRate >= 1500.0f && features.spectralCentroid >= 500.0f )
+    {
+        return SNARE;
+    }
+
+    // Pitched and ringing with little noise
+    if ( features.spectralCentroid < 1500.0f && features.decayTime >= 0.1f )
+    {
+        return TOM;
+    }
+
+    return PERCUSSION;
+}
+
+
+
+QList<int> SliceClassifier::assignGMDrumNotes( const QList<DrumType> drumTypes, const QList<Features> featuresList )
+{
+    Q_ASSERT( drumTypes.size() == featuresList.size() );
+
+    static const int kickNotes[]        = { 36, 35 };
+    static const int snareNotes[]       = { 38, 40, 39, 37 };
+    static const int closedHiHatNotes[] = { 42, 44 };
+    static const int openHiHatNotes[]   = { 46 };
+    static const int tomNotes[]         = { 41, 43, 45, 47, 48, 50 };
+    static const int cymbalNotes[]      = { 49, 57, 51, 59, 55, 52, 53 };
+    static const int percussionNotes[]  = { 54, 56, 58, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 75, 76, 77 };
+
+    const int* const notesByType[ NUM_DRUM_TYPES ] =
+    {
+        kickNotes, snareNotes, closedHiHatNotes, openHiHatNotes, tomNotes, cymbalNotes, percussionNotes
+    };
+
+    const int numNotesByType[ NUM_DRUM_TYPES ] =
+    {
+        numElementsInArray( kickNotes ), numElementsInArray( snareNotes ),
+        numElementsInArray( closedHiHatNotes ), numElementsInArray( openHiHatNotes ),
+        numElementsInArray( tomNotes ), numElementsInArray( cymbalNotes ),
+        numElementsInArray( percussionNotes )
+    };
+
+    QList<int> noteNums;
+    QList<int> sliceNumsByType[ NUM_DRUM_TYPES ];
+
+    for ( int sliceNum = 0; sliceNum < drumTypes.size(); sliceNum++ )
+    {
+        noteNums << -1;
+        sliceNumsByType[ drumTypes.at( sliceNum ) ] << sliceNum;
+    }
+
+    // GM toms run from low floor tom up to high tom
+    qSort( sliceNumsByType[ TOM ].begin(), sliceNumsByType[ TOM ].end(),
+           [&]( const int sliceNum1, const int sliceNum2 )
+           {
+               return featuresList.at( sliceNum1 ).spectralCentroid < featuresList.at( sliceNum2 ).spectralCentroid;
+           } );
+
+    for ( int drumType = 0; drumType < NUM_DRUM_TYPES; drumType++ )
+    {
+        const QList<int>& sliceNums = sliceNumsByType[ drumType ];
+        const int numNotes = qMin( sliceNums.size(), numNotesByType[ drumType ] );
+
+        for ( int i = 0; i < numNotes; i++ )
+        {
+            noteNums[ sliceNums.at( i ) ] = notesByType[ drumType ][ i ];
+        }
+    }
+
+    return noteNums;
+}
+
+
+
+QString SliceClassifier::getDrumTypeName( const DrumType drumType )
+{
+    switch ( drumType )
+    {
+    case KICK:
+        return QObject::tr( "Kick" );
+    case SNARE:
+        return QObject::tr( "Snare" );
+    case CLOSED_HI_HAT:
+        return QObject::tr( "Closed Hi-Hat" );
+    case OPEN_HI_HAT:
+        return QObject::tr( "Open Hi-Hat" );
+    case TOM:
+        return QObject::tr( "Tom" );
+    case CYMBAL:
+        return QObject::tr( "Cymbal" );
+    case PERCUSSION:
+        return QObject::tr( "Percussion" );
+    default:
+        return QString();
+    }
+}
+
+
+
+int SliceClassifier::getGMChokeGroup( const int noteNum )
+{
+    switch ( noteNum )
+    {
+    case 42:    // Closed hi-hat
+    case 44:    // Pedal hi-hat
+    case 46:    // Open hi-hat
+        return HI_HAT_CHOKE_GROUP;
+    default:
+        return 0;
+    }
+}
+
+
+
+//==================================================================================================
+// Public:
+
+void SliceClassifier::ClassificationJob::run()
+{
+    const QList<Features> featuresList = extractFeatures( m_sampleBufferList, m_sampleRate, this );
+
+    if ( ! isCancelled() )
+    {
+        foreach ( Features features, featuresList )
+        {
+            m_drumTypes << classify( features );
+        }
+
+        m_noteNums = assignGMDrumNotes( m_drumTypes, featuresList );
+    }
+
+    setProgress( 100 );
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+QVector<float> SliceClassifier::createHannWindow( const int size )
+{
+    QVector<float> window( size );
+
+    for ( int i = 0; i < size; i++ )
+    {
+        window[ i ] = 0.5f - 0.5f * std::cos( 2.0f * float_Pi * i / ( size - 1 ) );
+    }
+
+    return window;
+}
+
+
+
+float SliceClassifier::calcSumOfSquares( const float* const samples, const int numSamples )
+{
+    __m128 sum = _mm_setzero_ps();
+
+    const int numQuads = numSamples / 4;
+
+    for ( int i = 0; i < numQuads; i++ )
+    {
+        const __m128 quad = _mm_loadu_ps( samples + i * 4 );
+
+        sum = _mm_add_ps( sum, _mm_mul_ps( quad, quad ) );
+    }
+
+    float partialSums[ 4 ];
+    _mm_storeu_ps( partialSums, sum );
+
+    float total = partialSums[ 0 ] + partialSums[ 1 ] + partialSums[ 2 ] + partialSums[ 3 ];
+
+    for ( int i = numQuads * 4; i < numSamples; i++ )
+    {
+        total += samples[ i ] * samples[ i ];
+    }
+
+    return total;
+}
+
+
+
+int SliceClassifier::countZeroCrossings( const float* const samples, const int numSamples )
+{
+    // Compare the sign of each sample with the next one, four pairs at a time. Each lane of a
+    // comparison mask is either 0 or -1, so subtracting the masks counts the sign changes
+    const __m128 zero = _mm_setzero_ps();
+    __m128i counts = _mm_setzero_si128();
+
+    const int numPairs = numSamples - 1;
+    const int numQuads = numPairs / 4;
+
+    for ( int i = 0; i < numQuads; i++ )
+    {
+        const __m128 current = _mm_cmplt_ps( _mm_loadu_ps( samples + i * 4 ), zero );
+        const __m128 next = _mm_cmplt_ps( _mm_loadu_ps( samples + i * 4 + 1 ), zero );
+
+        counts = _mm_sub_epi32( counts, _mm_castps_si128( _mm_xor_ps( current, next ) ) );
+    }
+
+    int partialCounts[ 4 ];
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( partialCounts ), counts );
+
+    int total = partialCounts[ 0 ] + partialCounts[ 1 ] + partialCounts[ 2 ] + partialCounts[ 3 ];
+
+    for ( int i = numQuads * 4; i < numPairs; i++ )
+    {
+        if ( ( samples[ i ] < 0.0f ) != ( samples[ i + 1 ] < 0.0f ) )
+        {
+            total++;
+        }
+    }
+
+    return total;
+}
@@ -0,0 +1,146 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef SLICECLASSIFIER_H
+#define SLICECLASSIFIER_H
+
+#include <QList>
+#include <QVector>
+#include <QString>
+#include "samplebuffer.h"
+#include "jobscheduler.h"
+
+
+class SliceClassifier
+{
+public:
+    enum DrumType { KICK, SNARE, CLOSED_HI_HAT, OPEN_HI_HAT, TOM, CYMBAL, PERCUSSION, NUM_DRUM_TYPES };
+
+    struct Features
+    {
+        float spectralCentroid;     // Hz
+        float lowBandEnergy;        // Fraction of the spectral energy below LOW_BAND_MAX_HZ
+        float midBandEnergy;        // Fraction between LOW_BAND_MAX_HZ and HIGH_BAND_MIN_HZ
+        float highBandEnergy;       // Fraction above HIGH_BAND_MIN_HZ
+        float zeroCrossingRate;     // Crossings per second
+        float decayTime;            // Seconds from the peak until the envelope has fallen by DECAY_DB
+    };
+
+    // Extract features from each sample buffer. If called from a job the buffers are split into batches
+    // which are analysed concurrently as tasks of that job; either way this returns once all are done
+    static QList<Features> extractFeatures( QList<SharedSampleBuffer> sampleBufferList,
+                                            int sampleRate,
+                                            JobScheduler::Job* job = NULL );
+
+    // Features are taken from the loudest part of the slice, up to MAX_ANALYSIS_SECS after its peak
+    static Features extractFeatures( SharedSampleBuffer sampleBuffer, int sampleRate );
+
+    static DrumType classify( const Features& features );
+
+    // Returns a General MIDI drum note for each slice, or -1 if every note for its drum type has already
+    // been taken. Slices of the same type are given that type's notes in order; toms are sorted by pitch
+    static QList<int> assignGMDrumNotes( QList<DrumType> drumTypes, QList<Features> featuresList );
+
+    static QString getDrumTypeName( DrumType drumType );
+
+    // Returns the choke group a General MIDI drum note should play in, or 0 for none.
+    // The closed, pedal and open hi-hats share a group so that closing the hat cuts off an open one
+    static int getGMChokeGroup( int noteNum );
+
+    // Extracts features, classifies and assigns GM drum notes on a JobScheduler worker thread
+    class ClassificationJob : public JobScheduler::Job
+    {
+    public:
+        ClassificationJob( QList<SharedSampleBuffer> sampleBufferList, int sampleRate ) :
+            JobScheduler::Job(),
+            m_sampleBufferList( sampleBufferList ),
+            m_sampleRate( sampleRate )
+        {
+        }
+
+        void run();
+
+        QList<SharedSampleBuffer> getSampleBufferList() const   { return m_sampleBufferList; }
+        QList<DrumType> getDrumTypes() const                    { return m_drumTypes; }
+        QList<int> getNoteNums() const                          { return m_noteNums; }
+
+    private:
+        const QList<SharedSampleBuffer> m_sampleBufferList;
+        const int m_sampleRate;
+
+        QList<DrumType> m_drumTypes;
+        QList<int> m_noteNums;
+    };
+
+private:
+    static constexpr float LOW_BAND_MAX_HZ = 100.0f;
+    static constexpr float HIGH_BAND_MIN_HZ = 5000.0f;
+    static constexpr float DECAY_DB = -20.0f;
+    static constexpr float MAX_ANALYSIS_SECS = 2.0f;
+    static const int ENVELOPE_BLOCK_SIZE = 256;
+    static const int FFT_ORDER = 10;
+    static const int FFT_SIZE = 1 << FFT_ORDER;
+    static const int NUM_SPECTRAL_FRAMES = 4;   // Hop size is FFT_SIZE / 2
+    static const int NUM_TASKS_PER_THREAD = 4;
+    static const int HI_HAT_CHOKE_GROUP = 1;
+
+    static QVector<float> createHannWindow( int size );
+
+    // SSE2 kernels
+    static float calcSumOfSquares( const float* samples, int numSamples );
+    static int countZeroCrossings( const float* samples, int numSamples );
+
+    class FeatureTask : public JobScheduler::Task
+    {
+    public:
+        FeatureTask( const QList<SharedSampleBuffer>& sampleBufferList,
+                     int startIndex, int endIndex,
+                     int sampleRate,
+                     Features* results ) :
+            JobScheduler::Task(),
+            m_sampleBufferList( sampleBufferList ),
+            m_startIndex( startIndex ),
+            m_endIndex( endIndex ),
+            m_sampleRate( sampleRate ),
+            m_results( results )
+        {
+        }
+
+        void run()
+        {
+            for ( int i = m_startIndex; i < m_endIndex; i++ )
+            {
+                m_results[ i ] = extractFeatures( m_sampleBufferList.at( i ), m_sampleRate );
+            }
+        }
+
+    private:
+        const QList<SharedSampleBuffer>& m_sampleBufferList;
+        const int m_startIndex;
+        const int m_endIndex;   // Exclusive
+        const int m_sampleRate;
+        Features* const m_results;
+    };
+};
+
+
+#endif // SLICECLASSIFIER_H
@@ -121,9 +121,9 @@ void SlicePointItem::moveToNextZeroCrossing()
 
     const SharedSampleBuffer sampleBuffer = waveScene->getWaveformAt( 0 )->getSampleBuffer();
 
-    const int oldFrameNum = getFrameNum();
+    const FrameNum oldFrameNum = getFrameNum();
 
-    const int newFrameNum = SampleUtils::getNextZeroCrossing( sampleBuffer, oldFrameNum + 1 );
+    const FrameNum newFrameNum = SampleUtils::getNextZeroCrossing( sampleBuffer, oldFrameNum + 1 );
     setFrameNum( newFrameNum );
 
     const qreal newScenePosX = waveScene->getScenePosX( newFrameNum );
@@ -140,9 +140,9 @@ void SlicePointItem::moveToPrevZeroCrossing()
 
     const SharedSampleBuffer sampleBuffer = waveScene->getWaveformAt( 0 )->getSampleBuffer();
 
-    const int oldFrameNum = getFrameNum();
+    const FrameNum oldFrameNum = getFrameNum();
 
-    const int newFrameNum = SampleUtils::getPrevZeroCrossing( sampleBuffer, oldFrameNum - 1 );
+    const FrameNum newFrameNum = SampleUtils::getPrevZeroCrossing( sampleBuffer, oldFrameNum - 1 );
     setFrameNum( newFrameNum );
 
     const qreal newScenePosX = waveScene->getScenePosX( newFrameNum );
@@ -235,6 +235,11 @@ QVariant SlicePointItem::itemChange( GraphicsItemChange change, const QVariant&
         newPos.setY( BpmRuler::HEIGHT );
 #endif
 
+        if ( m_isLeftMousePressed )
+        {
+            emit dragged( waveScene->getFrameNum( newPos.x() ) );
+        }
+
         return newPos;
     }
 
@@ -283,11 +288,13 @@ void SlicePointItem::mouseReleaseEvent( QGraphicsSceneMouseEvent* event )
     {
         WaveGraphicsScene* const scene = static_cast<WaveGraphicsScene*>( this->scene() );
 
+        emit dragFinished();
+
         // If slice point has been moved then set new frame number
         if ( m_scenePosX_beforeMove != scenePos().x() )
         {
-            const int oldFrameNum = getFrameNum();
-            const int newFrameNum = scene->getFrameNum( scenePos().x() );
+            const FrameNum oldFrameNum = getFrameNum();
+            const FrameNum newFrameNum = scene->getFrameNum( scenePos().x() );
 
             setFrameNum( newFrameNum );
 
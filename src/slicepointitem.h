@@ -29,6 +29,7 @@
 #include <QStyleOptionGraphicsItem>
 #include "JuceHeader.h"
 #include "globals.h"
+#include "samplebuffer.h"
 
 
 class SlicePointItem;
@@ -55,8 +56,8 @@ public:
     void moveToNextZeroCrossing();
     void moveToPrevZeroCrossing();
 
-    int getFrameNum() const                             { return m_frameNum; }
-    void setFrameNum( int frameNum )                    { m_frameNum = frameNum; }
+    FrameNum getFrameNum() const                        { return m_frameNum; }
+    void setFrameNum( FrameNum frameNum )               { m_frameNum = frameNum; }
 
     bool isSnapEnabled() const                          { return m_isSnapEnabled; }
     void setSnap( bool enable )                         { m_isSnapEnabled = enable; }
@@ -85,7 +86,7 @@ private:
     bool m_isSnapEnabled;
     bool m_isLeftMousePressed;
 
-    int m_frameNum;
+    FrameNum m_frameNum;
 
     qreal m_scenePosX_beforeMove;
     qreal m_minDistFromOtherItems;
@@ -96,7 +97,11 @@ private:
     static void setRulerMarkColour( QGraphicsItem* item, QColor colour );
 
 signals:
-    void scenePosChanged( SlicePointItem* item, int oldFrameNum );
+    void scenePosChanged( SlicePointItem* item, FrameNum oldFrameNum );
+
+    // Emitted on every mouse move while the item is dragged, and when it's let go
+    void dragged( FrameNum frameNum );
+    void dragFinished();
 
 private:
     JUCE_LEAK_DETECTOR( SlicePointItem );
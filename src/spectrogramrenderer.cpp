@@ -0,0 +1,434 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "spectrogramrenderer.h"
+#include <QCache>
+
+
+struct SpectrogramTileKey
+{
+    int rendererId;
+    int generation;
+    int numColumns;
+    int tileIndex;
+
+    bool operator==( const SpectrogramTileKey& other ) const
+    {
+        return rendererId == other.rendererId && generation == other.generation &&
+               numColumns == other.numColumns && tileIndex == other.tileIndex;
+    }
+};
+
+static inline uint qHash( const SpectrogramTileKey& key )
+{
+    return uint( key.rendererId * 73856093 ) ^ uint( key.generation * 19349663 ) ^
+           uint( key.numColumns * 83492791 ) ^ uint( key.tileIndex );
+}
+
+// Tiles from all renderers share one cache so that memory use stays bounded however many slices
+// there are. The cost of each tile is its size in KiB. Only accessed from the GUI thread
+static const int MAX_TILE_CACHE_KB = 64 * 1024;
+static QCache<SpectrogramTileKey, QImage> tileCache( MAX_TILE_CACHE_KB );
+
+
+
+struct SpectrogramRenderer::Tables
+{
+    Tables();
+
+    static const int NUM_COLOURS = 256;
+
+    const FFT fft;
+    float window[ FFT_SIZE ];
+    float magnitudeScale;
+    int firstBin[ NUM_ROWS ];
+    int lastBin[ NUM_ROWS ];
+    QRgb palette[ NUM_COLOURS ];
+};
+
+
+
+SpectrogramRenderer::Tables::Tables() :
+    fft( FFT_ORDER, false )
+{
+    // Hann window
+    float windowSum = 0.0f;
+
+    for ( int i = 0; i < FFT_SIZE; i++ )
+    {
+        window[ i ] = 0.5f - 0.5f * std::cos( 2.0f * float_Pi * i / ( FFT_SIZE - 1 ) );
+        windowSum += window[ i ];
+    }
+
+    // A full scale sine wave should have a magnitude of 1.0 (0 dB)
+    magnitudeScale = 2.0f / windowSum;
+
+    // Map each row to a range of FFT bins on a log frequency scale, highest frequencies at the top
+    const int maxBin = FFT_SIZE / 2;
+
+    for ( int rowNum = 0; rowNum < NUM_ROWS; rowNum++ )
+    {
+        const int rowsFromBottom = NUM_ROWS - 1 - rowNum;
+
+        const float lower = std::pow( (float) maxBin, (float) rowsFromBottom / NUM_ROWS );
+        const float upper = std::pow( (float) maxBin, (float) ( rowsFromBottom + 1 ) / NUM_ROWS );
+
+        firstBin[ rowNum ] = jlimit( 1, maxBin - 1, (int) lower );
+        lastBin[ rowNum ] = jlimit( firstBin[ rowNum ], maxBin - 1, (int) upper - 1 );
+    }
+
+    // Black -> blue -> purple -> orange -> pale yellow
+    const QColor stops[] = { QColor(0, 0, 0), QColor(32, 0, 96), QColor(160, 0, 120),
+                             QColor(255, 120, 0), QColor(255, 255, 200) };
+    const int numSegments = sizeof( stops ) / sizeof( stops[0] ) - 1;
+
+    for ( int i = 0; i < NUM_COLOURS; i++ )
+    {
+        const qreal pos = (qreal) i / ( NUM_COLOURS - 1 ) * numSegments;
+        const int segment = qMin( (int) pos, numSegments - 1 );
+        const qreal frac = pos - segment;
+
+        const QColor& from = stops[ segment ];
+        const QColor& to = stops[ segment + 1 ];
+
+        palette[ i ] = qRgb( from.red()   + roundToInt( ( to.red()   - from.red() )   * frac ),
+                             from.green() + roundToInt( ( to.green() - from.green() ) * frac ),
+                             from.blue()  + roundToInt( ( to.blue()  - from.blue() )  * frac ) );
+    }
+}
+
+
+
+Atomic<int> SpectrogramRenderer::s_nextRendererId;
+
+
+
+//==================================================================================================
+// Public:
+
+SpectrogramRenderer::SpectrogramRenderer( const SharedSampleBuffer sampleBuffer, JobScheduler& jobScheduler, QObject* parent ) :
+    QObject( parent ),
+    m_sampleBuffer( sampleBuffer ),
+    m_jobScheduler( jobScheduler ),
+    m_rendererId( ++s_nextRendererId ),
+    m_state( new SharedState )
+{
+    m_state->renderer = this;
+}
+
+
+
+SpectrogramRenderer::~SpectrogramRenderer()
+{
+    {
+        const QMutexLocker locker( &m_state->mutex );
+        m_state->renderer = NULL;
+    }
+
+    removeCachedTiles();
+}
+
+
+
+void SpectrogramRenderer::paint( QPainter* const painter,
+                                 const QRectF& itemRect,
+                                 const qreal exposedRectLeft, const qreal exposedRectRight,
+                                 const qreal scaleFactor )
+{
+    const int numColumns = itemRect.width() * scaleFactor;
+
+    if ( numColumns <= 0 )
+    {
+        return;
+    }
+
+    // Jobs still queued for any other zoom level will now be skipped
+    m_state->numColumns = numColumns;
+
+    const int numTiles = ( numColumns + TILE_WIDTH - 1 ) / TILE_WIDTH;
+
+    const int firstVisibleColumn = qMax( (int) floor( exposedRectLeft * scaleFactor ), 0 );
+    const int lastVisibleColumn = qMin( (int) ceil( exposedRectRight * scaleFactor ), numColumns - 1 );
+
+    const int firstVisibleTile = qMin( firstVisibleColumn / TILE_WIDTH, numTiles - 1 );
+    const int lastVisibleTile = qMax( lastVisibleColumn / TILE_WIDTH, firstVisibleTile );
+
+    const qreal reciprocalScaleFactor = 1.0 / scaleFactor;
+
+    painter->save();
+    painter->setRenderHint( QPainter::SmoothPixmapTransform, true );
+
+    for ( int tileIndex = firstVisibleTile; tileIndex <= lastVisibleTile; tileIndex++ )
+    {
+        const SpectrogramTileKey key = { m_rendererId, m_state->generation.get(), numColumns, tileIndex };
+        const QImage* const image = tileCache.object( key );
+
+        if ( image != NULL )
+        {
+            const QRectF targetRect( itemRect.left() + tileIndex * TILE_WIDTH * reciprocalScaleFactor,
+                                     itemRect.top(),
+                                     image->width() * reciprocalScaleFactor,
+                                     itemRect.height() );
+
+            painter->drawImage( targetRect, *image );
+        }
+        else
+        {
+            requestTile( numColumns, tileIndex, VISIBLE_TILE_PRIORITY );
+        }
+    }
+
+    painter->restore();
+
+    // Prefetch the neighbouring tiles so that scrolling doesn't immediately reveal gaps
+    for ( int i = 1; i <= NUM_PREFETCH_TILES; i++ )
+    {
+        if ( firstVisibleTile - i >= 0 )
+        {
+            requestTile( numColumns, firstVisibleTile - i, PREFETCH_TILE_PRIORITY );
+        }
+        if ( lastVisibleTile + i < numTiles )
+        {
+            requestTile( numColumns, lastVisibleTile + i, PREFETCH_TILE_PRIORITY );
+        }
+    }
+}
+
+
+
+void SpectrogramRenderer::invalidate()
+{
+    // Results of any jobs already running will be discarded when they arrive
+    ++m_state->generation;
+    m_pendingTiles.clear();
+
+    removeCachedTiles();
+}
+
+
+
+void SpectrogramRenderer::setSampleBuffer( const SharedSampleBuffer sampleBuffer )
+{
+    m_sampleBuffer = sampleBuffer;
+
+    invalidate();
+}
+
+
+
+//==================================================================================================
+// Private Slots:
+
+void SpectrogramRenderer::storeTile( const int generation, const int numColumns, const int tileIndex, const QImage image )
+{
+    if ( generation != m_state->generation.get() )
+    {
+        return;
+    }
+
+    m_pendingTiles.remove( getPendingTileKey( numColumns, tileIndex ) );
+
+    // A null image means the job was skipped because its zoom level was no longer wanted
+    if ( ! image.isNull() )
+    {
+        const SpectrogramTileKey key = { m_rendererId, generation, numColumns, tileIndex };
+        tileCache.insert( key, new QImage( image ), qMax( image.byteCount() / 1024, 1 ) );
+
+        emit tileReady();
+    }
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void SpectrogramRenderer::requestTile( const int numColumns, const int tileIndex, const JobScheduler::Priority priority )
+{
+    const int generation = m_state->generation.get();
+    const SpectrogramTileKey key = { m_rendererId, generation, numColumns, tileIndex };
+    const qint64 pendingKey = getPendingTileKey( numColumns, tileIndex );
+
+    if ( tileCache.contains( key ) || m_pendingTiles.contains( pendingKey ) )
+    {
+        return;
+    }
+
+    const int firstColumn = tileIndex * TILE_WIDTH;
+    const int numTileColumns = qMin( TILE_WIDTH, numColumns - firstColumn );
+
+    const int numFrames = m_sampleBuffer->getNumFrames();
+    const int numChans = m_sampleBuffer->getNumChannels();
+    const qreal framesPerColumn = (qreal) numFrames / numColumns;
+    const float chanGain = 1.0f / numChans;
+
+    // Take a mono copy of the frames centred on each column so that the job never touches the sample
+    // buffer, which may be edited or resized in place while the tile is being computed
+    HeapBlock<float> frames( numTileColumns * FFT_SIZE, true );
+
+    for ( int columnNum = 0; columnNum < numTileColumns; columnNum++ )
+    {
+        const int windowStartFrame = (int) ( ( firstColumn + columnNum + 0.5 ) * framesPerColumn ) - FFT_SIZE / 2;
+
+        const int startFrame = qMax( windowStartFrame, 0 );
+        const int endFrame = qMin( windowStartFrame + FFT_SIZE, numFrames );
+
+        if ( endFrame > startFrame )
+        {
+            float* const dest = frames + columnNum * FFT_SIZE + ( startFrame - windowStartFrame );
+
+            for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+            {
+                FloatVectorOperations::addWithMultiply( dest,
+                                                        m_sampleBuffer->getReadPointer( chanNum, startFrame ),
+                                                        chanGain,
+                                                        endFrame - startFrame );
+            }
+        }
+    }
+
+    m_pendingTiles.insert( pendingKey );
+
+    const JobScheduler::SharedJob job( new TileJob( m_state, generation, numColumns, tileIndex, numTileColumns, frames ) );
+
+    // Tiles arrive too often to be worth reporting, so they're started without a description
+    m_jobScheduler.start( job, priority, QString() );
+}
+
+
+
+void SpectrogramRenderer::removeCachedTiles()
+{
+    foreach ( SpectrogramTileKey key, tileCache.keys() )
+    {
+        if ( key.rendererId == m_rendererId )
+        {
+            tileCache.remove( key );
+        }
+    }
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+qint64 SpectrogramRenderer::getTileCacheNumBytes()
+{
+    return static_cast<qint64>( tileCache.totalCost() ) * 1024;
+}
+
+
+
+void SpectrogramRenderer::clearTileCache()
+{
+    tileCache.clear();
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+const SpectrogramRenderer::Tables& SpectrogramRenderer::getTables()
+{
+    static const Tables tables;
+    return tables;
+}
+
+
+
+QImage SpectrogramRenderer::computeTile( const float* const frames, const int numTileColumns )
+{
+    const Tables& tables = getTables();
+
+    QImage image( numTileColumns, NUM_ROWS, QImage::Format_RGB32 );
+
+    HeapBlock<float> fftData( FFT_SIZE * 2 );
+
+    for ( int columnNum = 0; columnNum < numTileColumns; columnNum++ )
+    {
+        const float* const columnFrames = frames + columnNum * FFT_SIZE;
+
+        FloatVectorOperations::multiply( fftData, columnFrames, tables.window, FFT_SIZE );
+        FloatVectorOperations::clear( fftData + FFT_SIZE, FFT_SIZE );
+
+        tables.fft.performFrequencyOnlyForwardTransform( fftData );
+
+        for ( int rowNum = 0; rowNum < NUM_ROWS; rowNum++ )
+        {
+            float magnitude = 0.0f;
+
+            for ( int binNum = tables.firstBin[ rowNum ]; binNum <= tables.lastBin[ rowNum ]; binNum++ )
+            {
+                magnitude = qMax( magnitude, fftData[ binNum ] );
+            }
+
+            const float decibels = Decibels::gainToDecibels( magnitude * tables.magnitudeScale, MIN_DECIBELS );
+            const float level = jlimit( 0.0f, 1.0f, 1.0f - decibels / MIN_DECIBELS );
+
+            QRgb* const scanLine = reinterpret_cast<QRgb*>( image.scanLine( rowNum ) );
+            scanLine[ columnNum ] = tables.palette[ roundToInt( level * ( Tables::NUM_COLOURS - 1 ) ) ];
+        }
+    }
+
+    return image;
+}
+
+
+
+SpectrogramRenderer::TileJob::TileJob( const QSharedPointer<SharedState> state,
+                                       const int generation, const int numColumns, const int tileIndex,
+                                       const int numTileColumns, HeapBlock<float>& frames ) :
+    JobScheduler::Job(),
+    m_state( state ),
+    m_generation( generation ),
+    m_numColumns( numColumns ),
+    m_tileIndex( tileIndex ),
+    m_numTileColumns( numTileColumns )
+{
+    m_frames.swapWith( frames );
+}
+
+
+
+void SpectrogramRenderer::TileJob::run()
+{
+    QImage image;
+
+    // Don't bother computing tiles that have been invalidated or whose zoom level has since been left
+    if ( m_state->generation.get() == m_generation && m_state->numColumns.get() == m_numColumns )
+    {
+        image = computeTile( m_frames, m_numTileColumns );
+    }
+
+    const QMutexLocker locker( &m_state->mutex );
+
+    if ( m_state->renderer != NULL )
+    {
+        QMetaObject::invokeMethod( m_state->renderer, "storeTile", Qt::QueuedConnection,
+                                   Q_ARG( int, m_generation ),
+                                   Q_ARG( int, m_numColumns ),
+                                   Q_ARG( int, m_tileIndex ),
+                                   Q_ARG( QImage, image ) );
+    }
+}
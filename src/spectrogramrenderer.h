@@ -0,0 +1,138 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef SPECTROGRAMRENDERER_H
+#define SPECTROGRAMRENDERER_H
+
+#include <QObject>
+#include <QPainter>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include "JuceHeader.h"
+#include "samplebuffer.h"
+#include "jobscheduler.h"
+
+
+// Draws a log-frequency spectrogram of a sample buffer as a series of image tiles, each TILE_WIDTH
+// columns wide. Tiles are computed as jobs on the application's JobScheduler, those currently visible
+// first, and are then kept in a cache shared by all renderers until they are evicted or invalidated
+
+class SpectrogramRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    SpectrogramRenderer( SharedSampleBuffer sampleBuffer, JobScheduler& jobScheduler, QObject* parent = NULL );
+    ~SpectrogramRenderer();
+
+    // Draws the tiles covering the exposed part of 'itemRect' at the current horizontal scale factor;
+    // any tiles not yet available are queued and tileReady() is emitted as each one arrives
+    void paint( QPainter* painter,
+                const QRectF& itemRect,
+                qreal exposedRectLeft, qreal exposedRectRight,
+                qreal scaleFactor );
+
+    // Discards every cached tile; should be called whenever the sample data has been edited in place
+    void invalidate();
+
+    // Draw another buffer from now on, e.g. once an edit has replaced the item's audio
+    void setSampleBuffer( SharedSampleBuffer sampleBuffer );
+
+    // The tile cache is shared by all renderers. Clearing it frees memory; tiles are recomputed as needed
+    static qint64 getTileCacheNumBytes();
+    static void clearTileCache();
+
+signals:
+    void tileReady();
+
+private slots:
+    void storeTile( int generation, int numColumns, int tileIndex, QImage image );
+
+private:
+    struct SharedState
+    {
+        QMutex mutex;
+        SpectrogramRenderer* renderer;  // Set to NULL when the renderer is destroyed
+        Atomic<int> generation;
+        Atomic<int> numColumns;         // Tiles for any other zoom level are no longer wanted
+    };
+
+    class TileJob : public JobScheduler::Job
+    {
+    public:
+        TileJob( QSharedPointer<SharedState> state,
+                 int generation, int numColumns, int tileIndex,
+                 int numTileColumns, HeapBlock<float>& frames );
+
+        void run();
+
+    private:
+        const QSharedPointer<SharedState> m_state;
+        const int m_generation;
+        const int m_numColumns;
+        const int m_tileIndex;
+        const int m_numTileColumns;
+        HeapBlock<float> m_frames;      // FFT_SIZE mono frames for each column of the tile
+    };
+
+    // Copies the frames needed for a tile and queues a job to compute it, unless it is already cached or queued
+    void requestTile( int numColumns, int tileIndex, JobScheduler::Priority priority );
+
+    void removeCachedTiles();
+
+    // Lookup tables shared by all jobs: the FFT, its window, the row to bin mapping and the colour palette
+    struct Tables;
+    static const Tables& getTables();
+
+    static QImage computeTile( const float* frames, int numTileColumns );
+
+    static qint64 getPendingTileKey( int numColumns, int tileIndex )
+    {
+        return ( qint64( numColumns ) << 32 ) | tileIndex;
+    }
+
+    SharedSampleBuffer m_sampleBuffer;
+    JobScheduler& m_jobScheduler;
+    const int m_rendererId;
+
+    QSharedPointer<SharedState> m_state;
+
+    QSet<qint64> m_pendingTiles;
+
+    static Atomic<int> s_nextRendererId;
+
+    static const int TILE_WIDTH = 256;
+    static const int FFT_ORDER = 10;
+    static const int FFT_SIZE = 1 << FFT_ORDER;
+    static const int NUM_ROWS = 128;
+    static const int NUM_PREFETCH_TILES = 1;
+    static const JobScheduler::Priority VISIBLE_TILE_PRIORITY = JobScheduler::PRIORITY_INTERACTIVE;
+    static const JobScheduler::Priority PREFETCH_TILE_PRIORITY = JobScheduler::PRIORITY_BACKGROUND;
+    static constexpr float MIN_DECIBELS = -90.0f;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( SpectrogramRenderer );
+};
+
+#endif // SPECTROGRAMRENDERER_H
@@ -0,0 +1,167 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "streaminganalyser.h"
+#include <QMutexLocker>
+
+
+//==================================================================================================
+// Public:
+
+StreamingAnalyser::StreamingAnalyser( const AudioAnalyser::DetectionSettings settings ) :
+    m_settings( settings ),
+    m_numFramesBuffered( 0 ),
+    m_summedBPMs( 0.0 ),
+    m_numBPMDetections( 0 )
+{
+    char_t* detectionMethod = (char_t*) m_settings.detectionMethod.data();
+
+    QMutexLocker locker( &AudioAnalyser::getAubioMutex() );
+
+    m_onsetDetector = new_aubio_onset( detectionMethod, m_settings.windowSize, m_settings.hopSize, m_settings.sampleRate );
+    aubio_onset_set_threshold( m_onsetDetector, m_settings.threshold );
+    aubio_onset_set_minioi_s( m_onsetDetector, AudioAnalyser::MIN_INTER_ONSET_SECS );
+
+    m_tempoDetector = new_aubio_tempo( detectionMethod, m_settings.windowSize, m_settings.hopSize, m_settings.sampleRate );
+    aubio_tempo_set_threshold( m_tempoDetector, m_settings.threshold );
+
+    m_inputBuffer = new_fvec( m_settings.hopSize );
+    m_onsetResult = new_fvec( 1 );
+    m_tempoResult = new_fvec( 2 );
+}
+
+
+
+StreamingAnalyser::~StreamingAnalyser()
+{
+    QMutexLocker locker( &AudioAnalyser::getAubioMutex() );
+
+    del_aubio_onset( m_onsetDetector );
+    del_aubio_tempo( m_tempoDetector );
+
+    del_fvec( m_inputBuffer );
+    del_fvec( m_onsetResult );
+    del_fvec( m_tempoResult );
+}
+
+
+
+void StreamingAnalyser::process( const AudioSampleBuffer& source, int startFrame, int numFrames )
+{
+    const int numChans = source.getNumChannels();
+    const float multiplier = 1.0 / numChans;
+
+    while ( numFrames > 0 )
+    {
+        const int numFramesToAdd = jmin( numFrames, (int) ( m_settings.hopSize - m_numFramesBuffered ) );
+
+        // Mix down to mono, as AudioAnalyser does
+        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+        {
+            FloatVectorOperations::addWithMultiply( m_inputBuffer->data + m_numFramesBuffered,
+                                                    source.getReadPointer( chanNum, startFrame ),
+                                                    multiplier,
+                                                    numFramesToAdd );
+        }
+
+        m_numFramesBuffered += numFramesToAdd;
+        startFrame += numFramesToAdd;
+        numFrames -= numFramesToAdd;
+
+        if ( m_numFramesBuffered == m_settings.hopSize )
+        {
+            analyseHop();
+        }
+    }
+}
+
+
+
+void StreamingAnalyser::finish()
+{
+    if ( m_numFramesBuffered > 0 )
+    {
+        analyseHop();
+    }
+}
+
+
+
+int StreamingAnalyser::getOnsetFrameNums( const int startIndex, QList<FrameNum>& onsetFrameNums )
+{
+    QMutexLocker locker( &m_resultsMutex );
+
+    for ( int i = startIndex; i < m_onsetFrameNums.size(); i++ )
+    {
+        onsetFrameNums << m_onsetFrameNums.at( i );
+    }
+
+    return m_onsetFrameNums.size();
+}
+
+
+
+qreal StreamingAnalyser::getBPM()
+{
+    QMutexLocker locker( &m_resultsMutex );
+
+    return m_numBPMDetections > 0 ? floor( m_summedBPMs / m_numBPMDetections ) : 0.0;
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void StreamingAnalyser::analyseHop()
+{
+    // Any frames not yet received are zero, which pads the final hop
+    aubio_onset_do( m_onsetDetector, m_inputBuffer, m_onsetResult );
+    aubio_tempo_do( m_tempoDetector, m_inputBuffer, m_tempoResult );
+
+    const bool isOnset = m_onsetResult->data[ 0 ] != 0.0;
+    const bool isBeat = m_tempoResult->data[ 0 ] != 0.0;
+
+    if ( isOnset || isBeat )
+    {
+        QMutexLocker locker( &m_resultsMutex );
+
+        if ( isOnset )
+        {
+            m_onsetFrameNums << aubio_onset_get_last( m_onsetDetector );
+        }
+
+        if ( isBeat )
+        {
+            const qreal bpm = aubio_tempo_get_bpm( m_tempoDetector );
+
+            if ( bpm > 0.0 && aubio_tempo_get_confidence( m_tempoDetector ) > MIN_BPM_CONFIDENCE )
+            {
+                m_summedBPMs += bpm;
+                m_numBPMDetections++;
+            }
+        }
+    }
+
+    FloatVectorOperations::clear( m_inputBuffer->data, m_settings.hopSize );
+    m_numFramesBuffered = 0;
+}
@@ -0,0 +1,80 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef STREAMINGANALYSER_H
+#define STREAMINGANALYSER_H
+
+#include <aubio/aubio.h>
+#include <QList>
+#include <QMutex>
+#include "audioanalyser.h"
+
+
+// Onset and tempo detection on audio that arrives in blocks, e.g. from a capture thread.
+// aubio's detector state is kept between blocks so results match a single pass over the whole
+// take; an onset is reported at most one window plus one hop after the frame it occurred at
+class StreamingAnalyser
+{
+public:
+    // Creating and deleting the detectors is serialised with AudioAnalyser's, so any thread will do
+    StreamingAnalyser( AudioAnalyser::DetectionSettings settings );
+    ~StreamingAnalyser();
+
+    // Feed the next block of frames. Should always be called from the same thread
+    void process( const AudioSampleBuffer& source, int startFrame, int numFrames );
+
+    // Pad and analyse any frames left over from the last incomplete hop
+    void finish();
+
+    // Appends onsets detected since onset number "startIndex" to "onsetFrameNums".
+    // Returns the total number of onsets detected so far
+    int getOnsetFrameNums( int startIndex, QList<FrameNum>& onsetFrameNums );
+
+    // Average of the confident tempo estimates so far, or 0.0 if there haven't been any
+    qreal getBPM();
+
+private:
+    void analyseHop();
+
+    static constexpr qreal MIN_BPM_CONFIDENCE = 0.2;
+
+    AudioAnalyser::DetectionSettings m_settings;
+
+    aubio_onset_t* m_onsetDetector;
+    aubio_tempo_t* m_tempoDetector;
+
+    fvec_t* m_inputBuffer;
+    fvec_t* m_onsetResult;
+    fvec_t* m_tempoResult;
+
+    uint_t m_numFramesBuffered;
+
+    QMutex m_resultsMutex;
+    QList<FrameNum> m_onsetFrameNums;
+    qreal m_summedBPMs;
+    int m_numBPMDetections;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( StreamingAnalyser );
+};
+
+#endif // STREAMINGANALYSER_H
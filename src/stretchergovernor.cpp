@@ -0,0 +1,130 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "stretchergovernor.h"
+#include "JuceHeader.h"
+
+
+//==================================================================================================
+// Public:
+
+StretcherGovernor::StretcherGovernor()
+{
+    reset();
+}
+
+
+
+void StretcherGovernor::reset()
+{
+    m_level = LEVEL_FULL_QUALITY;
+    m_settleSecs = 0.0;
+    m_quietSecs = 0.0;
+    m_recoverySecs = MIN_RECOVERY_SECS;
+    m_secsSinceStepUp = MAX_RECOVERY_SECS;
+}
+
+
+
+bool StretcherGovernor::update( const double processSecs, const double periodSecs )
+{
+    if ( periodSecs <= 0.0 )
+    {
+        return false;
+    }
+
+    const double load = processSecs / periodSecs;
+
+    m_secsSinceStepUp = jmin( m_secsSinceStepUp + periodSecs, MAX_RECOVERY_SECS );
+
+    if ( load > RECOVERY_LOAD )
+    {
+        m_quietSecs = 0.0;
+    }
+    else
+    {
+        m_quietSecs += periodSecs;
+    }
+
+    if ( m_settleSecs > 0.0 )
+    {
+        m_settleSecs -= periodSecs;
+        return false;
+    }
+
+    // Step down
+    if ( load > MAX_LOAD && m_level < NUM_LEVELS - 1 )
+    {
+        // Raising quality didn't work out, so wait longer before trying again
+        if ( m_secsSinceStepUp < m_recoverySecs )
+        {
+            m_recoverySecs = jmin( m_recoverySecs * 2.0, MAX_RECOVERY_SECS );
+        }
+
+        m_level = Level( m_level + 1 );
+        m_settleSecs = SETTLE_SECS;
+        m_quietSecs = 0.0;
+
+        return true;
+    }
+
+    // Step up
+    if ( m_quietSecs >= m_recoverySecs && m_level > LEVEL_FULL_QUALITY )
+    {
+        m_level = Level( m_level - 1 );
+        m_settleSecs = SETTLE_SECS;
+        m_quietSecs = 0.0;
+        m_secsSinceStepUp = 0.0;
+
+        return true;
+    }
+
+    return false;
+}
+
+
+
+RubberBandStretcher::Options StretcherGovernor::getTransientsOption( const RubberBandStretcher::Options option ) const
+{
+    return m_level >= LEVEL_SMOOTH_TRANSIENTS ? RubberBandStretcher::OptionTransientsSmooth : option;
+}
+
+
+
+RubberBandStretcher::Options StretcherGovernor::getPhaseOption( const RubberBandStretcher::Options option ) const
+{
+    return m_level >= LEVEL_INDEPENDENT_PHASE ? RubberBandStretcher::OptionPhaseIndependent : option;
+}
+
+
+
+RubberBandStretcher::Options StretcherGovernor::getFormantOption( const RubberBandStretcher::Options option ) const
+{
+    return m_level >= LEVEL_SHIFTED_FORMANTS ? RubberBandStretcher::OptionFormantShifted : option;
+}
+
+
+
+RubberBandStretcher::Options StretcherGovernor::getPitchOption( const RubberBandStretcher::Options option ) const
+{
+    return m_level >= LEVEL_FAST_PITCH_SHIFTING ? RubberBandStretcher::OptionPitchHighSpeed : option;
+}
@@ -0,0 +1,90 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef STRETCHERGOVERNOR_H
+#define STRETCHERGOVERNOR_H
+
+#include <rubberband/RubberBandStretcher.h>
+
+using namespace RubberBand;
+
+
+// Lowers the real-time stretcher's quality one step at a time when processing an audio cycle comes
+// close to taking longer than the cycle lasts, and restores it once there is headroom again.
+// Only the options that Rubber Band allows to be changed while running are touched.
+// No clock is read here; the caller measures the processing time, so behaviour depends on the
+// times passed to update() alone
+class StretcherGovernor
+{
+public:
+    // Each level keeps the savings of the levels below it
+    enum Level
+    {
+        LEVEL_FULL_QUALITY = 0,
+        LEVEL_FAST_PITCH_SHIFTING,      // OptionPitchHighSpeed
+        LEVEL_SHIFTED_FORMANTS,         // OptionFormantShifted
+        LEVEL_INDEPENDENT_PHASE,        // OptionPhaseIndependent
+        LEVEL_SMOOTH_TRANSIENTS,        // OptionTransientsSmooth
+        NUM_LEVELS
+    };
+
+    // Quality is lowered as soon as a cycle uses more than this fraction of its duration
+    static constexpr double MAX_LOAD = 0.7;
+
+    // Quality is raised again after every cycle has stayed below this fraction for the recovery time
+    static constexpr double RECOVERY_LOAD = 0.35;
+
+    // The recovery time doubles, up to the maximum, each time raising quality leads straight back
+    // to an overload
+    static constexpr double MIN_RECOVERY_SECS = 2.0;
+    static constexpr double MAX_RECOVERY_SECS = 60.0;
+
+    // A new level isn't judged until it has been running for this long
+    static constexpr double SETTLE_SECS = 0.05;
+
+    StretcherGovernor();
+
+    void reset();
+
+    // Call once per audio cycle. "processSecs" is the time taken to produce the cycle's audio and
+    // "periodSecs" is how long the cycle lasts. Returns true if the level has changed
+    bool update( double processSecs, double periodSecs );
+
+    Level getLevel() const                  { return m_level; }
+
+    // The user's choice of option with the current level applied
+    RubberBandStretcher::Options getTransientsOption( RubberBandStretcher::Options option ) const;
+    RubberBandStretcher::Options getPhaseOption( RubberBandStretcher::Options option ) const;
+    RubberBandStretcher::Options getFormantOption( RubberBandStretcher::Options option ) const;
+    RubberBandStretcher::Options getPitchOption( RubberBandStretcher::Options option ) const;
+
+private:
+    Level m_level;
+
+    double m_settleSecs;        // Time left before the current level is judged
+    double m_quietSecs;         // Time since the load was last above RECOVERY_LOAD
+    double m_recoverySecs;
+    double m_secsSinceStepUp;
+};
+
+
+#endif // STRETCHERGOVERNOR_H
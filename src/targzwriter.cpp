@@ -0,0 +1,301 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "targzwriter.h"
+#include <QThread>
+#include <QByteArray>
+#include <cstdio>
+
+
+//==================================================================================================
+// Public:
+
+TarGzWriter::TarGzWriter( const QString archiveFilePath, JobScheduler::Job* const job ) :
+    m_job( job ),
+    m_maxQueuedTasks( 0 ),
+    m_pendingSize( 0 ),
+    m_modificationTime( Time::currentTimeMillis() / 1000 ),
+    m_isFinished( false ),
+    m_isSuccessful( true )
+{
+    const File archiveFile( archiveFilePath.toLocal8Bit().data() );
+
+    // FileOutputStream appends to existing files
+    if ( archiveFile.exists() )
+    {
+        archiveFile.deleteFile();
+    }
+
+    m_outputStream = new FileOutputStream( archiveFile );
+
+    if ( m_outputStream->failedToOpen() )
+    {
+        recordError( "Couldn't open " + archiveFilePath + " for writing" );
+    }
+
+    const int numThreads = qMax( 1, QThread::idealThreadCount() );
+
+    // Enough blocks in flight to keep every thread busy without buffering the whole archive
+    m_maxQueuedTasks = numThreads * 2;
+
+    m_pendingTask = SharedCompressionTask( new CompressionTask() );
+    m_pendingTask->input.setSize( BLOCK_SIZE );
+}
+
+
+
+TarGzWriter::~TarGzWriter()
+{
+    // Started tasks must be waited for before the job returns, even if the archive is abandoned
+    foreach ( SharedCompressionTask task, m_taskQueue )
+    {
+        task->wait();
+    }
+}
+
+
+
+bool TarGzWriter::addDirectory( QString pathInArchive )
+{
+    if ( ! pathInArchive.endsWith( '/' ) )
+    {
+        pathInArchive.append( '/' );
+    }
+
+    return writeHeader( pathInArchive, 0, '5' );
+}
+
+
+
+bool TarGzWriter::addFile( const QString pathInArchive, const MemoryBlock& data )
+{
+    const size_t numBytes = data.getSize();
+
+    if ( writeHeader( pathInArchive, numBytes, '0' ) )
+    {
+        appendToTarStream( data.getData(), numBytes );
+
+        const size_t numPaddingBytes = ( TAR_RECORD_SIZE - numBytes % TAR_RECORD_SIZE ) % TAR_RECORD_SIZE;
+
+        if ( numPaddingBytes > 0 )
+        {
+            const char padding[ TAR_RECORD_SIZE ] = {};
+            appendToTarStream( padding, numPaddingBytes );
+        }
+    }
+
+    return m_isSuccessful;
+}
+
+
+
+bool TarGzWriter::finish()
+{
+    if ( m_isFinished )
+    {
+        return m_isSuccessful;
+    }
+
+    m_isFinished = true;
+
+    // End of archive is marked by two empty records
+    const char endOfArchive[ TAR_RECORD_SIZE * 2 ] = {};
+    appendToTarStream( endOfArchive, sizeof( endOfArchive ) );
+
+    if ( m_pendingSize > 0 )
+    {
+        submitPendingBlock();
+    }
+
+    while ( ! m_taskQueue.isEmpty() )
+    {
+        writeOldestBlock();
+    }
+
+    if ( m_isSuccessful )
+    {
+        m_outputStream->flush();
+
+        if ( m_outputStream->getStatus().failed() )
+        {
+            recordError( m_outputStream->getStatus().getErrorMessage().toRawUTF8() );
+        }
+    }
+
+    m_outputStream = NULL;
+
+    return m_isSuccessful;
+}
+
+
+
+//==================================================================================================
+// Private:
+
+void TarGzWriter::CompressionTask::run()
+{
+    {
+        MemoryOutputStream outputStream( output, false );
+        GZIPCompressorOutputStream gzipStream( &outputStream, 6, false, GZIPCompressorOutputStream::windowBitsGZIP );
+
+        gzipStream.write( input.getData(), input.getSize() );
+        gzipStream.flush();
+    }
+
+    input.reset();
+}
+
+
+
+bool TarGzWriter::writeHeader( const QString pathInArchive, const int64 numBytes, const char typeFlag )
+{
+    if ( ! m_isSuccessful )
+    {
+        return false;
+    }
+
+    const QByteArray path = pathInArchive.toUtf8();
+
+    QByteArray name = path;
+    QByteArray prefix;
+
+    // ustar stores paths longer than 100 bytes as a prefix and name split at a slash
+    if ( path.size() > 100 )
+    {
+        int splitPos = path.lastIndexOf( '/', path.endsWith( '/' ) ? path.size() - 2 : -1 );
+
+        while ( splitPos > 155 )
+        {
+            splitPos = path.lastIndexOf( '/', splitPos - 1 );
+        }
+
+        if ( splitPos <= 0 || path.size() - splitPos - 1 > 100 )
+        {
+            recordError( "The path " + pathInArchive + " is too long to store in the archive" );
+            return false;
+        }
+
+        prefix = path.left( splitPos );
+        name = path.mid( splitPos + 1 );
+    }
+
+    char header[ TAR_RECORD_SIZE ] = {};
+
+    memcpy( header, name.constData(), name.size() );
+    snprintf( header + 100, 8, "%07o", typeFlag == '5' ? 0755 : 0644 );        // Mode
+    snprintf( header + 108, 8, "%07o", 0 );                                     // Owner ID
+    snprintf( header + 116, 8, "%07o", 0 );                                     // Group ID
+    snprintf( header + 124, 12, "%011llo", (unsigned long long) numBytes );     // Size
+    snprintf( header + 136, 12, "%011llo", (unsigned long long) m_modificationTime );
+    header[ 156 ] = typeFlag;
+    memcpy( header + 257, "ustar", 6 );
+    memcpy( header + 263, "00", 2 );
+    memcpy( header + 345, prefix.constData(), prefix.size() );
+
+    // The checksum is calculated with the checksum field itself filled with spaces
+    memset( header + 148, ' ', 8 );
+
+    unsigned int checksum = 0;
+
+    for ( int i = 0; i < TAR_RECORD_SIZE; i++ )
+    {
+        checksum += static_cast<unsigned char>( header[ i ] );
+    }
+
+    snprintf( header + 148, 7, "%06o", checksum );
+    header[ 155 ] = ' ';
+
+    appendToTarStream( header, TAR_RECORD_SIZE );
+
+    return m_isSuccessful;
+}
+
+
+
+void TarGzWriter::appendToTarStream( const void* data, size_t numBytes )
+{
+    const char* bytes = static_cast<const char*>( data );
+
+    while ( numBytes > 0 && m_isSuccessful )
+    {
+        const size_t numBytesToCopy = jmin( numBytes, BLOCK_SIZE - m_pendingSize );
+
+        m_pendingTask->input.copyFrom( bytes, (int) m_pendingSize, numBytesToCopy );
+
+        m_pendingSize += numBytesToCopy;
+        bytes += numBytesToCopy;
+        numBytes -= numBytesToCopy;
+
+        if ( m_pendingSize == BLOCK_SIZE )
+        {
+            submitPendingBlock();
+        }
+    }
+}
+
+
+
+void TarGzWriter::submitPendingBlock()
+{
+    m_pendingTask->input.setSize( m_pendingSize );
+
+    m_taskQueue.enqueue( m_pendingTask );
+
+    if ( m_job != NULL )
+    {
+        m_job->startTask( m_pendingTask );
+    }
+
+    m_pendingTask = SharedCompressionTask( new CompressionTask() );
+    m_pendingTask->input.setSize( BLOCK_SIZE );
+    m_pendingSize = 0;
+
+    while ( m_taskQueue.size() > m_maxQueuedTasks )
+    {
+        writeOldestBlock();
+    }
+}
+
+
+
+void TarGzWriter::writeOldestBlock()
+{
+    SharedCompressionTask task = m_taskQueue.dequeue();
+
+    task->wait();
+
+    if ( m_isSuccessful && ! m_outputStream->write( task->output.getData(), task->output.getSize() ) )
+    {
+        recordError( m_outputStream->getStatus().getErrorMessage().toRawUTF8() );
+    }
+}
+
+
+
+void TarGzWriter::recordError( const QString errorInfo )
+{
+    if ( m_isSuccessful )
+    {
+        m_isSuccessful = false;
+        m_errorInfo = errorInfo;
+    }
+}
@@ -0,0 +1,96 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef TARGZWRITER_H
+#define TARGZWRITER_H
+
+#include "JuceHeader.h"
+#include "jobscheduler.h"
+#include <QString>
+#include <QQueue>
+#include <QSharedPointer>
+
+
+// Streams a gzip-compressed ustar archive to disk. The tar stream is cut into fixed size blocks
+// which are compressed concurrently as independent gzip members and written out in order;
+// concatenated gzip members form a valid gzip file, so standard tools and libarchive can read it.
+// Blocks are compressed as tasks of "job"; without a job they're compressed on the calling thread
+class TarGzWriter
+{
+public:
+    TarGzWriter( QString archiveFilePath, JobScheduler::Job* job = NULL );
+    ~TarGzWriter();
+
+    bool isOpen() const                 { return m_isSuccessful; }
+
+    bool addDirectory( QString pathInArchive );
+    bool addFile( QString pathInArchive, const MemoryBlock& data );
+
+    // Writes the end-of-archive marker and waits for all outstanding blocks to be written.
+    // Returns false if anything failed since the archive was opened
+    bool finish();
+
+    QString getErrorInfo() const        { return m_errorInfo; }
+
+public:
+    static const int BLOCK_SIZE = 1024 * 1024;
+
+private:
+    class CompressionTask : public JobScheduler::Task
+    {
+    public:
+        CompressionTask() : JobScheduler::Task() {}
+
+        void run();
+
+        MemoryBlock input;
+        MemoryBlock output;
+    };
+
+    typedef QSharedPointer<CompressionTask> SharedCompressionTask;
+
+    bool writeHeader( QString pathInArchive, int64 numBytes, char typeFlag );
+    void appendToTarStream( const void* data, size_t numBytes );
+    void submitPendingBlock();
+    void writeOldestBlock();
+    void recordError( QString errorInfo );
+
+    static const int TAR_RECORD_SIZE = 512;
+
+    ScopedPointer<FileOutputStream> m_outputStream;
+    JobScheduler::Job* const m_job;
+    QQueue<SharedCompressionTask> m_taskQueue;
+    int m_maxQueuedTasks;
+
+    SharedCompressionTask m_pendingTask;
+    size_t m_pendingSize;
+
+    const int64 m_modificationTime;
+    bool m_isFinished;
+    bool m_isSuccessful;
+    QString m_errorInfo;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( TarGzWriter );
+};
+
+#endif // TARGZWRITER_H
@@ -22,7 +22,6 @@
 
 #include "textfilehandler.h"
 #include "JuceHeader.h"
-#include "messageboxes.h"
 #include <QDir>
 
 
@@ -85,10 +84,10 @@ bool TextFileHandler::createProjectXmlFile( const QString filePath, const Projec
         docElement.addChildElement( sampleElement );
     }
 
-    foreach ( int slicePointFrameNum, settings.slicePointFrameNums )
+    foreach ( FrameNum slicePointFrameNum, settings.slicePointFrameNums )
     {
         XmlElement* slicePointElement = new XmlElement( "slice_point" );
-        slicePointElement->setAttribute( "frame_num", slicePointFrameNum );
+        slicePointElement->setAttribute( "frame_num", String( (int64) slicePointFrameNum ) );
         docElement.addChildElement( slicePointElement );
     }
 
@@ -122,7 +121,7 @@ bool TextFileHandler::createProjectXmlFile( const QString filePath, const Projec
 
 
 
-bool TextFileHandler::readProjectXmlFile( const QString filePath, ProjectSettings& settings )
+bool TextFileHandler::readProjectXmlFile( const QString filePath, ProjectSettings& settings, QString& errorInfo )
 {
     ScopedPointer<XmlElement> docElement;
     docElement = XmlDocument::parse( File( filePath.toLocal8Bit().data() ) );
@@ -143,14 +142,14 @@ bool TextFileHandler::readProjectXmlFile( const QString filePath, ProjectSetting
                 {
                     SharedSampleRange sampleRange( new SampleRange );
 
-                    sampleRange->startFrame = elem->getIntAttribute( "start_frame" );
-                    sampleRange->numFrames = elem->getIntAttribute( "num_frames" );
+                    sampleRange->startFrame = elem->getStringAttribute( "start_frame" ).getLargeIntValue();
+                    sampleRange->numFrames = elem->getStringAttribute( "num_frames" ).getLargeIntValue();
 
                     settings.sampleRangeList << sampleRange;
                 }
                 else if ( elem->hasTagName( "slice_point" ) )
                 {
-                    settings.slicePointFrameNums << elem->getIntAttribute( "frame_num" );
+                    settings.slicePointFrameNums << elem->getStringAttribute( "frame_num" ).getLargeIntValue();
                 }
                 else if ( elem->hasTagName( "note_time_ratio" ) )
                 {
@@ -221,14 +220,12 @@ bool TextFileHandler::readProjectXmlFile( const QString filePath, ProjectSetting
         }
         else // The xml file doesn't have a valid "project" tag
         {
-            MessageBoxes::showWarningDialog( QObject::tr("Couldn't open project!"),
-                                             QObject::tr("The project file is invalid") );
+            errorInfo = QObject::tr("The project file is invalid");
         }
     }
     else // The xml file couldn't be read
     {
-        MessageBoxes::showWarningDialog( QObject::tr("Couldn't open project!"),
-                                         QObject::tr("The project file is unreadable") );
+        errorInfo = QObject::tr("The project file is unreadable");
     }
 
     return isSuccessful;
@@ -294,9 +291,9 @@ bool TextFileHandler::readPathsConfigFile( PathsConfig& config )
 
 
 
-bool TextFileHandler::createH2DrumkitXmlFile( const QString dirPath, const QString kitName,
-                                              const QStringList audioFileNames,
-                                              const SamplerAudioSource::EnvelopeSettings& envelopes )
+String TextFileHandler::createH2DrumkitXml( const QString kitName,
+                                           const QStringList audioFileNames,
+                                           const SamplerAudioSource::EnvelopeSettings& envelopes )
 {
     Q_ASSERT( audioFileNames.size() == envelopes.attackValues.size() );
 
@@ -456,9 +453,7 @@ bool TextFileHandler::createH2DrumkitXmlFile( const QString dirPath, const QStri
 
     docElement.addChildElement( instrumentListElement );
 
-    File file( QDir( dirPath ).absoluteFilePath( "drumkit.xml" ).toLocal8Bit().data() );
-
-    return docElement.writeToFile( file, String::empty );
+    return docElement.createDocument( String::empty );
 }
 
 
@@ -473,27 +468,34 @@ bool TextFileHandler::createSFZFile( const QString sfzFilePath,
     Q_ASSERT( sampleBufferList.size() == audioFileNames.size() &&
               sampleBufferList.size() == envelopes.attackValues.size() );
 
+    if ( audioFileNames.size() > Midi::NUM_KEYS )
+    {
+        return false;
+    }
+
     File file( sfzFilePath.toLocal8Bit().data() );
 
     const bool isSuccessful = file.create();
 
     if ( isSuccessful )
     {
-        int key = Midi::MIDDLE_C;
+        // The same keys as the sampler; channels are only given when there are too many slices for one
+        const int startKeyNum = Midi::getStartKeyNum( audioFileNames.size() );
+        const bool isMultiChannel = audioFileNames.size() > Midi::NUM_NOTES;
 
-        if ( audioFileNames.size() > Midi::MAX_POLYPHONY - Midi::MIDDLE_C )
-        {
-            key = qMax( Midi::MAX_POLYPHONY - audioFileNames.size(), 0 );
-        }
-
-        for ( int i = 0; i < audioFileNames.size() && i < Midi::MAX_POLYPHONY; i++ )
+        for ( int i = 0; i < audioFileNames.size(); i++ )
         {
+            const int keyNum = startKeyNum + i;
             const QString fileName = audioFileNames.at( i );
             const qreal attackValue = ( envelopes.attackValues.at( i ) * sampleBufferList.at( i )->getNumFrames() ) / sampleRate;
             const qreal releaseValue = ( envelopes.releaseValues.at( i ) * sampleBufferList.at( i )->getNumFrames() ) / sampleRate;
             const QString loopMode = envelopes.oneShotSettings.at( i ) ? "one_shot" : "no_loop";
 
-            const QString groupText = "<group> key=" + QString::number( key ) +
+            const QString channelText = isMultiChannel ? " lochan=" + QString::number( Midi::getChannel( keyNum ) ) +
+                                                         " hichan=" + QString::number( Midi::getChannel( keyNum ) )
+                                                       : QString();
+
+            const QString groupText = "<group> key=" + QString::number( Midi::getNoteNum( keyNum ) ) + channelText +
                                       " ampeg_attack=" + QString::number( attackValue ) +
                                       " ampeg_release=" + QString::number( releaseValue ) +
                                       " loop_mode=" + loopMode + "\n";
@@ -502,8 +504,6 @@ bool TextFileHandler::createSFZFile( const QString sfzFilePath,
             file.appendText( groupText.toLocal8Bit().data() );
             file.appendText( regionText.toLocal8Bit().data() );
             file.appendText( "\n" );
-
-            key++;
         }
     }
 
@@ -54,7 +54,7 @@ public:
         }
 
         QString projectName;
-        QList<int> slicePointFrameNums;
+        QList<FrameNum> slicePointFrameNums;
         QStringList audioFileNames;
         QList<SharedSampleRange> sampleRangeList;   // Deprecated, exists only to provide backward compatibility
         qreal originalBpm;
@@ -78,7 +78,8 @@ public:
 
     static bool createProjectXmlFile( QString filePath, const ProjectSettings& settings );
 
-    static bool readProjectXmlFile( QString filePath, ProjectSettings& settings );
+    // Returns false and sets "errorInfo" if the file can't be read. Safe to call from any thread
+    static bool readProjectXmlFile( QString filePath, ProjectSettings& settings, QString& errorInfo );
 
 
 
@@ -94,9 +95,11 @@ public:
 
 
 
-    static bool createH2DrumkitXmlFile( QString dirPath, QString kitName, QStringList audioFileNames,
-                                        const SamplerAudioSource::EnvelopeSettings& envelopes );
+    // Returns the contents of a Hydrogen "drumkit.xml" file
+    static String createH2DrumkitXml( QString kitName, QStringList audioFileNames,
+                                      const SamplerAudioSource::EnvelopeSettings& envelopes );
 
+    // Returns false without writing anything if there are more slices than Midi::NUM_KEYS
     static bool createSFZFile( QString sfzFilePath,
                                QString samplesDirName,
                                QStringList audioFileNames,
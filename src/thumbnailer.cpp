@@ -0,0 +1,317 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "thumbnailer.h"
+#include "audiofilereader.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <cmath>
+
+
+//==================================================================================================
+// Public Static:
+
+bool Thumbnailer::decode( const QString filePath,
+                          const int numColumns,
+                          DecodedFile& decodedFile,
+                          JobScheduler::Job* const job )
+{
+    static const int HOP_SIZE = 4096;
+
+    AudioFileReader reader;
+
+    if ( numColumns < 1 || ! reader.open( filePath ) )
+    {
+        return false;
+    }
+
+    const int numChans = reader.getNumChannels();
+    const int sampleRate = reader.getSampleRate();
+    const FrameNum numFrames = reader.getNumFrames();
+
+    const int decimationFactor = qMax( 1, sampleRate / ANALYSIS_SAMPLE_RATE );
+    const int analysisSampleRate = sampleRate / decimationFactor;
+    const int numAnalysisFrames = (int) qMin( numFrames / decimationFactor, (FrameNum) MAX_ANALYSIS_SECS * analysisSampleRate );
+    const float analysisGain = 1.0f / ( numChans * decimationFactor );
+
+    SharedSampleBuffer analysisBuffer( new SampleBuffer( 1, numAnalysisFrames ) );
+    float* const analysisSamples = analysisBuffer->getWritePointer( 0 );
+    int analysisFrameNum = 0;
+    float decimationSum = 0.0f;
+    int decimationCount = 0;
+    double sumOfSquares = 0.0;
+
+    QVector<float> minValues( numColumns, 0.0f );
+    QVector<float> maxValues( numColumns, 0.0f );
+    float* const mins = minValues.data();
+    float* const maxs = maxValues.data();
+    int columnNum = 0;
+    FrameNum nextColumnStartFrame = numFrames / numColumns;
+
+    AudioSampleBuffer block( numChans, HOP_SIZE );
+    FrameNum frameNum = 0;
+
+    while ( frameNum < numFrames )
+    {
+        if ( job != NULL )
+        {
+            if ( job->isCancelled() )
+            {
+                return false;
+            }
+
+            job->setProgress( (int) ( frameNum * 100 / numFrames ) );
+        }
+
+        const int numFramesRead = reader.read( block, 0, (int) qMin( (FrameNum) HOP_SIZE, numFrames - frameNum ) );
+
+        if ( numFramesRead <= 0 )
+        {
+            break;
+        }
+
+        for ( int i = 0; i < numFramesRead; i++ )
+        {
+            while ( frameNum + i >= nextColumnStartFrame && columnNum < numColumns - 1 )
+            {
+                columnNum++;
+                nextColumnStartFrame = ( columnNum + 1 ) * numFrames / numColumns;
+            }
+
+            float monoSum = 0.0f;
+
+            for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+            {
+                const float sample = block.getSample( chanNum, i );
+
+                mins[ columnNum ] = qMin( mins[ columnNum ], sample );
+                maxs[ columnNum ] = qMax( maxs[ columnNum ], sample );
+                monoSum += sample;
+                sumOfSquares += sample * sample;
+            }
+
+            // Box filter before decimating; good enough for onset and tempo detection
+            if ( analysisFrameNum < numAnalysisFrames )
+            {
+                decimationSum += monoSum;
+
+                if ( ++decimationCount == decimationFactor )
+                {
+                    analysisSamples[ analysisFrameNum++ ] = decimationSum * analysisGain;
+                    decimationSum = 0.0f;
+                    decimationCount = 0;
+                }
+            }
+        }
+
+        frameNum += numFramesRead;
+    }
+
+    if ( frameNum == 0 )
+    {
+        return false;
+    }
+
+    // The file may be shorter than its header says
+    analysisBuffer->setSize( 1, analysisFrameNum, true );
+
+    decodedFile.analysisBuffer = analysisBuffer;
+    decodedFile.analysisSampleRate = analysisSampleRate;
+    decodedFile.minValues = minValues;
+    decodedFile.maxValues = maxValues;
+    decodedFile.rmsLevel = (float) std::sqrt( sumOfSquares / ( frameNum * numChans ) );
+    decodedFile.sampleRate = sampleRate;
+    decodedFile.numChans = numChans;
+    decodedFile.numFrames = frameNum;
+
+    return true;
+}
+
+
+
+AudioAnalyser::DetectionSettings Thumbnailer::getAnalysisSettings( const DecodedFile& decodedFile )
+{
+    AudioAnalyser::DetectionSettings settings;
+    settings.detectionMethod = "default";
+    settings.threshold = 0.3;
+    settings.windowSize = ANALYSIS_WINDOW_SIZE;
+    settings.hopSize = ANALYSIS_HOP_SIZE;
+    settings.sampleRate = decodedFile.analysisSampleRate;
+
+    return settings;
+}
+
+
+
+qreal Thumbnailer::guessBPM( const DecodedFile& decodedFile )
+{
+    // One-shots are too short to have a tempo
+    if ( decodedFile.analysisBuffer.isNull() ||
+         decodedFile.analysisBuffer->getNumFrames() < MIN_BPM_SECS * decodedFile.analysisSampleRate )
+    {
+        return 0.0;
+    }
+
+    return AudioAnalyser::calcBPM( decodedFile.analysisBuffer, getAnalysisSettings( decodedFile ) );
+}
+
+
+
+Thumbnailer::Thumbnail Thumbnailer::getThumbnail( const QString filePath,
+                                                  const QString cacheDirPath,
+                                                  JobScheduler::Job* const job )
+{
+    const QString cacheFilePath = getCacheFilePath( filePath, cacheDirPath );
+
+    Thumbnail thumbnail;
+
+    if ( ! cacheFilePath.isEmpty() && readCacheFile( cacheFilePath, thumbnail ) )
+    {
+        return thumbnail;
+    }
+
+    DecodedFile decodedFile;
+
+    if ( ! decode( filePath, NUM_COLUMNS, decodedFile, job ) )
+    {
+        return Thumbnail();
+    }
+
+    thumbnail.minValues = decodedFile.minValues;
+    thumbnail.maxValues = decodedFile.maxValues;
+    thumbnail.sampleRate = decodedFile.sampleRate;
+    thumbnail.numChans = decodedFile.numChans;
+    thumbnail.numFrames = decodedFile.numFrames;
+    thumbnail.bpm = guessBPM( decodedFile );
+
+    if ( job != NULL && job->isCancelled() )
+    {
+        return Thumbnail();
+    }
+
+    if ( ! cacheFilePath.isEmpty() )
+    {
+        writeCacheFile( cacheFilePath, thumbnail );
+    }
+
+    return thumbnail;
+}
+
+
+
+void Thumbnailer::ThumbnailJob::run()
+{
+    m_thumbnail = Thumbnailer::getThumbnail( m_filePath, m_cacheDirPath, this );
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+QString Thumbnailer::getCacheFilePath( const QString filePath, const QString cacheDirPath )
+{
+    if ( cacheDirPath.isEmpty() )
+    {
+        return QString();
+    }
+
+    const QFileInfo fileInfo( filePath );
+
+    // A changed file gets a new cache file name, so a stale thumbnail is never read
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+    hash.addData( fileInfo.absoluteFilePath().toUtf8() );
+    hash.addData( QByteArray::number( fileInfo.size() ) );
+    hash.addData( QByteArray::number( fileInfo.lastModified().toMSecsSinceEpoch() ) );
+
+    return QDir( cacheDirPath ).absoluteFilePath( QString( hash.result().toHex() ) + ".thumb" );
+}
+
+
+
+bool Thumbnailer::readCacheFile( const QString cacheFilePath, Thumbnail& thumbnail )
+{
+    QFile file( cacheFilePath );
+
+    if ( ! file.open( QIODevice::ReadOnly ) )
+    {
+        return false;
+    }
+
+    QDataStream inStream( &file );
+
+    quint32 magic = 0;
+    qint32 version = 0;
+
+    inStream >> magic >> version;
+
+    if ( magic != CACHE_MAGIC || version != CACHE_VERSION )
+    {
+        return false;
+    }
+
+    qint32 sampleRate = 0;
+    qint32 numChans = 0;
+    qint64 numFrames = 0;
+
+    inStream >> thumbnail.minValues >> thumbnail.maxValues >> thumbnail.bpm >> sampleRate >> numChans >> numFrames;
+
+    thumbnail.sampleRate = sampleRate;
+    thumbnail.numChans = numChans;
+    thumbnail.numFrames = numFrames;
+
+    return inStream.status() == QDataStream::Ok &&
+           thumbnail.minValues.size() == NUM_COLUMNS &&
+           thumbnail.maxValues.size() == NUM_COLUMNS;
+}
+
+
+
+void Thumbnailer::writeCacheFile( const QString cacheFilePath, const Thumbnail& thumbnail )
+{
+    QDir().mkpath( QFileInfo( cacheFilePath ).absolutePath() );
+
+    // Written under a temporary name so that a reader on another thread never sees half a file
+    const QString partFilePath = cacheFilePath + ".part";
+    QFile file( partFilePath );
+
+    if ( ! file.open( QIODevice::WriteOnly ) )
+    {
+        return;
+    }
+
+    QDataStream outStream( &file );
+
+    outStream << CACHE_MAGIC << CACHE_VERSION;
+    outStream << thumbnail.minValues << thumbnail.maxValues << thumbnail.bpm
+              << (qint32) thumbnail.sampleRate << (qint32) thumbnail.numChans << (qint64) thumbnail.numFrames;
+
+    file.close();
+
+    QFile::remove( cacheFilePath );
+    QFile::rename( partFilePath, cacheFilePath );
+}
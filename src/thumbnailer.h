@@ -0,0 +1,121 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef THUMBNAILER_H
+#define THUMBNAILER_H
+
+#include <QString>
+#include <QVector>
+#include "samplebuffer.h"
+#include "jobscheduler.h"
+#include "audioanalyser.h"
+
+
+// Makes waveform overviews and tempo guesses for audio files without loading them, so that a directory of
+// files can be browsed quickly. Thumbnails are cached on disk and only remade if the file has changed
+class Thumbnailer
+{
+public:
+    static const int NUM_COLUMNS = 100;
+
+    struct Thumbnail
+    {
+        Thumbnail() : bpm( 0.0 ), sampleRate( 0 ), numChans( 0 ), numFrames( 0 ) {}
+
+        bool isValid() const                { return numFrames > 0; }
+
+        QVector<float> minValues;           // One per column, over every channel
+        QVector<float> maxValues;
+        qreal bpm;                          // 0.0 if no tempo was found
+        int sampleRate;
+        int numChans;
+        FrameNum numFrames;
+    };
+
+    // The file mixed down to mono and decimated for analysis, plus its per-column peaks at the full rate
+    struct DecodedFile
+    {
+        DecodedFile() : analysisSampleRate( 0 ), rmsLevel( 0.0f ), sampleRate( 0 ), numChans( 0 ), numFrames( 0 ) {}
+
+        SharedSampleBuffer analysisBuffer;  // At most MAX_ANALYSIS_SECS long
+        int analysisSampleRate;
+        QVector<float> minValues;
+        QVector<float> maxValues;
+        float rmsLevel;                     // Over the whole file and every channel
+        int sampleRate;
+        int numChans;
+        FrameNum numFrames;
+    };
+
+    // Streams the whole file a block at a time. Returns false if the file can't be read or "job" is cancelled
+    static bool decode( QString filePath, int numColumns, DecodedFile& decodedFile, JobScheduler::Job* job = NULL );
+
+    // Onset and tempo detection settings suited to a decoded file's analysis buffer
+    static AudioAnalyser::DetectionSettings getAnalysisSettings( const DecodedFile& decodedFile );
+
+    // Returns 0.0 if the file is too short to have a tempo
+    static qreal guessBPM( const DecodedFile& decodedFile );
+
+    // Returns an invalid thumbnail if the file can't be read. "cacheDirPath" may be empty, in which case
+    // nothing is cached
+    static Thumbnail getThumbnail( QString filePath, QString cacheDirPath, JobScheduler::Job* job = NULL );
+
+    // Makes a thumbnail on a JobScheduler worker thread
+    class ThumbnailJob : public JobScheduler::Job
+    {
+    public:
+        ThumbnailJob( QString filePath, QString cacheDirPath ) :
+            JobScheduler::Job(),
+            m_filePath( filePath ),
+            m_cacheDirPath( cacheDirPath )
+        {
+        }
+
+        void run();
+
+        QString getFilePath() const                 { return m_filePath; }
+        Thumbnail getThumbnail() const              { return m_thumbnail; }
+
+    private:
+        const QString m_filePath;
+        const QString m_cacheDirPath;
+
+        Thumbnail m_thumbnail;
+    };
+
+private:
+    static const int ANALYSIS_SAMPLE_RATE = 11025;  // Approximate; the file's rate is divided by a whole number
+    static const int MAX_ANALYSIS_SECS = 120;
+    static const int MIN_BPM_SECS = 4;
+    static const int ANALYSIS_WINDOW_SIZE = 512;
+    static const int ANALYSIS_HOP_SIZE = 128;
+    static const quint32 CACHE_MAGIC = 0x53485442;  // "SHTB"
+    static const qint32 CACHE_VERSION = 1;
+
+    static QString getCacheFilePath( QString filePath, QString cacheDirPath );
+    static bool readCacheFile( QString cacheFilePath, Thumbnail& thumbnail );
+    static void writeCacheFile( QString cacheFilePath, const Thumbnail& thumbnail );
+};
+
+
+#endif // THUMBNAILER_H
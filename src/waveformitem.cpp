@@ -48,6 +48,9 @@ WaveformItem::WaveformItem( const SharedSampleBuffer sampleBuffer,
     m_wavePen = QPen( QColor(23, 23, 135, 191) );
     m_wavePen.setCosmetic( true );
 
+    m_spectrogramWavePen = QPen( QColor(255, 255, 255, 95) );
+    m_spectrogramWavePen.setCosmetic( true );
+
     m_centreLinePen = QPen( QColor(127, 127, 127, 191) );
     m_centreLinePen.setCosmetic( true );
 
@@ -83,6 +86,11 @@ void WaveformItem::paint( QPainter* painter, const QStyleOptionGraphicsItem* opt
     painter->setBrush( brush() );
     painter->drawRect( rect() );
 
+    if ( m_spectrogram != NULL )
+    {
+        m_spectrogram->paint( painter, rect(), option->exposedRect.left(), option->exposedRect.right(), m_globalScaleFactor );
+    }
+
     // Scale waveform to fit size of rect
     painter->save();
     painter->scale( 1.0, rect().height() * 0.5 / numChans );
@@ -100,7 +108,7 @@ void WaveformItem::paint( QPainter* painter, const QStyleOptionGraphicsItem* opt
 
     // Draw waveform
     painter->translate( 0.0, 1.0 );
-    painter->setPen( m_wavePen );
+    painter->setPen( m_spectrogram != NULL ? m_spectrogramWavePen : m_wavePen );
 
     if ( m_detailLevel != VERY_HIGH )
     {
@@ -136,6 +144,84 @@ void WaveformItem::setRect( const qreal x, const qreal y, const qreal width, con
 
 
 
+void WaveformItem::setSpectrogramEnabled( const bool isEnabled, JobScheduler* const jobScheduler )
+{
+    if ( isEnabled && m_spectrogram == NULL )
+    {
+        Q_ASSERT( jobScheduler != NULL );
+
+        m_spectrogram = new SpectrogramRenderer( m_sampleBuffer, *jobScheduler );
+
+        connect( m_spectrogram, SIGNAL( tileReady() ),
+                 this, SLOT( spectrogramTileReady() ) );
+    }
+    else if ( ! isEnabled )
+    {
+        m_spectrogram = NULL;
+    }
+
+    update();
+}
+
+
+
+void WaveformItem::setSampleBuffer( const SharedSampleBuffer sampleBuffer )
+{
+    m_sampleBuffer = sampleBuffer;
+
+    if ( m_spectrogram != NULL )
+    {
+        m_spectrogram->setSampleBuffer( sampleBuffer );
+    }
+
+    releaseSampleBins();
+    update();
+}
+
+
+
+void WaveformItem::invalidateSpectrogram()
+{
+    if ( m_spectrogram != NULL )
+    {
+        m_spectrogram->invalidate();
+        update();
+    }
+}
+
+
+
+qint64 WaveformItem::getSampleBinsNumBytes() const
+{
+    qint64 numBytes = 0;
+
+    for ( int chanNum = 0; chanNum < m_minSampleValues.size(); chanNum++ )
+    {
+        numBytes += ( m_minSampleValues[ chanNum ]->size() + m_maxSampleValues[ chanNum ]->size() ) * sizeof( float );
+    }
+
+    return numBytes;
+}
+
+
+
+void WaveformItem::releaseSampleBins()
+{
+    for ( int chanNum = 0; chanNum < m_minSampleValues.size(); chanNum++ )
+    {
+        m_minSampleValues[ chanNum ]->clear();
+        m_maxSampleValues[ chanNum ]->clear();
+    }
+
+    m_firstCalculatedBin = NOT_SET;
+    m_lastCalculatedBin = NOT_SET;
+
+    // Forces the bins to be reset on the next paint
+    m_globalScaleFactor = NOT_SET;
+}
+
+
+
 //==================================================================================================
 // Public Static:
 
@@ -158,22 +244,23 @@ QVariant WaveformItem::itemChange( GraphicsItemChange change, const QVariant &va
         qreal minDistanceFromSceneRightEdge = 0.0;
 
         // If this item is part of a group of selected items then calculate the
-        // minimum distance it must be from the left and right edges of the scene
+        // minimum distance it must be from the left and right edges of the scene.
+        // Selected items may be out of the scene, so their widths come from the layout
         if ( isSelected() )
         {
             WaveGraphicsScene* scene = static_cast<WaveGraphicsScene*>( this->scene() );
             QList<WaveformItem*> selectedItems = scene->getSelectedWaveforms();
 
-            foreach( WaveformItem* item, selectedItems )
+            if ( ! selectedItems.isEmpty() )
             {
-                if ( getOrderPos() > item->getOrderPos() )
-                {
-                    minDistanceFromSceneLeftEdge += item->rect().width();
-                }
-                else if ( getOrderPos() < item->getOrderPos() )
-                {
-                    minDistanceFromSceneRightEdge += item->rect().width();
-                }
+                const int leftmostOrderPos = selectedItems.first()->getOrderPos();
+                const int rightmostOrderPos = selectedItems.last()->getOrderPos();
+
+                minDistanceFromSceneLeftEdge = scene->getWaveformScenePosX( getOrderPos() ) -
+                                               scene->getWaveformScenePosX( leftmostOrderPos );
+
+                minDistanceFromSceneRightEdge = scene->getWaveformScenePosX( rightmostOrderPos + 1 ) -
+                                                scene->getWaveformScenePosX( getOrderPos() + 1 );
             }
         }
 
@@ -254,38 +341,40 @@ void WaveformItem::mouseMoveEvent( QGraphicsSceneMouseEvent* event )
     WaveGraphicsScene* scene = static_cast<WaveGraphicsScene*>( this->scene() );
     QList<WaveformItem*> selectedItems = scene->getSelectedWaveforms();
 
+    if ( selectedItems.isEmpty() )
+    {
+        return;
+    }
+
+    // The leftmost and rightmost selected items may be out of the scene, and so not moved by the drag;
+    // their positions are found from the layout instead
+    const qreal dragOffsetX = scene->getDragOffsetX();
+
     // If this item is being dragged to the left...
     if ( event->screenPos().x() < event->lastScreenPos().x() )
     {
         // Get the order position and scene position of the leftmost selected item
-        const QPointF leftmostSelectedItemScenePos = selectedItems.first()->scenePos();
         const int leftmostSelectedItemOrderPos = selectedItems.first()->getOrderPos();
+        const qreal leftmostSelectedItemScenePosX = scene->getWaveformScenePosX( leftmostSelectedItemOrderPos ) + dragOffsetX;
 
-        // Get item under left edge of the leftmost selected item
-        QGraphicsItem* const otherItem = scene->items( leftmostSelectedItemScenePos ).last();
+        // Get the order position of the item under the left edge of the leftmost selected item
+        const int otherItemOrderPos = scene->getWaveformOrderPosAt( scene->getFrameNum( leftmostSelectedItemScenePosX ) );
 
-        // If the other item is a WaveformItem...
-        if ( otherItem != this && otherItem->type() == WaveformItem::Type )
+        if ( otherItemOrderPos >= 0 && otherItemOrderPos < leftmostSelectedItemOrderPos )
         {
-            WaveformItem* const otherWaveformItem = qgraphicsitem_cast<WaveformItem*>( otherItem );
-            const int otherItemOrderPos = otherWaveformItem->getOrderPos();
-
-            if ( otherItemOrderPos < leftmostSelectedItemOrderPos )
+            // If the left edge of the leftmost selected item is more than halfway across the other item
+            // then move the other item out of the way
+            if ( leftmostSelectedItemScenePosX < scene->getWaveformCentreScenePosX( otherItemOrderPos ) )
             {
-                // If the left edge of the leftmost selected item is more than halfway across the other item
-                // then move the other item out of the way
-                if ( leftmostSelectedItemScenePos.x() < otherWaveformItem->scenePos().x() + otherWaveformItem->rect().center().x() )
-                {
-                    const int numPlacesMoved = otherItemOrderPos - leftmostSelectedItemOrderPos;
-                    QList<int> selectedItemsOrderPositions;
-
-                    foreach ( WaveformItem* item, selectedItems )
-                    {
-                        selectedItemsOrderPositions << item->getOrderPos();
-                    }
+                const int numPlacesMoved = otherItemOrderPos - leftmostSelectedItemOrderPos;
+                QList<int> selectedItemsOrderPositions;
 
-                    emit orderPosIsChanging( selectedItemsOrderPositions, numPlacesMoved );
+                foreach ( WaveformItem* item, selectedItems )
+                {
+                    selectedItemsOrderPositions << item->getOrderPos();
                 }
+
+                emit orderPosIsChanging( selectedItemsOrderPositions, numPlacesMoved );
             }
         }
     }
@@ -295,34 +384,27 @@ void WaveformItem::mouseMoveEvent( QGraphicsSceneMouseEvent* event )
     {
         // Get the order position and scene position of the rightmost selected item
         const int rightmostSelectedItemOrderPos = selectedItems.last()->getOrderPos();
-        const qreal rightmostSelectedItemRightEdge = selectedItems.last()->scenePos().x() +
-                                                     selectedItems.last()->rect().width() - 1;
+        const qreal rightmostSelectedItemRightEdge = scene->getWaveformScenePosX( rightmostSelectedItemOrderPos + 1 ) +
+                                                     dragOffsetX - 1;
 
-        // Get item under right edge of the rightmost selected item
-        QGraphicsItem* const otherItem = scene->items( QPointF(rightmostSelectedItemRightEdge, BpmRuler::HEIGHT) ).last();
+        // Get the order position of the item under the right edge of the rightmost selected item
+        const int otherItemOrderPos = scene->getWaveformOrderPosAt( scene->getFrameNum( rightmostSelectedItemRightEdge ) );
 
-        // If the other item is a WaveformItem...
-        if ( otherItem != this && otherItem->type() == WaveformItem::Type )
+        if ( otherItemOrderPos > rightmostSelectedItemOrderPos )
         {
-            WaveformItem* const otherWaveformItem = qgraphicsitem_cast<WaveformItem*>( otherItem );
-            const int otherItemOrderPos = otherWaveformItem->getOrderPos();
-
-            if ( otherItemOrderPos > rightmostSelectedItemOrderPos )
+            // If the right edge of the rightmost selected item is more than halfway across the other item
+            // then move the other item out of the way
+            if ( rightmostSelectedItemRightEdge > scene->getWaveformCentreScenePosX( otherItemOrderPos ) )
             {
-                // If the right edge of the rightmost selected item is more than halfway across the other item
-                // then move the other item out of the way
-                if ( rightmostSelectedItemRightEdge > otherWaveformItem->scenePos().x() + otherWaveformItem->rect().center().x() )
-                {
-                    const int numPlacesMoved = otherItemOrderPos - rightmostSelectedItemOrderPos;
-                    QList<int> orderPositions;
-
-                    foreach ( WaveformItem* item, selectedItems )
-                    {
-                        orderPositions << item->getOrderPos();
-                    }
+                const int numPlacesMoved = otherItemOrderPos - rightmostSelectedItemOrderPos;
+                QList<int> orderPositions;
 
-                    emit orderPosIsChanging( orderPositions, numPlacesMoved );
+                foreach ( WaveformItem* item, selectedItems )
+                {
+                    orderPositions << item->getOrderPos();
                 }
+
+                emit orderPosIsChanging( orderPositions, numPlacesMoved );
             }
         }
     }
@@ -32,6 +32,7 @@
 #include <QList>
 #include "JuceHeader.h"
 #include "samplebuffer.h"
+#include "spectrogramrenderer.h"
 #include "globals.h"
 
 
@@ -58,12 +59,28 @@ public:
 
     SharedSampleBuffer getSampleBuffer() const                      { return m_sampleBuffer; }
 
+    // Edits don't change sample data in place; they give the item a new buffer
+    void setSampleBuffer( SharedSampleBuffer sampleBuffer );
+
     int getOrderPos() const                                         { return m_currentOrderPos; }
     void setOrderPos( int orderPos )                                { m_currentOrderPos = orderPos; }
 
     qreal getStretchRatio() const                                   { return m_stretchRatio; }
     void setStretchRatio( qreal ratio )                             { m_stretchRatio = ratio; }
 
+    // Draw a spectrogram behind the waveform outline, computed on "jobScheduler", which is only needed to enable it
+    void setSpectrogramEnabled( bool isEnabled, JobScheduler* jobScheduler = NULL );
+    bool isSpectrogramEnabled() const                               { return m_spectrogram != NULL; }
+
+    // Must be called after the sample data has been edited in place so the spectrogram is recomputed
+    void invalidateSpectrogram();
+
+    // Memory used by the min/max sample bins drawn when zoomed out
+    qint64 getSampleBinsNumBytes() const;
+
+    // Free the min/max sample bins; they're recalculated the next time the item is painted
+    void releaseSampleBins();
+
 public:
     // For use with qSort(); sorts by order position
     static bool isLessThanOrderPos( const WaveformItem* item1, const WaveformItem* item2 );
@@ -88,9 +105,10 @@ private:
     enum DetailLevel { LOW, HIGH, VERY_HIGH };
     DetailLevel m_detailLevel;
 
-    const SharedSampleBuffer m_sampleBuffer;
+    SharedSampleBuffer m_sampleBuffer;
 
     QPen m_wavePen;
+    QPen m_spectrogramWavePen;
     QPen m_centreLinePen;
 
     int m_currentOrderPos;
@@ -107,12 +125,17 @@ private:
     OwnedArray< Array<float> > m_minSampleValues;
     OwnedArray< Array<float> > m_maxSampleValues;
 
+    ScopedPointer<SpectrogramRenderer> m_spectrogram;
+
 private:
     static const int NOT_SET = -1;
     static constexpr qreal DETAIL_LEVEL_MAX_CUTOFF = 0.05;
     static constexpr qreal DETAIL_LEVEL_VERY_HIGH_CUTOFF = 1.0;
     static constexpr qreal DETAIL_LEVEL_HIGH_CUTOFF = 10.0;
 
+private slots:
+    void spectrogramTileReady()                                     { update(); }
+
 signals:
     // As waveform items are being dragged, their old order positions are emitted along with
     // the no. of places which they have moved, allowing other waveform items to be reshuffled.
@@ -0,0 +1,130 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "waveformlayout.h"
+
+
+//==================================================================================================
+// Public:
+
+WaveformLayout::WaveformLayout() :
+    m_totalLength( 0 )
+{
+}
+
+
+
+void WaveformLayout::setLengths( const QVector<FrameNum>& lengths )
+{
+    const int numItems = lengths.size();
+
+    m_lengths = lengths;
+    m_tree.fill( 0, numItems + 1 );
+    m_totalLength = 0;
+
+    // Build in linear time by passing each partial sum up to its parent
+    for ( int i = 1; i <= numItems; i++ )
+    {
+        m_tree[ i ] += m_lengths.at( i - 1 );
+        m_totalLength += m_lengths.at( i - 1 );
+
+        const int parent = i + ( i & -i );
+
+        if ( parent <= numItems )
+        {
+            m_tree[ parent ] += m_tree.at( i );
+        }
+    }
+}
+
+
+
+void WaveformLayout::clear()
+{
+    m_lengths.clear();
+    m_tree.clear();
+    m_totalLength = 0;
+}
+
+
+
+void WaveformLayout::setLength( const int index, const FrameNum length )
+{
+    const FrameNum delta = length - m_lengths.at( index );
+
+    if ( delta == 0 )
+    {
+        return;
+    }
+
+    m_lengths[ index ] = length;
+    m_totalLength += delta;
+
+    for ( int i = index + 1; i < m_tree.size(); i += ( i & -i ) )
+    {
+        m_tree[ i ] += delta;
+    }
+}
+
+
+
+FrameNum WaveformLayout::getStartOffset( const int index ) const
+{
+    FrameNum offset = 0;
+
+    for ( int i = index; i > 0; i -= ( i & -i ) )
+    {
+        offset += m_tree.at( i );
+    }
+
+    return offset;
+}
+
+
+
+int WaveformLayout::findIndex( const FrameNum offset ) const
+{
+    const int numItems = m_lengths.size();
+
+    if ( numItems == 0 )
+    {
+        return -1;
+    }
+
+    // Descend the tree to find how many items end at or before 'offset'
+    int numItemsBefore = 0;
+    FrameNum remainingOffset = offset;
+
+    for ( int step = nextPowerOfTwo( numItems + 1 ) / 2; step > 0; step /= 2 )
+    {
+        const int i = numItemsBefore + step;
+
+        if ( i <= numItems && m_tree.at( i ) <= remainingOffset )
+        {
+            numItemsBefore = i;
+            remainingOffset -= m_tree.at( i );
+        }
+    }
+
+    return jmin( numItemsBefore, numItems - 1 );
+}
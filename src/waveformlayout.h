@@ -0,0 +1,68 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#ifndef WAVEFORMLAYOUT_H
+#define WAVEFORMLAYOUT_H
+
+#include <QVector>
+#include "samplebuffer.h"
+#include "JuceHeader.h"
+
+
+// Lays out waveform items end to end by keeping the length of each, in stretched frames, in a
+// Fenwick tree (binary indexed tree). The offset at which any item starts, and the item at any
+// offset, can then be found in O(log n), and a change of length takes O(log n) to apply.
+// Setting all the lengths at once takes O(n)
+
+class WaveformLayout
+{
+public:
+    WaveformLayout();
+
+    void setLengths( const QVector<FrameNum>& lengths );
+    void clear();
+
+    int getNumItems() const                         { return m_lengths.size(); }
+
+    FrameNum getLength( int index ) const           { return m_lengths.at( index ); }
+    void setLength( int index, FrameNum length );
+
+    // The sum of the lengths of all items before 'index'
+    FrameNum getStartOffset( int index ) const;
+
+    FrameNum getTotalLength() const                 { return m_totalLength; }
+
+    // Returns the index of the item spanning 'offset'. Offsets before the first item give 0, offsets
+    // after the last give the last index, and -1 is returned if there are no items
+    int findIndex( FrameNum offset ) const;
+
+private:
+    QVector<FrameNum> m_lengths;
+    QVector<FrameNum> m_tree;       // 1-based; m_tree[ i ] holds the sum of the ( i & -i ) lengths up to item i - 1
+    FrameNum m_totalLength;
+
+private:
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR( WaveformLayout );
+};
+
+#endif // WAVEFORMLAYOUT_H
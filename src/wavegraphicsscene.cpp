@@ -24,6 +24,7 @@
 #include "audioanalyser.h"
 #include "globals.h"
 #include <QDebug>
+#include <algorithm>
 
 
 //==================================================================================================
@@ -32,7 +33,10 @@
 WaveGraphicsScene::WaveGraphicsScene( const qreal x, const qreal y, const qreal width, const qreal height, QObject* parent ) :
     QGraphicsScene( x, y, width, height, parent ),
     m_interactionMode( AUDITION_ITEMS ),
-    m_isSceneAtSampleDetailLevel( false )
+    m_isUpdatingSelection( false ),
+    m_isSceneAtSampleDetailLevel( false ),
+    m_isSpectrogramEnabled( false ),
+    m_jobScheduler( NULL )
 {
     createBpmRuler();
 
@@ -57,6 +61,9 @@ WaveGraphicsScene::WaveGraphicsScene( const qreal x, const qreal y, const qreal
 
     QObject::connect( m_timer, SIGNAL( finished() ),
                       this, SIGNAL( playheadFinishedScrolling() ) );
+
+    QObject::connect( this, SIGNAL( selectionChanged() ),
+                      this, SLOT( updateSelectedWaveforms() ) );
 }
 
 
@@ -187,24 +194,19 @@ void WaveGraphicsScene::insertWaveforms( const QList<SharedWaveformItem> wavefor
     }
 
     // Resize and reposition all waveform items
-    const int totalNumFrames = getTotalNumFrames( m_waveformItemList );
-    qreal scenePosX = 0.0;
-
-    foreach ( SharedWaveformItem item, m_waveformItemList )
-    {
-        const qreal itemWidth = item->getSampleBuffer()->getNumFrames() * ( width() / totalNumFrames ) * item->getStretchRatio();
-
-        item->setRect( 0.0, 0.0, itemWidth, height() - BpmRuler::HEIGHT );
-        item->setPos( scenePosX, BpmRuler::HEIGHT );
+    layOutWaveformItems();
 
-        scenePosX += itemWidth;
-    }
-
-    // Add waveform items to scene
+    // Items removed while selected are still selected when they're put back
     foreach ( SharedWaveformItem item, waveformItems )
     {
-        addItem( item.data() );
+        if ( item->isSelected() )
+        {
+            m_selectedWaveformItems.insert( item.data() );
+        }
     }
+
+    // Add the waveform items in view to the scene
+    bindVisibleWaveforms();
     update();
 
     setInteractionMode( m_interactionMode );
@@ -224,7 +226,12 @@ QList<SharedWaveformItem> WaveGraphicsScene::removeWaveforms( const QList<int> w
         SharedWaveformItem item = m_waveformItemList.at( startOrderPos );
 
         m_waveformItemList.removeAt( startOrderPos );
-        removeItem( item.data() );
+
+        if ( item->scene() == this )
+        {
+            unbindWaveform( item.data() );
+        }
+        m_selectedWaveformItems.remove( item.data() );
 
         removedWaveforms << item;
     }
@@ -240,18 +247,8 @@ QList<SharedWaveformItem> WaveGraphicsScene::removeWaveforms( const QList<int> w
     }
 
     // Resize and reposition all waveform items
-    const int totalNumFrames = getTotalNumFrames( m_waveformItemList );
-    qreal scenePosX = 0.0;
-
-    foreach ( SharedWaveformItem item, m_waveformItemList )
-    {
-        const qreal itemWidth = item->getSampleBuffer()->getNumFrames() * ( width() / totalNumFrames ) * item->getStretchRatio();
-
-        item->setRect( 0.0, 0.0, itemWidth, height() - BpmRuler::HEIGHT );
-        item->setPos( scenePosX, BpmRuler::HEIGHT );
-
-        scenePosX += itemWidth;
-    }
+    layOutWaveformItems();
+    bindVisibleWaveforms();
 
     return removedWaveforms;
 }
@@ -262,11 +259,13 @@ QList<WaveformItem*> WaveGraphicsScene::getSelectedWaveforms() const
 {
     QList<WaveformItem*> selectedItems;
 
-    foreach ( QGraphicsItem* item, this->selectedItems() )
+    // An item that has been deselected directly, or made unselectable, while out of the scene is
+    // still in the set
+    foreach ( WaveformItem* item, m_selectedWaveformItems )
     {
-        if ( item->type() == WaveformItem::Type )
+        if ( item->isSelected() )
         {
-            selectedItems << qgraphicsitem_cast<WaveformItem*>( item );
+            selectedItems << item;
         }
     }
     qSort( selectedItems.begin(), selectedItems.end(), WaveformItem::isLessThanOrderPos );
@@ -293,56 +292,50 @@ QList<int> WaveGraphicsScene::getSelectedWaveformsOrderPositions() const
 
 void WaveGraphicsScene::selectNextWaveform()
 {
-    const QList<int> orderPositions = getSelectedWaveformsOrderPositions();
-
-    foreach ( SharedWaveformItem item, m_waveformItemList )
-    {
-        item->setSelected( false );
-    }
+    const QList<WaveformItem*> selectedItems = getSelectedWaveforms();
+    int orderPos = 0;
 
-    if ( ! orderPositions.isEmpty() )
+    if ( ! selectedItems.isEmpty() )
     {
-        int orderPos = orderPositions.last() + 1;
+        orderPos = selectedItems.last()->getOrderPos() + 1;
 
         if ( orderPos >= m_waveformItemList.size() )
         {
             orderPos = 0;
         }
-
-        m_waveformItemList.at( orderPos )->setSelected( true );
     }
-    else
+
+    foreach ( WaveformItem* item, selectedItems )
     {
-        m_waveformItemList.first()->setSelected( true );
+        setWaveformSelected( item, false );
     }
+
+    setWaveformSelected( m_waveformItemList.at( orderPos ).data(), true );
 }
 
 
 
 void WaveGraphicsScene::selectPreviousWaveform()
 {
-    const QList<int> orderPositions = getSelectedWaveformsOrderPositions();
-
-    foreach ( SharedWaveformItem item, m_waveformItemList )
-    {
-        item->setSelected( false );
-    }
+    const QList<WaveformItem*> selectedItems = getSelectedWaveforms();
+    int orderPos = m_waveformItemList.size() - 1;
 
-    if ( ! orderPositions.isEmpty() )
+    if ( ! selectedItems.isEmpty() )
     {
-        int orderPos = orderPositions.first() - 1;
+        orderPos = selectedItems.first()->getOrderPos() - 1;
 
         if ( orderPos < 0 )
         {
             orderPos = m_waveformItemList.size() - 1;
         }
-
-        m_waveformItemList.at( orderPos )->setSelected( true );
     }
-    else
+
+    foreach ( WaveformItem* item, selectedItems )
     {
-        m_waveformItemList.last()->setSelected( true );
+        setWaveformSelected( item, false );
     }
+
+    setWaveformSelected( m_waveformItemList.at( orderPos ).data(), true );
 }
 
 
@@ -351,20 +344,41 @@ void WaveGraphicsScene::stretchWaveforms( const QList<int> orderPosList, const Q
 {
     if ( ! m_waveformItemList.isEmpty() )
     {
-        const int totalNumFrames = getTotalNumFrames( m_waveformItemList );
+        const FrameNum oldTotalNumFrames = m_layout.getTotalLength();
+
+        int firstOrderPos = m_waveformItemList.size();
+        int lastOrderPos = -1;
 
         for ( int i = 0; i < orderPosList.size() && i < ratioList.size(); i++ )
         {
-            SharedWaveformItem item = m_waveformItemList.at( orderPosList.at( i ) );
-
-            const qreal origWidth = item->getSampleBuffer()->getNumFrames() * ( width() / totalNumFrames );
-            const qreal newWidth = origWidth * ratioList.at( i );
+            const int orderPos = orderPosList.at( i );
+            SharedWaveformItem item = m_waveformItemList.at( orderPos );
 
-            item->setRect( 0.0, 0.0, newWidth, height() - BpmRuler::HEIGHT );
             item->setStretchRatio( ratioList.at( i ) );
+            m_layout.setLength( orderPos, getStretchedNumFrames( item ) );
+
+            firstOrderPos = qMin( firstOrderPos, orderPos );
+            lastOrderPos = qMax( lastOrderPos, orderPos );
+        }
 
-            slideWaveformItemIntoPlace( orderPosList.at( i ) );
+        // If the overall length has changed then every item must be rescaled to fit the scene, otherwise
+        // only the stretched items and those in between them have moved
+        if ( m_layout.getTotalLength() != oldTotalNumFrames )
+        {
+            layOutWaveformItems();
         }
+        else
+        {
+            for ( int orderPos = firstOrderPos; orderPos <= lastOrderPos; orderPos++ )
+            {
+                if ( m_waveformItemList.at( orderPos )->scene() == this )
+                {
+                    layOutWaveformItem( orderPos );
+                }
+            }
+        }
+
+        bindVisibleWaveforms();
     }
 }
 
@@ -376,15 +390,13 @@ QList<qreal> WaveGraphicsScene::getWaveformStretchRatios( const QList<int> order
 
     if ( ! m_waveformItemList.isEmpty() )
     {
-        const int totalNumFrames = getTotalNumFrames( m_waveformItemList );
-
+        // Items outside the view aren't kept up to date with the scene's size, so the ratio is taken from
+        // the layout rather than the item's width
         foreach ( int orderPos, orderPositions )
         {
             SharedWaveformItem item = m_waveformItemList.at( orderPos );
 
-            const qreal origWidth = item->getSampleBuffer()->getNumFrames() * ( width() / totalNumFrames );
-
-            stretchRatioList << item->rect().width() / origWidth;
+            stretchRatioList << m_layout.getLength( orderPos ) / (qreal) item->getSampleBuffer()->getNumFrames();
         }
     }
 
@@ -395,13 +407,45 @@ QList<qreal> WaveGraphicsScene::getWaveformStretchRatios( const QList<int> order
 
 void WaveGraphicsScene::redrawWaveforms()
 {
-    resizeWaveformItems( 1.0 );
+    // Items out of view have no spectrogram or sample bins to invalidate
+    foreach ( WaveformItem* item, m_boundWaveformItems )
+    {
+        item->invalidateSpectrogram();
+    }
+
+    resizeWaveformItems();
+    getView()->viewport()->update();
+}
+
+
+
+void WaveGraphicsScene::redrawWaveforms( const QList<int> editedOrderPositions )
+{
+    foreach ( int orderPos, editedOrderPositions )
+    {
+        m_waveformItemList.at( orderPos )->invalidateSpectrogram();
+    }
+
+    resizeWaveformItems();
     getView()->viewport()->update();
 }
 
 
 
-SharedSlicePointItem WaveGraphicsScene::createSlicePoint( const int frameNum, const bool canBeMovedPastOtherSlicePoints )
+void WaveGraphicsScene::setSpectrogramEnabled( const bool isEnabled )
+{
+    m_isSpectrogramEnabled = isEnabled;
+
+    // Items out of view are set as they're bound
+    foreach ( WaveformItem* item, m_boundWaveformItems )
+    {
+        item->setSpectrogramEnabled( isEnabled, m_jobScheduler );
+    }
+}
+
+
+
+SharedSlicePointItem WaveGraphicsScene::createSlicePoint( const FrameNum frameNum, const bool canBeMovedPastOtherSlicePoints )
 {
     const qreal scenePosX = getScenePosX( frameNum );
 
@@ -414,8 +458,14 @@ SharedSlicePointItem WaveGraphicsScene::createSlicePoint( const int frameNum, co
     matrix.scale( 1.0 / currentScaleFactor, 1.0 ); // slice point handle is set to correct width even if view is scaled
     item->setTransform( matrix );
 
-    QObject::connect( item, SIGNAL( scenePosChanged(SlicePointItem*,int) ),
-                      this, SLOT( updateSlicePointOrdering(SlicePointItem*,int) ) );
+    QObject::connect( item, SIGNAL( scenePosChanged(SlicePointItem*,FrameNum) ),
+                      this, SLOT( updateSlicePointOrdering(SlicePointItem*,FrameNum) ) );
+
+    QObject::connect( item, SIGNAL( dragged(FrameNum) ),
+                      this, SIGNAL( slicePointDragged(FrameNum) ) );
+
+    QObject::connect( item, SIGNAL( dragFinished() ),
+                      this, SIGNAL( slicePointDragFinished() ) );
 
     addItem( item );
     update();
@@ -430,7 +480,7 @@ SharedSlicePointItem WaveGraphicsScene::createSlicePoint( const int frameNum, co
 
 void WaveGraphicsScene::addSlicePoint( const SharedSlicePointItem slicePoint )
 {
-    const int slicePointFrameNum = slicePoint.data()->getFrameNum();
+    const FrameNum slicePointFrameNum = slicePoint.data()->getFrameNum();
     const qreal scenePosX = getScenePosX( slicePointFrameNum );
 
     QTransform matrix;
@@ -459,7 +509,7 @@ void WaveGraphicsScene::removeSlicePoint( const SharedSlicePointItem slicePointI
 
 
 
-void WaveGraphicsScene::moveSlicePoint( const SharedSlicePointItem slicePointItem, const int newFrameNum )
+void WaveGraphicsScene::moveSlicePoint( const SharedSlicePointItem slicePointItem, const FrameNum newFrameNum )
 {
     const qreal newScenePosX = getScenePosX( newFrameNum );
 
@@ -498,9 +548,9 @@ SharedSlicePointItem WaveGraphicsScene::getSelectedSlicePoint()
 
 
 
-QList<int> WaveGraphicsScene::getSlicePointFrameNums() const
+QList<FrameNum> WaveGraphicsScene::getSlicePointFrameNums() const
 {
-    QList<int> slicePointFrameNums;
+    QList<FrameNum> slicePointFrameNums;
 
     foreach ( SharedSlicePointItem slicePointItem, m_slicePointItemList )
     {
@@ -521,9 +571,9 @@ void WaveGraphicsScene::selectNone()
         item->setSelected( false );
     }
 
-    foreach ( SharedWaveformItem item, m_waveformItemList )
+    foreach ( WaveformItem* item, getSelectedWaveforms() )
     {
-        item->setSelected( false );
+        setWaveformSelected( item, false );
     }
 }
 
@@ -533,7 +583,7 @@ void WaveGraphicsScene::selectAll()
 {
     foreach ( SharedWaveformItem item, m_waveformItemList )
     {
-        item->setSelected( true );
+        setWaveformSelected( item.data(), true );
     }
 }
 
@@ -541,7 +591,7 @@ void WaveGraphicsScene::selectAll()
 
 void WaveGraphicsScene::startPlayhead( const bool isLoopingDesired, const qreal stretchRatio )
 {
-    const int numFrames = getTotalNumFrames( m_waveformItemList );
+    const FrameNum numFrames = m_layout.getTotalLength();
 
     const qreal startPosX = 0.0;
     const qreal endPosX   = width() - 1;
@@ -553,7 +603,7 @@ void WaveGraphicsScene::startPlayhead( const bool isLoopingDesired, const qreal
 
 void WaveGraphicsScene::startPlayhead( const qreal startPosX,
                                        const qreal endPosX,
-                                       const int numFrames,
+                                       const FrameNum numFrames,
                                        const bool isLoopingDesired,
                                        const qreal stretchRatio )
 {
@@ -624,7 +674,7 @@ void WaveGraphicsScene::updatePlayheadSpeed( const qreal stretchRatio )
         m_timer->stop();
 
         const qreal sampleRate = m_sampleHeader->sampleRate;
-        const int numFrames = getTotalNumFrames( m_waveformItemList );
+        const FrameNum numFrames = m_layout.getTotalLength();
 
         const int newDuration = roundToInt( (numFrames / sampleRate) * 1000 * stretchRatio );
 //        const int newTime = roundToInt( mTimer->currentTime() * stretchRatio );
@@ -673,10 +723,10 @@ void WaveGraphicsScene::setBpmRulerMarks( const qreal bpm, const int timeSigNume
         const qreal beatLineHeight = BpmRuler::HEIGHT - 5.0;
         const qreal divLineHeight = BpmRuler::HEIGHT - 13.0;
 
-        const int totalNumFrames = getTotalNumFrames( m_waveformItemList );
+        const FrameNum totalNumFrames = m_layout.getTotalLength();
         const qreal framesPerDivision = ( ( m_sampleHeader->sampleRate * 60 ) / bpm ) / divsPerBeat;
 
-        int frameNum = 0;
+        FrameNum frameNum = 0;
         int bar = 1;
         int beat = 0;
         int div = 0;
@@ -724,13 +774,20 @@ void WaveGraphicsScene::setBpmRulerMarks( const qreal bpm, const int timeSigNume
 
 void WaveGraphicsScene::clearAll()
 {
-    foreach ( QGraphicsItem* item, items() )
     {
-        removeItem( item );
+        const ScopedValueSetter<bool> setter( m_isUpdatingSelection, true );
+
+        foreach ( QGraphicsItem* item, items() )
+        {
+            removeItem( item );
+        }
     }
     update();
 
     m_waveformItemList.clear();
+    m_layout.clear();
+    m_boundWaveformItems.clear();
+    m_selectedWaveformItems.clear();
     m_slicePointItemList.clear();
     m_rulerMarksList.clear();
 
@@ -741,23 +798,30 @@ void WaveGraphicsScene::clearAll()
 
 void WaveGraphicsScene::clearWaveform()
 {
-    foreach ( QGraphicsItem* item, items() )
     {
-        if ( item->type() == WaveformItem::Type )
+        const ScopedValueSetter<bool> setter( m_isUpdatingSelection, true );
+
+        foreach ( QGraphicsItem* item, items() )
         {
-            removeItem( item );
+            if ( item->type() == WaveformItem::Type )
+            {
+                removeItem( item );
+            }
         }
     }
     update();
 
     m_waveformItemList.clear();
+    m_layout.clear();
+    m_boundWaveformItems.clear();
+    m_selectedWaveformItems.clear();
 }
 
 
 
-qreal WaveGraphicsScene::getScenePosX( const int frameNum ) const
+qreal WaveGraphicsScene::getScenePosX( const FrameNum frameNum ) const
 {
-    const int numFrames = getTotalNumFrames( m_waveformItemList );
+    const FrameNum numFrames = m_layout.getTotalLength();
 
     qreal scenePosX = frameNum * ( width() / numFrames );
 
@@ -772,11 +836,11 @@ qreal WaveGraphicsScene::getScenePosX( const int frameNum ) const
 
 
 
-int WaveGraphicsScene::getFrameNum( qreal scenePosX ) const
+FrameNum WaveGraphicsScene::getFrameNum( qreal scenePosX ) const
 {
-    const int numFrames = getTotalNumFrames( m_waveformItemList );
+    const FrameNum numFrames = m_layout.getTotalLength();
 
-    int frameNum = roundToIntAccurate( scenePosX / ( width() / numFrames ) );
+    FrameNum frameNum = roundToFrameNum( scenePosX / ( width() / numFrames ) );
 
     if ( frameNum < 0 )
         frameNum = 0;
@@ -789,13 +853,45 @@ int WaveGraphicsScene::getFrameNum( qreal scenePosX ) const
 
 
 
+qreal WaveGraphicsScene::getWaveformScenePosX( const int orderPos ) const
+{
+    return m_layout.getStartOffset( orderPos ) * ( width() / m_layout.getTotalLength() );
+}
+
+
+
+qreal WaveGraphicsScene::getWaveformCentreScenePosX( const int orderPos ) const
+{
+    const qreal centreFrameNum = m_layout.getStartOffset( orderPos ) + m_layout.getLength( orderPos ) * 0.5;
+
+    return centreFrameNum * ( width() / m_layout.getTotalLength() );
+}
+
+
+
+qreal WaveGraphicsScene::getDragOffsetX() const
+{
+    QGraphicsItem* const grabberItem = mouseGrabberItem();
+
+    if ( grabberItem != NULL && grabberItem->type() == WaveformItem::Type && grabberItem->isSelected() )
+    {
+        const WaveformItem* const item = qgraphicsitem_cast<WaveformItem*>( grabberItem );
+
+        return item->scenePos().x() - getWaveformScenePosX( item->getOrderPos() );
+    }
+
+    return 0.0;
+}
+
+
+
 qreal WaveGraphicsScene::getNearestFramePosX( qreal scenePosX ) const
 {
-    const int numFrames = getTotalNumFrames( m_waveformItemList );
+    const FrameNum numFrames = m_layout.getTotalLength();
 
     const qreal distanceBetweenFrames = width() / numFrames;
 
-    const int frameNum = roundToIntAccurate( scenePosX / distanceBetweenFrames );
+    const FrameNum frameNum = roundToFrameNum( scenePosX / distanceBetweenFrames );
 
     qreal posX = frameNum * distanceBetweenFrames;
 
@@ -810,15 +906,12 @@ qreal WaveGraphicsScene::getNearestFramePosX( qreal scenePosX ) const
 
 
 
-void WaveGraphicsScene::resizeWaveformItems( const qreal scaleFactorX )
+void WaveGraphicsScene::resizeWaveformItems()
 {
-    foreach ( SharedWaveformItem item, m_waveformItemList )
+    // Items out of view are resized as they're bound
+    foreach ( WaveformItem* item, m_boundWaveformItems )
     {
-        const qreal newWidth = item->rect().width() * scaleFactorX;
-        item->setRect( 0.0, 0.0, newWidth, height() - BpmRuler::HEIGHT );
-
-        const qreal newX = item->scenePos().x() * scaleFactorX;
-        item->setPos( newX, BpmRuler::HEIGHT );
+        layOutWaveformItem( item->getOrderPos() );
     }
 }
 
@@ -893,6 +986,86 @@ void WaveGraphicsScene::scaleItems( const qreal scaleFactorX )
         {
             item->setTransform( matrix );
         }
+
+        bindVisibleWaveforms();
+    }
+}
+
+
+
+//==================================================================================================
+// Public Slots:
+
+void WaveGraphicsScene::bindVisibleWaveforms()
+{
+    if ( m_waveformItemList.isEmpty() || views().isEmpty() )
+    {
+        return;
+    }
+
+    WaveGraphicsView* const view = getView();
+    const QRectF visibleRect = view->mapToScene( view->viewport()->rect() ).boundingRect();
+
+    // Keep a margin either side of the visible area so items are ready before they're scrolled into view
+    const qreal margin = visibleRect.width() * 0.5;
+
+    const int firstOrderPos = m_layout.findIndex( getFrameNum( visibleRect.left() - margin ) );
+    const int lastOrderPos = m_layout.findIndex( getFrameNum( visibleRect.right() + margin ) );
+
+    // The item being dragged is left in the scene, as removing it would end the drag
+    foreach ( WaveformItem* item, m_boundWaveformItems.values() )
+    {
+        const int orderPos = item->getOrderPos();
+
+        if ( ( orderPos < firstOrderPos || orderPos > lastOrderPos ) && item != mouseGrabberItem() )
+        {
+            unbindWaveform( item );
+        }
+    }
+
+    for ( int orderPos = firstOrderPos; orderPos <= lastOrderPos; orderPos++ )
+    {
+        bindWaveform( orderPos );
+    }
+}
+
+
+
+//==================================================================================================
+// Protected:
+
+void WaveGraphicsScene::mousePressEvent( QGraphicsSceneMouseEvent* event )
+{
+    QGraphicsScene::mousePressEvent( event );
+
+    // If no item took the press then QGraphicsScene has cleared the selection, but only of the items
+    // it contains
+    if ( ! event->isAccepted() &&
+         ! ( event->modifiers() & Qt::ControlModifier ) &&
+         getView()->dragMode() != QGraphicsView::ScrollHandDrag )
+    {
+        deselectDetachedWaveforms();
+    }
+}
+
+
+
+void WaveGraphicsScene::mouseReleaseEvent( QGraphicsSceneMouseEvent* event )
+{
+    QGraphicsItem* const grabberItem = mouseGrabberItem();
+
+    QGraphicsScene::mouseReleaseEvent( event );
+
+    // Clicking a selected item without moving it leaves it as the only selected item. QGraphicsScene
+    // won't report a change if the rest of the selection is out of the scene
+    if ( grabberItem != NULL &&
+         grabberItem->type() == WaveformItem::Type &&
+         grabberItem->isSelected() &&
+         event->button() == Qt::LeftButton &&
+         ! ( event->modifiers() & Qt::ControlModifier ) &&
+         event->scenePos() == event->buttonDownScenePos( Qt::LeftButton ) )
+    {
+        deselectDetachedWaveforms();
     }
 }
 
@@ -908,6 +1081,112 @@ WaveGraphicsView* WaveGraphicsScene::getView() const
 
 
 
+void WaveGraphicsScene::layOutWaveformItems()
+{
+    QVector<FrameNum> lengths;
+    lengths.reserve( m_waveformItemList.size() );
+
+    foreach ( SharedWaveformItem item, m_waveformItemList )
+    {
+        lengths << getStretchedNumFrames( item );
+    }
+
+    m_layout.setLengths( lengths );
+
+    // Items out of view are laid out as they're bound
+    foreach ( WaveformItem* item, m_boundWaveformItems )
+    {
+        layOutWaveformItem( item->getOrderPos() );
+    }
+}
+
+
+
+void WaveGraphicsScene::layOutWaveformItem( const int orderPos )
+{
+    const SharedWaveformItem item = m_waveformItemList.at( orderPos );
+    const qreal distanceBetweenFrames = width() / m_layout.getTotalLength();
+
+    item->setRect( 0.0, 0.0, m_layout.getLength( orderPos ) * distanceBetweenFrames, height() - BpmRuler::HEIGHT );
+    item->setPos( m_layout.getStartOffset( orderPos ) * distanceBetweenFrames, BpmRuler::HEIGHT );
+}
+
+
+
+void WaveGraphicsScene::bindWaveform( const int orderPos )
+{
+    const SharedWaveformItem item = m_waveformItemList.at( orderPos );
+
+    if ( item->scene() == NULL )
+    {
+        // A selected item brought into view during a drag joins the items being dragged
+        const qreal dragOffsetX = item->isSelected() ? getDragOffsetX() : 0.0;
+
+        layOutWaveformItem( orderPos );
+        item->setSpectrogramEnabled( m_isSpectrogramEnabled, m_jobScheduler );
+
+        // The item keeps its selected state while it's out of the scene
+        const ScopedValueSetter<bool> setter( m_isUpdatingSelection, true );
+
+        addItem( item.data() );
+        m_boundWaveformItems.insert( item.data() );
+
+        if ( dragOffsetX != 0.0 )
+        {
+            item->moveBy( dragOffsetX, 0.0 );
+        }
+    }
+}
+
+
+
+void WaveGraphicsScene::unbindWaveform( WaveformItem* const item )
+{
+    {
+        const ScopedValueSetter<bool> setter( m_isUpdatingSelection, true );
+
+        removeItem( item );
+        m_boundWaveformItems.remove( item );
+    }
+
+    item->setSpectrogramEnabled( false );
+    item->releaseSampleBins();
+}
+
+
+
+void WaveGraphicsScene::setWaveformSelected( WaveformItem* const item, const bool isSelected )
+{
+    const ScopedValueSetter<bool> setter( m_isUpdatingSelection, true );
+
+    item->setSelected( isSelected );
+
+    // Unselectable items stay deselected
+    if ( item->isSelected() )
+    {
+        m_selectedWaveformItems.insert( item );
+    }
+    else
+    {
+        m_selectedWaveformItems.remove( item );
+    }
+}
+
+
+
+void WaveGraphicsScene::deselectDetachedWaveforms()
+{
+    foreach ( WaveformItem* item, m_selectedWaveformItems.values() )
+    {
+        if ( item->scene() == NULL )
+        {
+            setWaveformSelected( item, false );
+        }
+    }
+}
+
+
+
 void WaveGraphicsScene::connectWaveform( const SharedWaveformItem item )
 {
     connect( item.data(), SIGNAL( orderPosIsChanging(QList<int>,int) ),
@@ -945,16 +1224,9 @@ void WaveGraphicsScene::createBpmRuler()
 //==================================================================================================
 // Private Static:
 
-int WaveGraphicsScene::getTotalNumFrames( const QList<SharedWaveformItem> waveformItemList )
+FrameNum WaveGraphicsScene::getStretchedNumFrames( const SharedWaveformItem item )
 {
-    int numFrames = 0;
-
-    foreach ( SharedWaveformItem item, waveformItemList )
-    {
-        numFrames += static_cast<int>( item->getSampleBuffer()->getNumFrames() * item->getStretchRatio() );
-    }
-
-    return numFrames;
+    return static_cast<FrameNum>( item->getSampleBuffer()->getNumFrames() * item->getStretchRatio() );
 }
 
 
@@ -964,96 +1236,113 @@ int WaveGraphicsScene::getTotalNumFrames( const QList<SharedWaveformItem> wavefo
 
 void WaveGraphicsScene::reorderWaveformItems( const QList<int> oldOrderPositions, const int numPlacesMoved )
 {
-    const int numSelectedItems = oldOrderPositions.size();
+    const int firstSelectedOrderPos = oldOrderPositions.first();
+    const int lastSelectedOrderPos = oldOrderPositions.last();
 
-    qreal distanceToMove = 0.0;
+    const QList<SharedWaveformItem>::iterator begin = m_waveformItemList.begin();
 
-    foreach ( int orderPos, oldOrderPositions )
-    {
-        distanceToMove += m_waveformItemList.at( orderPos )->rect().width();
-    }
+    int firstAffectedOrderPos;
+    int lastAffectedOrderPos;
 
-    QList<int> itemsToMoveCurrentOrderPositions;
+    // The selected items are contiguous, so moving them past the items they've been dragged over is a
+    // single rotation of the affected range of the list
 
     // If waveform items have been dragged to the left...
     if ( numPlacesMoved < 0 )
     {
-        int pos = oldOrderPositions.first() + numPlacesMoved;
-
-        for ( int num = 0; num < abs( numPlacesMoved ); num++ )
-        {
-            itemsToMoveCurrentOrderPositions << pos++;
-        }
-
-        foreach ( int orderPos, itemsToMoveCurrentOrderPositions )
-        {
-            const qreal currentScenePosX = m_waveformItemList.at( orderPos )->scenePos().x();
+        firstAffectedOrderPos = firstSelectedOrderPos + numPlacesMoved;
+        lastAffectedOrderPos = lastSelectedOrderPos;
 
-            m_waveformItemList.at( orderPos )->setPos( currentScenePosX + distanceToMove, BpmRuler::HEIGHT );
-            m_waveformItemList.at( orderPos )->setOrderPos( orderPos + numSelectedItems );
-        }
-
-        for ( int i = 0; i < numSelectedItems; i++ )
-        {
-            const int orderPos = oldOrderPositions.at( i );
-
-            m_waveformItemList.at( orderPos )->setOrderPos( orderPos + numPlacesMoved );
-            m_waveformItemList.move( orderPos, orderPos + numPlacesMoved );
-        }
+        std::rotate( begin + firstAffectedOrderPos, begin + firstSelectedOrderPos, begin + lastAffectedOrderPos + 1 );
     }
     else // If waveform items have been dragged to the right...
     {
-        int pos = oldOrderPositions.last() + 1;
+        firstAffectedOrderPos = firstSelectedOrderPos;
+        lastAffectedOrderPos = lastSelectedOrderPos + numPlacesMoved;
 
-        for ( int num = 0; num < numPlacesMoved; num++ )
-        {
-            itemsToMoveCurrentOrderPositions << pos++;
-        }
+        std::rotate( begin + firstAffectedOrderPos, begin + lastSelectedOrderPos + 1, begin + lastAffectedOrderPos + 1 );
+    }
 
-        foreach ( int orderPos, itemsToMoveCurrentOrderPositions )
-        {
-            const qreal currentScenePosX = m_waveformItemList.at( orderPos )->scenePos().x();
+    for ( int orderPos = firstAffectedOrderPos; orderPos <= lastAffectedOrderPos; orderPos++ )
+    {
+        const SharedWaveformItem item = m_waveformItemList.at( orderPos );
 
-            m_waveformItemList.at( orderPos )->setPos( currentScenePosX - distanceToMove, BpmRuler::HEIGHT );
-            m_waveformItemList.at( orderPos )->setOrderPos( orderPos - numSelectedItems );
-        }
+        item->setOrderPos( orderPos );
+        m_layout.setLength( orderPos, getStretchedNumFrames( item ) );
+    }
 
-        const int lastIndex = numSelectedItems - 1;
+    // Move the items that have been displaced; the selected items are left under the mouse
+    // and slid into place once dropped
+    for ( int orderPos = firstAffectedOrderPos; orderPos <= lastAffectedOrderPos; orderPos++ )
+    {
+        const SharedWaveformItem item = m_waveformItemList.at( orderPos );
 
-        for ( int i = lastIndex; i >= 0; i-- )
+        if ( ! item->isSelected() )
         {
-            const int orderPos = oldOrderPositions.at( i );
-
-            m_waveformItemList.at( orderPos )->setOrderPos( orderPos + numPlacesMoved );
-            m_waveformItemList.move( orderPos, orderPos + numPlacesMoved );
+            item->setPos( getScenePosX( m_layout.getStartOffset( orderPos ) ), BpmRuler::HEIGHT );
         }
     }
+
+    bindVisibleWaveforms();
 }
 
 
 
 void WaveGraphicsScene::slideWaveformItemIntoPlace( const int orderPos )
 {
-    qreal newScenePosX = 0.0;
+    m_waveformItemList.at( orderPos )->setPos( getScenePosX( m_layout.getStartOffset( orderPos ) ), BpmRuler::HEIGHT );
+}
+
+
+
+void WaveGraphicsScene::updateSelectedWaveforms()
+{
+    if ( m_isUpdatingSelection )
+    {
+        return;
+    }
+
+    QSet<WaveformItem*> boundSelectedItems;
+    QSet<WaveformItem*> prevBoundSelectedItems;
+
+    foreach ( WaveformItem* item, m_boundWaveformItems )
+    {
+        if ( item->isSelected() )
+        {
+            boundSelectedItems.insert( item );
+        }
+        if ( m_selectedWaveformItems.contains( item ) )
+        {
+            prevBoundSelectedItems.insert( item );
+        }
+    }
+
+    // Only the selection of slice points has changed
+    if ( boundSelectedItems == prevBoundSelectedItems )
+    {
+        return;
+    }
 
-    for ( int i = 0; i < orderPos; i++ )
+    // Clicking and rubber band selection can only reach the items in the scene, and replace the
+    // selection rather than add to it, so anything selected out of view is deselected
+    foreach ( WaveformItem* item, m_selectedWaveformItems - m_boundWaveformItems )
     {
-        newScenePosX += m_waveformItemList.at( i )->rect().width();
+        setWaveformSelected( item, false );
     }
 
-    m_waveformItemList.at( orderPos )->setPos( newScenePosX, BpmRuler::HEIGHT );
+    m_selectedWaveformItems = boundSelectedItems;
 }
 
 
 
-void WaveGraphicsScene::updateSlicePointOrdering( SlicePointItem* const movedItem, const int oldFrameNum )
+void WaveGraphicsScene::updateSlicePointOrdering( SlicePointItem* const movedItem, const FrameNum oldFrameNum )
 {
     qSort( m_slicePointItemList.begin(), m_slicePointItemList.end(), SlicePointItem::isLessThanFrameNum );
 
     SharedSlicePointItem sharedSlicePoint;
 
-    int numFramesFromPrevSlicePoint = movedItem->getFrameNum();
-    int numFramesToNextSlicePoint = getTotalNumFrames( m_waveformItemList ) - movedItem->getFrameNum();
+    FrameNum numFramesFromPrevSlicePoint = movedItem->getFrameNum();
+    FrameNum numFramesToNextSlicePoint = m_layout.getTotalLength() - movedItem->getFrameNum();
     int orderPos = 0;
 
     for ( int i = 0; i < m_slicePointItemList.size(); i++ )
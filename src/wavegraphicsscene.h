@@ -26,11 +26,14 @@
 #include <QGraphicsScene>
 #include <QTimeLine>
 #include <QGraphicsItemAnimation>
+#include <QSet>
 #include "JuceHeader.h"
 #include "waveformitem.h"
 #include "slicepointitem.h"
 #include "samplebuffer.h"
 #include "wavegraphicsview.h"
+#include "waveformlayout.h"
+#include "jobscheduler.h"
 
 class WaveGraphicsView;
 
@@ -87,11 +90,41 @@ public:
 
     QList<qreal> getWaveformStretchRatios( QList<int> orderPositions ) const;
 
-    // Redraw all waveform items
+    // Returns the order pos. of the waveform item spanning the given frame (as returned by getFrameNum()),
+    // or -1 if there are no waveform items
+    int getWaveformOrderPosAt( FrameNum frameNum ) const    { return m_layout.findIndex( frameNum ); }
+
+    // Returns the frame (as returned by getFrameNum()) at which the given waveform item starts
+    FrameNum getWaveformStartFrameNum( int orderPos ) const { return m_layout.getStartOffset( orderPos ); }
+
+    // Returns the scene x-coord of the left edge of the given waveform item according to the layout, which is
+    // valid whether or not the item is currently in the scene. Passing the no. of waveform items gives the
+    // right edge of the last one
+    qreal getWaveformScenePosX( int orderPos ) const;
+
+    // Returns the scene x-coord of the centre of the given waveform item according to the layout, which is
+    // valid whether or not the item is currently in the scene
+    qreal getWaveformCentreScenePosX( int orderPos ) const;
+
+    // Returns how far the selected waveform items have been dragged from their places in the layout, or 0.0 if
+    // they aren't being dragged. Only those in the scene are moved by the drag
+    qreal getDragOffsetX() const;
+
+    // Redraw all waveform items after the sample data of every item has been edited in place
     void redrawWaveforms();
 
+    // Redraw all waveform items after the sample data of only the given items has been edited in place
+    void redrawWaveforms( QList<int> editedOrderPositions );
+
+    // Spectrograms are computed on this scheduler; must be set before they can be enabled
+    void setJobScheduler( JobScheduler* jobScheduler )     { m_jobScheduler = jobScheduler; }
+
+    // Show or hide a spectrogram behind every waveform item, including those created later
+    void setSpectrogramEnabled( bool isEnabled );
+    bool isSpectrogramEnabled() const                       { return m_isSpectrogramEnabled; }
+
     // Create a new slice point item and add it to the scene
-    SharedSlicePointItem createSlicePoint( int frameNum, bool canBeMovedPastOtherSlicePoints );
+    SharedSlicePointItem createSlicePoint( FrameNum frameNum, bool canBeMovedPastOtherSlicePoints );
 
     // Add a slice point item to the scene
     void addSlicePoint( SharedSlicePointItem slicePoint );
@@ -99,13 +132,13 @@ public:
     // Remove a slice point item from the scene
     void removeSlicePoint( SharedSlicePointItem slicePointItem );
 
-    void moveSlicePoint( SharedSlicePointItem slicePointItem, int newFrameNum );
+    void moveSlicePoint( SharedSlicePointItem slicePointItem, FrameNum newFrameNum );
 
     // Returns the currently selected slice point item
     SharedSlicePointItem getSelectedSlicePoint();
 
     // Returns a sorted and edited list containing the frame no. of every valid slice point item
-    QList<int> getSlicePointFrameNums() const;
+    QList<FrameNum> getSlicePointFrameNums() const;
 
     // Returns a list of all slice point items
     QList<SharedSlicePointItem> getSlicePointList() const   { return m_slicePointItemList; }
@@ -116,7 +149,7 @@ public:
     void startPlayhead( bool isLoopingDesired, qreal stretchRatio = 1.0 );
     void startPlayhead( qreal startPosX,
                         qreal endPosX,
-                        int numFrames,
+                        FrameNum numFrames,
                         bool isLoopingDesired,
                         qreal stretchRatio = 1.0 );
     void stopPlayhead();
@@ -130,19 +163,29 @@ public:
     void clearAll();
     void clearWaveform();
 
-    qreal getScenePosX( int frameNum ) const;
-    int getFrameNum( qreal scenePosX ) const;
+    qreal getScenePosX( FrameNum frameNum ) const;
+    FrameNum getFrameNum( qreal scenePosX ) const;
     qreal getNearestFramePosX( qreal scenePosX ) const;
 
     bool isSceneAtSampleDetailLevel() const                 { return m_isSceneAtSampleDetailLevel; }
 
-    void resizeWaveformItems( qreal scaleFactorX );
+    void resizeWaveformItems();
     void resizeSlicePointItems( qreal scaleFactorX );
     void resizePlayhead();
     void resizeRuler( qreal scaleFactorX );
 
     void scaleItems( qreal scaleFactorX );
 
+public slots:
+    // Only the waveform items within (or close to) the visible part of the scene are kept in the scene;
+    // the rest are detached along with their drawing caches. This must be called whenever the visible
+    // part of the scene changes
+    void bindVisibleWaveforms();
+
+protected:
+    void mousePressEvent( QGraphicsSceneMouseEvent* event );
+    void mouseReleaseEvent( QGraphicsSceneMouseEvent* event );
+
 private:
     WaveGraphicsView* getView() const;
 
@@ -150,9 +193,34 @@ private:
 
     void createBpmRuler();
 
+    // Rebuild the layout from the waveform item list, then resize and reposition every waveform item
+    void layOutWaveformItems();
+
+    // Resize and reposition a single waveform item according to the layout
+    void layOutWaveformItem( int orderPos );
+
+    // Add a waveform item to the scene if it isn't already
+    void bindWaveform( int orderPos );
+
+    // Remove a waveform item from the scene and free its drawing caches
+    void unbindWaveform( WaveformItem* item );
+
+    // Select or deselect a waveform item, whether or not it's in the scene
+    void setWaveformSelected( WaveformItem* item, bool isSelected );
+
+    // Deselect every selected waveform item that isn't in the scene
+    void deselectDetachedWaveforms();
+
     InteractionMode m_interactionMode;
 
     QList<SharedWaveformItem> m_waveformItemList;
+    WaveformLayout m_layout;
+    QSet<WaveformItem*> m_boundWaveformItems;
+
+    // QGraphicsScene only tracks the selection of the items it contains, so the selected waveform
+    // items are kept here, whether or not they're in the scene
+    QSet<WaveformItem*> m_selectedWaveformItems;
+    bool m_isUpdatingSelection;
     QList<SharedSlicePointItem> m_slicePointItemList;
 
     QList<SharedGraphicsItem> m_rulerMarksList;
@@ -166,24 +234,34 @@ private:
 
     bool m_isSceneAtSampleDetailLevel;
 
+    bool m_isSpectrogramEnabled;
+    JobScheduler* m_jobScheduler;
+
 private:
-    static int getTotalNumFrames( QList<SharedWaveformItem> waveformItemList );
+    static FrameNum getStretchedNumFrames( SharedWaveformItem item );
 
 signals:
     void slicePointPosChanged( SharedSlicePointItem slicePoint,
                                int orderPos,
-                               int numFramesFromPrevSlicePoint,
-                               int numFramesToNextSlicePoint,
-                               int oldFrameNum );
+                               FrameNum numFramesFromPrevSlicePoint,
+                               FrameNum numFramesToNextSlicePoint,
+                               FrameNum oldFrameNum );
     void playheadFinishedScrolling();
 
+    // Relayed from the slice point item being dragged
+    void slicePointDragged( FrameNum frameNum );
+    void slicePointDragFinished();
+
 private slots:
     // 'oldOrderPositions' is assumed to be sorted
     // 'numPlacesMoved' should be negative if the items have moved left, or positive if the items have moved right
     void reorderWaveformItems( QList<int> oldOrderPositions, int numPlacesMoved );
 
     void slideWaveformItemIntoPlace( int orderPos );
-    void updateSlicePointOrdering( SlicePointItem* movedItem, int oldFrameNum );
+
+    // Takes up changes made to the selection through the scene, e.g. by clicking or rubber band selection
+    void updateSelectedWaveforms();
+    void updateSlicePointOrdering( SlicePointItem* movedItem, FrameNum oldFrameNum );
     void removePlayhead();
 
     void setSceneDetailLevelToSamples();
@@ -22,6 +22,8 @@
 
 #include "wavegraphicsview.h"
 #include <QGLWidget>
+#include <QScrollBar>
+#include <QStringList>
 #include <QDebug>
 
 
@@ -30,24 +32,22 @@
 
 WaveGraphicsView::WaveGraphicsView( QWidget* parent ) :
     QGraphicsView( parent ),
-    m_isViewZoomedIn( false )
+    m_isViewZoomedIn( false ),
+    m_isOpenGLEnabled( false ),
+    m_averageFrameTimeMs( 0.0 )
 {
     // Set up view and scene
-    setViewport( new QGLWidget( QGLFormat(QGL::SampleBuffers) ) );
-    setViewportUpdateMode( QGraphicsView::FullViewportUpdate );
+    setOpenGLEnabled( isHardwareOpenGLAvailable() );
 
-#if QT_VERSION >= 0x040700  // Qt 4.7 or greater
-    setRenderHint( QPainter::HighQualityAntialiasing, true );
-#else
-    setRenderHint( QPainter::HighQualityAntialiasing, false );
-#endif
-
-    setOptimizationFlags( DontSavePainterState | DontAdjustForAntialiasing );
     setBackgroundBrush( Qt::gray );
     setCacheMode( CacheBackground );
 
     m_scene = new WaveGraphicsScene( 0.0, 0.0, 1024.0, 768.0 );
     setScene( m_scene );
+
+    // Waveform items are only kept in the scene while they're in view
+    connect( horizontalScrollBar(), SIGNAL( valueChanged(int) ),
+             m_scene, SLOT( bindVisibleWaveforms() ) );
 }
 
 
@@ -103,6 +103,57 @@ void WaveGraphicsView::zoomOriginal()
 
 
 
+void WaveGraphicsView::setOpenGLEnabled( const bool isEnabled )
+{
+    if ( isEnabled )
+    {
+        setViewport( new QGLWidget( QGLFormat(QGL::SampleBuffers) ) );
+
+        // Partial updates aren't supported by the GL viewport
+        setViewportUpdateMode( QGraphicsView::FullViewportUpdate );
+
+#if QT_VERSION >= 0x040700  // Qt 4.7 or greater
+        setRenderHint( QPainter::HighQualityAntialiasing, true );
+#else
+        setRenderHint( QPainter::HighQualityAntialiasing, false );
+#endif
+
+        setOptimizationFlags( DontSavePainterState | DontAdjustForAntialiasing );
+    }
+    else
+    {
+        setViewport( new QWidget );
+
+        // Only repaint the regions that have changed, e.g. a thin strip either side of the playhead
+        setViewportUpdateMode( QGraphicsView::SmartViewportUpdate );
+
+        // All pens are cosmetic and one pixel wide, so antialiasing adds cost for little benefit.
+        // Without it, updated regions needn't be padded to cover antialiased edges
+        setRenderHint( QPainter::HighQualityAntialiasing, false );
+        setRenderHint( QPainter::Antialiasing, false );
+
+        setOptimizationFlags( DontSavePainterState | DontAdjustForAntialiasing );
+    }
+
+    m_isOpenGLEnabled = isEnabled;
+    m_averageFrameTimeMs = 0.0;
+}
+
+
+
+//==================================================================================================
+// Public Static:
+
+bool WaveGraphicsView::isHardwareOpenGLAvailable()
+{
+    // Probing creates a GL context, so it's only done once
+    static const bool s_isAvailable = probeHardwareOpenGL();
+
+    return s_isAvailable;
+}
+
+
+
 //==================================================================================================
 // Protected:
 
@@ -112,12 +163,75 @@ void WaveGraphicsView::resizeEvent( QResizeEvent* event )
 
     m_scene->setSceneRect( 0.0, 0.0, event->size().width(), event->size().height() );
 
-    m_scene->resizeWaveformItems( scaleFactorX );
+    m_scene->resizeWaveformItems();
     m_scene->resizeSlicePointItems( scaleFactorX );
     m_scene->resizePlayhead();
     m_scene->resizeRuler( scaleFactorX );
 
     QGraphicsView::resizeEvent( event );
+
+    m_scene->bindVisibleWaveforms();
+}
+
+
+
+void WaveGraphicsView::paintEvent( QPaintEvent* event )
+{
+    const double startTimeMs = Time::getMillisecondCounterHiRes();
+
+    QGraphicsView::paintEvent( event );
+
+    const double frameTimeMs = Time::getMillisecondCounterHiRes() - startTimeMs;
+
+    if ( m_averageFrameTimeMs == 0.0 )
+    {
+        m_averageFrameTimeMs = frameTimeMs;
+    }
+    else
+    {
+        m_averageFrameTimeMs += ( frameTimeMs - m_averageFrameTimeMs ) * 0.1;
+    }
+}
+
+
+
+//==================================================================================================
+// Private Static:
+
+bool WaveGraphicsView::probeHardwareOpenGL()
+{
+    if ( ! QGLFormat::hasOpenGL() )
+    {
+        return false;
+    }
+
+    QGLWidget glWidget;
+
+    if ( ! glWidget.isValid() )
+    {
+        return false;
+    }
+
+    glWidget.makeCurrent();
+
+    const QString rendererName = QString( reinterpret_cast<const char*>( glGetString( GL_RENDERER ) ) );
+
+    glWidget.doneCurrent();
+
+    const QStringList softwareRendererNames = QStringList() << "llvmpipe" << "softpipe" << "Software Rasterizer"
+                                                            << "swrast" << "SwiftShader" << "GDI Generic"
+                                                            << "Microsoft Basic Render Driver"
+                                                            << "Apple Software Renderer";
+
+    foreach ( QString softwareRendererName, softwareRendererNames )
+    {
+        if ( rendererName.contains( softwareRendererName, Qt::CaseInsensitive ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 
@@ -25,6 +25,7 @@
 
 #include <QGraphicsView>
 #include <QResizeEvent>
+#include <QPaintEvent>
 #include "JuceHeader.h"
 #include "wavegraphicsscene.h"
 
@@ -44,14 +45,34 @@ public:
     void zoomOut();
     void zoomOriginal();
 
+    // Draw using OpenGL, or else the CPU-based raster engine. The raster path only repaints the parts
+    // of the view that have changed, which is much cheaper than a software OpenGL implementation
+    // redrawing the whole view on every playhead tick
+    void setOpenGLEnabled( bool isEnabled );
+    bool isOpenGLEnabled() const                            { return m_isOpenGLEnabled; }
+
+    // Moving average of the time taken to paint the view, reset whenever the renderer is changed
+    qreal getAverageFrameTimeMs() const                     { return m_averageFrameTimeMs; }
+
+public:
+    // Returns false if OpenGL is unavailable or is implemented in software, e.g. Mesa's llvmpipe
+    static bool isHardwareOpenGLAvailable();
+
 protected:
     void resizeEvent( QResizeEvent* event );
+    void paintEvent( QPaintEvent* event );
 
 private:
     ScopedPointer<WaveGraphicsScene> m_scene;
 
     bool m_isViewZoomedIn;
 
+    bool m_isOpenGLEnabled;
+    qreal m_averageFrameTimeMs;
+
+private:
+    static bool probeHardwareOpenGL();
+
 signals:
     void minDetailLevelReached();
     void maxDetailLevelReached();
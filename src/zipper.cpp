@@ -28,7 +28,7 @@
 //==================================================================================================
 // Public Static:
 
-void Zipper::compress( const QString sourceDirPath, const QString zipFilePath )
+bool Zipper::compress( const QString sourceDirPath, const QString zipFilePath )
 {
     const File sourceDir( sourceDirPath.toLocal8Bit().data() );
     const File zipFile( zipFilePath.toLocal8Bit().data() );
@@ -50,7 +50,17 @@ void Zipper::compress( const QString sourceDirPath, const QString zipFilePath )
     }
 
     FileOutputStream stream( zipFile );
-    zipBuilder.writeToStream( stream, NULL );
+
+    if ( stream.failedToOpen() )
+    {
+        return false;
+    }
+
+    const bool isSuccessful = zipBuilder.writeToStream( stream, NULL );
+
+    stream.flush();
+
+    return isSuccessful && stream.getStatus().wasOk();
 }
 
 
@@ -29,7 +29,8 @@
 class Zipper
 {
 public:
-    static void compress( QString sourceDirPath, QString zipFilePath );
+    // Returns false if the zip file couldn't be written
+    static bool compress( QString sourceDirPath, QString zipFilePath );
     static void decompress( QString zipFilePath, QString destDirPath );
 };
 
@@ -0,0 +1,193 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+// Only built with "qmake CONFIG+=rtcheck"
+
+
+#include "sampleraudiosource.h"
+#include "rubberbandaudiosource.h"
+#include "realtimechecker.h"
+
+
+// Drives the audio sources the way the audio device would, without one, while the GUI thread's
+// side of things (notes, scrubbing, stretch settings) changes between blocks. Anything the
+// real-time safety checker reports while a block is rendered fails the test
+class AudioGraphTests : public UnitTest
+{
+public:
+    AudioGraphTests() : UnitTest( "AudioGraph" ) {}
+
+    void runTest()
+    {
+        beginTest( "Sampler" );
+        {
+            SamplerAudioSource samplerSource;
+            setUp( samplerSource );
+
+            samplerSource.prepareToPlay( BLOCK_SIZE, SAMPLE_RATE );
+
+            const int numViolations = RealtimeChecker::getNumViolations();
+
+            renderBlocks( samplerSource, samplerSource );
+
+            expectEquals( RealtimeChecker::getNumViolations() - numViolations, 0, "See stderr for the calls reported" );
+
+            samplerSource.releaseResources();
+        }
+
+        beginTest( "Real-time time stretch" );
+        {
+            SamplerAudioSource samplerSource;
+            setUp( samplerSource );
+
+            RubberbandAudioSource stretchSource( &samplerSource, NUM_CHANS, RubberBandStretcher::OptionProcessRealTime, false, true );
+            stretchSource.enablePitchCorrection( true );
+
+            for ( int i = 0; i < NUM_SLICES; i++ )
+            {
+                stretchSource.setNoteTimeRatio( samplerSource.getLowestAssignedMidiNote() + i, 1.0 + i * 0.1 );
+            }
+
+            stretchSource.prepareToPlay( BLOCK_SIZE, SAMPLE_RATE );
+
+            const int numViolations = RealtimeChecker::getNumViolations();
+
+            renderBlocks( samplerSource, stretchSource, &stretchSource );
+
+            expectEquals( RealtimeChecker::getNumViolations() - numViolations, 0, "See stderr for the calls reported" );
+
+            stretchSource.releaseResources();
+        }
+    }
+
+private:
+    static const int SAMPLE_RATE = 44100;
+    static const int BLOCK_SIZE = 256;
+    static const int NUM_CHANS = 2;
+    static const int NUM_SLICES = 16;
+    static const int NUM_BLOCKS = 2000;
+
+    // Slices of a decaying tone, a few of them in a choke group and with an envelope
+    void setUp( SamplerAudioSource& samplerSource )
+    {
+        QList<SharedSampleBuffer> sampleBufferList;
+
+        for ( int i = 0; i < NUM_SLICES; i++ )
+        {
+            const int numFrames = 2000 + i * 500;
+
+            SharedSampleBuffer sampleBuffer( new SampleBuffer( NUM_CHANS, numFrames ) );
+
+            for ( int frameNum = 0; frameNum < numFrames; frameNum++ )
+            {
+                const float value = std::sin( frameNum * 0.05f ) * ( 1.0f - frameNum / float( numFrames ) );
+
+                for ( int chanNum = 0; chanNum < NUM_CHANS; chanNum++ )
+                {
+                    sampleBuffer->setSample( chanNum, frameNum, value );
+                }
+            }
+
+            sampleBufferList << sampleBuffer;
+        }
+
+        m_sampleBufferList = sampleBufferList;
+
+        samplerSource.setSamples( sampleBufferList, SAMPLE_RATE );
+        samplerSource.setVoiceLimit( 4 );
+
+        for ( int i = 0; i < 4; i++ )
+        {
+            samplerSource.setChokeGroup( i, 1 );
+            samplerSource.setOneShot( i + 4, false );
+            samplerSource.setAttack( i + 8, 0.1 );
+            samplerSource.setRelease( i + 4, 0.2 );
+        }
+    }
+
+    // Renders NUM_BLOCKS from 'outputSource', playing the samples in turn, triggering notes as MIDI
+    // input and scrubbing, with the time stretch settings changed along the way if 'stretchSource' is given
+    void renderBlocks( SamplerAudioSource& samplerSource,
+                       AudioSource& outputSource,
+                       RubberbandAudioSource* const stretchSource = NULL )
+    {
+        AudioSampleBuffer outputBuffer( NUM_CHANS, BLOCK_SIZE );
+        const AudioSourceChannelInfo info( &outputBuffer, 0, BLOCK_SIZE );
+
+        MidiMessageCollector* const midiCollector = samplerSource.getMidiMessageCollector();
+
+        samplerSource.setLooping( true );
+        samplerSource.playAll();
+
+        for ( int blockNum = 0; blockNum < NUM_BLOCKS; blockNum++ )
+        {
+            const int keyNum = samplerSource.getLowestAssignedMidiNote() + blockNum % NUM_SLICES;
+
+            if ( blockNum % 7 == 0 )
+            {
+                MidiMessage message = MidiMessage::noteOn( Midi::getChannel( keyNum ), Midi::getNoteNum( keyNum ), 0.8f );
+                message.setTimeStamp( Time::getMillisecondCounterHiRes() * 0.001 );
+                midiCollector->addMessageToQueue( message );
+            }
+            else if ( blockNum % 7 == 3 )
+            {
+                MidiMessage message = MidiMessage::noteOff( Midi::getChannel( keyNum ), Midi::getNoteNum( keyNum ) );
+                message.setTimeStamp( Time::getMillisecondCounterHiRes() * 0.001 );
+                midiCollector->addMessageToQueue( message );
+            }
+
+            if ( blockNum == NUM_BLOCKS / 4 )
+            {
+                samplerSource.playSample( 3, SharedSampleRange() );
+            }
+            else if ( blockNum == NUM_BLOCKS / 2 )
+            {
+                samplerSource.stop();
+            }
+
+            if ( blockNum > NUM_BLOCKS / 2 && blockNum < NUM_BLOCKS * 3 / 4 )
+            {
+                const int sampleNum = blockNum % NUM_SLICES;
+                samplerSource.scrub( sampleNum, ( blockNum * 37 ) % m_sampleBufferList.at( sampleNum )->getNumFrames() );
+            }
+            else if ( blockNum == NUM_BLOCKS * 3 / 4 )
+            {
+                samplerSource.stopScrubbing();
+            }
+
+            if ( stretchSource != NULL && blockNum % 100 == 0 )
+            {
+                stretchSource->setGlobalTimeRatio( 0.75 + ( blockNum / 100 % 4 ) * 0.25 );
+                stretchSource->enablePitchCorrection( blockNum / 100 % 2 == 0 );
+                stretchSource->setTransientsOption( blockNum / 100 % 3 == 0 ? RubberBandStretcher::OptionTransientsSmooth
+                                                                             : RubberBandStretcher::OptionTransientsCrisp );
+            }
+
+            outputBuffer.clear();
+            outputSource.getNextAudioBlock( info );
+        }
+    }
+
+    QList<SharedSampleBuffer> m_sampleBufferList;
+};
+
+static AudioGraphTests audioGraphTests;
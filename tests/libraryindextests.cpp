@@ -0,0 +1,181 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+
+#include "libraryindex.h"
+#include <QFile>
+#include <cmath>
+
+
+// Checks how library queries are parsed and which entries they match, and that an update indexes
+// unreadable files without returning them from queries
+class LibraryIndexTests : public UnitTest
+{
+public:
+    LibraryIndexTests() : UnitTest( "LibraryIndex" ) {}
+
+    void runTest()
+    {
+        beginTest( "Parsing queries" );
+        {
+            LibraryIndex::Query query;
+
+            expect( LibraryIndex::parseQuery( QStringList() << "bpm=120..125" << "duration=..4", query ) );
+            expectEquals( query.minBPM, 120.0f );
+            expectEquals( query.maxBPM, 125.0f );
+            expect( std::isnan( query.minDurationSecs ) );
+            expectEquals( query.maxDurationSecs, 4.0f );
+            expect( std::isnan( query.minNumOnsets ) && std::isnan( query.maxNumOnsets ) );
+            expect( std::isnan( query.minLoudness ) && std::isnan( query.maxLoudness ) );
+            expect( query.nameContains.isEmpty() );
+
+            expect( LibraryIndex::parseQuery( QStringList() << "onsets=8" << "name=Kick", query ) );
+            expectEquals( query.minNumOnsets, 8.0f );
+            expectEquals( query.maxNumOnsets, 8.0f );
+            expect( query.nameContains == "Kick" );
+            expect( std::isnan( query.minBPM ) && std::isnan( query.maxBPM ), "Previous query not reset" );
+
+            expect( LibraryIndex::parseQuery( QStringList() << "BPM=90.." << "loudness=-20.5..-6", query ) );
+            expectEquals( query.minBPM, 90.0f );
+            expect( std::isnan( query.maxBPM ) );
+            expectEquals( query.minLoudness, -20.5f );
+            expectEquals( query.maxLoudness, -6.0f );
+
+            expect( LibraryIndex::parseQuery( QStringList(), query ) );
+            expect( std::isnan( query.minBPM ) && std::isnan( query.maxLoudness ) );
+        }
+
+        beginTest( "Invalid queries" );
+        {
+            const char* const invalidTerms[] = { "bpm=..", "bpm=fast", "bpm=120..x", "duration=", "tempo=120", "=120", "bpm" };
+
+            for ( int i = 0; i < numElementsInArray( invalidTerms ); i++ )
+            {
+                LibraryIndex::Query query;
+
+                expect( ! LibraryIndex::parseQuery( QStringList() << "duration=..4" << invalidTerms[ i ], query ),
+                        String( invalidTerms[ i ] ) + " was accepted" );
+            }
+        }
+
+        const LibraryIndex::Entry loop = createEntry( "/loops/Funky Break 120.wav", 120.0f );
+        const LibraryIndex::Entry noTempo = createEntry( "/loops/pad.wav", 0.0f );
+
+        LibraryIndex::Entry unreadable;
+        unreadable.filePath = "/loops/unreadable.wav";
+
+        beginTest( "Matching entries" );
+        {
+            expect( matches( loop, QStringList() ) );
+            expect( matches( noTempo, QStringList() ) );
+            expect( ! matches( unreadable, QStringList() ) );
+
+            // Limits are inclusive
+            expect( matches( loop, QStringList() << "bpm=120..125" ) );
+            expect( matches( loop, QStringList() << "bpm=..120" ) );
+            expect( ! matches( loop, QStringList() << "bpm=120.5.." ) );
+            expect( ! matches( noTempo, QStringList() << "bpm=..200" ), "Entry without a tempo matched a BPM query" );
+
+            expect( matches( loop, QStringList() << "duration=..4" ) );
+            expect( ! matches( loop, QStringList() << "duration=..1.5" ) );
+
+            expect( matches( loop, QStringList() << "onsets=8" ) );
+            expect( ! matches( loop, QStringList() << "onsets=9.." ) );
+
+            expect( matches( loop, QStringList() << "loudness=-20..-6" ) );
+            expect( ! matches( loop, QStringList() << "loudness=-6.." ) );
+
+            // Only the file name is searched, not the dir
+            expect( matches( loop, QStringList() << "name=funky" ) );
+            expect( ! matches( loop, QStringList() << "name=loops" ) );
+
+            expect( matches( loop, QStringList() << "bpm=118..122" << "duration=..4" << "name=break" ) );
+            expect( ! matches( loop, QStringList() << "bpm=118..122" << "duration=..4" << "name=kick" ) );
+        }
+
+        beginTest( "Updating" );
+        {
+            File tempDir = File::getSpecialLocation( File::tempDirectory ).getNonexistentChildFile( "shuriken_tests", "", false );
+            tempDir.getChildFile( "loops" ).createDirectory();
+            tempDir.getChildFile( "loops/not audio.wav" ).replaceWithText( "Not audio" );
+            tempDir.getChildFile( "loops/readme.txt" ).replaceWithText( "Not indexed" );
+
+            const QString tempDirPath = QString::fromUtf8( tempDir.getFullPathName().toRawUTF8() );
+            const QString indexFilePath = tempDirPath + "/library.index";
+
+            LibraryIndex index;
+            index.setDirPaths( QStringList() << tempDirPath << tempDirPath + "/loops" );
+
+            expectEquals( index.getDirPaths().size(), 2 );
+
+            // Files in more than one library dir are only indexed once
+            expectEquals( index.update(), 1 );
+            expectEquals( index.getNumEntries(), 1 );
+            expect( index.find( LibraryIndex::Query() ).isEmpty(), "Unreadable file was found" );
+
+            expectEquals( index.update(), 0, "Unchanged file was analysed again" );
+
+            expect( index.save( indexFilePath ) );
+
+            LibraryIndex loadedIndex;
+
+            expect( loadedIndex.load( indexFilePath ) );
+            expect( loadedIndex.getDirPaths() == index.getDirPaths() );
+            expectEquals( loadedIndex.getNumEntries(), 1 );
+            expectEquals( loadedIndex.update(), 0, "Entries changed by saving and loading" );
+
+            tempDir.getChildFile( "loops/not audio.wav" ).deleteFile();
+
+            expectEquals( loadedIndex.update(), 0 );
+            expectEquals( loadedIndex.getNumEntries(), 0, "Deleted file still indexed" );
+
+            tempDir.deleteRecursively();
+        }
+    }
+
+private:
+    static LibraryIndex::Entry createEntry( const QString filePath, const float bpm )
+    {
+        LibraryIndex::Entry entry;
+
+        entry.filePath = filePath;
+        entry.durationSecs = 2.0f;
+        entry.sampleRate = 44100;
+        entry.bpm = bpm;
+        entry.numOnsets = 8;
+        entry.loudness = -12.0f;
+
+        return entry;
+    }
+
+    bool matches( const LibraryIndex::Entry& entry, const QStringList terms )
+    {
+        LibraryIndex::Query query;
+
+        expect( LibraryIndex::parseQuery( terms, query ), "Query not parsed: " + String( terms.join( " " ).toUtf8().constData() ) );
+
+        return LibraryIndex::matches( entry, query );
+    }
+};
+
+static LibraryIndexTests libraryIndexTests;
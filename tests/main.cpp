@@ -0,0 +1,65 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "JuceHeader.h"
+#include <iostream>
+
+
+// Runs the tests that the *tests.cpp files register, or only those named on the command line.
+// Returns non-zero if any of them failed
+int main( int argc, char* argv[] )
+{
+    Array<UnitTest*> tests;
+
+    for ( int i = 0; i < UnitTest::getAllTests().size(); i++ )
+    {
+        UnitTest* const test = UnitTest::getAllTests().getUnchecked( i );
+
+        bool isWanted = argc < 2;
+
+        for ( int argNum = 1; argNum < argc; argNum++ )
+        {
+            isWanted = isWanted || test->getName() == argv[ argNum ];
+        }
+
+        if ( isWanted )
+        {
+            tests.add( test );
+        }
+    }
+
+    UnitTestRunner runner;
+    runner.setAssertOnFailure( false );
+    runner.runTests( tests );
+
+    int numFailures = 0;
+
+    for ( int i = 0; i < runner.getNumResults(); i++ )
+    {
+        numFailures += runner.getResult( i )->failures;
+    }
+
+    std::cout << ( numFailures == 0 ? "All tests passed" : "Some tests failed" ) << std::endl;
+
+    return numFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "memoryaccountant.h"
+#include <QFile>
+
+
+// Checks how MemoryAccountant tallies sample buffers, and that undo data spilled to a temp dir
+// is brought back intact
+class MemoryAccountantTests : public UnitTest
+{
+public:
+    MemoryAccountantTests() : UnitTest( "MemoryAccountant" ) {}
+
+    void runTest()
+    {
+        const SharedSampleBuffer stereoBuffer = createSampleBuffer( 2, 1000 );
+        const SharedSampleBuffer monoBuffer = createSampleBuffer( 1, 500 );
+
+        const qint64 stereoNumBytes = 2 * 1000 * sizeof( float );
+        const qint64 monoNumBytes = 1 * 500 * sizeof( float );
+
+        beginTest( "Buffer size" );
+        {
+            expectEquals( MemoryAccountant::getNumBytes( *stereoBuffer ), stereoNumBytes );
+            expectEquals( MemoryAccountant::getNumBytes( SampleBuffer() ), (qint64) 0 );
+        }
+
+        beginTest( "Each buffer is counted once" );
+        {
+            MemoryAccountant::Usage usage;
+
+            usage.addSampleBuffers( MemoryAccountant::SAMPLES, QList<SharedSampleBuffer>() << stereoBuffer );
+            usage.addSampleBuffers( MemoryAccountant::UNDO_HISTORY, QList<SharedSampleBuffer>() << stereoBuffer << monoBuffer );
+            usage.addSampleBuffers( MemoryAccountant::CLIPBOARD, QList<SharedSampleBuffer>() << monoBuffer );
+
+            expectEquals( usage.getNumBytes( MemoryAccountant::SAMPLES ), stereoNumBytes );
+            expectEquals( usage.getNumBytes( MemoryAccountant::UNDO_HISTORY ), monoNumBytes );
+            expectEquals( usage.getNumBytes( MemoryAccountant::CLIPBOARD ), (qint64) 0 );
+            expectEquals( usage.getTotalNumBytes(), stereoNumBytes + monoNumBytes );
+        }
+
+        beginTest( "Bytes added by category" );
+        {
+            MemoryAccountant::Usage usage;
+
+            usage.addNumBytes( MemoryAccountant::WAVEFORM_CACHE, 100 );
+            usage.addNumBytes( MemoryAccountant::WAVEFORM_CACHE, 50 );
+            usage.addNumBytes( MemoryAccountant::SPECTROGRAM_CACHE, 1000 );
+
+            expectEquals( usage.getNumBytes( MemoryAccountant::WAVEFORM_CACHE ), (qint64) 150 );
+            expectEquals( usage.getTotalNumBytes(), (qint64) 1150 );
+        }
+
+        File tempDir = File::getSpecialLocation( File::tempDirectory ).getNonexistentChildFile( "shuriken_tests", "", false );
+        tempDir.createDirectory();
+
+        const QString tempDirPath = QString::fromUtf8( tempDir.getFullPathName().toRawUTF8() );
+
+        AudioFileHandler fileHandler;
+
+        beginTest( "Spill and restore" );
+        {
+            MemoryAccountant accountant( tempDirPath, fileHandler );
+
+            const SharedSampleBuffer sampleBuffer = createSampleBuffer( 2, 1000 );
+
+            const QSharedPointer<MemoryAccountant::SpillJob> job = accountant.createSpillJob( QList<SharedSampleBuffer>() << sampleBuffer,
+                                                                                             SAMPLE_RATE );
+            expect( ! job.isNull() );
+            job->run();
+
+            const QHash<const SampleBuffer*, SharedSampleBuffer> placeholders = accountant.takePlaceholders( *job );
+
+            expectEquals( placeholders.size(), 1 );
+
+            SharedSampleBuffer placeholder = placeholders.value( sampleBuffer.data() );
+
+            expect( ! placeholder.isNull() );
+            expectEquals( placeholder->getNumFrames(), 0 );
+            expectEquals( placeholder->getNumChannels(), 2 );
+            expectEquals( sampleBuffer->getNumFrames(), 1000, "Spilled buffer changed in place" );
+            expectEquals( accountant.getNumSpilledBytes(), stereoNumBytes );
+            expect( accountant.getTempDirNumBytes() >= stereoNumBytes );
+
+            MemoryAccountant::Usage usage;
+            usage.addSampleBuffers( MemoryAccountant::UNDO_HISTORY, QList<SharedSampleBuffer>() << placeholder );
+
+            expectEquals( usage.getTotalNumBytes(), (qint64) 0, "Placeholder counted" );
+
+            SharedSampleBuffer restoredBuffer = accountant.restore( placeholder );
+
+            expect( ! restoredBuffer.isNull() );
+            expect( restoredBuffer != placeholder );
+            expectBuffersEqual( *restoredBuffer, *sampleBuffer );
+            expectEquals( accountant.getNumSpilledBytes(), (qint64) 0, "Restored data counted as spilled" );
+
+            expect( accountant.restore( placeholder ) == restoredBuffer, "Placeholder read twice" );
+
+            placeholder.clear();
+            restoredBuffer.clear();
+
+            expectEquals( accountant.getNumSpilledBytes(), (qint64) 0 );
+            expectEquals( accountant.getTempDirNumBytes(), (qint64) 0, "Temp file left behind" );
+        }
+
+        beginTest( "Restoring buffers that weren't spilled" );
+        {
+            MemoryAccountant accountant( tempDirPath, fileHandler );
+
+            const SharedSampleBuffer sampleBuffer = createSampleBuffer( 1, 500 );
+
+            expect( accountant.restore( sampleBuffer ) == sampleBuffer );
+        }
+
+        beginTest( "Unreadable spill files" );
+        {
+            MemoryAccountant accountant( tempDirPath, fileHandler );
+
+            const QSharedPointer<MemoryAccountant::SpillJob> job = accountant.createSpillJob( QList<SharedSampleBuffer>() << createSampleBuffer( 1, 500 ),
+                                                                                             SAMPLE_RATE );
+            job->run();
+
+            const SharedSampleBuffer placeholder = accountant.takePlaceholders( *job ).values().first();
+
+            expect( QFile::remove( job->getFilePaths().first() ) );
+
+            expect( accountant.restore( placeholder ).isNull(), "Missing file restored" );
+            expectEquals( accountant.getNumSpilledBytes(), monoNumBytes, "Failed restore forgotten" );
+        }
+
+        beginTest( "Deleted placeholders are forgotten" );
+        {
+            MemoryAccountant accountant( tempDirPath, fileHandler );
+
+            const QSharedPointer<MemoryAccountant::SpillJob> job = accountant.createSpillJob( QList<SharedSampleBuffer>() << createSampleBuffer( 1, 500 ),
+                                                                                             SAMPLE_RATE );
+            job->run();
+
+            QHash<const SampleBuffer*, SharedSampleBuffer> placeholders = accountant.takePlaceholders( *job );
+
+            expectEquals( accountant.getNumSpilledBytes(), monoNumBytes );
+
+            placeholders.clear();
+
+            expectEquals( accountant.getNumSpilledBytes(), (qint64) 0 );
+            expectEquals( accountant.getTempDirNumBytes(), (qint64) 0, "Temp file left behind" );
+        }
+
+        beginTest( "No temp dir" );
+        {
+            MemoryAccountant noTempDirAccountant( QString(), fileHandler );
+
+            expect( noTempDirAccountant.createSpillJob( QList<SharedSampleBuffer>() << createSampleBuffer( 1, 500 ), SAMPLE_RATE ).isNull() );
+        }
+
+        tempDir.deleteRecursively();
+    }
+
+private:
+    static const int SAMPLE_RATE = 44100;
+
+    static SharedSampleBuffer createSampleBuffer( const int numChans, const int numFrames )
+    {
+        SharedSampleBuffer sampleBuffer( new SampleBuffer( numChans, numFrames ) );
+
+        for ( int chanNum = 0; chanNum < numChans; chanNum++ )
+        {
+            for ( int frameNum = 0; frameNum < numFrames; frameNum++ )
+            {
+                sampleBuffer->setSample( chanNum, frameNum, std::sin( frameNum * 0.01f * ( chanNum + 1 ) ) );
+            }
+        }
+
+        return sampleBuffer;
+    }
+
+    void expectBuffersEqual( const SampleBuffer& sampleBuffer, const SampleBuffer& expected )
+    {
+        expectEquals( sampleBuffer.getNumChannels(), expected.getNumChannels() );
+        expectEquals( sampleBuffer.getNumFrames(), expected.getNumFrames() );
+
+        if ( sampleBuffer.getNumChannels() != expected.getNumChannels() || sampleBuffer.getNumFrames() != expected.getNumFrames() )
+        {
+            return;
+        }
+
+        for ( int chanNum = 0; chanNum < expected.getNumChannels(); chanNum++ )
+        {
+            for ( int frameNum = 0; frameNum < expected.getNumFrames(); frameNum++ )
+            {
+                if ( std::abs( sampleBuffer.getSample( chanNum, frameNum ) - expected.getSample( chanNum, frameNum ) ) > 1.0e-6f )
+                {
+                    expect( false, "Sample data differs at channel " + String( chanNum ) + ", frame " + String( frameNum ) );
+                    return;
+                }
+            }
+        }
+    }
+};
+
+static MemoryAccountantTests memoryAccountantTests;
@@ -0,0 +1,122 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "memorylocker.h"
+
+
+// Registers buffers with MemoryLocker and checks what it reports. Whether the memory ends up
+// locked or only prefaulted depends on RLIMIT_MEMLOCK, so only the total is checked
+class MemoryLockerTests : public UnitTest
+{
+public:
+    MemoryLockerTests() : UnitTest( "MemoryLocker" ) {}
+
+    void runTest()
+    {
+        const int64 bufferBytes = 2 * NUM_FRAMES * sizeof( float );
+
+        beginTest( "Nothing is reported while disabled" );
+        {
+            MemoryLocker::setEnabled( false );
+
+            AudioSampleBuffer buffer( 2, NUM_FRAMES );
+            MemoryLocker::lock( buffer );
+
+            expectEquals( getTotalBytes(), (int64) 0 );
+
+            MemoryLocker::unlock( buffer );
+        }
+
+        beginTest( "Lock and unlock" );
+        {
+            MemoryLocker::setEnabled( true );
+
+            const int64 initialBytes = getTotalBytes();
+
+            AudioSampleBuffer buffer( 2, NUM_FRAMES );
+            MemoryLocker::lock( buffer );
+
+            expect( getTotalBytes() - initialBytes >= bufferBytes );
+
+            MemoryLocker::unlock( buffer );
+
+            expectEquals( getTotalBytes(), initialBytes );
+
+            MemoryLocker::setEnabled( false );
+        }
+
+        beginTest( "Nested calls" );
+        {
+            MemoryLocker::setEnabled( true );
+
+            const int64 initialBytes = getTotalBytes();
+
+            AudioSampleBuffer buffer( 2, NUM_FRAMES );
+            MemoryLocker::lock( buffer );
+
+            const int64 lockedBytes = getTotalBytes();
+
+            MemoryLocker::lock( buffer );
+
+            expectEquals( getTotalBytes(), lockedBytes, "Buffer was counted twice" );
+
+            MemoryLocker::unlock( buffer );
+
+            expectEquals( getTotalBytes(), lockedBytes, "Buffer was unregistered by the first unlock()" );
+
+            MemoryLocker::unlock( buffer );
+
+            expectEquals( getTotalBytes(), initialBytes );
+
+            MemoryLocker::setEnabled( false );
+        }
+
+        beginTest( "Buffers registered before enabling" );
+        {
+            AudioSampleBuffer buffer( 2, NUM_FRAMES );
+            MemoryLocker::lock( buffer );
+
+            MemoryLocker::setEnabled( true );
+
+            expect( getTotalBytes() >= bufferBytes );
+
+            MemoryLocker::setEnabled( false );
+
+            expectEquals( getTotalBytes(), (int64) 0 );
+
+            MemoryLocker::unlock( buffer );
+        }
+    }
+
+private:
+    static const int NUM_FRAMES = 100000;
+
+    static int64 getTotalBytes()
+    {
+        const MemoryLocker::Status status = MemoryLocker::getStatus();
+
+        return status.numBytesLocked + status.numBytesNotLocked;
+    }
+};
+
+static MemoryLockerTests memoryLockerTests;
@@ -0,0 +1,98 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "JuceHeader.h"
+#include "globals.h"
+
+
+// Checks how slices are assigned to MIDI channels and notes
+class MidiTests : public UnitTest
+{
+public:
+    MidiTests() : UnitTest( "Midi" ) {}
+
+    void runTest()
+    {
+        beginTest( "Key nos." );
+        {
+            expectEquals( Midi::getKeyNum( 1, 0 ), 0 );
+            expectEquals( Midi::getKeyNum( 1, Midi::MIDDLE_C ), Midi::MIDDLE_C );
+            expectEquals( Midi::getKeyNum( 2, 0 ), Midi::NUM_NOTES );
+            expectEquals( Midi::getKeyNum( Midi::NUM_CHANNELS, Midi::NUM_NOTES - 1 ), Midi::NUM_KEYS - 1 );
+
+            expectEquals( Midi::getChannel( Midi::NUM_NOTES - 1 ), 1 );
+            expectEquals( Midi::getNoteNum( Midi::NUM_NOTES - 1 ), Midi::NUM_NOTES - 1 );
+            expectEquals( Midi::getChannel( Midi::NUM_NOTES ), 2 );
+            expectEquals( Midi::getNoteNum( Midi::NUM_NOTES ), 0 );
+        }
+
+        beginTest( "Every key maps to a channel and note and back" );
+        {
+            for ( int keyNum = 0; keyNum < Midi::NUM_KEYS; keyNum++ )
+            {
+                const int channel = Midi::getChannel( keyNum );
+                const int noteNum = Midi::getNoteNum( keyNum );
+
+                expect( channel >= 1 && channel <= Midi::NUM_CHANNELS, "Key " + String( keyNum ) + " is on channel " + String( channel ) );
+                expect( noteNum >= 0 && noteNum < Midi::NUM_NOTES, "Key " + String( keyNum ) + " is note " + String( noteNum ) );
+                expectEquals( Midi::getKeyNum( channel, noteNum ), keyNum );
+            }
+        }
+
+        beginTest( "Start key" );
+        {
+            expectEquals( Midi::getStartKeyNum( 0 ), Midi::MIDDLE_C );
+            expectEquals( Midi::getStartKeyNum( 1 ), Midi::MIDDLE_C );
+            expectEquals( Midi::getStartKeyNum( Midi::NUM_NOTES - Midi::MIDDLE_C ), Midi::MIDDLE_C );
+            expectEquals( Midi::getStartKeyNum( Midi::NUM_NOTES - Midi::MIDDLE_C + 1 ), Midi::MIDDLE_C - 1 );
+            expectEquals( Midi::getStartKeyNum( Midi::NUM_NOTES - 1 ), 1 );
+            expectEquals( Midi::getStartKeyNum( Midi::NUM_NOTES ), 0 );
+            expectEquals( Midi::getStartKeyNum( Midi::NUM_NOTES + 1 ), 0 );
+            expectEquals( Midi::getStartKeyNum( Midi::NUM_KEYS ), 0 );
+        }
+
+        beginTest( "Slices stay on channel 1 while they fit" );
+        {
+            for ( int numSlices = 1; numSlices <= Midi::NUM_KEYS; numSlices++ )
+            {
+                const int startKeyNum = Midi::getStartKeyNum( numSlices );
+                const int endKeyNum = startKeyNum + numSlices - 1;
+
+                expect( endKeyNum < Midi::NUM_KEYS, String( numSlices ) + " slices run out of keys" );
+
+                if ( numSlices <= Midi::NUM_NOTES )
+                {
+                    expectEquals( Midi::getChannel( endKeyNum ), 1, String( numSlices ) + " slices spill onto channel 2" );
+                }
+                else
+                {
+                    // Channels are used in turn, with no gaps
+                    expectEquals( startKeyNum, 0 );
+                    expectEquals( Midi::getChannel( endKeyNum ), ( numSlices - 1 ) / Midi::NUM_NOTES + 1 );
+                }
+            }
+        }
+    }
+};
+
+static MidiTests midiTests;
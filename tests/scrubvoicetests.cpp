@@ -0,0 +1,173 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "scrubvoice.h"
+
+
+// Scrubs a sample of constant level, so that the output shows the gain of the overlapping grains
+// directly, and checks when the voice falls silent
+class ScrubVoiceTests : public UnitTest
+{
+public:
+    ScrubVoiceTests() : UnitTest( "ScrubVoice" ) {}
+
+    void runTest()
+    {
+        const SharedSampleBuffer sampleBuffer( new SampleBuffer( 1, SAMPLE_RATE ) );
+        FloatVectorOperations::fill( sampleBuffer->getWritePointer( 0 ), 1.0f, SAMPLE_RATE );
+
+        // A grain lasts GRAIN_SECS, i.e. 353 frames at 44.1 kHz
+        const int maxGrainLength = SAMPLE_RATE / 100;
+
+        beginTest( "Silent until a position is set" );
+        {
+            ScrubVoice voice;
+            voice.setPlaybackSampleRate( SAMPLE_RATE );
+
+            expectEquals( render( voice, 4096 ).getMagnitude( 0, 0, 4096 ), 0.0f );
+        }
+
+        beginTest( "Silent without a playback sample rate" );
+        {
+            ScrubVoice voice;
+            voice.setPosition( sampleBuffer, SAMPLE_RATE, 20000 );
+
+            expectEquals( render( voice, 4096 ).getMagnitude( 0, 0, 4096 ), 0.0f );
+        }
+
+        beginTest( "One grain while the position stays still" );
+        {
+            ScrubVoice voice;
+            voice.setPlaybackSampleRate( SAMPLE_RATE );
+            voice.setPosition( sampleBuffer, SAMPLE_RATE, 20000 );
+
+            const AudioSampleBuffer output = render( voice, 4096 );
+
+            expect( output.getMagnitude( 0, 0, maxGrainLength ) > 0.99f );
+            expect( output.getMagnitude( 0, 0, maxGrainLength ) <= 1.0f );
+            expectEquals( output.getMagnitude( 0, maxGrainLength, 4096 - maxGrainLength ), 0.0f );
+        }
+
+        beginTest( "Constant gain while moving" );
+        {
+            ScrubVoice voice;
+            voice.setPlaybackSampleRate( SAMPLE_RATE );
+
+            float minLevel = 1.0f;
+            float maxLevel = 0.0f;
+
+            for ( int blockNum = 0; blockNum < 100; blockNum++ )
+            {
+                voice.setPosition( sampleBuffer, SAMPLE_RATE, 20000 + blockNum * 50 );
+
+                const AudioSampleBuffer output = render( voice, 64 );
+
+                // Skip the fade in of the first grain
+                if ( blockNum * 64 >= maxGrainLength )
+                {
+                    for ( int chanNum = 0; chanNum < 2; chanNum++ )
+                    {
+                        Range<float> range = FloatVectorOperations::findMinAndMax( output.getReadPointer( chanNum ), 64 );
+
+                        minLevel = jmin( minLevel, range.getStart() );
+                        maxLevel = jmax( maxLevel, range.getEnd() );
+                    }
+                }
+            }
+
+            expect( minLevel > 0.99f, "Level dipped to " + String( minLevel ) );
+            expect( maxLevel <= 1.0f, "Level rose to " + String( maxLevel ) );
+        }
+
+        beginTest( "Silent after stopping" );
+        {
+            ScrubVoice voice;
+            voice.setPlaybackSampleRate( SAMPLE_RATE );
+
+            for ( int blockNum = 0; blockNum < 20; blockNum++ )
+            {
+                voice.setPosition( sampleBuffer, SAMPLE_RATE, 20000 + blockNum * 50 );
+                render( voice, 64 );
+            }
+
+            voice.stop();
+
+            // Grains already playing fade out as usual
+            const AudioSampleBuffer output = render( voice, 4096 );
+
+            expectEquals( output.getMagnitude( 0, maxGrainLength, 4096 - maxGrainLength ), 0.0f );
+        }
+
+        beginTest( "Silent straight after clearing" );
+        {
+            ScrubVoice voice;
+            voice.setPlaybackSampleRate( SAMPLE_RATE );
+            voice.setPosition( sampleBuffer, SAMPLE_RATE, 20000 );
+
+            render( voice, 64 );
+
+            voice.clear();
+
+            expectEquals( render( voice, 4096 ).getMagnitude( 0, 0, 4096 ), 0.0f );
+        }
+
+        beginTest( "Ends of the sample" );
+        {
+            const FrameNum positions[] = { 0, 1, SAMPLE_RATE - 2, SAMPLE_RATE - 1 };
+
+            for ( int i = 0; i < numElementsInArray( positions ); i++ )
+            {
+                ScrubVoice voice;
+                voice.setPlaybackSampleRate( SAMPLE_RATE );
+                voice.setPosition( sampleBuffer, SAMPLE_RATE, positions[ i ] );
+
+                const float magnitude = render( voice, 4096 ).getMagnitude( 0, 0, 4096 );
+
+                expect( magnitude > 0.0f && magnitude <= 1.0f,
+                        "Magnitude at frame " + String( positions[ i ] ) + " is " + String( magnitude ) );
+            }
+
+            // Past the end, the grain is clamped to the last frames of the sample
+            ScrubVoice voice;
+            voice.setPlaybackSampleRate( SAMPLE_RATE );
+            voice.setPosition( sampleBuffer, SAMPLE_RATE, SAMPLE_RATE + 1000 );
+
+            expect( render( voice, 4096 ).getMagnitude( 0, 0, 4096 ) <= 1.0f );
+        }
+    }
+
+private:
+    static const int SAMPLE_RATE = 44100;
+
+    static AudioSampleBuffer render( ScrubVoice& voice, const int numFrames )
+    {
+        AudioSampleBuffer outputBuffer( 2, numFrames );
+        outputBuffer.clear();
+
+        voice.renderNextBlock( outputBuffer, 0, numFrames );
+
+        return outputBuffer;
+    }
+};
+
+static ScrubVoiceTests scrubVoiceTests;
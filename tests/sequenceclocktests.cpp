@@ -0,0 +1,253 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "sequenceclock.h"
+#include "sampleraudiosource.h"
+#include "globals.h"
+
+
+// Renders "Play All" from a SamplerAudioSource offline, the way the audio device would, and checks
+// where each note-on lands against a reference timeline worked out for the whole sequence in one go
+class SequenceClockTests : public UnitTest
+{
+public:
+    SequenceClockTests() : UnitTest( "SequenceClock" ) {}
+
+    void runTest()
+    {
+        const int blockSizes[] = { 1, 3, 64, 256, 441, 512, 1000, 4096 };
+        const int numBlockSizes = numElementsInArray( blockSizes );
+
+        Array<FrameNum> sliceLengths;
+        sliceLengths.add( 1000 );
+        sliceLengths.add( 2205 );
+        sliceLengths.add( 37 );
+        sliceLengths.add( 44100 );
+        sliceLengths.add( 7919 );
+
+        beginTest( "Equal sample rates" );
+        {
+            const Array<FrameNum> reference = getReferenceTimeline( sliceLengths, 3, 44100, 44100 );
+
+            expectEquals( reference[ 1 ], (FrameNum) 1000 );
+            expectEquals( reference[ 5 ], (FrameNum) 55261 );
+
+            for ( int i = 0; i < numBlockSizes; i++ )
+            {
+                expectTimelinesEqual( playAll( sliceLengths, 3, blockSizes[ i ], 44100, 44100 ), reference, blockSizes[ i ] );
+            }
+        }
+
+        beginTest( "Different sample rates" );
+        {
+            const int sampleRates[][ 2 ] = { { 44100, 48000 }, { 48000, 44100 }, { 22050, 96000 }, { 96000, 44100 } };
+
+            for ( int rateNum = 0; rateNum < numElementsInArray( sampleRates ); rateNum++ )
+            {
+                const int sourceRate = sampleRates[ rateNum ][ 0 ];
+                const int playbackRate = sampleRates[ rateNum ][ 1 ];
+
+                const Array<FrameNum> reference = getReferenceTimeline( sliceLengths, 3, sourceRate, playbackRate );
+
+                for ( int i = 0; i < numBlockSizes; i++ )
+                {
+                    expectTimelinesEqual( playAll( sliceLengths, 3, blockSizes[ i ], sourceRate, playbackRate ),
+                                          reference,
+                                          blockSizes[ i ] );
+                }
+            }
+        }
+
+        beginTest( "No drift over many loops" );
+        {
+            const int numLoops = 500;
+            const Array<FrameNum> noteOnFrameNums = playAll( sliceLengths, numLoops, 512, 44100, 48000 );
+
+            FrameNum numSourceFrames = 0;
+
+            for ( int i = 0; i < noteOnFrameNums.size(); i++ )
+            {
+                const double idealFrameNum = numSourceFrames * 48000.0 / 44100.0;
+
+                expect( std::abs( noteOnFrameNums[ i ] - idealFrameNum ) < 1.0,
+                        "Note " + String( i ) + " is " + String( noteOnFrameNums[ i ] - idealFrameNum ) + " frames out" );
+
+                numSourceFrames += sliceLengths[ i % sliceLengths.size() ];
+            }
+        }
+
+        beginTest( "Empty slices" );
+        {
+            Array<FrameNum> emptySliceLengths;
+            emptySliceLengths.add( 0 );
+            emptySliceLengths.add( 0 );
+            emptySliceLengths.add( 100 );
+            emptySliceLengths.add( 0 );
+
+            const Array<FrameNum> reference = getReferenceTimeline( emptySliceLengths, 2, 44100, 44100 );
+
+            expectEquals( reference[ 1 ], (FrameNum) 1 );
+            expectEquals( reference[ 3 ], (FrameNum) 100 );
+            expectEquals( reference[ 4 ], (FrameNum) 101 );
+
+            for ( int i = 0; i < numBlockSizes; i++ )
+            {
+                expectTimelinesEqual( playAll( emptySliceLengths, 2, blockSizes[ i ], 44100, 44100 ), reference, blockSizes[ i ] );
+            }
+        }
+
+        beginTest( "Reset" );
+        {
+            SequenceClock clock;
+            clock.setSampleRates( 44100, 48000 );
+
+            clock.addNote( 1000 );
+            clock.advanceBlock( 512 );
+            clock.advanceBlock( 512 );
+
+            clock.reset();
+
+            expect( clock.isNoteOnDue( 1 ) );
+            expectEquals( clock.getNoteOnOffset(), 0 );
+        }
+    }
+
+private:
+    static const int NUM_CHANS = 2;
+
+    // Plays silent slices of the given lengths with "Play All" and looping enabled, and returns the
+    // playback frame no. of each note-on that SamplerAudioSource passes to its sampler
+    Array<FrameNum> playAll( const Array<FrameNum>& sliceLengths,
+                             const int numLoops,
+                             const int blockSize,
+                             const int sourceSampleRate,
+                             const int playbackSampleRate )
+    {
+        const int numNotes = sliceLengths.size() * numLoops;
+
+        QList<SharedSampleBuffer> sampleBufferList;
+
+        for ( int i = 0; i < sliceLengths.size(); i++ )
+        {
+            SharedSampleBuffer sampleBuffer( new SampleBuffer( NUM_CHANS, static_cast<int>( sliceLengths[ i ] ) ) );
+            sampleBuffer->clear();
+
+            sampleBufferList << sampleBuffer;
+        }
+
+        SamplerAudioSource samplerSource;
+
+        samplerSource.setSamples( sampleBufferList, sourceSampleRate );
+        samplerSource.prepareToPlay( blockSize, playbackSampleRate );
+        samplerSource.setLooping( true );
+        samplerSource.playAll();
+
+        AudioSampleBuffer outputBuffer( NUM_CHANS, blockSize );
+        const AudioSourceChannelInfo info( &outputBuffer, 0, blockSize );
+        MidiBuffer midiBuffer;
+
+        const int firstKeyNum = samplerSource.getLowestAssignedMidiNote();
+
+        Array<FrameNum> noteOnFrameNums;
+        FrameNum blockStartFrameNum = 0;
+
+        while ( noteOnFrameNums.size() < numNotes )
+        {
+            samplerSource.getNextAudioBlock( info, midiBuffer );
+
+            MidiBuffer::Iterator iterator( midiBuffer );
+            MidiMessage message;
+            int offset;
+
+            while ( noteOnFrameNums.size() < numNotes && iterator.getNextEvent( message, offset ) )
+            {
+                if ( message.isNoteOn() )
+                {
+                    expect( offset >= 0 && offset < blockSize, "Note-on offset " + String( offset ) + " is outside the block" );
+
+                    const int sliceNum = Midi::getKeyNum( message.getChannel(), message.getNoteNumber() ) - firstKeyNum;
+
+                    if ( sliceNum != noteOnFrameNums.size() % sliceLengths.size() )
+                    {
+                        expect( false, "Note " + String( noteOnFrameNums.size() ) + " plays slice " + String( sliceNum ) );
+                        return noteOnFrameNums;
+                    }
+
+                    noteOnFrameNums.add( blockStartFrameNum + offset );
+                }
+            }
+
+            blockStartFrameNum += blockSize;
+        }
+
+        samplerSource.releaseResources();
+
+        return noteOnFrameNums;
+    }
+
+    // Each note starts where the slices before it end, converted to the playback rate and rounded
+    // down, but never less than one frame after the previous note
+    static Array<FrameNum> getReferenceTimeline( const Array<FrameNum>& sliceLengths,
+                                                 const int numLoops,
+                                                 const int sourceSampleRate,
+                                                 const int playbackSampleRate )
+    {
+        Array<FrameNum> noteOnFrameNums;
+        FrameNum numSourceFrames = 0;
+
+        for ( int i = 0; i < sliceLengths.size() * numLoops; i++ )
+        {
+            FrameNum frameNum = numSourceFrames * playbackSampleRate / sourceSampleRate;
+
+            if ( i > 0 )
+            {
+                frameNum = jmax( frameNum, noteOnFrameNums.getLast() + 1 );
+            }
+
+            noteOnFrameNums.add( frameNum );
+            numSourceFrames += sliceLengths[ i % sliceLengths.size() ];
+        }
+
+        return noteOnFrameNums;
+    }
+
+    void expectTimelinesEqual( const Array<FrameNum>& noteOnFrameNums,
+                               const Array<FrameNum>& reference,
+                               const int blockSize )
+    {
+        expectEquals( noteOnFrameNums.size(), reference.size() );
+
+        for ( int i = 0; i < jmin( noteOnFrameNums.size(), reference.size() ); i++ )
+        {
+            if ( noteOnFrameNums[ i ] != reference[ i ] )
+            {
+                expect( false, "Block size " + String( blockSize ) + ": note " + String( i ) + " starts at frame " +
+                               String( noteOnFrameNums[ i ] ) + " instead of " + String( reference[ i ] ) );
+                return;
+            }
+        }
+    }
+};
+
+
+static SequenceClockTests sequenceClockTests;
@@ -0,0 +1,232 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "shurikensampler.h"
+
+
+// Plays notes on a ShurikenSampler and checks which voices are choked or stolen to make room
+class ShurikenSamplerTests : public UnitTest
+{
+public:
+    ShurikenSamplerTests() : UnitTest( "ShurikenSampler" ) {}
+
+    void runTest()
+    {
+        beginTest( "Choke groups" );
+        {
+            ShurikenSampler sampler;
+            setUp( sampler, 8, 4 );
+
+            setChokeGroup( sampler, 0, 1 );
+            setChokeGroup( sampler, 1, 1 );
+            setChokeGroup( sampler, 2, 2 );
+
+            sampler.noteOn( 1, 0, 1.0f );
+            sampler.noteOn( 1, 2, 1.0f );
+            sampler.noteOn( 1, 3, 1.0f );
+            sampler.noteOn( 1, 1, 1.0f );
+
+            expect( findVoice( sampler, 0 )->isFadingOut(), "Sound in the same choke group wasn't cut off" );
+            expect( ! findVoice( sampler, 1 )->isFadingOut() );
+            expect( ! findVoice( sampler, 2 )->isFadingOut(), "Sound in a different choke group was cut off" );
+            expect( ! findVoice( sampler, 3 )->isFadingOut(), "Sound in no choke group was cut off" );
+
+            render( sampler, 1000 );
+
+            expect( findVoice( sampler, 0 ) == NULL, "Choked voice didn't stop after fading out" );
+            expectEquals( getNumActiveVoices( sampler ), 3 );
+        }
+
+        beginTest( "Voice limit fades out the oldest of equally loud voices" );
+        {
+            ShurikenSampler sampler;
+            setUp( sampler, 8, 3 );
+            sampler.setVoiceLimit( 2 );
+
+            sampler.noteOn( 1, 0, 1.0f );
+            render( sampler, 100 );
+            sampler.noteOn( 1, 1, 1.0f );
+            render( sampler, 100 );
+            sampler.noteOn( 1, 2, 1.0f );
+
+            expect( findVoice( sampler, 0 )->isFadingOut() );
+            expect( ! findVoice( sampler, 1 )->isFadingOut() );
+            expect( ! findVoice( sampler, 2 )->isFadingOut() );
+        }
+
+        beginTest( "Voice limit fades out the quietest voice" );
+        {
+            ShurikenSampler sampler;
+            setUp( sampler, 8, 3 );
+            sampler.setVoiceLimit( 2 );
+
+            sampler.noteOn( 1, 0, 1.0f );
+            sampler.noteOn( 1, 1, 0.2f );
+            sampler.noteOn( 1, 2, 1.0f );
+
+            expect( ! findVoice( sampler, 0 )->isFadingOut() );
+            expect( findVoice( sampler, 1 )->isFadingOut() );
+            expect( ! findVoice( sampler, 2 )->isFadingOut() );
+        }
+
+        beginTest( "Voices fading out are bounded" );
+        {
+            ShurikenSampler sampler;
+            setUp( sampler, 32, 20 );
+            sampler.setVoiceLimit( 1 );
+
+            for ( int noteNum = 0; noteNum < 20; noteNum++ )
+            {
+                sampler.noteOn( 1, noteNum, 1.0f );
+
+                // ShurikenSampler::MAX_NUM_FADING_VOICES is 8
+                expect( getNumFadingVoices( sampler ) <= 8, String( getNumFadingVoices( sampler ) ) + " voices fading out" );
+                expectEquals( getNumActiveVoices( sampler ) - getNumFadingVoices( sampler ), 1 );
+            }
+
+            expect( findVoice( sampler, 19 ) != NULL && ! findVoice( sampler, 19 )->isFadingOut() );
+        }
+
+        beginTest( "Quietest voice is stolen when every voice is busy" );
+        {
+            ShurikenSampler sampler;
+            setUp( sampler, 2, 3 );
+
+            sampler.noteOn( 1, 0, 1.0f );
+            sampler.noteOn( 1, 1, 0.3f );
+            sampler.noteOn( 1, 2, 1.0f );
+
+            expect( findVoice( sampler, 0 ) != NULL );
+            expect( findVoice( sampler, 1 ) == NULL, "Quietest voice wasn't stolen" );
+            expect( findVoice( sampler, 2 ) != NULL );
+        }
+
+        beginTest( "No voice limit" );
+        {
+            ShurikenSampler sampler;
+            setUp( sampler, 4, 4 );
+
+            for ( int noteNum = 0; noteNum < 4; noteNum++ )
+            {
+                sampler.noteOn( 1, noteNum, 1.0f );
+            }
+
+            expectEquals( getNumActiveVoices( sampler ), 4 );
+            expectEquals( getNumFadingVoices( sampler ), 0 );
+        }
+    }
+
+private:
+    static const int SAMPLE_RATE = 44100;
+
+    // Adds 'numSounds' one second sounds on MIDI channel 1, from note 0 upwards
+    static void setUp( ShurikenSampler& sampler, const int numVoices, const int numSounds )
+    {
+        for ( int i = 0; i < numVoices; i++ )
+        {
+            sampler.addVoice( new ShurikenSamplerVoice() );
+        }
+
+        for ( int noteNum = 0; noteNum < numSounds; noteNum++ )
+        {
+            SharedSampleBuffer sampleBuffer( new SampleBuffer( 2, SAMPLE_RATE ) );
+
+            for ( int chanNum = 0; chanNum < 2; chanNum++ )
+            {
+                FloatVectorOperations::fill( sampleBuffer->getWritePointer( chanNum ), 0.5f, SAMPLE_RATE );
+            }
+
+            BigInteger noteNums;
+            noteNums.setBit( noteNum );
+
+            sampler.addSamplerSound( new ShurikenSamplerSound( sampleBuffer, SAMPLE_RATE, 1, noteNums, noteNum ) );
+        }
+
+        sampler.setCurrentPlaybackSampleRate( SAMPLE_RATE );
+    }
+
+    static void setChokeGroup( ShurikenSampler& sampler, const int noteNum, const int groupNum )
+    {
+        static_cast<ShurikenSamplerSound*>( sampler.getSound( noteNum ) )->setChokeGroup( groupNum );
+    }
+
+    static void render( ShurikenSampler& sampler, const int numFrames )
+    {
+        AudioSampleBuffer outputBuffer( 2, numFrames );
+        outputBuffer.clear();
+
+        MidiBuffer midiBuffer;
+
+        sampler.renderNextBlock( outputBuffer, midiBuffer, 0, numFrames );
+    }
+
+    // Returns NULL if no active voice is playing 'noteNum'
+    static ShurikenSamplerVoice* findVoice( const ShurikenSampler& sampler, const int noteNum )
+    {
+        for ( int i = 0; i < sampler.getNumVoices(); i++ )
+        {
+            ShurikenSamplerVoice* const voice = static_cast<ShurikenSamplerVoice*>( sampler.getVoice( i ) );
+
+            if ( voice->isVoiceActive() && voice->getCurrentlyPlayingNote() == noteNum )
+            {
+                return voice;
+            }
+        }
+
+        return NULL;
+    }
+
+    static int getNumActiveVoices( const ShurikenSampler& sampler )
+    {
+        int numVoices = 0;
+
+        for ( int i = 0; i < sampler.getNumVoices(); i++ )
+        {
+            if ( sampler.getVoice( i )->isVoiceActive() )
+            {
+                numVoices++;
+            }
+        }
+
+        return numVoices;
+    }
+
+    static int getNumFadingVoices( const ShurikenSampler& sampler )
+    {
+        int numVoices = 0;
+
+        for ( int i = 0; i < sampler.getNumVoices(); i++ )
+        {
+            const ShurikenSamplerVoice* const voice = static_cast<ShurikenSamplerVoice*>( sampler.getVoice( i ) );
+
+            if ( voice->isVoiceActive() && voice->isFadingOut() )
+            {
+                numVoices++;
+            }
+        }
+
+        return numVoices;
+    }
+};
+
+static ShurikenSamplerTests shurikenSamplerTests;
@@ -0,0 +1,211 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+#include "JuceHeader.h"
+#include "stretchergovernor.h"
+
+
+// Feeds a StretcherGovernor made-up processing times, as RubberbandAudioSource would measure them,
+// and checks when it lowers and raises quality
+class StretcherGovernorTests : public UnitTest
+{
+public:
+    StretcherGovernorTests() : UnitTest( "StretcherGovernor" ) {}
+
+    void runTest()
+    {
+        beginTest( "Step down when the load exceeds MAX_LOAD" );
+        {
+            StretcherGovernor governor;
+
+            expect( ! update( governor, StretcherGovernor::MAX_LOAD ) );
+            expectEquals( (int) governor.getLevel(), (int) StretcherGovernor::LEVEL_FULL_QUALITY );
+
+            expect( update( governor, StretcherGovernor::MAX_LOAD + 0.01 ) );
+            expectEquals( (int) governor.getLevel(), (int) StretcherGovernor::LEVEL_FAST_PITCH_SHIFTING );
+        }
+
+        beginTest( "Overloads are ignored while a new level settles" );
+        {
+            StretcherGovernor governor;
+
+            update( governor, 1.0 );
+
+            const int numSettleCycles = int( StretcherGovernor::SETTLE_SECS / PERIOD_SECS );
+
+            for ( int i = 0; i < numSettleCycles - 1; i++ )
+            {
+                expect( ! update( governor, 1.0 ), "Stepped down during the settle window" );
+            }
+
+            expectEquals( (int) governor.getLevel(), (int) StretcherGovernor::LEVEL_FAST_PITCH_SHIFTING );
+
+            const double secs = runUntilChange( governor, 1.0, 1.0 );
+
+            expect( secs > 0.0 && secs <= 3 * PERIOD_SECS, "Next step down took " + String( secs ) + " secs" );
+            expectEquals( (int) governor.getLevel(), (int) StretcherGovernor::LEVEL_SHIFTED_FORMANTS );
+        }
+
+        beginTest( "Step down stops at the lowest level" );
+        {
+            StretcherGovernor governor;
+
+            runFor( governor, 1.0, 10.0 );
+
+            expectEquals( (int) governor.getLevel(), StretcherGovernor::NUM_LEVELS - 1 );
+        }
+
+        beginTest( "Step up after the recovery time" );
+        {
+            StretcherGovernor governor;
+
+            update( governor, 1.0 );
+
+            const double secs = runUntilChange( governor, 0.1, 10.0 );
+
+            expectWithinAPeriod( secs, StretcherGovernor::MIN_RECOVERY_SECS );
+            expectEquals( (int) governor.getLevel(), (int) StretcherGovernor::LEVEL_FULL_QUALITY );
+        }
+
+        beginTest( "No step up while the load is above RECOVERY_LOAD" );
+        {
+            StretcherGovernor governor;
+
+            update( governor, 1.0 );
+
+            const double load = ( StretcherGovernor::RECOVERY_LOAD + StretcherGovernor::MAX_LOAD ) / 2.0;
+
+            expectEquals( runUntilChange( governor, load, StretcherGovernor::MAX_RECOVERY_SECS * 2.0 ), -1.0 );
+            expectEquals( (int) governor.getLevel(), (int) StretcherGovernor::LEVEL_FAST_PITCH_SHIFTING );
+        }
+
+        beginTest( "Recovery time doubles up to MAX_RECOVERY_SECS" );
+        {
+            StretcherGovernor governor;
+
+            update( governor, 1.0 );
+
+            double recoverySecs = StretcherGovernor::MIN_RECOVERY_SECS;
+
+            for ( int i = 0; i < 8; i++ )
+            {
+                expectWithinAPeriod( runUntilChange( governor, 0.1, 100.0 ), recoverySecs );
+
+                // Overloaded again as soon as the new level has settled
+                expect( runUntilChange( governor, 1.0, 1.0 ) > 0.0 );
+
+                recoverySecs = jmin( recoverySecs * 2.0, StretcherGovernor::MAX_RECOVERY_SECS );
+            }
+
+            expectEquals( recoverySecs, StretcherGovernor::MAX_RECOVERY_SECS );
+        }
+
+        beginTest( "Recovery time doesn't double after a late overload" );
+        {
+            StretcherGovernor governor;
+
+            update( governor, 1.0 );
+
+            expectWithinAPeriod( runUntilChange( governor, 0.1, 10.0 ), StretcherGovernor::MIN_RECOVERY_SECS );
+
+            // Full quality holds for longer than the recovery time before the next overload
+            runFor( governor, 0.5, StretcherGovernor::MIN_RECOVERY_SECS * 2.0 );
+            update( governor, 1.0 );
+
+            expectWithinAPeriod( runUntilChange( governor, 0.1, 10.0 ), StretcherGovernor::MIN_RECOVERY_SECS );
+        }
+
+        beginTest( "Reset" );
+        {
+            StretcherGovernor governor;
+
+            runFor( governor, 1.0, 1.0 );
+
+            governor.reset();
+
+            expectEquals( (int) governor.getLevel(), (int) StretcherGovernor::LEVEL_FULL_QUALITY );
+            expect( update( governor, 1.0 ), "Reset didn't end the settle window" );
+        }
+
+        beginTest( "Options" );
+        {
+            StretcherGovernor governor;
+
+            const RubberBandStretcher::Options transients = RubberBandStretcher::OptionTransientsCrisp;
+            const RubberBandStretcher::Options phase = RubberBandStretcher::OptionPhaseLaminar;
+            const RubberBandStretcher::Options formant = RubberBandStretcher::OptionFormantPreserved;
+            const RubberBandStretcher::Options pitch = RubberBandStretcher::OptionPitchHighQuality;
+
+            expectEquals( governor.getTransientsOption( transients ), transients );
+            expectEquals( governor.getPhaseOption( phase ), phase );
+            expectEquals( governor.getFormantOption( formant ), formant );
+            expectEquals( governor.getPitchOption( pitch ), pitch );
+
+            runFor( governor, 1.0, 10.0 );
+
+            expectEquals( governor.getTransientsOption( transients ), (int) RubberBandStretcher::OptionTransientsSmooth );
+            expectEquals( governor.getPhaseOption( phase ), (int) RubberBandStretcher::OptionPhaseIndependent );
+            expectEquals( governor.getFormantOption( formant ), (int) RubberBandStretcher::OptionFormantShifted );
+            expectEquals( governor.getPitchOption( pitch ), (int) RubberBandStretcher::OptionPitchHighSpeed );
+        }
+    }
+
+private:
+    static constexpr double PERIOD_SECS = 0.01;
+
+    // Processes one cycle at 'load', the fraction of the cycle's duration taken to process it
+    static bool update( StretcherGovernor& governor, const double load )
+    {
+        return governor.update( load * PERIOD_SECS, PERIOD_SECS );
+    }
+
+    static void runFor( StretcherGovernor& governor, const double load, const double secs )
+    {
+        for ( double elapsedSecs = 0.0; elapsedSecs < secs; elapsedSecs += PERIOD_SECS )
+        {
+            update( governor, load );
+        }
+    }
+
+    // Returns the time taken for the level to change, or -1.0 if it hasn't changed within 'maxSecs'
+    static double runUntilChange( StretcherGovernor& governor, const double load, const double maxSecs )
+    {
+        for ( double elapsedSecs = PERIOD_SECS; elapsedSecs <= maxSecs; elapsedSecs += PERIOD_SECS )
+        {
+            if ( update( governor, load ) )
+            {
+                return elapsedSecs;
+            }
+        }
+
+        return -1.0;
+    }
+
+    void expectWithinAPeriod( const double secs, const double expectedSecs )
+    {
+        expect( std::abs( secs - expectedSecs ) <= PERIOD_SECS * 1.5,
+                "Took " + String( secs ) + " secs instead of " + String( expectedSecs ) );
+    }
+};
+
+static StretcherGovernorTests stretcherGovernorTests;
@@ -0,0 +1,89 @@
+# -------------------------------------------------
+# Unit tests, built separately from Shuriken itself:
+#
+#   qmake tests/tests.pro && make && ./shuriken_tests
+#
+# Each *tests.cpp file registers juce::UnitTest instances which main.cpp runs. Only the sources
+# under test are compiled in, so the tests don't need an audio device, a display or a project.
+#
+# "qmake CONFIG+=rtcheck tests/tests.pro" also builds the audio graph tests, which render the audio
+# sources offline with the real-time safety checker linked in. See src/realtimechecker.h
+# -------------------------------------------------
+QMAKE_CXXFLAGS += -msse \
+    -msse2 \
+    -std=c++11
+QT += gui
+greaterThan( QT_MAJOR_VERSION, 4 ): QT += widgets
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = shuriken_tests
+TEMPLATE = app
+SOURCES += ../src/JuceLibraryCode/modules/juce_core/juce_core.cpp \
+    ../src/JuceLibraryCode/modules/juce_audio_basics/juce_audio_basics.cpp \
+    ../src/audioanalyser.cpp \
+    ../src/audiofilehandler.cpp \
+    ../src/audiofilereader.cpp \
+    ../src/jobscheduler.cpp \
+    ../src/libraryindex.cpp \
+    ../src/memoryaccountant.cpp \
+    ../src/memorylocker.cpp \
+    ../src/sampleraudiosource.cpp \
+    ../src/scrubvoice.cpp \
+    ../src/sequenceclock.cpp \
+    ../src/shurikensampler.cpp \
+    ../src/stretchergovernor.cpp \
+    ../src/thumbnailer.cpp \
+    ../src/waveformlayout.cpp \
+    main.cpp \
+    libraryindextests.cpp \
+    memoryaccountanttests.cpp \
+    memorylockertests.cpp \
+    midimessagecollector.cpp \
+    miditests.cpp \
+    scrubvoicetests.cpp \
+    sequenceclocktests.cpp \
+    shurikensamplertests.cpp \
+    stretchergovernortests.cpp \
+    waveformlayouttests.cpp
+HEADERS += ../src/audioanalyser.h \
+    ../src/audiofilehandler.h \
+    ../src/audiofilereader.h \
+    ../src/globals.h \
+    ../src/jobscheduler.h \
+    ../src/libraryindex.h \
+    ../src/memoryaccountant.h \
+    ../src/memorylocker.h \
+    ../src/realtimechecker.h \
+    ../src/sampleraudiosource.h \
+    ../src/scrubvoice.h \
+    ../src/sequenceclock.h \
+    ../src/samplebuffer.h \
+    ../src/shurikensampler.h \
+    ../src/stretchergovernor.h \
+    ../src/thumbnailer.h \
+    ../src/waveformlayout.h
+INCLUDEPATH += ../src \
+    ../src/SndLibShuriken \
+    ../src/JuceLibraryCode
+LIBS += -L$$PWD/../lib \
+    -lsndlib_shuriken \
+    -laubio \
+    -ldl \
+    -lpthread \
+    -lrt \
+    -lsndfile \
+    -lsamplerate
+unix:DEFINES += "LINUX=1"
+DEFINES += "DEBUG=1" \
+    "_DEBUG=1"
+
+rtcheck {
+    CONFIG += debug
+    DEFINES += "SHURIKEN_RTCHECK=1"
+    SOURCES += ../src/realtimechecker.cpp \
+        ../src/rubberbandaudiosource.cpp \
+        audiographtests.cpp
+    HEADERS += ../src/rubberbandaudiosource.h
+    LIBS += -lrubberband
+    QMAKE_LFLAGS += -rdynamic
+}
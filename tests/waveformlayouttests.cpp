@@ -0,0 +1,172 @@
+/*
+  This file is part of Shuriken Beat Slicer.
+
+  Copyright (C) 2015 Andrew M Taylor <a.m.taylor303@gmail.com>
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <https://www.gnu.org/licenses/>
+  or write to the Free Software Foundation, Inc., 51 Franklin Street,
+  Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+
+
+#include "waveformlayout.h"
+
+
+// Checks WaveformLayout against a plain running sum of the same lengths, through random changes
+class WaveformLayoutTests : public UnitTest
+{
+public:
+    WaveformLayoutTests() : UnitTest( "WaveformLayout" ) {}
+
+    void runTest()
+    {
+        beginTest( "No items" );
+        {
+            WaveformLayout layout;
+
+            expectEquals( layout.getNumItems(), 0 );
+            expectEquals( layout.getTotalLength(), (FrameNum) 0 );
+            expectEquals( layout.getStartOffset( 0 ), (FrameNum) 0 );
+            expectEquals( layout.findIndex( 0 ), -1 );
+            expectEquals( layout.findIndex( 100 ), -1 );
+        }
+
+        beginTest( "Item boundaries" );
+        {
+            QVector<FrameNum> lengths;
+            lengths << 100 << 0 << 50 << 200;
+
+            WaveformLayout layout;
+            layout.setLengths( lengths );
+
+            expectEquals( layout.getStartOffset( 2 ), (FrameNum) 100 );
+            expectEquals( layout.getTotalLength(), (FrameNum) 350 );
+
+            // An item of zero length is never found
+            expectEquals( layout.findIndex( -1 ), 0 );
+            expectEquals( layout.findIndex( 0 ), 0 );
+            expectEquals( layout.findIndex( 99 ), 0 );
+            expectEquals( layout.findIndex( 100 ), 2 );
+            expectEquals( layout.findIndex( 149 ), 2 );
+            expectEquals( layout.findIndex( 150 ), 3 );
+            expectEquals( layout.findIndex( 349 ), 3 );
+            expectEquals( layout.findIndex( 350 ), 3 );
+            expectEquals( layout.findIndex( 10000 ), 3 );
+
+            layout.clear();
+
+            expectEquals( layout.getNumItems(), 0 );
+            expectEquals( layout.getTotalLength(), (FrameNum) 0 );
+        }
+
+        beginTest( "Random lengths" );
+        {
+            Random random( 1 );
+
+            for ( int trialNum = 0; trialNum < 100; trialNum++ )
+            {
+                // Covers sizes either side of powers of two, where the tree's shape changes
+                const int numItems = random.nextInt( 70 );
+
+                QVector<FrameNum> lengths;
+
+                for ( int i = 0; i < numItems; i++ )
+                {
+                    lengths << getRandomLength( random );
+                }
+
+                WaveformLayout layout;
+                layout.setLengths( lengths );
+
+                expectMatches( layout, lengths );
+
+                for ( int changeNum = 0; changeNum < 50 && numItems > 0; changeNum++ )
+                {
+                    const int index = random.nextInt( numItems );
+
+                    lengths[ index ] = getRandomLength( random );
+                    layout.setLength( index, lengths.at( index ) );
+
+                    expectMatches( layout, lengths );
+                }
+            }
+        }
+    }
+
+private:
+    // One item in five is empty
+    static FrameNum getRandomLength( Random& random )
+    {
+        return random.nextInt( 5 ) == 0 ? 0 : random.nextInt( 100000 );
+    }
+
+    // Compares every start offset, the total and the item found at offsets in and around
+    // each item with the answers from a linear scan of 'lengths'
+    void expectMatches( const WaveformLayout& layout, const QVector<FrameNum>& lengths )
+    {
+        const int numItems = lengths.size();
+
+        expectEquals( layout.getNumItems(), numItems );
+
+        FrameNum startOffset = 0;
+        bool isMatching = true;
+
+        for ( int i = 0; i < numItems && isMatching; i++ )
+        {
+            isMatching = layout.getLength( i ) == lengths.at( i ) && layout.getStartOffset( i ) == startOffset;
+
+            const FrameNum endOffset = startOffset + lengths.at( i );
+
+            if ( lengths.at( i ) > 0 )
+            {
+                isMatching = isMatching &&
+                             layout.findIndex( startOffset ) == i &&
+                             layout.findIndex( endOffset - 1 ) == i &&
+                             layout.findIndex( ( startOffset + endOffset ) / 2 ) == i;
+            }
+
+            expect( isMatching, "Item " + String( i ) + " of " + String( numItems ) + " is out of place" );
+
+            startOffset = endOffset;
+        }
+
+        expectEquals( layout.getStartOffset( numItems ), startOffset );
+        expectEquals( layout.getTotalLength(), startOffset );
+
+        if ( numItems > 0 )
+        {
+            expectEquals( layout.findIndex( -1 ), 0 );
+            expectEquals( layout.findIndex( 0 ), findFirstNonEmpty( lengths ) );
+            expectEquals( layout.findIndex( startOffset ), numItems - 1 );
+        }
+    }
+
+    // Offset 0 belongs to the first item that has any length, or to the last item if none do
+    static int findFirstNonEmpty( const QVector<FrameNum>& lengths )
+    {
+        for ( int i = 0; i < lengths.size(); i++ )
+        {
+            if ( lengths.at( i ) > 0 )
+            {
+                return i;
+            }
+        }
+
+        return lengths.size() - 1;
+    }
+};
+
+static WaveformLayoutTests waveformLayoutTests;